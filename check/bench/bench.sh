@@ -0,0 +1,50 @@
+#!/bin/bash
+#=======================================================================
+# * Project: MediaTex
+# * Module:  benchmark
+# *
+# * Run the benchmark on a synthetic collection
+#
+# MediaTex is an Electronic Records Management System
+# Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#=======================================================================
+#set -x
+set -e
+
+# retrieve environment
+[ -z $srcdir ] && srcdir=.
+. utmediatex.sh
+
+# sizes may be overwritten: make bench BENCH_FLAGS="-A 100000"
+WORK=$PWD/bench/work
+
+if [ ! -f $CONFFILE ]; then
+    echo "no $CONFFILE: please run 'make check' first"
+    exit 1
+fi
+
+rm -fr $WORK
+install -m 750 -d $WORK
+
+# run the benchmark
+bench/benchmark -w $WORK -o bench/bench $BENCH_FLAGS \
+		>bench/bench.log 2>&1 || {
+    tail bench/bench.log
+    exit 1
+}
+
+rm -fr $WORK
+cat bench/bench.csv
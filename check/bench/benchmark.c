@@ -0,0 +1,1011 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : benchmark
+ *
+ * Time the load, scan, extract-score, cache, HTML and daemon entry
+ * points on a synthetic collection
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex-config.h"
+#include "server/mediatex-server.h"
+#include "client/mediatex-client.h"
+
+#define BENCH_MAX_PHASES 32
+
+typedef struct BenchParam {
+  int nbArchives;   // content archives
+  int nbContainers; // containers holding them
+  int nbServers;    // peers sharing remote supplies
+  int depth;        // containers nesting depth
+  int nbFiles;      // files written into the cache for scanCache
+} BenchParam;
+
+typedef struct BenchPhase {
+  char* label;
+  long items;
+  long long usec;
+} BenchPhase;
+
+static BenchPhase phases[BENCH_MAX_PHASES];
+static int nbPhases = 0;
+static struct timespec benchStart;
+
+static EType containerTypes[] = {TGZ, TBZ, ZIP, TAR, CPIO, AFIO};
+
+/*=======================================================================
+ * Function   : benchBegin, benchEnd
+ * Description: Time a phase
+ * Synopsis   : static void benchBegin()
+ *              static void benchEnd(char* label, long items)
+ * Input      : char* label: phase name (static string)
+ *              long items: number of items processed by the phase
+ * Output     : N/A
+ =======================================================================*/
+static void
+benchBegin()
+{
+  clock_gettime(CLOCK_MONOTONIC, &benchStart);
+}
+
+static void
+benchEnd(char* label, long items)
+{
+  struct timespec stop;
+  BenchPhase* phase = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  if (nbPhases >= BENCH_MAX_PHASES) return;
+  phase = phases + nbPhases++;
+  phase->label = label;
+  phase->items = items;
+  phase->usec = (stop.tv_sec - benchStart.tv_sec) * 1000000LL
+    + (stop.tv_nsec - benchStart.tv_nsec) / 1000;
+  logMain(LOG_NOTICE, "%-20s %8li items %12lli usec",
+	  label, items, phase->usec);
+}
+
+/*=======================================================================
+ * Function   : benchHash
+ * Description: Build a fake (but unique) md5sum
+ * Synopsis   : static void benchHash(char* hash, int kind, int i)
+ * Input      : int kind: archive family
+ *              int i: archive number
+ * Output     : char* hash: MAX_SIZE_MD5+1 buffer
+ =======================================================================*/
+static void
+benchHash(char* hash, int kind, int i)
+{
+  sprintf(hash, "%08x%024x", 0xbe4c0000 + kind, i);
+}
+
+/*=======================================================================
+ * Function   : benchRelocate
+ * Description: Make the collection write its files into a work
+ *              directory, so as the unit tests metadata is not altered
+ * Synopsis   : static int benchRelocate(Collection* coll, char* dir)
+ * Input      : Collection* coll
+ *              char* dir: absolute path to the work directory
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+benchRelocate(Collection* coll, char* dir)
+{
+  int rc = FALSE;
+  char** paths[] = {
+    &coll->catalogDB, &coll->serversDB, &coll->extractDB,
+    &coll->md5sumsDB, &coll->md5sumsJnl, &coll->snapshotDB,
+    &coll->cacheDir, &coll->htmlDir, &coll->htmlIndexDir,
+    &coll->htmlCacheDir, &coll->htmlScoreDir, &coll->htmlCgiDir};
+  char* names[] = {
+    "/catalog", "/servers", "/extract",
+    "/coll.md5", "/coll.jnl", "/coll.bin",
+    "/cache", "/html", "/html/index",
+    "/html/cache", "/html/score", "/html/cgi"};
+  int i = 0;
+
+  for (i=0; i<12; ++i) {
+    *paths[i] = destroyString(*paths[i]);
+    if (!(*paths[i] = createString(dir))
+	|| !(*paths[i] = catString(*paths[i], names[i]))) goto error;
+    if (i < 6) continue;
+    if (mkdir(*paths[i], 0750) && errno != EEXIST) {
+      logMain(LOG_ERR, "mkdir %s fails: %s", *paths[i], strerror(errno));
+      goto error;
+    }
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchRelocate fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchServers
+ * Description: Add the peers
+ * Synopsis   : static int benchServers(Collection* coll,
+ *                                      BenchParam* param, Server** out)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : Server** out: the nbServers added servers
+ *              TRUE on success
+ =======================================================================*/
+static int
+benchServers(Collection* coll, BenchParam* param, Server** out)
+{
+  int rc = FALSE;
+  Server* model = 0;
+  Server* server = 0;
+  char fingerPrint[MAX_SIZE_MD5+1];
+  char label[32];
+  int i = 0;
+
+  if (!(model = getLocalHost(coll))) goto error;
+  if (isEmptyString(model->userKey) || isEmptyString(model->hostKey)) {
+    logMain(LOG_ERR, "localhost has no keys: run make check first");
+    goto error;
+  }
+
+  for (i=0; i<param->nbServers; ++i) {
+    benchHash(fingerPrint, 0xff, i);
+    sprintf(label, "bench%i", i);
+    if (!(server = addServer(coll, fingerPrint))) goto error;
+    if (!(server->label = createString(label))
+	|| !(server->user = createString(label))
+	|| !(server->user = catString(server->user, "-"))
+	|| !(server->user = catString(server->user, coll->label))
+	|| !(server->comment = createString("benchmark peer"))
+	|| !(server->userKey = createString(model->userKey))
+	|| !(server->hostKey = createString(model->hostKey))) goto error;
+    snprintf(server->host, MAX_SIZE_HOST, "%s.mediatex.org", label);
+    server->mdtxPort = model->mdtxPort;
+    server->sshPort = model->sshPort;
+    server->wwwPort = model->wwwPort;
+    server->lastCommit = currentTime();
+    server->cacheSize = model->cacheSize;
+    server->cacheTTL = model->cacheTTL;
+    server->queryTTL = model->queryTTL;
+    out[i] = server;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchServers fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchExtract
+ * Description: Add the containers and the archives they hold
+ * Synopsis   : static int benchExtract(Collection* coll,
+ *                                 BenchParam* param, Server** servers)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ *              Server** servers: images are shared by these peers
+ * Output     : TRUE on success
+ * Note       : container c's archive is held by container c-1,
+ *              except every depth containers, whose archive is an
+ *              image published by a peer.
+ =======================================================================*/
+static int
+benchExtract(Collection* coll, BenchParam* param, Server** servers)
+{
+  int rc = FALSE;
+  Container** containers = 0;
+  Container* container = 0;
+  Archive* archive = 0;
+  Image* image = 0;
+  char hash[MAX_SIZE_MD5+1];
+  char path[64];
+  int nbTypes = sizeof(containerTypes) / sizeof(EType);
+  int i = 0;
+
+  if (!(containers = malloc(param->nbContainers * sizeof(Container*)))) {
+    logMain(LOG_ERR, "malloc fails: %s", strerror(errno));
+    goto error;
+  }
+
+  for (i=0; i<param->nbContainers; ++i) {
+    benchHash(hash, 1, i);
+    if (!(archive = addArchive(coll, hash, 1024 * (1 + i % 4096))))
+      goto error;
+    if (!(container =
+	  addContainer(coll, containerTypes[i % nbTypes], archive)))
+      goto error;
+    containers[i] = container;
+
+    if (i % param->depth) {
+      sprintf(path, "level%i/container%i", i % param->depth, i);
+      if (!addFromAsso(coll, archive, containers[i-1], path)) goto error;
+    }
+    else {
+      if (!(image = addImage(coll, servers[(i / param->depth)
+					  % param->nbServers], archive)))
+	goto error;
+      image->score = 10;
+    }
+  }
+
+  for (i=0; i<param->nbArchives; ++i) {
+    benchHash(hash, 2, i);
+    if (!(archive = addArchive(coll, hash, 1 + i % 65536))) goto error;
+    sprintf(path, "dir%i/file%i", i % 100, i);
+    if (!addFromAsso(coll, archive, containers[i % param->nbContainers],
+		     path)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchExtract fails");
+  }
+  if (containers) free(containers);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchCatalog
+ * Description: Add documents (10 archives each), humans and categories
+ * Synopsis   : static int benchCatalog(Collection* coll,
+ *                                      BenchParam* param)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+benchCatalog(Collection* coll, BenchParam* param)
+{
+  int rc = FALSE;
+  Category* categories[10];
+  Document* document = 0;
+  Human* human = 0;
+  Archive* archive = 0;
+  Carac* carac = 0;
+  Role* role = 0;
+  char hash[MAX_SIZE_MD5+1];
+  char label[32];
+  int i = 0;
+
+  if (!(carac = addCarac(coll, "bench"))) goto error;
+  if (!(role = addRole(coll, "author"))) goto error;
+  for (i=0; i<10; ++i) {
+    sprintf(label, "category%i", i);
+    if (!(categories[i] = addCategory(coll, label, TRUE))) goto error;
+    if (i && !addCategoryLink(coll, categories[(i-1)/3], categories[i]))
+      goto error;
+  }
+
+  for (i=0; i<param->nbArchives; ++i) {
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    if (i % 10 == 0) {
+      sprintf(label, "document%i", i / 10);
+      if (!(document = addDocument(coll, label))) goto error;
+      if (!addAssoCarac(coll, carac, DOC, document, label)) goto error;
+      if (!addDocumentToCategory(coll, document, categories[i % 100 / 10]))
+	goto error;
+    }
+    if (i % 100 == 0) {
+      sprintf(label, "human%i", i / 100);
+      if (!(human = addHuman(coll, label, "Bench"))) goto error;
+      if (!addHumanToCategory(coll, human, categories[i % 1000 / 100]))
+	goto error;
+    }
+    if (i % 10 == 0 && !addAssoRole(coll, role, human, document))
+      goto error;
+    if (!addArchiveToDocument(coll, archive, document)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchCatalog fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchRecords
+ * Description: Add a remote supply per archive, and a local supply
+ *              for every 10th archive
+ * Synopsis   : static int benchRecords(Collection* coll,
+ *                                 BenchParam* param, Server** servers)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ *              Server** servers: peers providing the remote supplies
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+benchRecords(Collection* coll, BenchParam* param, Server** servers)
+{
+  int rc = FALSE;
+  Archive* archive = 0;
+  Record* record = 0;
+  char hash[MAX_SIZE_MD5+1];
+  char path[64];
+  char* extra = 0;
+  int i = 0;
+
+  // journal writes are not what we are measuring here
+  coll->cacheTree->noJournal = TRUE;
+  coll->cacheTree->totalSize = 1024*GIGA;
+
+  for (i=0; i<param->nbArchives; ++i) {
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    sprintf(path, "dir%i/file%i", i % 100, i);
+
+    if (!(extra = createString(path))) goto error;
+    if (!(record = addRecord(coll, servers[i % param->nbServers],
+			     archive, SUPPLY, extra))) goto error;
+    extra = 0;
+    if (!addCacheEntry(coll, record)) goto error;
+
+    if (i % 10) continue;
+    if (!(extra = createString(path))) goto error;
+    if (!(record = addRecord(coll, coll->localhost,
+			     archive, SUPPLY, extra))) goto error;
+    extra = 0;
+    if (!addCacheEntry(coll, record)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchRecords fails");
+  }
+  coll->cacheTree->noJournal = FALSE;
+  extra = destroyString(extra);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchCacheFiles
+ * Description: Write small files into the cache for scanCache
+ * Synopsis   : static int benchCacheFiles(Collection* coll,
+ *                                         BenchParam* param)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+benchCacheFiles(Collection* coll, BenchParam* param)
+{
+  int rc = FALSE;
+  char* path = 0;
+  FILE* fd = 0;
+  char name[64];
+  int i = 0, j = 0;
+
+  sprintf(name, "/dir%i", 0);
+  for (i=0; i<param->nbFiles; ++i) {
+    if (i % 100 == 0) {
+      sprintf(name, "/dir%i", i / 100);
+      if (!(path = createString(coll->cacheDir))
+	  || !(path = catString(path, name))) goto error;
+      if (mkdir(path, 0750) && errno != EEXIST) {
+	logMain(LOG_ERR, "mkdir %s fails: %s", path, strerror(errno));
+	goto error;
+      }
+      path = destroyString(path);
+    }
+
+    sprintf(name, "/dir%i/scan%i", i / 100, i);
+    if (!(path = createString(coll->cacheDir))
+	|| !(path = catString(path, name))) goto error;
+    if (!(fd = fopen(path, "w"))) {
+      logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
+      goto error;
+    }
+    for (j=0; j<1024; ++j) fprintf(fd, "%i:%i\n", i, j);
+    if (fclose(fd)) {
+      logMain(LOG_ERR, "fclose fails: %s", strerror(errno));
+      goto error;
+    }
+    fd = 0;
+    path = destroyString(path);
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchCacheFiles fails");
+  }
+  if (fd) fclose(fd);
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchCacheAlloc
+ * Description: Allocate then free room for the first archives
+ * Synopsis   : static int benchCacheAlloc(Collection* coll,
+ *                                         BenchParam* param, long* nb)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : long* nb: number of allocations done
+ *              TRUE on success
+ =======================================================================*/
+static int
+benchCacheAlloc(Collection* coll, BenchParam* param, long* nb)
+{
+  int rc = FALSE;
+  Record** records = 0;
+  Archive* archive = 0;
+  char hash[MAX_SIZE_MD5+1];
+  int max = 0;
+  int i = 0;
+
+  *nb = 0;
+  max = param->nbArchives < 1000 ? param->nbArchives : 1000;
+  if (!(records = calloc(max, sizeof(Record*)))) {
+    logMain(LOG_ERR, "calloc fails: %s", strerror(errno));
+    goto error;
+  }
+
+  for (i=0; i<max; ++i) {
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    if (archive->state >= ALLOCATED) continue;
+    if (!cacheAlloc(records + i, coll, archive)) goto error;
+    ++*nb;
+  }
+
+  for (i=0; i<max; ++i) {
+    if (!records[i]) continue;
+    if (!delCacheEntry(coll, records[i])) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchCacheAlloc fails");
+  }
+  if (records) free(records);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchCgiServer
+ * Description: Query the archives through the cgi entry point
+ * Synopsis   : static int benchCgiServer(Collection* coll,
+ *                                        BenchParam* param, long* nb)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : long* nb: number of queries done
+ *              TRUE on success
+ * Note       : archives having a local supply are skipped, as their
+ *              files are not written into the cache
+ =======================================================================*/
+static int
+benchCgiServer(Collection* coll, BenchParam* param, long* nb)
+{
+  int rc = FALSE;
+  Connexion connexion;
+  Archive* archive = 0;
+  Record* record = 0;
+  char hash[MAX_SIZE_MD5+1];
+  char* extra = 0;
+  int max = 0;
+  int i = 0;
+
+  *nb = 0;
+  memset(&connexion, 0, sizeof(Connexion));
+  connexion.server = coll->localhost;
+  if (!(connexion.message = createRecordTree())) goto error;
+  connexion.message->collection = coll;
+  connexion.message->messageType = CGI;
+  strncpy(connexion.message->fingerPrint, coll->localhost->fingerPrint,
+	  MAX_SIZE_MD5);
+
+  max = param->nbArchives < 1000 ? param->nbArchives : 1000;
+  for (i=0; i<max; ++i) {
+    if (i % 10 == 0) continue;
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    if (!(extra = createString("!wanted"))) goto error;
+    if (!(record = addRecord(coll, coll->localhost, archive,
+			     DEMAND, extra))) goto error;
+    extra = 0;
+    if (!avl_insert(connexion.message->records, record)) {
+      logMain(LOG_ERR, "cannot add record (already there?)");
+      goto error;
+    }
+
+    if (!cgiServer(&connexion)) goto error;
+    ++*nb;
+
+    // unlink the query from the message, then from its archive
+    connexion.message->records->freeitem = 0;
+    avl_free_nodes(connexion.message->records);
+    connexion.message->records->freeitem = (void(*)(void*)) destroyRecord;
+    if (!delRecord(coll, record)) goto error;
+    record = 0;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchCgiServer fails");
+  }
+  extra = destroyString(extra);
+  if (record) {
+    connexion.message->records->freeitem = 0;
+    avl_free_nodes(connexion.message->records);
+    connexion.message->records->freeitem = (void(*)(void*)) destroyRecord;
+    delRecord(coll, record);
+  }
+  destroyRecordTree(connexion.message);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchDemands
+ * Description: Add a remote demand for every 10th archive not having
+ *              a local supply, so as extractArchives has work to do
+ * Synopsis   : static int benchDemands(Collection* coll,
+ *                                 BenchParam* param, Server** servers,
+ *                                 long* nb)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ *              Server** servers: peers asking for the archives
+ * Output     : long* nb: number of demands added
+ *              TRUE on success
+ =======================================================================*/
+static int
+benchDemands(Collection* coll, BenchParam* param, Server** servers,
+	     long* nb)
+{
+  int rc = FALSE;
+  Archive* archive = 0;
+  Record* record = 0;
+  char hash[MAX_SIZE_MD5+1];
+  char* extra = 0;
+  int i = 0;
+
+  *nb = 0;
+  coll->cacheTree->noJournal = TRUE;
+  for (i=5; i<param->nbArchives; i+=10) {
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    if (!(extra = createString("!wanted"))) goto error;
+    if (!(record = addRecord(coll, servers[i % param->nbServers],
+			     archive, DEMAND, extra))) goto error;
+    extra = 0;
+    if (!addCacheEntry(coll, record)) goto error;
+    ++*nb;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchDemands fails");
+  }
+  coll->cacheTree->noJournal = FALSE;
+  extra = destroyString(extra);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchFreeCache
+ * Description: Allocate room into a full cache, so as local supplies
+ *              have to be freed
+ * Synopsis   : static int benchFreeCache(Collection* coll,
+ *                                        BenchParam* param, long* nb)
+ * Input      : Collection* coll
+ *              BenchParam* param
+ * Output     : long* nb: number of allocations done
+ *              TRUE on success
+ * Note       : freeCache is static, cacheAlloc is its only caller
+ =======================================================================*/
+static int
+benchFreeCache(Collection* coll, BenchParam* param, long* nb)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  Record** records = 0;
+  Archive* archive = 0;
+  char hash[MAX_SIZE_MD5+1];
+  off_t totalSize = 0;
+  int max = 0;
+  int i = 0;
+
+  *nb = 0;
+  cache = coll->cacheTree;
+  totalSize = cache->totalSize;
+  max = param->nbArchives < 1000 ? param->nbArchives : 1000;
+  if (!(records = calloc(max, sizeof(Record*)))) {
+    logMain(LOG_ERR, "calloc fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // no room left: each allocation first frees some local supplies
+  cache->totalSize = cache->useSize + cache->partSize;
+  for (i=0; i<max; ++i) {
+    benchHash(hash, 2, i);
+    if (!(archive = getArchive(coll, hash, 1 + i % 65536))) goto error;
+    if (archive->state >= ALLOCATED) continue;
+    if (!cacheAlloc(records + i, coll, archive)) goto error;
+    if (records[i]) ++*nb;
+  }
+
+  for (i=0; i<max; ++i) {
+    if (!records[i]) continue;
+    if (!delCacheEntry(coll, records[i])) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchFreeCache fails");
+  }
+  cache->totalSize = totalSize;
+  if (records) free(records);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchParseRecords
+ * Description: Parse back the records file
+ * Synopsis   : static int benchParseRecords(Collection* coll, long* nb)
+ * Input      : Collection* coll
+ * Output     : long* nb: number of records parsed
+ *              TRUE on success
+ =======================================================================*/
+static int
+benchParseRecords(Collection* coll, long* nb)
+{
+  int rc = FALSE;
+  RecordTree* tree = 0;
+  int fd = -1;
+
+  if ((fd = open(coll->md5sumsDB, O_RDONLY)) == -1) {
+    logMain(LOG_ERR, "open %s fails: %s", coll->md5sumsDB, strerror(errno));
+    goto error;
+  }
+  if (!(tree = parseRecords(fd))) goto error;
+  *nb = avl_count(tree->records);
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchParseRecords fails");
+  }
+  if (fd != -1) close(fd);
+  tree = destroyRecordTree(tree);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : benchWrite
+ * Description: Write the results as CSV and JSON
+ * Synopsis   : static int benchWrite(char* prefix, BenchParam* param)
+ * Input      : char* prefix: output path without extension
+ *              BenchParam* param
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+benchWrite(char* prefix, BenchParam* param)
+{
+  int rc = FALSE;
+  char* path = 0;
+  FILE* fd = 0;
+  int i = 0;
+
+  if (!(path = createString(prefix))
+      || !(path = catString(path, ".csv"))) goto error;
+  if (!(fd = fopen(path, "w"))) {
+    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
+    goto error;
+  }
+  fprintf(fd, "version,archives,containers,servers,depth,"
+	  "phase,items,usec\n");
+  for (i=0; i<nbPhases; ++i) {
+    fprintf(fd, "%s,%i,%i,%i,%i,%s,%li,%lli\n", PACKAGE_VERSION,
+	    param->nbArchives, param->nbContainers, param->nbServers,
+	    param->depth, phases[i].label, phases[i].items, phases[i].usec);
+  }
+  if (fclose(fd)) goto error;
+  fd = 0;
+
+  path = destroyString(path);
+  if (!(path = createString(prefix))
+      || !(path = catString(path, ".json"))) goto error;
+  if (!(fd = fopen(path, "w"))) {
+    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
+    goto error;
+  }
+  fprintf(fd, "{\n  \"version\": \"%s\",\n", PACKAGE_VERSION);
+  fprintf(fd, "  \"parameters\": {\"archives\": %i, \"containers\": %i, "
+	  "\"servers\": %i, \"depth\": %i, \"files\": %i},\n",
+	  param->nbArchives, param->nbContainers, param->nbServers,
+	  param->depth, param->nbFiles);
+  fprintf(fd, "  \"phases\": [\n");
+  for (i=0; i<nbPhases; ++i) {
+    fprintf(fd, "    {\"phase\": \"%s\", \"items\": %li, \"usec\": %lli}%s\n",
+	    phases[i].label, phases[i].items, phases[i].usec,
+	    (i < nbPhases-1)?",":"");
+  }
+  fprintf(fd, "  ]\n}\n");
+  if (fclose(fd)) goto error;
+  fd = 0;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "benchWrite fails");
+  }
+  if (fd) fclose(fd);
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+  fprintf(stderr, " [ -w directory ] [ -o prefix ]"
+	  " [ -A archives ] [ -C containers ]"
+	  "\n\t\t[ -K servers ] [ -D depth ] [ -F files ]");
+
+  mdtxOptions();
+  fprintf(stderr, "  ---\n"
+	  "  -w, --work-dir\tabsolute path to a scratch directory\n"
+	  "  -o, --output\t\tresults path without .csv/.json extension\n"
+	  "  -A, --archives\tnumber of archives (10000)\n"
+	  "  -C, --containers\tnumber of containers (1000)\n"
+	  "  -K, --servers\t\tnumber of peers (10)\n"
+	  "  -D, --depth\t\tcontainers nesting depth (3)\n"
+	  "  -F, --files\t\tnumber of files to scan (100)\n");
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Benchmark on a synthetic collection
+ * Synopsis   : ./benchmark -w dir -o prefix
+ * Input      : N/A
+ * Output     : prefix.csv and prefix.json
+ * Note       : use the coll1 collection set up by make check, but
+ *              write its files into the work directory.
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  BenchParam param = {10000, 1000, 10, 3, 100};
+  char workDir[256] = "";
+  char output[256] = "bench";
+  Collection* coll = 0;
+  Server** servers = 0;
+  long nb = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"w:o:A:C:K:D:F:";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {"work-dir", required_argument, 0, 'w'},
+    {"output", required_argument, 0, 'o'},
+    {"archives", required_argument, 0, 'A'},
+    {"containers", required_argument, 0, 'C'},
+    {"servers", required_argument, 0, 'K'},
+    {"depth", required_argument, 0, 'D'},
+    {"files", required_argument, 0, 'F'},
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  env.dryRun = FALSE;
+  env.noGit = TRUE;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+    case 'w':
+    case 'o':
+      if(optarg == 0 || *optarg == (char)0 || strlen(optarg) > 255) {
+	fprintf(stderr, "%s: nil, empty or too long argument\n",
+		programName);
+	rc = EINVAL;
+	break;
+      }
+      strcpy(cOption == 'w' ? workDir : output, optarg);
+      break;
+
+    case 'A':
+      if ((param.nbArchives = atoi(optarg)) < 1) rc = EINVAL;
+      break;
+
+    case 'C':
+      if ((param.nbContainers = atoi(optarg)) < 1) rc = EINVAL;
+      break;
+
+    case 'K':
+      if ((param.nbServers = atoi(optarg)) < 1) rc = EINVAL;
+      break;
+
+    case 'D':
+      if ((param.depth = atoi(optarg)) < 1) rc = EINVAL;
+      break;
+
+    case 'F':
+      if ((param.nbFiles = atoi(optarg)) < 0) rc = EINVAL;
+      break;
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+  if (*workDir != '/') {
+    fprintf(stderr, "%s: please provide an absolute work directory\n",
+	    programName);
+    rc = EINVAL;
+    goto optError;
+  }
+
+  /************************************************************************/
+  if (!(servers = calloc(param.nbServers, sizeof(Server*)))) goto error;
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!loadCollection(coll, SERV|CTLG|EXTR|CACH)) goto error;
+  if (!benchRelocate(coll, workDir)) goto error2;
+
+  // generate
+  benchBegin();
+  if (!benchServers(coll, &param, servers)) goto error2;
+  if (!benchExtract(coll, &param, servers)) goto error2;
+  if (!benchCatalog(coll, &param)) goto error2;
+  benchEnd("generate", avl_count(coll->archives));
+  coll->extractTree->score = -1;
+  if (!computeExtractScore(coll)) goto error2;
+  benchBegin();
+  if (!benchRecords(coll, &param, servers)) goto error2;
+  benchEnd("addCacheEntry", avl_count(coll->cacheTree->recordTree->records));
+  coll->fileState[iCTLG] = MODIFIED;
+  coll->fileState[iEXTR] = MODIFIED;
+  coll->fileState[iSERV] = MODIFIED;
+  if (!releaseCollection(coll, SERV|CTLG|EXTR|CACH)) goto error;
+
+  // serialize then parse back
+  benchBegin();
+  if (!saveCollection(coll, SERV|CTLG|EXTR)) goto error;
+  benchEnd("saveCollection", avl_count(coll->archives));
+  benchBegin();
+  if (!serializeRecordTree(coll->cacheTree->recordTree,
+			   coll->md5sumsDB, 0)) goto error;
+  benchEnd("serializeRecordTree",
+	   avl_count(coll->cacheTree->recordTree->records));
+  benchBegin();
+  if (!benchParseRecords(coll, &nb)) goto error;
+  benchEnd("parseRecords", nb);
+
+  // load each file from disk
+  coll->fileState[iCACH] = LOADED; // already saved above
+  if (!diseaseCollection(coll, SERV|CTLG|EXTR|CACH)) goto error;
+  benchBegin();
+  if (!loadCollection(coll, SERV)) goto error;
+  benchEnd("loadServers", coll->serverTree->servers->nbItems);
+  benchBegin();
+  if (!loadCollection(coll, EXTR)) goto error3;
+  benchEnd("loadExtract", avl_count(coll->extractTree->containers));
+  benchBegin();
+  if (!loadCollection(coll, CTLG)) goto error4;
+  benchEnd("loadCatalog", avl_count(coll->catalogTree->documents));
+  benchBegin();
+  if (!loadCollection(coll, CACH)) goto error5;
+  benchEnd("loadRecords", avl_count(coll->cacheTree->recordTree->records));
+
+  // score and cache
+  benchBegin();
+  coll->extractTree->score = -1;
+  if (!computeExtractScore(coll)) goto error6;
+  benchEnd("computeExtractScore", avl_count(coll->archives));
+  benchBegin();
+  if (!benchCacheAlloc(coll, &param, &nb)) goto error6;
+  benchEnd("cacheAlloc", nb);
+
+  // daemon entry points: the peers are fictitious, so do not run any
+  // copy or extraction command
+  env.dryRun = TRUE;
+  benchBegin();
+  if (!benchCgiServer(coll, &param, &nb)) goto error7;
+  benchEnd("cgiServer", nb);
+  benchBegin();
+  if (!benchCgiServer(coll, &param, &nb)) goto error7;
+  benchEnd("cgiServerLookup", nb);
+  if (!benchDemands(coll, &param, servers, &nb)) goto error7;
+  benchBegin();
+  if (!extractArchives(coll)) goto error7;
+  benchEnd("extractArchives", nb);
+  benchBegin();
+  if (!sendRemoteNotify(coll)) goto error7;
+  benchEnd("sendRemoteNotify",
+	   avl_count(coll->cacheTree->recordTree->records));
+  env.dryRun = FALSE;
+  if (!benchCacheFiles(coll, &param)) goto error6;
+  benchBegin();
+  if (!scanCollection(coll, FALSE)) goto error6;
+  benchEnd("scanCache", param.nbFiles);
+
+  // html
+  benchBegin();
+  if (!serializeHtmlCache(coll)) goto error6;
+  benchEnd("htmlCache", param.nbFiles);
+  benchBegin();
+  if (!serializeHtmlIndex(coll)) goto error6;
+  benchEnd("htmlIndex", avl_count(coll->catalogTree->documents));
+  benchBegin();
+  if (!serializeHtmlScore(coll)) goto error6;
+  benchEnd("htmlScore", avl_count(coll->archives));
+
+  // the scanned files are the only local supplies really on disk
+  benchBegin();
+  if (!benchFreeCache(coll, &param, &nb)) goto error6;
+  benchEnd("freeCache", nb);
+
+  if (!benchWrite(output, &param)) goto error6;
+  /************************************************************************/
+
+  rc = TRUE;
+  goto error6;
+ error7:
+  env.dryRun = FALSE;
+ error6:
+  if (!releaseCollection(coll, CACH)) rc = FALSE;
+ error5:
+  if (!releaseCollection(coll, CTLG)) rc = FALSE;
+ error4:
+  if (!releaseCollection(coll, EXTR)) rc = FALSE;
+ error3:
+  if (!releaseCollection(coll, SERV)) rc = FALSE;
+  goto error;
+ error2:
+  if (!releaseCollection(coll, SERV|CTLG|EXTR|CACH)) rc = FALSE;
+ error:
+  if (servers) free(servers);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -0,0 +1,122 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : searchIndex
+ *
+ * Unit test for searchIndex
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex.h"
+#include "client/mediatex-client.h"
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  //fprintf(stderr, "  ---\n");
+  return;
+}
+
+/*=======================================================================
+ * Function   : main 
+ * Author     : Nicolas ROCHE
+ * modif      : 2012/05/01
+ * Description: Unit test for searchIndex module.
+ * Synopsis   : utsearchIndex
+ * Input      : N/A
+ * Output     : N/A
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  Collection* coll = 0;
+  SearchIndex* index = 0;
+  SearchHit hits[MAX_SEARCH_HITS];
+  char* queries[] = {"pan", "hand", "there", "ME no", "wel", "xyz", 0};
+  int i = 0, j = 0, n = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS;
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+       
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!loadCollection(coll, CTLG)) goto error;
+  env.dryRun = FALSE;
+  if (!saveSearchIndex(coll)) goto error;
+  if (!releaseCollection(coll, CTLG)) goto error;
+
+  // catalog is no more needed
+  if (!(index = openSearchIndex(coll))) goto error;
+  for (i = 0; queries[i]; ++i) {
+    if ((n = querySearchIndex(index, queries[i], hits, MAX_SEARCH_HITS))
+	== -1) goto error;
+    printf("%s: %i\n", queries[i], n);
+    for (j = 0; j < n; ++j) {
+      printf("  %s %i %s %s\n", strCType(hits[j].type),
+	     hits[j].score, hits[j].label, hits[j].url);
+    }
+  }
+  index = closeSearchIndex(index);
+  /************************************************************************/
+
+  freeConfiguration();
+  rc = TRUE;
+ error:
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -79,6 +79,10 @@ echo "* Send status message" >>common/$TEST.out
 common/ut$TEST -d >>common/$TEST.out 2>&1 &
 wait || common/ut$TEST -G -swarning >>common/$TEST.out 2>&1
 
+echo "* Send push message" >>common/$TEST.out
+common/ut$TEST -U >>common/$TEST.out 2>&1 &
+wait || common/ut$TEST -G -swarning >>common/$TEST.out 2>&1
+
 echo "* Free shm" >>common/$TEST.out
 #sleep 1
 common/ut$TEST -F >>common/$TEST.out 2>&1
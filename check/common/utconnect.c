@@ -125,7 +125,7 @@ main(int argc, char** argv)
     goto error;
   }
 
-  // check alarm signal do not break the stack
+  // check an unreachable server is skipped next times
   if ((socket = connectServer(server)) == -1) {
     if ((socket = connectServer(server)) == -1) {
       if ((socket = connectServer(server)) == -1) goto end;
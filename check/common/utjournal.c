@@ -0,0 +1,336 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : journal
+ *
+ * unit test for the records journal
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+#include <sys/wait.h>
+
+/*=======================================================================
+ * Function   : listRecords
+ * Description: List the records serialized on disk
+ * Synopsis   : static char* listRecords(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : the list, 0 on error
+ =======================================================================*/
+static char*
+listRecords(Collection* coll)
+{
+  char* rc = 0;
+  Record* record = 0;
+  AVLNode* node = 0;
+  char buf[MAX_SIZE_STRING + 2*MAX_SIZE_MD5 + 128];
+
+  if (!(rc = createString(""))) goto error;
+  for (node = coll->cacheTree->recordTree->records->head; node;
+       node = node->next) {
+    record = node->item;
+    if (record->type & REMOVE) continue;
+    switch (getRecordType(record)) {
+    case LOCAL_SUPPLY:
+    case REMOTE_SUPPLY:
+    case FINAL_DEMAND:
+    case LOCAL_DEMAND:
+    case REMOTE_DEMAND:
+      break;
+    default:
+      continue; // not serialized on disk
+    }
+    snprintf(buf, sizeof(buf), "%s %s %s:%lli %li %s\n",
+	     strRecordType(record), record->server->fingerPrint,
+	     record->archive->hash, (long long int)record->archive->size,
+	     (long int)record->date, record->extra);
+    if (!(rc = catString(rc, buf))) goto error;
+  }
+
+  return rc;
+ error:
+  return destroyString(rc);
+}
+
+/*=======================================================================
+ * Function   : addDemand
+ * Description: Add a final demand into the cache
+ * Synopsis   : static Record* addDemand(Collection* coll, char* hash)
+ * Input      : Collection* coll
+ *              char* hash: archive wanted (size is 123)
+ * Output     : the record added, 0 on error
+ =======================================================================*/
+static Record*
+addDemand(Collection* coll, char* hash)
+{
+  Record* rc = 0;
+  Archive* archive = 0;
+  char* extra = 0;
+
+  if (!(archive = addArchive(coll, hash, 123))) goto error;
+  if (!(extra = createString("journal@test.org"))) goto error;
+  if (!(rc = addRecord(coll, coll->localhost, archive, DEMAND, extra)))
+    goto error;
+  if (!addCacheEntry(coll, rc)) rc = 0;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : crash
+ * Description: Modify the cache and exit without saving it
+ * Synopsis   : static void crash(Collection* coll, int fd)
+ * Input      : Collection* coll
+ *              int fd: where to write the records we had
+ * Output     : N/A (exit status is 0 on success)
+ =======================================================================*/
+static void
+crash(Collection* coll, int fd)
+{
+  Record* record = 0;
+  char* list = 0;
+  int rc = FALSE;
+
+  if (!loadCollection(coll, CACH)) goto error;
+  if (!getLocalHost(coll)) goto error;
+
+  // 3 events: 2 records added and one removed
+  if (!addDemand(coll, "00000000000000000000000000000001")) goto error;
+  if (!(record = addDemand(coll, "00000000000000000000000000000002")))
+    goto error;
+  if (!delCacheEntry(coll, record)) goto error;
+
+  if (!(list = listRecords(coll))) goto error;
+  if (!fdWrite(fd, list, strlen(list))) goto error;
+  rc = TRUE;
+ error:
+  // neither release nor save: only the journal keeps the changes
+  _exit(rc?0:1);
+}
+
+/*=======================================================================
+ * Function   : replay
+ * Description: Load the cache and compare with the records we had
+ * Synopsis   : static int replay(Collection* coll, char* expected)
+ * Input      : Collection* coll
+ *              char* expected: records listed before the crash
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+replay(Collection* coll, char* expected)
+{
+  int rc = FALSE;
+  char* list = 0;
+
+  if (!loadCollection(coll, CACH)) goto error;
+  printf("%i events replayed\n", coll->cacheTree->nbJournal);
+  if (!(list = listRecords(coll))) goto error2;
+  if (strcmp(list, expected)) {
+    printf("replay gives other records:\n%s", list);
+    goto error2;
+  }
+  printf("replay gives the same records\n");
+
+  rc = TRUE;
+ error2:
+  if (!releaseCollection(coll, CACH)) rc = FALSE;
+  if (!diseaseCollection(coll, CACH)) rc = FALSE;
+ error:
+  destroyString(list);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : share
+ * Description: Let another tree append to the journal we write
+ * Synopsis   : static int share(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Note       : as after a SIGHUP, when a job keeps the previous tree
+ =======================================================================*/
+static int
+share(Collection* coll)
+{
+  int rc = FALSE;
+  char* list = 0;
+  int status = 0;
+  pid_t pid = 0;
+
+  if (!loadCollection(coll, CACH)) goto error;
+  if (!getLocalHost(coll)) goto error2;
+  if (!addDemand(coll, "00000000000000000000000000000003")) goto error2;
+
+  // the child process writes with its own copy of the tree
+  fflush(stdout);
+  if ((pid = fork()) == -1) goto error2;
+  if (pid == 0) {
+    _exit(addDemand(coll, "00000000000000000000000000000004")?0:1);
+  }
+  if (waitpid(pid, &status, 0) == -1) goto error2;
+  if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+    printf("child process fails\n");
+    goto error2;
+  }
+  printf("journal written by another tree: %s\n",
+	 checkCacheJournal(coll)?"no":"yes");
+
+  // force the compaction
+  coll->cacheTree->nbJournal = MAX_JOURNAL_EVENTS;
+  if (!saveRecords(coll)) goto error2;
+  printf("journal kept: %s\n",
+	 access(coll->md5sumsJnl, R_OK)?"no":"yes");
+
+  rc = TRUE;
+ error2:
+  if (!releaseCollection(coll, CACH)) rc = FALSE;
+  if (!diseaseCollection(coll, CACH)) rc = FALSE;
+  if (!rc) goto error;
+
+  // the next load gets the events of both trees
+  rc = FALSE;
+  if (!loadCollection(coll, CACH)) goto error;
+  if (!(list = listRecords(coll))) goto error3;
+  printf("events of both trees loaded: %s\n",
+	 (strstr(list, "00000000000000000000000000000003") &&
+	  strstr(list, "00000000000000000000000000000004"))?"yes":"no");
+  rc = TRUE;
+ error3:
+  if (!releaseCollection(coll, CACH)) rc = FALSE;
+  if (!diseaseCollection(coll, CACH)) rc = FALSE;
+ error:
+  destroyString(list);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for the records journal.
+ * Synopsis   : ./utjournal
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Collection* coll = 0;
+  char* expected = 0;
+  char buf[1024];
+  int fds[2] = {-1, -1};
+  int status = 0;
+  pid_t pid = 0;
+  ssize_t n = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  env.dryRun = FALSE; // the journal is only written then
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!expandCollection(coll)) goto error;
+  if (unlink(coll->md5sumsJnl) && errno != ENOENT) goto error;
+
+  // the child process modifies the cache and crashes
+  if (pipe(fds)) goto error;
+  fflush(stdout);
+  if ((pid = fork()) == -1) goto error;
+  if (pid == 0) {
+    close(fds[0]);
+    crash(coll, fds[1]);
+  }
+  close(fds[1]);
+  fds[1] = -1;
+  if (!(expected = createString(""))) goto error;
+  while ((n = read(fds[0], buf, sizeof(buf)-1)) > 0) {
+    buf[n] = 0;
+    if (!(expected = catString(expected, buf))) goto error;
+  }
+  if (waitpid(pid, &status, 0) == -1) goto error;
+  if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+    printf("child process fails\n");
+    goto error;
+  }
+  if (access(coll->md5sumsJnl, R_OK)) {
+    printf("no journal written\n");
+    goto error;
+  }
+
+  // the journal is still there, so replay it twice
+  printf("after the crash:\n");
+  if (!replay(coll, expected)) goto error;
+  printf("replayed again:\n");
+  if (!replay(coll, expected)) goto error;
+  printf("shared with another tree:\n");
+  if (!share(coll)) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  if (fds[0] != -1) close(fds[0]);
+  if (fds[1] != -1) close(fds[1]);
+  if (coll) unlink(coll->md5sumsJnl);
+  destroyString(expected);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
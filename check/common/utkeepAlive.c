@@ -0,0 +1,223 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : connect
+ *
+ * test for the kept alive connections
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+#include <sys/wait.h>  // waitpid
+
+#define PEER_PORT 12346
+
+static int nbAccepted = 0;
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  //fprintf(stderr, "\t\t---\n");
+
+  return;
+}
+
+/*=======================================================================
+ * Function   : peerJob
+ * Description: Fake daemon: reply to one frame and close the connection
+ * Synopsis   : static int peerJob(int sock, struct sockaddr_in* address)
+ * Input      : int sock: accepted socket
+ *              struct sockaddr_in* address: not used
+ * Output     : TRUE on success
+ * Note       : on the third connection, a second frame is read but
+ *              not replied. Stop after the fourth connection.
+ =======================================================================*/
+static int 
+peerJob(int sock, struct sockaddr_in* address)
+{
+  int rc = FALSE;
+  char reply[32];
+  int fd = -1;
+
+  (void) address;
+  if ((fd = readFrame(sock)) == -1) goto error;
+  sprintf(reply, "20%i connection %i\n", nbAccepted, nbAccepted+1);
+  if (!tcpWrite(sock, reply, strlen(reply))) goto error;
+
+  // the reply to the next frame is lost
+  if (nbAccepted == 2) {
+    close(fd);
+    if ((fd = readFrame(sock)) == -1) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (fd != -1) close(fd);
+  close(sock); // while the client keeps it in its pool
+  if (++nbAccepted == 4) env.running = FALSE;
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : main 
+ * Author     : Nicolas ROCHE
+ * modif      : 2017/02/01
+ * Description: Unit test for the connection pool.
+ * Synopsis   : ./utkeepAlive
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  Configuration* conf = 0;
+  Collection* coll = 0;
+  Archive* archive = 0;
+  Server* server = 0;
+  Record* record = 0;
+  RecordTree* tree = 0;
+  struct sockaddr_in address;
+  char reply[64];
+  char path[16];
+  char* extra = 0;
+  pid_t pid = -1;
+  int status = 0;
+  int i = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS;
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  env.dryRun = FALSE;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  if (!(conf = getConfiguration())) goto error;
+  if (!parseConfiguration(conf->confFile)) goto error;
+  if (!(coll = getCollection("coll1"))) goto error;
+  if (!expandCollection(coll)) goto error;
+
+  // new record tree
+  if ((tree = createRecordTree())== 0) goto error;
+  tree->collection = coll;
+  strncpy(tree->fingerPrint, coll->userFingerPrint, MAX_SIZE_MD5);
+
+  // new server as localhost:PEER_PORT
+  if (!(server = addServer(coll, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"))) 
+    goto error;
+  strncpy(server->host, "localhost", MAX_SIZE_HOST);
+  server->mdtxPort = PEER_PORT;
+
+  // several records, so as the frame needs several writes
+  for (i = 0; i < 100; ++i) {
+    sprintf(path, "path%i", i);
+    if (!(extra = createString(path))) goto error;
+    if (!(archive = addArchive(coll, "hash", i))) goto error;
+    if (!(record = newRecord(server, archive, DEMAND, extra))) goto error;
+    if (!avl_insert(tree->records, record)) {
+      logMain(LOG_ERR, "cannot add record (already there?)");
+      goto error;
+    }
+  }
+
+  // the fake daemon
+  if (!buildSocketAddressEasy(&address, 0x7f000001, PEER_PORT)) 
+    goto error;
+  if ((pid = fork()) == -1) {
+    logMain(LOG_ERR, "fork fails: %s", strerror(errno));
+    goto error;
+  }
+  if (pid == 0) {
+    rc = acceptTcpSocket(&address, peerJob);
+    _exit(rc?0:1);
+  }
+  sleep(1);
+
+  // first exchange opens a connection kept into the pool
+  if (!exchangeServer(server, tree, 0, reply, sizeof(reply))) goto error;
+  printf("first exchange: %s\n", reply);
+  usleep(200000); // let the peer close it
+
+  // second one sees it closed, and so opens a new one
+  if (!exchangeServer(server, tree, 0, reply, sizeof(reply))) goto error;
+  printf("second exchange: %s\n", reply);
+  usleep(200000);
+  if (!exchangeServer(server, tree, 0, reply, sizeof(reply))) goto error;
+  printf("third exchange: %s\n", reply);
+
+  // the frame was sent: it must not be sent again
+  printf("lost reply: %s\n", 
+	 exchangeServer(server, tree, 0, reply, sizeof(reply))?
+	 "success":"failure");
+  if (!exchangeServer(server, tree, 0, reply, sizeof(reply))) goto error;
+  printf("next exchange: %s\n", reply);
+
+  if (waitpid(pid, &status, 0) == -1) {
+    logMain(LOG_ERR, "waitpid fails: %s", strerror(errno));
+    goto error;
+  }
+  pid = -1;
+  printf("peer exits with %i\n", WEXITSTATUS(status));
+  expireServerConnections(TRUE);
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  if (pid > 0) kill(pid, SIGTERM);
+  tree = destroyRecordTree(tree);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -0,0 +1,281 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : loader
+ *
+ * unit test for the concurrent load of the extract part files
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+
+#define NB_PARTS 8
+#define NB_CONTAINERS 4000 // 7 lines each
+
+/*=======================================================================
+ * Function   : writeParts
+ * Description: Write the same containers into one or several parts
+ * Synopsis   : static int writeParts(Collection* coll, int nbParts)
+ * Input      : Collection* coll
+ *              int nbParts: number of part files to write
+ * Output     : TRUE on success
+ * Note       : the first child of a container is the parent of the
+ *              next one, so as parts refer to each other's archives
+ =======================================================================*/
+static int
+writeParts(Collection* coll, int nbParts)
+{
+  int rc = FALSE;
+  char* path = 0;
+  FILE* fd = 0;
+  int l = 0;
+  int i = 0;
+  int j = 0;
+
+  if (!(path = createString(coll->extractDB)) ||
+      !(path = catString(path, "000.txt"))) goto error;
+  l = strlen(coll->extractDB);
+
+  for (j = 0; j < NB_PARTS; ++j) {
+    sprintf(path+l, "%03i.txt", j);
+    if (j >= nbParts) {
+      if (unlink(path) && errno != ENOENT) goto error;
+      continue;
+    }
+    if (!(fd = fopen(path, "w"))) goto error;
+    for (i = j * NB_CONTAINERS / nbParts;
+	 i < (j+1) * NB_CONTAINERS / nbParts; ++i) {
+      fprintf(fd, "(TGZ\n%032x:%i\n=>\n%032x:%i\tnext%i\n"
+	      "%032x:%i\tfile%i\n)\n\n",
+	      2*i, 100+i, 2*(i+1), 101+i, i, 2*i+1, 1, i);
+    }
+    if (fclose(fd)) goto error;
+    fd = 0;
+  }
+
+  rc = TRUE;
+ error:
+  if (fd) fclose(fd);
+  destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : dumpTree
+ * Description: List the archives by ids and the containers
+ * Synopsis   : static char* dumpTree(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : the list, 0 on error
+ =======================================================================*/
+static char*
+dumpTree(Collection* coll)
+{
+  char* rc = 0;
+  Archive** archives = 0;
+  Archive* archive = 0;
+  Container* container = 0;
+  FromAsso* asso = 0;
+  AVLNode* node = 0;
+  AVLNode* node2 = 0;
+  char buf[2*MAX_SIZE_MD5 + 128];
+  int i = 0;
+
+  if (!(rc = createString(""))) goto error;
+  if (coll->maxId > 0) {
+    if (!(archives = malloc(coll->maxId * sizeof(Archive*)))) goto error;
+    memset(archives, 0, coll->maxId * sizeof(Archive*));
+  }
+  for (node = coll->archives->head; node; node = node->next) {
+    archive = node->item;
+    if (archive->id < 0 || archive->id >= coll->maxId) goto error;
+    archives[archive->id] = archive;
+  }
+  for (i = 0; i < coll->maxId; ++i) {
+    if (!archives[i]) continue;
+    sprintf(buf, "%i %s:%lli\n", i,
+	    archives[i]->hash, (long long int)archives[i]->size);
+    if (!(rc = catString(rc, buf))) goto error;
+  }
+
+  for (node = coll->extractTree->containers->head; node;
+       node = node->next) {
+    container = node->item;
+    sprintf(buf, "%s %s:%lli %i\n", strEType(container->type),
+	    container->parent->hash,
+	    (long long int)container->parent->size,
+	    container->parents->nbItems);
+    if (!(rc = catString(rc, buf))) goto error;
+    for (node2 = container->childs->head; node2; node2 = node2->next) {
+      asso = node2->item;
+      sprintf(buf, " %i %s\n", asso->archive->id, asso->path);
+      if (!(rc = catString(rc, buf))) goto error;
+    }
+  }
+
+  if (archives) free(archives);
+  return rc;
+ error:
+  if (archives) free(archives);
+  return destroyString(rc);
+}
+
+/*=======================================================================
+ * Function   : load
+ * Description: Load the part files from scratch
+ * Synopsis   : static char* load(Collection* coll, long long* steps)
+ * Input      : Collection* coll
+ * Output     : long long* steps: progress bar counter after the load
+ *              the loaded tree, 0 on error
+ =======================================================================*/
+static char*
+load(Collection* coll, long long* steps)
+{
+  char* rc = 0;
+
+  // start from scratch, and from the part files
+  if (!diseaseCollection(coll, CTLG|EXTR|SERV|CACH)) goto error;
+  if (!diseaseArchives(coll)) goto error;
+  coll->maxId = 0;
+  if (unlink(coll->snapshotDB) && errno != ENOENT) goto error;
+
+  if (!loadCollection(coll, EXTR)) goto error;
+  *steps = env.progBar.cur;
+  rc = dumpTree(coll);
+  if (!releaseCollection(coll, EXTR)) rc = destroyString(rc);
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for the concurrent load of the part files.
+ * Synopsis   : ./utloader
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Collection* coll = 0;
+  char* path = 0;
+  char* save = 0;
+  char* serial = 0;
+  char* parallel = 0;
+  long long int serialSteps = 0;
+  long long int parallelSteps = 0;
+  int isSaved = FALSE;
+  int i = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!expandCollection(coll)) goto error;
+  if (!(path = createString(coll->extractDB)) ||
+      !(path = catString(path, "000.txt")) ||
+      !(save = createString(path)) ||
+      !(save = catString(save, ".save"))) goto error;
+  if (rename(path, save)) goto error;
+  isSaved = TRUE;
+
+  // a single part file is parsed by the calling thread
+  if (!writeParts(coll, 1)) goto error;
+  if (!(serial = load(coll, &serialSteps))) goto error;
+
+  // several part files are parsed by the loader threads
+  if (!writeParts(coll, NB_PARTS)) goto error;
+  if (!(parallel = load(coll, &parallelSteps))) goto error;
+
+  printf("parallel load gives the same tree: %s\n",
+	 strcmp(serial, parallel)?"no":"yes");
+  printf("parallel load counts the same steps: %s\n",
+	 (serialSteps == parallelSteps)?"yes":"no");
+  if (serialSteps != parallelSteps) {
+    printf("serial: %lli, parallel: %lli\n", serialSteps, parallelSteps);
+  }
+
+  if (!diseaseCollection(coll, CTLG|EXTR|SERV|CACH)) goto error;
+  if (!diseaseArchives(coll)) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  if (isSaved) {
+    for (i = 1; i < NB_PARTS; ++i) {
+      sprintf(path + strlen(coll->extractDB), "%03i.txt", i);
+      unlink(path);
+    }
+    sprintf(path + strlen(coll->extractDB), "%03i.txt", 0);
+    if (rename(save, path)) rc = FALSE;
+    unlink(coll->snapshotDB);
+  }
+  destroyString(serial);
+  destroyString(parallel);
+  destroyString(path);
+  destroyString(save);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
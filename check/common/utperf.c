@@ -0,0 +1,185 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : perf
+ *
+ * unit test for perf
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  //fprintf(stderr, "  ---\n");
+  return;
+}
+
+/*=======================================================================
+ * Function   : checkDump
+ * Description: Print the stable fields of a STATUS dump
+ * Synopsis   : static int checkDump(char* path)
+ * Input      : char* path: the dump file
+ * Output     : TRUE on success
+ * Note       : timings vary, so only check the buckets add up to count
+ =======================================================================*/
+static int 
+checkDump(char* path)
+{
+  int rc = FALSE;
+  FILE* fd = 0;
+  char line[1024];
+  char name[32];
+  unsigned long count = 0;
+  unsigned long long sumUsec = 0;
+  unsigned long long maxUsec = 0;
+  unsigned long long bytes = 0;
+  unsigned long bucket = 0;
+  unsigned long total = 0;
+  char* ptr = 0;
+  int n = 0;
+  int i = 0;
+
+  if (!(fd = fopen(path, "r"))) {
+    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
+    goto error;
+  }
+  while (fgets(line, sizeof(line), fd)) {
+    if (*line == '#') {
+      printf("%s", line);
+      continue;
+    }
+    if (sscanf(line, "%31s %lu %llu %llu %llu%n", name, &count, 
+	       &sumUsec, &maxUsec, &bytes, &n) != 5) goto error;
+    total = 0;
+    ptr = line + n;
+    for (i = 0; i < PERF_BUCKETS; ++i) {
+      if (sscanf(ptr, " %lu%n", &bucket, &n) != 1) goto error;
+      total += bucket;
+      ptr += n;
+    }
+    printf("%s %lu %llu %s\n", name, count, bytes,
+	   (total == count && maxUsec <= sumUsec)? "ok" : "ko");
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "checkDump fails");
+  }
+  if (fd) fclose(fd);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : main 
+ * Author     : Nicolas ROCHE
+ * modif      : 2017/02/01
+ * Description: Unit test for perf module.
+ * Synopsis   : ./utperf
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  char* path = "common/perf.dat";
+  struct timespec start;
+  int i = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS;
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+  perfEnable(FALSE); // as mediatexd may do: no log handler yet
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+  if (unsetenv("MDTX_PERF")) goto optError;
+  perfGetEnv(); // as mediatexd does
+
+  /************************************************************************/
+  // disabled: nothing recorded nor saved
+  perfBegin(start);
+  perfEnd(PERF_CHECKSUM, start, 1024);
+  if (!perfSave(path)) goto error;
+  if (access(path, F_OK) == 0) goto error;
+  
+  if (setenv("MDTX_PERF", "1", 1)) goto error;
+  perfGetEnv();
+  printf("enabled by MDTX_PERF: %s\n", perfIsEnabled?"yes":"no");
+  for (i = 0; i < 3; ++i) {
+    perfBegin(start);
+    perfEnd(PERF_CHECKSUM, start, 1024);
+  }
+  perfBegin(start);
+  perfEnd(PERF_NOTIFY, start, 0);
+  perfBegin(start);
+  perfEnd(PERF_EXTRACT + TGZ, start, 4096);
+  perfBegin(start);
+  perfEnd(PERF_EXTRACT + ISO, start, 2048);
+
+  // what the STATUS job does
+  perfStatus(LOG_NOTICE);
+  if (!perfSave(path)) goto error;
+  if (!checkDump(path)) goto error;
+  if (unlink(path) == -1) goto error;
+  perfEnable(FALSE);
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -42,7 +42,7 @@ usage(char* programName)
   mdtxUsage(programName);
   fprintf(stderr, 
 	  "\n\t\t{ -I | -G | -F | "
-	  "\n\t\t  -W | -E | -N | -Q | -S | -T | -C | -P | -L }"
+	  "\n\t\t  -W | -E | -N | -Q | -S | -T | -C | -P | -L | -U }"
 	  "\n\t\t[ -e ]\n");
 
   mdtxOptions();
@@ -59,6 +59,7 @@ usage(char* programName)
 	  "  -C, --do-clean\tperform clean\n"
 	  "  -P, --do-purge\tperform purge\n"
 	  "  -L, --do-status\tperform log status\n"
+	  "  -U, --do-push\t\tpush the git modules\n"
 	  "  -e, --set-error\terror test\n");
   return;
 }
@@ -83,7 +84,7 @@ main(int argc, char** argv)
   int rc = 0;
   int cOption = EOF;
   char* programName = *argv;
-  char* options = MDTX_SHORT_OPTIONS"IGFWENQSTCPde";
+  char* options = MDTX_SHORT_OPTIONS"IGFWENQSTCPdUe";
   struct option longOptions[] = {
     MDTX_LONG_OPTIONS,
     {"initialize", required_argument, 0, 'I'},
@@ -98,6 +99,7 @@ main(int argc, char** argv)
     {"do-clean", required_argument, 0, 'C'},
     {"do-purge", required_argument, 0, 'P'},
     {"do-status", required_argument, 0, 'd'},
+    {"do-push", required_argument, 0, 'U'},
     {"set-error", required_argument, 0, 'e'},
     {0, 0, 0, 0}
   };
@@ -171,6 +173,11 @@ main(int argc, char** argv)
       signal = REG_STATUS;
       break;
 
+    case 'U':
+      if (signal != UNDEF) rc=7;
+      signal = REG_PUSH;
+      break;
+
     case 'e':
       doError = TRUE;
       break;
@@ -0,0 +1,232 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : rescore
+ *
+ * unit test for the incremental extract scores
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+
+// from extract000.txt
+#define LOGO_TGZ "0387eee9820fa224525ff8b2e0dfa9be", 24546
+#define LOGO_PNG "022a34b2f9b893fba5774237e1aa80ea", 24075
+#define LOGO_XPM "b281449c229bcc4a3556cdcc0d3ebcec", 815
+#define LOGO_P2  "c0c055a0829982bd646e2fafff01aaa6", 4066
+
+/*=======================================================================
+ * Function   : dumpScores
+ * Description: List the scores of all the archives
+ * Synopsis   : static char* dumpScores(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : the list, 0 on error
+ =======================================================================*/
+static char*
+dumpScores(Collection* coll)
+{
+  char* rc = 0;
+  Archive* archive = 0;
+  AVLNode* node = 0;
+  char buf[MAX_SIZE_MD5 + 64];
+
+  if (!(rc = createString(""))) goto error;
+  for (node = coll->archives->head; node; node = node->next) {
+    archive = node->item;
+    sprintf(buf, "%s:%lli %5.2f%s\n",
+	    archive->hash, (long long int)archive->size,
+	    archive->extractScore, archive->incInherency?" (inc)":"");
+    if (!(rc = catString(rc, buf))) goto error;
+  }
+  sprintf(buf, "global %5.2f\n", coll->extractTree->score);
+  if (!(rc = catString(rc, buf))) goto error;
+
+  return rc;
+ error:
+  return destroyString(rc);
+}
+
+/*=======================================================================
+ * Function   : compare
+ * Description: Compare the incremental scores with a full computation
+ * Synopsis   : static int compare(Collection* coll, char* step,
+ *                                 char** previous)
+ * Input      : Collection* coll
+ *              char* step: the change applied
+ *              char** previous: the scores before the change
+ * Output     : char** previous: the scores after the change
+ *              TRUE if both computations give the same scores
+ =======================================================================*/
+static int
+compare(Collection* coll, char* step, char** previous)
+{
+  int rc = FALSE;
+  char* incremental = 0;
+  char* full = 0;
+
+  // only re-score what the change impacts
+  if (coll->extractTree->score == -1) goto error;
+  if (!computeExtractScore(coll)) goto error;
+  if (!(incremental = dumpScores(coll))) goto error;
+
+  // as after diseaseExtractTree, but keeping the trees in memory
+  coll->extractTree->score = -1;
+  if (!computeExtractScore(coll)) goto error;
+  if (!(full = dumpScores(coll))) goto error;
+
+  rc = !strcmp(incremental, full);
+  printf("%s: scores changed: %s, same as a full computation: %s\n",
+	 step, strcmp(*previous, full)?"yes":"no", rc?"yes":"no");
+  if (!rc) {
+    printf("incremental scores:\n%sfull scores:\n%s", incremental, full);
+  }
+
+  destroyString(*previous);
+  *previous = full;
+  full = 0;
+ error:
+  destroyString(incremental);
+  destroyString(full);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for the incremental extract scores.
+ * Synopsis   : ./utrescore
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Collection* coll = 0;
+  Archive* tgz = 0;
+  Archive* png = 0;
+  Archive* xpm = 0;
+  Archive* p2 = 0;
+  Container* tgzContainer = 0;
+  Server* server = 0;
+  Image* image = 0;
+  FromAsso* asso = 0;
+  char* scores = 0;
+  time_t lastCommit = 0;
+  int isLoaded = FALSE;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!loadCollection(coll, SERV|EXTR)) goto error;
+  isLoaded = TRUE;
+  if (!computeExtractScore(coll)) goto error;
+  if (!(scores = dumpScores(coll))) goto error;
+
+  if (!(tgz = getArchive(coll, LOGO_TGZ)) ||
+      !(png = getArchive(coll, LOGO_PNG)) ||
+      !(xpm = getArchive(coll, LOGO_XPM)) ||
+      !(p2 = getArchive(coll, LOGO_P2))) goto error;
+  if (!(tgzContainer = tgz->toContainer)) goto error;
+  if (!(image = rgHead(arImages(png)))) goto error;
+  server = image->server;
+
+  // a new image for a container
+  if (!(image = addImage(coll, server, tgz))) goto error;
+  image->score = 10;
+  if (!compare(coll, "add an image", &scores)) goto error;
+
+  // a server that do not commit any more
+  lastCommit = server->lastCommit;
+  server->lastCommit = 0;
+  if (!compare(coll, "mute a server", &scores)) goto error;
+  server->lastCommit = lastCommit;
+  if (!compare(coll, "unmute the server", &scores)) goto error;
+
+  // an archive losing all its images
+  while ((image = rgHead(arImages(png)))) {
+    if (!delImage(coll, image)) goto error;
+  }
+  if (!compare(coll, "del the images", &scores)) goto error;
+
+  // a content removed from its container, and added again
+  if (!(asso = rgHead(arFromContainers(xpm)))) goto error;
+  if (!delFromAsso(coll, asso)) goto error;
+  if (!compare(coll, "del a content", &scores)) goto error;
+  if (!addFromAsso(coll, xpm, tgzContainer, "logo/logo.xpm")) goto error;
+  if (!compare(coll, "add the content", &scores)) goto error;
+
+  // a container losing one of its parents
+  if (!delFromArchive(coll, p2->toContainer, p2)) goto error;
+  if (!compare(coll, "del a parent", &scores)) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  if (isLoaded && !releaseCollection(coll, SERV|EXTR)) rc = FALSE;
+  destroyString(scores);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -0,0 +1,321 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : snapshot
+ *
+ * unit test for snapshot
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex.h"
+#include <utime.h>
+
+// not in the serialized order (INC, then containers by type)
+static char* extractPart =
+  "# MediaTeX extraction metadata: coll1\n"
+  "\n"
+  "(TGZ\n"
+  "0387eee9820fa224525ff8b2e0dfa9be:24546\n"
+  "=>\n"
+  "022a34b2f9b893fba5774237e1aa80ea:24075\tlogo/logo.png\n"
+  "b281449c229bcc4a3556cdcc0d3ebcec:815\tlogo/logo.xpm\n"
+  ")\n"
+  "\n"
+  "(ISO\n"
+  "de5008799752552b7963a2670dc5eb18:391168\n"
+  "=>\n"
+  "1a167d608e76a6a4a8b16d168580873c:20480\tlogoP1.cat\n"
+  ")\n"
+  "\n"
+  "(INC\n"
+  "=>\n"
+  "0a7ecd447ef2acb3b5c6e4c550e6636f:374784\t1994-01-01,00:00:00\n"
+  ")\n";
+
+#define OLD_MTIME 1000000000
+
+/*=======================================================================
+ * Function   : dumpIds
+ * Description: List the archives by ids
+ * Synopsis   : static char* dumpIds(Collection* coll, int doPrint)
+ * Input      : Collection* coll
+ *              int doPrint: also print the list on stdout
+ * Output     : the list, 0 on error
+ =======================================================================*/
+static char*
+dumpIds(Collection* coll, int doPrint)
+{
+  char* rc = 0;
+  Archive** archives = 0;
+  Archive* archive = 0;
+  AVLNode* node = 0;
+  char buf[MAX_SIZE_MD5 + 64];
+  int i = 0;
+
+  if (!(rc = createString(""))) goto error;
+  if (coll->maxId == 0) goto end;
+  if (!(archives = malloc(coll->maxId * sizeof(Archive*)))) goto error;
+  memset(archives, 0, coll->maxId * sizeof(Archive*));
+
+  for (node = coll->archives->head; node; node = node->next) {
+    archive = node->item;
+    if (archive->id < 0 || archive->id >= coll->maxId) goto error;
+    archives[archive->id] = archive;
+  }
+  for (i = 0; i < coll->maxId; ++i) {
+    if (!archives[i]) continue;
+    sprintf(buf, "%3i %s:%lli\n", i,
+	    archives[i]->hash, (long long int)archives[i]->size);
+    if (doPrint) printf("%s", buf);
+    if (!(rc = catString(rc, buf))) goto error;
+  }
+
+ end:
+  if (archives) free(archives);
+  return rc;
+ error:
+  if (archives) free(archives);
+  return destroyString(rc);
+}
+
+/*=======================================================================
+ * Function   : reload
+ * Description: Free the collection and load it again
+ * Synopsis   : static char* reload(Collection* coll, int collFiles,
+ *                                  int doPrint)
+ * Input      : Collection* coll
+ *              int collFiles: files to load
+ *              int doPrint: also print the ids on stdout
+ * Output     : the archives by ids, 0 on error
+ =======================================================================*/
+static char*
+reload(Collection* coll, int collFiles, int doPrint)
+{
+  char* rc = 0;
+
+  // start from scratch so as the ids are given again
+  if (!diseaseCollection(coll, CTLG|EXTR|SERV|CACH)) goto error;
+  if (!diseaseArchives(coll)) goto error;
+  if (avl_count(coll->archives)) goto error;
+  coll->maxId = 0;
+
+  if (!loadCollection(coll, collFiles)) goto error;
+  rc = dumpIds(coll, doPrint);
+  if (!releaseCollection(coll, collFiles)) rc = destroyString(rc);
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : compare
+ * Description: Compare a snapshot load with a text load
+ * Synopsis   : static int compare(Collection* coll, int collFiles,
+ *                                 int doPrint)
+ * Input      : Collection* coll
+ *              int collFiles: files to load
+ *              int doPrint: also print the ids on stdout
+ * Output     : TRUE if both loads give the same ids
+ =======================================================================*/
+static int
+compare(Collection* coll, int collFiles, int doPrint)
+{
+  int rc = FALSE;
+  char* byText = 0;
+  char* bySnapshot = 0;
+
+  // the text load writes the snapshot the next load uses
+  if (unlink(coll->snapshotDB) && errno != ENOENT) goto error;
+  if (!(byText = reload(coll, collFiles, doPrint))) goto error;
+  if (access(coll->snapshotDB, R_OK)) {
+    printf("no snapshot written\n");
+    goto error;
+  }
+  if (!(bySnapshot = reload(coll, collFiles, FALSE))) goto error;
+
+  if (!(rc = !strcmp(byText, bySnapshot))) {
+    printf("snapshot load gives other ids:\n%s", bySnapshot);
+    goto error;
+  }
+  printf("snapshot load gives the same ids\n");
+ error:
+  destroyString(byText);
+  destroyString(bySnapshot);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : isRefreshed
+ * Description: Load from the snapshot and tell if it was written
+ * Synopsis   : static int isRefreshed(Collection* coll, int* result)
+ * Input      : Collection* coll
+ * Output     : int* result: TRUE if the snapshot was written
+ *              TRUE on success
+ =======================================================================*/
+static int
+isRefreshed(Collection* coll, int* result)
+{
+  int rc = FALSE;
+  struct utimbuf times;
+  struct stat statBuffer;
+  char* ids = 0;
+
+  times.actime = times.modtime = OLD_MTIME;
+  if (utime(coll->snapshotDB, &times)) goto error;
+  if (!(ids = reload(coll, EXTR, FALSE))) goto error;
+  if (stat(coll->snapshotDB, &statBuffer)) goto error;
+  *result = (statBuffer.st_mtime != OLD_MTIME);
+
+  rc = TRUE;
+ error:
+  destroyString(ids);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for snapshot module.
+ * Synopsis   : ./utsnapshot
+ * Input      : N/A
+ * Output     : stdout
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Collection* coll = 0;
+  char* path = 0;
+  char* save = 0;
+  char* ids = 0;
+  FILE* fd = 0;
+  struct stat statBuffer;
+  struct utimbuf times;
+  int isSaved = FALSE;
+  int result = FALSE;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  env.dryRun = FALSE; // the snapshot is only written then
+  if (!(coll = mdtxGetCollection("coll1"))) goto error;
+  if (!expandCollection(coll)) goto error;
+  if (!(path = createString(coll->extractDB)) ||
+      !(path = catString(path, "000.txt")) ||
+      !(save = createString(path)) ||
+      !(save = catString(save, ".save"))) goto error;
+
+  // part file not in the order serializeExtractTree would give
+  if (rename(path, save)) goto error;
+  isSaved = TRUE;
+  if (!(fd = fopen(path, "w"))) goto error;
+  if (fputs(extractPart, fd) == EOF) goto error;
+  if (fclose(fd)) goto error;
+  fd = 0;
+  times.actime = times.modtime = currentTime() - 60; // parsed after
+  if (utime(path, &times)) goto error;
+
+  printf("extract only:\n");
+  if (!compare(coll, EXTR, TRUE)) goto error;
+
+  // same content but another mtime (ie: git checkout)
+  if (stat(path, &statBuffer)) goto error;
+  times.actime = times.modtime = statBuffer.st_mtime - 3600;
+  if (utime(path, &times)) goto error;
+  if (!isRefreshed(coll, &result)) goto error;
+  printf("new mtime stored: %s\n", result?"yes":"no");
+  if (!isRefreshed(coll, &result)) goto error;
+  printf("new mtime stored again: %s\n", result?"yes":"no");
+
+  // clients only read the snapshot written by the server
+  env.noSnapshot = TRUE;
+  times.actime = times.modtime = statBuffer.st_mtime - 7200;
+  if (utime(path, &times)) goto error;
+  if (!isRefreshed(coll, &result)) goto error;
+  printf("new mtime stored by a client: %s\n", result?"yes":"no");
+  if (unlink(coll->snapshotDB)) goto error;
+  if (!(ids = reload(coll, EXTR, FALSE))) goto error;
+  printf("snapshot written by a client: %s\n",
+	 access(coll->snapshotDB, F_OK)?"no":"yes");
+  env.noSnapshot = FALSE;
+
+  // archives from the catalog are created before the extract ones
+  if (rename(save, path)) goto error;
+  isSaved = FALSE;
+  printf("catalog and extract:\n");
+  if (!compare(coll, CTLG|EXTR, FALSE)) goto error;
+
+  if (!diseaseCollection(coll, CTLG|EXTR|SERV|CACH)) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  if (fd) fclose(fd);
+  if (isSaved && rename(save, path)) rc = FALSE;
+  if (coll) unlink(coll->snapshotDB);
+  destroyString(path);
+  destroyString(save);
+  destroyString(ids);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -58,6 +58,46 @@ EOF
 mrProperOutputs $TEST.out
 diff $srcdir/$TEST.exp $TEST.out
 
+# $1: output file (answers), logs go to $1.log
+function queries()
+{
+    REQUEST_METHOD=GET \
+    QUERY_STRING="hash=40485334450b64014fd7a4810b5698b3&size=12" \
+    SCRIPT_FILENAME=/${MDTXUSER}-coll1/public_html/cgi/get.cgi \
+    MDTX_NO_REGRESSION=1 \
+	../src/$TEST -n -s info -f file >$1 2>$1.log
+
+    REQUEST_METHOD=POST \
+    SCRIPT_FILENAME=/${MDTXUSER}-coll1/public_html/cgi/get.cgi \
+    MDTX_NO_REGRESSION=1 \
+    CONTENT_TYPE=application/x-www-form-urlencoded \
+    CONTENT_LENGTH=64 \
+	../src/$TEST -n -s info -f file >>$1 2>>$1.log <<EOF
+hash=40485334450b64014fd7a4810b5698b3&size=12&mail=test@test.org
+EOF
+}
+
+# same answers when the queries go through the persistent worker
+SOCK=${PIDDIR}/${MDTXUSER}-cgi.sock
+queries $TEST.alone
+MDTX_NO_REGRESSION=1 ../src/$TEST -W -n -s info -f file \
+    >$TEST.worker.log 2>&1 &
+PID=$!
+trap "kill -CONT $PID; kill $PID; rm -f $SOCK" EXIT
+for I in $(seq 1 50); do
+    [ -S $SOCK ] && break
+    sleep 0.1
+done
+queries $TEST.forwarded
+grep -q "forward query to the cgi worker" $TEST.forwarded.log
+diff $TEST.alone $TEST.forwarded
+
+# and when the worker hangs (served by get.cgi after the deadline)
+kill -STOP $PID
+queries $TEST.stuck
+grep -q "serve the query without the cgi worker" $TEST.stuck.log
+diff $TEST.alone $TEST.stuck
+
 # note for gdb:
 # M-x gdb
 # Run gdb (like this): libtool --mode=execute gdb --annotate=3 ../src/mediatex-cgi
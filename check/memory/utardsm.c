@@ -66,6 +66,7 @@ main(int argc, char** argv)
   RG* cont = 0;
   RG* ring = 0;
   RG* ring2 = 0;
+  RGS compact;
   FILE* hin = (FILE*)stdin;
   FILE* hout = (FILE*)stdout;
   char buffer[BUFSIZ];
@@ -169,6 +170,19 @@ main(int argc, char** argv)
 
   ring = destroyOnlyRing(ring);
   ring2 = destroyOnlyRing(ring2);
+
+  // compact ring (the first items use the inline cells)
+  rgInitCompact(&compact);
+  for (i=0; i<3; ++i) rgInsert(&compact.ring, E2[i]);
+  rgHead(&compact.ring);
+  rgRemove(&compact.ring);
+  if (!rgInsert(&compact.ring, E1[0])) goto error;
+  fprintf(hout, "compact: ");
+  rgRewind(&compact.ring);
+  while ((it = rgNext(&compact.ring))) fprintf(hout, "%c", *it);
+  fprintf(hout, " (cell %s)\n", 
+	  (compact.ring.tail == compact.cells)?"reused":"not reused");
+  rgDelete(&compact.ring);
   /*------------------------------------------------------------------*/
   if ((cont = createRing()) == 0) goto error;
   if ((ring2 = createRing()) == 0) goto error;
@@ -39,6 +39,50 @@ testThread(void* arg)
   return 0;
 }
 
+static int isOwner = FALSE;
+
+/*=======================================================================
+ * Function   : ownerThread
+ * Description: Acquire the cache as a job would do
+ * Synopsis   : void* ownerThread(void* arg)
+ * Input      : void* arg: Collection* coll
+ * Output     : N/A
+ =======================================================================*/
+void* 
+ownerThread(void* arg)
+{
+  isOwner = acquireCacheOwner((Collection*)arg);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : lookup
+ * Description: Look for a previous cgi lookup result and log it
+ * Synopsis   : static int lookup(Collection* coll, Archive* archive,
+ *                                int* epoch)
+ * Input      : Collection* coll
+ *              Archive* archive: archive looked for
+ * Output     : int* epoch: to provide to addCacheLookup
+ *              TRUE on success
+ =======================================================================*/
+static int 
+lookup(Collection* coll, Archive* archive, int* epoch)
+{
+  int rc = FALSE;
+  CacheTree* cache = coll->cacheTree;
+  char status[576]; // as the connexion's one
+  int isHit = FALSE;
+
+  if (!getCacheLookup(coll, archive, status, &isHit, epoch)) goto error;
+  logMain(LOG_NOTICE, "%s%s (hits: %li, misses: %li, kept: %u)",
+	  isHit?"hit, reply: ":"miss", isHit?status:"",
+	  cache->lookupHits, cache->lookupMisses, 
+	  avl_count(cache->lookups));
+  rc = TRUE;
+ error:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : usage
  * Description: Print the usage.
@@ -73,10 +117,15 @@ main(int argc, char** argv)
 {
   char inputRep[256] = ".";
   Collection* coll = 0;
+  Collection* other = 0;
+  Configuration* oldConf = 0;
+  pthread_t thread;
   RecordTree* tree = 0;
   Record* record = 0;
   AVLNode* node = 0;
   AVLNode* next = 0;
+  int isLookupDone = FALSE;
+  int epoch = 0;
   // ---
   int rc = 0;
   int cOption = EOF;
@@ -130,6 +179,34 @@ main(int argc, char** argv)
   if (!unLockCache(coll)) goto error;
   if (!unLockCache(coll)) goto error;
 
+  // 2 configurations never use the same cache at once (cf SIGHUP)
+  logMain(LOG_NOTICE, "---"); 
+  logMain(LOG_NOTICE, "cache used by a previous configuration"); 
+  if (!(other = createCollection())) goto error;
+  strncpy(other->label, coll->label, MAX_SIZE_COLL);
+  if (!acquireCacheOwner(other)) goto error;
+  if (!acquireCacheOwner(other)) goto error;
+  if (pthread_create(&thread, 0, ownerThread, coll)) goto error;
+  usleep(200000);
+  logMain(LOG_NOTICE, "new configuration waits: %s", isOwner?"no":"yes");
+  if (!releaseCacheOwner(other)) goto error;
+  usleep(200000);
+  logMain(LOG_NOTICE, "still waits while used: %s", isOwner?"no":"yes");
+  if (!releaseCacheOwner(other)) goto error;
+  if (pthread_join(thread, 0)) goto error;
+  logMain(LOG_NOTICE, "gets it once released: %s", isOwner?"yes":"no");
+
+  logMain(LOG_NOTICE, "previous configuration cannot use it again"); 
+  if (!(oldConf = createConfiguration())) goto error;
+  if (!useConfiguration(oldConf)) goto error;
+  isOwner = acquireCacheOwner(other);
+  if (!useConfiguration(0)) goto error;
+  oldConf = destroyConfiguration(oldConf);
+  logMain(LOG_NOTICE, "refused: %s", isOwner?"no":"yes");
+  if (isOwner && !releaseCacheOwner(other)) goto error;
+  if (!releaseCacheOwner(coll)) goto error;
+  other = destroyCollection(other);
+
   if (!(tree = createExempleRecordTree(coll))) goto error;
   if (!computeExtractScore(coll)) goto error;
   
@@ -148,8 +225,24 @@ main(int argc, char** argv)
     aesFlush(&tree->aes);
     fprintf(stderr, "\n");
 
+    // cgi lookup result recorded before the first supply
+    if (!isLookupDone) {
+      logMain(LOG_NOTICE, "record a cgi lookup result"); 
+      if (!lookup(coll, record->archive, &epoch)) goto error;
+      if (!addCacheLookup(coll, record->archive, "200 found", TRUE, epoch))
+	goto error;
+      if (!lookup(coll, record->archive, &epoch)) goto error;
+    }
+
     if (!addCacheEntry(coll, record)) goto error;
     avl_unlink_node(tree->records, node);
+
+    // and forgotten as the supply changes
+    if (!isLookupDone) {
+      logMain(LOG_NOTICE, "forget the cgi lookup result"); 
+      if (!lookup(coll, record->archive, &epoch)) goto error;
+      isLookupDone = TRUE;
+    }
     free(node);
 
     if (record->archive->state >= AVAILABLE) {
@@ -22,6 +22,7 @@
  =======================================================================*/
 
 #include "mediatex.h"
+#include <utime.h>
 
 /*=======================================================================
  * Function   : usage
@@ -40,6 +41,77 @@ usage(char* programName)
   return;
 }
 
+/*=======================================================================
+ * Function   : serializeObjects
+ * Description: Serialize some objects into part files
+ * Synopsis   : static int serializeObjects(char* path, int edited)
+ * Input      : char* path: prefix of the part files
+ *              int edited: object having a new value
+ * Output     : TRUE on success
+ =======================================================================*/
+static int 
+serializeObjects(char* path, int edited)
+{
+  int rc = FALSE;
+  CvsFile fd = {0, 0, 0, FALSE, 0, cvsCutOpen, cvsCutPrint};
+  int i = 0;
+
+  fd.path = path;
+  if (!fd.open(&fd)) goto error;
+  for (i = 0; i < 600; ++i) {
+    fd.doCut = TRUE;
+    if (!fd.print(&fd, "Object %03i\n", i)) goto error;
+    fd.doCut = FALSE;
+    if (!fd.print(&fd, "  \"value\" = \"%s\"\n\n", 
+		  (i == edited)?"edited":"original")) goto error;
+  }
+  fd.doCut = TRUE;
+
+  rc = TRUE;
+ error:
+  if (!cvsClose(&fd)) rc = FALSE;
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : checkParts
+ * Description: Tell which part files were re-written
+ * Synopsis   : static int checkParts(char* path, int doReset)
+ * Input      : char* path: prefix of the part files
+ *              int doReset: set the mtimes to 0 (or unlink the files)
+ * Output     : TRUE on success
+ =======================================================================*/
+static int 
+checkParts(char* path, int doReset)
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  struct utimbuf times = {0, 0};
+  char part[64];
+  int i = 0;
+
+  for (i = 0; i < 1000; ++i) {
+    sprintf(part, "%s%03i.txt", path, i);
+    if (stat(part, &statBuffer)) break;
+    if (doReset) {
+      if (utime(part, &times) == -1) goto error;
+      continue;
+    }
+    if (statBuffer.st_mtime && statBuffer.st_size) {
+      logMain(LOG_NOTICE, "%s re-written", part);
+    }
+    if (unlink(part) == -1) goto error;
+  }
+  if (doReset) logMain(LOG_NOTICE, "%i parts", i);
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "checkParts fails: %s", strerror(errno));
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : main 
  * Author     : Nicolas ROCHE
@@ -91,6 +163,13 @@ main(int argc, char** argv)
   if (!cvsCutPrint(&fd, "%s", "3rd line ...\n")) goto error;
   if (!cvsCutPrint(&fd, "%s", "4rth line ...\n")) goto error;
   if (!cvsClose(&fd)) goto error;
+
+  // an edit only re-writes its own part
+  env.cvsprintMax = 2000;
+  if (!serializeObjects("memory/cvsPrint", -1)) goto error;
+  if (!checkParts("memory/cvsPrint", TRUE)) goto error;
+  if (!serializeObjects("memory/cvsPrint", 300)) goto error;
+  if (!checkParts("memory/cvsPrint", FALSE)) goto error;
   /************************************************************************/
 
   rc = TRUE;
@@ -124,6 +124,7 @@ main(int argc, char** argv)
   char buffer[BUFSIZ];
   char* string = 0;
   char* copy = 0;
+  AVLTree* pool = 0;
   
   char* prefix = createString("prefix");
   char* suffix = createString("/suffix");
@@ -139,6 +140,16 @@ main(int argc, char** argv)
   prefix = destroyString(prefix);
   prefix = catString(prefix, suffix);
   fprintf(hout, "concatenate 0/1 %s\n", prefix);
+
+  if (!(pool = createStringPool())) goto error;
+  if (!(string = internString(pool, "value"))) goto error;
+  if (!(copy = internString(pool, "value"))) goto error;
+  fprintf(hout, "intern twice: %s\n", (string == copy)?"shared":"copied");
+  if (!(copy = internString(pool, "other"))) goto error;
+  fprintf(hout, "intern other: %s\n", (string == copy)?"shared":"copied");
+  fprintf(hout, "pool size: %u\n", avl_count(pool));
+  pool = destroyStringPool(pool);
+  string = copy = 0;
    
   fprintf(hout, 
 	  "Enter items, one per line.\nEnd the list by EOF (ctl-d)\n");
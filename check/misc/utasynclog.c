@@ -0,0 +1,208 @@
+/*=======================================================================
+ * Project: MediaTex
+ * Module : unit tests
+ *
+ * test for the asynchronous logs
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex.h"
+#include <sys/wait.h>  // waitpid
+
+#define NB_DROPPED 10
+#define NB_PENDING 100
+
+static int isEmitted = FALSE;
+
+/*=======================================================================
+ * Function   : emitter
+ * Description: Thread emitting a notice message
+ * Synopsis   : static void* emitter(void* arg)
+ * Input      : void* arg: not used
+ * Output     : 0
+ =======================================================================*/
+static void*
+emitter(void* arg)
+{
+  logEmitFunc(env.logHandler, LOG_NOTICE, "waited for room");
+  isEmitted = TRUE;
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : countLines
+ * Description: Count the lines written into the log file
+ * Synopsis   : static int countLines(char* path, char* last)
+ * Input      : char* path: the log file
+ * Output     : char* last: the last line (LOG_LINE_SIZE), if not 0
+ *              the number of lines, -1 on error
+ =======================================================================*/
+static int
+countLines(char* path, char* last)
+{
+  int rc = -1;
+  FILE* fd = 0;
+  char buf[LOG_LINE_SIZE+2];
+
+  if (!(fd = fopen(path, "r"))) goto error;
+  for (rc = 0; fgets(buf, LOG_LINE_SIZE+2, fd); ++rc) {
+    buf[strcspn(buf, "\n")] = 0;
+    if (last) strncpy(last, buf, LOG_LINE_SIZE);
+  }
+  fclose(fd);
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  miscUsage(programName);
+  miscOptions();
+
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for the asynchronous logs.
+ * Synopsis   : utasynclog -l logFile
+ * Input      : N/A
+ * Output     : stdout, and the messages written into logFile
+ * Note       : exit without closing the logs, as the daemon does on
+ *              fatal errors, so the last messages are only written by
+ *              logFlush
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  LogQueue* queue = 0;
+  pthread_t thread;
+  char last[LOG_LINE_SIZE];
+  int isLocked = FALSE;
+  int isStarted = FALSE;
+  int status = 0;
+  pid_t pid = 0;
+  int i = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MISC_SHORT_OPTIONS;
+  struct option longOptions[] = {
+    MISC_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MISC_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  if (!env.logFile) {
+    usage(programName);
+    goto optError;
+  }
+   
+  // set the asynchronous log handler
+  if (unlink(env.logFile) && errno != ENOENT) goto error;
+  if (!(env.logHandler = 
+	logOpen(programName, getLogFacility("file"), env.logSeverity, 
+		env.logFile))) goto error;
+  if (!logStartAsync(env.logHandler)) goto error;
+  queue = env.logHandler->queue;
+
+  // fill the queue while the logger thread cannot write
+  pthread_mutex_lock(&queue->writeMutex);
+  isLocked = TRUE;
+  for (i = 0; i < LOG_QUEUE_SIZE; ++i) {
+    logEmitFunc(env.logHandler, LOG_NOTICE, "message %i", i);
+  }
+
+  // then info messages are dropped...
+  for (i = 0; i < NB_DROPPED; ++i) {
+    logEmitFunc(env.logHandler, LOG_INFO, "dropped %i", i);
+  }
+  printf("info messages dropped: %lu\n", queue->nbDropped);
+
+  // ...and the others wait for room
+  if (pthread_create(&thread, 0, emitter, 0)) goto error;
+  isStarted = TRUE;
+  sleep(1);
+  printf("notice message waits for room: %s\n", isEmitted?"no":"yes");
+  pthread_mutex_unlock(&queue->writeMutex);
+  isLocked = FALSE;
+  pthread_join(thread, 0);
+  isStarted = FALSE;
+  printf("notice message written: %s\n", isEmitted?"yes":"no");
+
+  // logFlush writes the pending messages (and the drops report)
+  for (i = 0; i < NB_PENDING; ++i) {
+    logEmitFunc(env.logHandler, LOG_NOTICE, "pending %i", i);
+  }
+  logFlush(env.logHandler);
+  printf("lines after logFlush: %i\n", countLines(env.logFile, last));
+
+  // a forked child has no logger thread: it writes synchronously
+  fflush(stdout);
+  if ((pid = fork()) == -1) goto error;
+  if (pid == 0) {
+    logEmitFunc(env.logHandler, LOG_NOTICE, "from the child");
+    logFlush(env.logHandler);
+    _exit(EXIT_SUCCESS);
+  }
+  while ((waitpid(pid, &status, 0)) == -1 && errno == EINTR);
+  printf("lines after the child: %i\n", countLines(env.logFile, last));
+  printf("child logs synchronously: %s\n", 
+	 strcmp(last, "from the child")?"no":"yes");
+
+  // still pending when exiting
+  for (i = 0; i < NB_PENDING; ++i) {
+    logEmitFunc(env.logHandler, LOG_NOTICE, "at exit %i", i);
+  }
+
+  rc = TRUE;
+ error:
+  if (isLocked) pthread_mutex_unlock(&queue->writeMutex);
+  if (isStarted) pthread_join(thread, 0);
+  logFlush(env.logHandler);
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
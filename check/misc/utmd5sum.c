@@ -23,6 +23,78 @@
 
 #include "mediatex.h"
 
+#define NB_HASHERS 8
+
+/*=======================================================================
+ * Function   : hasher
+ * Description: Thread computing checksums, like the upload does
+ * Synopsis   : static void* hasher(void* arg)
+ * Input      : void* arg: the CheckData to compute
+ * Output     : N/A
+ =======================================================================*/
+static void*
+hasher(void* arg)
+{
+  CheckData* data = (CheckData*)arg;
+
+  doChecksum(data);
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : hashConcurrently
+ * Description: Compute the same checksums from several threads
+ * Synopsis   : static int hashConcurrently(char* path, CheckData* ref)
+ * Input      : char* path: file to hash
+ *              CheckData* ref: checksums computed alone
+ * Output     : TRUE if all threads get the same checksums
+ * Note       : misc logs are hidden, as the threads interleave them
+ =======================================================================*/
+static int
+hashConcurrently(char* path, CheckData* ref)
+{
+  int rc = FALSE;
+  CheckData data[NB_HASHERS];
+  pthread_t threads[NB_HASHERS];
+  LogSeverity* severity = 0;
+  int nbThreads = 0;
+  int isSame = TRUE;
+  int i = 0;
+
+  severity = env.logHandler->severity[LOG_MISC];
+  env.logHandler->severity[LOG_MISC] = &LogSeverities[3]; // err
+  env.progBar.cur = env.progBar.max = 0;
+
+  memset(data, 0, sizeof(data));
+  for (i = 0; i < NB_HASHERS; ++i) {
+    data[i].path = path;
+    data[i].opp = CHECK_CACHE_ID;
+    data[i].noProgBar = TRUE;
+  }
+  for (nbThreads = 0; nbThreads < NB_HASHERS; ++nbThreads) {
+    if (pthread_create(threads + nbThreads, 0, hasher, data + nbThreads))
+      break;
+  }
+  for (i = 0; i < nbThreads; ++i) {
+    pthread_join(threads[i], 0);
+  }
+  env.logHandler->severity[LOG_MISC] = severity;
+  if (nbThreads < NB_HASHERS) goto error;
+
+  for (i = 0; i < NB_HASHERS; ++i) {
+    if (data[i].rc != CHECK_SUCCESS ||
+	strcmp(data[i].quickMd5sum, ref->quickMd5sum) ||
+	strcmp(data[i].fullMd5sum, ref->fullMd5sum)) isSame = FALSE;
+  }
+  logMain(LOG_NOTICE, "%i threads get the same checksums: %s",
+	  NB_HASHERS, isSame?"yes":"no");
+  logMain(LOG_NOTICE, "progbar untouched: %s",
+	  (env.progBar.cur || env.progBar.max)?"no":"yes");
+  rc = isSame;
+ error:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : usage
  * Description: Print the usage.
@@ -59,6 +131,7 @@ main(int argc, char** argv)
 {
   char* inputPath = 0;
   CheckData data;
+  CheckData ref;
   // ---
   int rc = 0;
   int cOption = EOF;
@@ -117,6 +190,10 @@ main(int argc, char** argv)
 	  "Quick computation, no path resolution, no progbar");
   data.opp = CHECK_CACHE_ID;
   if (!doChecksum(&data)) goto error;
+  ref = data;
+
+  logMain(LOG_NOTICE, "Quick computation, from several threads");
+  if (!hashConcurrently(inputPath, &ref)) goto error;
   
   memset((void*)&data, 0, sizeof(data));
   data.path = inputPath;
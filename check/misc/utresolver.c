@@ -0,0 +1,169 @@
+/* ======================================================================= 
+ * Project: Mediatex
+ * Module : socket address
+ *
+ * unit test for the resolver cache
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ======================================================================= */
+
+#include "mediatex.h"
+
+#define UNRESOLVABLE "unresolvable.invalid"
+
+/*=======================================================================
+ * Function   : logIp
+ * Description: Log the IP address of a host name
+ * Synopsis   : static void logIp(char* host)
+ * Input      : char* host: the host name
+ * Output     : N/A
+ =======================================================================*/
+static void
+logIp(char* host)
+{
+  struct in_addr ipv4;
+
+  if (getIpFromHostname(&ipv4, host)) {
+    logMain(LOG_NOTICE, "IP of %s is: %s", host, inet_ntoa(ipv4));
+  }
+  else {
+    logMain(LOG_NOTICE, "IP of %s is: unknown", host);
+  }
+}
+
+/*=======================================================================
+ * Function   : logName
+ * Description: Log the host name of 127.0.0.1
+ * Synopsis   : static void logName()
+ * Input      : N/A
+ * Output     : N/A
+ =======================================================================*/
+static void
+logName()
+{
+  struct in_addr ipv4;
+  char* text = 0;
+
+  ipv4.s_addr = htonl(0x7f000001);
+  text = getHostNameByAddr(&ipv4);
+  logMain(LOG_NOTICE, "host name of %s is: %s", 
+	  inet_ntoa(ipv4), text?text:"unknown");
+  if (text) free(text);
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  miscUsage(programName);
+
+  miscOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main 
+ * Description: Unit test for the resolver cache
+ * Synopsis   : utresolver
+ * Input      : N/A
+ * Output     : N/A
+ * Note       : currentTime() never changes for unit tests, so the
+ *              cache is aged instead
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MISC_SHORT_OPTIONS;
+  struct option longOptions[] = {
+    MISC_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MISC_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  logMain(LOG_NOTICE, "%s", "Without resolver thread, answers are cached:");
+  logIp("localhost");
+  logIp("localhost");
+  logName();
+  logName();
+  resolverStatus(LOG_NOTICE);
+
+  logMain(LOG_NOTICE, "%s", "Failures are cached too:");
+  logIp(UNRESOLVABLE);
+  logIp(UNRESOLVABLE);
+  resolverStatus(LOG_NOTICE);
+
+  logMain(LOG_NOTICE, "%s", "Failures are kept less time:");
+  ageResolver(DNS_FAILED_TTL);
+  logIp(UNRESOLVABLE);
+  logIp("localhost");
+  resolverStatus(LOG_NOTICE);
+
+  logMain(LOG_NOTICE, "%s", "Outdated answers are resolved again:");
+  ageResolver(DNS_CACHE_TTL);
+  logIp("localhost");
+  resolverStatus(LOG_NOTICE);
+
+  logMain(LOG_NOTICE, "%s", 
+	  "With a resolver thread, outdated answers are served:");
+  if (!startResolver()) goto error;
+  logName();
+  sleep(1); // let the resolver thread refresh it
+  logMain(LOG_NOTICE, "%s", "and refreshed:");
+  resolverStatus(LOG_NOTICE);
+  if (!stopResolver()) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
@@ -0,0 +1,136 @@
+/* ======================================================================= 
+ * Project: Mediatex
+ * Module : command
+ *
+ * unit test for the child processes (posix_spawn when available)
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ======================================================================= */
+
+#include "mediatex.h"
+
+/*=======================================================================
+ * Function   : run
+ * Description: Run a shell command line and print its exit status
+ * Synopsis   : static void run(char* label, char* command, char* pwd,
+ *                              int doHideStderr)
+ * Input      : char* label: what is tested
+ *              char* command: the shell command line
+ *              char* pwd: directory to change to before exec
+ *              int doHideStderr: close stderr before exec
+ * Output     : N/A
+ =======================================================================*/
+static void
+run(char* label, char* command, char* pwd, int doHideStderr)
+{
+  char *argv[] = {"/bin/sh", "-c", 0, 0};
+  int rc = FALSE;
+
+  // so as the child's outputs are not mixed with ours
+  fflush(stdout);
+  argv[2] = command;
+  rc = execScript(argv, 0, pwd, doHideStderr);
+  printf("%s: %s\n", label, rc?"success":"fails");
+  fflush(stdout);
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void 
+usage(char* programName)
+{
+  miscUsage(programName);
+
+  miscOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main 
+ * Description: Unit test for the child processes
+ * Synopsis   : ./utspawn
+ * Input      : N/A
+ * Output     : stdout
+ * Note       : expect the script logs at notice level, so as the
+ *              stdout of the childs is hidden
+ =======================================================================*/
+int 
+main(int argc, char** argv)
+{
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MISC_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MISC_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0)) 
+	!= EOF) {
+    switch(cOption) {
+      
+      GET_MISC_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  // exit status
+  run("exit 0", "exit 0", 0, FALSE);
+  run("exit 3", "exit 3", 0, FALSE);
+
+  // environment provided to the child
+  run("environment", "[ \"$MDTX_MDTXUSER\" = mdtx1 ]", 0, FALSE);
+
+  // redirections
+  run("stdout hidden", "echo stdout not hidden", 0, FALSE);
+  run("stderr shown", "echo stderr shown >&2", 0, FALSE);
+  run("stderr hidden", "echo stderr not hidden >&2", 0, TRUE);
+
+  // working directory
+  run("chdir", "[ \"$(/bin/pwd)\" = / ]", "/", FALSE);
+  run("chdir to a missing directory", "exit 0", 
+      "/nonexistent.invalid", FALSE);
+  /************************************************************************/
+
+  rc = TRUE;
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
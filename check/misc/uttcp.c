@@ -204,7 +204,7 @@ main(int argc, char** argv)
       goto error;
     }
     
-    if ((socket = connectTcpSocket(&address)) == -1) {
+    if ((socket = connectTcpSocket(&address, CONNECT_TIMEOUT, 0)) == -1) {
       goto error;
     }
     
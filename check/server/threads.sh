@@ -44,7 +44,11 @@ while [ -z "$(ps -ef | grep [u]t$TEST)" ]; do :; done
 telnet 127.0.0.1 6560 >/dev/null 2>&1 || true
 common/utregister -W 2>/dev/null
 
-# HUP wait end of jobs
+# HUP do not wait end of jobs anymore (synchronize for the outputs)
+shm=$(common/utregister -G 2>/dev/null);
+while [ "$shm" != "=> 0000000000" ]; do
+	shm=$(common/utregister -G 2>/dev/null)
+done
 kill -s HUP $PID
 
 # 3 sockets
@@ -54,7 +58,7 @@ telnet 127.0.0.1 6560 >/dev/null 2>&1 || true
 
 # synchronize with daeomon
 shm=$(common/utregister -G 2>/dev/null);
-while [ "$shm" != "=> 000000000" ]; do
+while [ "$shm" != "=> 0000000000" ]; do
 	shm=$(common/utregister -G 2>/dev/null)
 done
 
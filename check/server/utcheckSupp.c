@@ -0,0 +1,166 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : checkSupp
+ *
+ * unit test for the support files check scheduler
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex.h"
+#include "server/mediatex-server.h"
+#include "server/utFunc.h"
+
+#define NOW 1000000000 // fixed date, so as delays are predictable
+
+/*=======================================================================
+ * Function   : logNext
+ * Description: Log the support file the checker would choose
+ * Synopsis   : static void logNext(Configuration* conf, time_t now,
+ *                                  time_t wait)
+ * Input      : Configuration* conf
+ *              time_t now: current date
+ *              time_t wait: delay the checker would wait at most
+ * Output     : N/A
+ =======================================================================*/
+static void
+logNext(Configuration* conf, time_t now, time_t wait)
+{
+  Support* supp = 0;
+  int nbFiles = 0;
+
+  supp = nextSupportCheck(conf, now, &wait, &nbFiles);
+  logMain(LOG_NOTICE, "next: %s, files: %i, wait: %lli",
+	  supp?supp->name:"none", nbFiles, (long long int)wait);
+}
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for the support files check scheduler.
+ * Synopsis   : ./utcheckSupp
+ * Input      : N/A
+ * Output     : N/A
+ * Note       : no support file is really checked
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Configuration* conf = 0;
+  Support* oldest = 0;
+  Support* outdated = 0;
+  Support* recent = 0;
+  Support* floppy = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  // private snapshot, as the checker thread does
+  if (!(conf = createConfiguration())) goto error;
+  if (!useConfiguration(conf)) goto error;
+  conf->fileTTL = 12*DAY;
+  if (!(oldest = addSupport("/support/oldest")) ||
+      !(outdated = addSupport("/support/outdated")) ||
+      !(recent = addSupport("/support/recent")) ||
+      !(floppy = addSupport("floppy"))) goto error;
+  oldest->lastCheck = NOW - 12*DAY;
+  outdated->lastCheck = NOW - 7*DAY;
+  recent->lastCheck = NOW - 2*DAY;
+  floppy->lastCheck = NOW - 20*DAY; // not a file: never checked
+
+  utLog("%s", "Checks are due after half of the fileTTL:", 0);
+  logNext(conf, NOW, CHECK_SUPP_IDLE);
+  logNext(conf, NOW, 10*DAY);
+  oldest->lastCheck = NOW;
+  logNext(conf, NOW, 10*DAY);
+  outdated->lastCheck = NOW;
+  logNext(conf, NOW, 10*DAY);
+  logNext(conf, NOW + 4*DAY, 10*DAY);
+
+  utLog("%s", "Checks are spread over half of the fileTTL:", 0);
+  logMain(LOG_NOTICE, "wait: %lli",
+	  (long long int)spreadSupportChecks(conf, 3, CHECK_SUPP_IDLE));
+  logMain(LOG_NOTICE, "wait: %lli",
+	  (long long int)spreadSupportChecks(conf, 3, 4*DAY));
+  logMain(LOG_NOTICE, "wait: %lli",
+	  (long long int)spreadSupportChecks(conf, 0, 4*DAY));
+
+  utLog("%s", "A failing check is retried a day later:", 0);
+  oldest->lastCheck = NOW - 12*DAY;
+  outdated->lastCheck = NOW - 7*DAY;
+  failSupportCheck("/support/oldest", NOW);
+  logNext(conf, NOW, 10*DAY);
+  outdated->lastCheck = NOW;
+  logNext(conf, NOW, 10*DAY);
+  logNext(conf, NOW + CHECK_SUPP_RETRY, 10*DAY);
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  useConfiguration(0);
+  conf = destroyConfiguration(conf);
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
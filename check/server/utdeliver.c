@@ -175,6 +175,14 @@ main(int argc, char** argv)
   if (!deliverMails(coll)) goto error;
   utLog("%s", "Finaly we have :", coll);
 
+  utLog("%s", "reclaim the delivered demand:", 0);
+  logMain(LOG_NOTICE, "%s record to reclaim", 
+	  coll->cacheTree->nbRemoved > 0 ? "some" : "no");
+  if (!reclaimCacheTree(coll)) goto error;
+  logMain(LOG_NOTICE, "%s record to reclaim, %i left", 
+	  coll->cacheTree->nbRemoved > 0 ? "some" : "no",
+	  avl_count(coll->cacheTree->recordTree->records));
+
   if (!utCleanCaches()) goto error;
   /************************************************************************/
   
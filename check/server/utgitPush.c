@@ -0,0 +1,154 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : gitPush
+ *
+ * unit test for gitPush
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex.h"
+#include "server/mediatex-server.h"
+#include "server/utFunc.h"
+#include <sys/file.h> // flock
+
+/*=======================================================================
+ * Function   : usage
+ * Description: Print the usage.
+ * Synopsis   : static void usage(char* programName)
+ * Input      : programName = the name of the program; usually argv[0].
+ * Output     : N/A
+ =======================================================================*/
+static void
+usage(char* programName)
+{
+  mdtxUsage(programName);
+
+  mdtxOptions();
+  return;
+}
+
+/*=======================================================================
+ * Function   : main
+ * Description: Unit test for gitPush module.
+ * Synopsis   : ./utgitPush
+ * Input      : N/A
+ * Output     : N/A
+ * Note       : commits, pulls and pushes are not really done
+ *              (noRegression)
+ =======================================================================*/
+int
+main(int argc, char** argv)
+{
+  Configuration* conf = 0;
+  char* trueArgv[] = {"/bin/true", 0};
+  char* falseArgv[] = {"/bin/false", 0};
+  int lock1 = -1, lock2 = -1, fd = -1;
+  int i = 0;
+  // ---
+  int rc = 0;
+  int cOption = EOF;
+  char* programName = *argv;
+  char* options = MDTX_SHORT_OPTIONS"";
+  struct option longOptions[] = {
+    MDTX_LONG_OPTIONS,
+    {0, 0, 0, 0}
+  };
+
+  // import mdtx environment
+  env = envUnitTest;
+  getEnv(&env);
+
+  // parse the command line
+  while ((cOption = getopt_long(argc, argv, options, longOptions, 0))
+	!= EOF) {
+    switch(cOption) {
+
+      GET_MDTX_OPTIONS; // generic options
+    }
+    if (rc) goto optError;
+  }
+
+  // export mdtx environment
+  if (!setEnv(programName, &env)) goto optError;
+
+  /************************************************************************/
+  if (!(conf = getConfiguration())) goto error;
+
+  // as mediatexd, before any thread is started
+  utLog("%s", "The helper runs the scripts:", 0);
+  if (!startGitHelper()) goto error;
+  logMain(LOG_NOTICE, "%s as mdtx1: %s", trueArgv[0],
+	  askGitHelper(trueArgv, "mdtx1")?"success":"failure");
+  logMain(LOG_NOTICE, "%s: %s", falseArgv[0],
+	  askGitHelper(falseArgv, 0)?"success":"failure");
+
+  utLog("%s", "Commands share the module lock, not the daemon:", 0);
+  if ((lock1 = lockGitModule(".", LOCK_SH)) == -1) goto error;
+  if ((lock2 = lockGitModule(".", LOCK_SH)) == -1) goto error;
+  if ((fd = open(".", O_RDONLY)) == -1) goto error;
+  logMain(LOG_NOTICE, "exclusive lock while shared: %s",
+	  flock(fd, LOCK_EX | LOCK_NB)?"refused":"granted");
+  unlockGitModule(lock1);
+  unlockGitModule(lock2);
+  logMain(LOG_NOTICE, "exclusive lock once released: %s",
+	  flock(fd, LOCK_EX | LOCK_NB)?"refused":"granted");
+  close(fd);
+
+  if (!startPusher()) goto error;
+
+  utLog("%s", "Successive queries on a module:", 0);
+  for (i = 0; i < 3; ++i) {
+    if (!queuePush("mdtx1-coll1")) goto error;
+  }
+  if (!queuePush("mdtx1")) goto error;
+  pusherStatus(LOG_NOTICE);
+
+  utLog("%s", "Still in the quiet period:", 0);
+  sleep(1);
+  pusherStatus(LOG_NOTICE);
+
+  utLog("%s", "Once quiet, each module is pushed once:", 0);
+  sleep(GIT_QUIET_DELAY + 2);
+  pusherStatus(LOG_NOTICE);
+
+  utLog("%s", "Stop flushes the queued pushes:", 0);
+  if (!queuePush("mdtx1-coll1")) goto error;
+  if (!queuePush("mdtx1-coll2")) goto error;
+  if (!stopPusher()) goto error;
+  pusherStatus(LOG_NOTICE);
+
+  utLog("%s", "No more query once stopped:", 0);
+  if (queuePush("mdtx1-coll1")) goto error;
+  pusherStatus(LOG_NOTICE);
+  if (!stopGitHelper()) goto error;
+  /************************************************************************/
+
+  rc = TRUE;
+ error:
+  freeConfiguration();
+  ENDINGS;
+  rc=!rc;
+ optError:
+  exit(rc);
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* mode: auto-fill */
+/* End: */
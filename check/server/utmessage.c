@@ -28,6 +28,7 @@
 // callback functions requiered (not used here)
 int hupManager(){return 0;};
 int termManager(){return 0;};
+int outdatedManager(Configuration* conf){return 0;};
 void* signalJob(void* arg){return 0;};
 void* socketJob(void* arg){return 0;};
 
@@ -57,6 +57,20 @@ hupManager()
   return TRUE;
 }
 
+/*=======================================================================
+ * Function   : outdatedManager
+ * Description: Callback function for replaced configurations
+ * Synopsis   : int outdatedManager(Configuration* conf)
+ * Input      : Configuration* conf: configuration to free
+ * Output     : N/A
+ =======================================================================*/
+int
+outdatedManager(Configuration* conf)
+{
+  destroyConfiguration(conf);
+  return TRUE;
+}
+
 
 /*=======================================================================
  * Function   : signalJob
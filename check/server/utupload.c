@@ -24,6 +24,59 @@
 #include "mediatex.h"
 #include "server/mediatex-server.h"
 #include "server/utFunc.h"
+#include <sys/file.h>
+
+#define README_HASH "3f18841537668dcf4fafd1471c64d52d"
+#define README_SIZE 1937
+
+/*=======================================================================
+ * Function   : streamUpload
+ * Description: Stream a content for misc/README to the daemon
+ * Synopsis   : static int streamUpload(Collection* coll, char* extra,
+ *                                      char* content, size_t len,
+ *                                      Connexion** connexion)
+ * Input      : Collection* coll
+ *              char* extra: the final supply to upload
+ *              char* content, size_t len: what the client sends
+ * Output     : Connexion** connexion: having the daemon's status
+ *              TRUE if the daemon accepts the upload
+ * Note       : chunks are queued on a socket pair before the daemon
+ *              reads them, so the client must know the offset the
+ *              daemon will ask for (we print it).
+ =======================================================================*/
+static int
+streamUpload(Collection* coll, char* extra, char* content, size_t len,
+	     Connexion** connexion)
+{
+  int rc = FALSE;
+  int sv[2] = {-1, -1};
+  char reply[64];
+  ssize_t n = 0;
+
+  if (!(*connexion = utUploadMessage(coll, extra))) goto error;
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+    logMain(LOG_ERR, "socketpair fails: %s", strerror(errno));
+    goto error;
+  }
+  (*connexion)->sock = sv[0];
+  if (len > 0 && !sendChunk(sv[1], content, len)) goto error;
+  if (!sendChunk(sv[1], 0, 0)) goto error;
+
+  rc = uploadStreamArchive(*connexion);
+
+  if ((n = recv(sv[1], reply, sizeof(reply)-1, MSG_DONTWAIT)) > 0) {
+    reply[n] = 0;
+    if (reply[n-1] == '\n') reply[n-1] = 0;
+    logMain(LOG_NOTICE, "asked: %s", reply);
+  }
+  else {
+    logMain(LOG_NOTICE, "%s", "asked: nothing");
+  }
+ error:
+  if (sv[0] != -1) close(sv[0]);
+  if (sv[1] != -1) close(sv[1]);
+  return rc;
+}
 
 
 /*=======================================================================
@@ -65,7 +118,11 @@ main(int argc, char** argv)
   char* miscRep = 0;
   char* absoluteMiscRep = 0;
   char* extra = 0;
+  char* readme = 0;
+  char* partPath = 0;
+  char content[README_SIZE + 10];
   AVLNode* node = 0;
+  int fd = -1;
   // ---
   int rc = 0;
   int cOption = EOF;
@@ -113,6 +170,7 @@ main(int argc, char** argv)
   if (!(absoluteMiscRep = getAbsolutePath(miscRep))) goto error;
   if (!(extra = createString(absoluteMiscRep))) goto error;
   if (!(extra = catString(extra, "/README"))) goto error;
+  if (!(readme = createString(extra))) goto error;
 
   utLog("%s", "Clean the cache:", 0);
   if (!utCleanCaches()) goto error;
@@ -205,6 +263,79 @@ main(int argc, char** argv)
     goto error;
   }
   utLog("We get %s", connexion->status, coll);
+  destroyRecordTree(connexion->message);
+  free (connexion);
+  connexion = 0;
+
+  utLog("%s", "Clean the cache:", 0);
+  if (!utCleanCaches()) goto error;
+  if (!scanCollection(coll, TRUE)) goto error;
+
+  /*--------------------------------------------------------*/
+  utLog("%s", " * Stream resuming a partial upload:", 0);
+  if ((fd = open(readme, O_RDONLY)) == -1) goto error;
+  if (fdRead(fd, content, README_SIZE) != README_SIZE) goto error;
+  close(fd);
+  if (!(partPath = createString(coll->cacheDir)) ||
+      !(partPath = catString(partPath, "/" UPLOAD_PART_PREFIX 
+			     README_HASH "-1937"))) goto error;
+  if ((fd = open(partPath, O_WRONLY | O_CREAT | O_TRUNC, 0660)) == -1)
+    goto error;
+  if (!fdWrite(fd, content, 1000)) goto error;
+  close(fd);
+  fd = -1;
+  if (!streamUpload(coll, readme, content + 1000, README_SIZE - 1000,
+		    &connexion)) {
+    if (connexion) {
+      utLog("reply : %s", connexion->status, 0);
+    }
+    goto error;
+  }
+  utLog("We get %s", connexion->status, coll);
+  destroyRecordTree(connexion->message);
+  free (connexion);
+  connexion = 0;
+
+  utLog("%s", "Clean the cache:", 0);
+  if (!utCleanCaches()) goto error;
+  if (!scanCollection(coll, TRUE)) goto error;
+
+  /*--------------------------------------------------------*/
+  utLog("%s", " * Stream too much content:", 0);
+  memset(content + README_SIZE, '.', 10);
+  if (streamUpload(coll, readme, content, README_SIZE + 10, &connexion))
+    goto error;
+  logMain(LOG_NOTICE, "reply : %s", connexion->status);
+  logMain(LOG_NOTICE, "partial content kept: %s", 
+	  access(partPath, F_OK)?"no":"yes");
+  destroyRecordTree(connexion->message);
+  free (connexion);
+  connexion = 0;
+
+  /*--------------------------------------------------------*/
+  utLog("%s", " * Stream a corrupted content:", 0);
+  content[0] ^= 1;
+  if (streamUpload(coll, readme, content, README_SIZE, &connexion))
+    goto error;
+  content[0] ^= 1;
+  logMain(LOG_NOTICE, "reply : %s", connexion->status);
+  logMain(LOG_NOTICE, "partial content kept: %s", 
+	  access(partPath, F_OK)?"no":"yes");
+  destroyRecordTree(connexion->message);
+  free (connexion);
+  connexion = 0;
+
+  /*--------------------------------------------------------*/
+  utLog("%s", " * Stream while another stream writes the partial:", 0);
+  if ((fd = open(partPath, O_WRONLY | O_CREAT, 0660)) == -1) goto error;
+  if (flock(fd, LOCK_EX)) goto error;
+  if (streamUpload(coll, readme, content, README_SIZE, &connexion))
+    goto error;
+  logMain(LOG_NOTICE, "reply : %s", connexion->status);
+  close(fd);
+  fd = -1;
+  if (unlink(partPath)) goto error;
+
   /*--------------------------------------------------------*/
   utLog("%s", "Clean the cache:", 0);
   if (!utCleanCaches()) goto error;
@@ -212,7 +343,10 @@ main(int argc, char** argv)
 
   rc = TRUE;
  error:
+  if (fd != -1) close(fd);
   destroyString(extra);
+  destroyString(readme);
+  destroyString(partPath);
   destroyString(miscRep);
   destroyString(absoluteMiscRep);
   if (connexion) destroyRecordTree(connexion->message);
@@ -209,6 +209,8 @@ function USERS_coll_disease()
     rm -fr $COLL_GIT
     rm -fr $COLL_HOME
     rm -f  $MD5SUMS/$1.md5
+    rm -f  $MD5SUMS/$1.jnl
+    rm -f  $MD5SUMS/$1.bin
 
     # /etc/mediatex/mdtx-coll (link)
     rm -f $ETCDIR/$1
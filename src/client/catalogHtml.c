@@ -155,7 +155,7 @@ htmlIndexArchive(FILE* fd, Collection* coll, Archive* self)
   htmlLiOpen(fd);
 
   // look for a thumbnail
-  while ((assoCarac = rgNext_r(self->assoCaracs, &curr))) {
+  while ((assoCarac = rgNext_r(arAssoCaracs(self), &curr))) {
     if (!strcmp(assoCarac->carac->label, "icon")) {
       path = assoCarac->value;
       break;
@@ -168,11 +168,12 @@ htmlIndexArchive(FILE* fd, Collection* coll, Archive* self)
   htmlLink(fd, 0, url, getArchiveScore(self));
 
   /* latexalize caracs */
-  if (!isEmptyRing(self->assoCaracs)) {
-    rgRewind(self->assoCaracs);
+  if (!isEmptyRing(arAssoCaracs(self))) {
+    curr = 0;
     htmlUlOpen(fd);
 
-    while ((assoCarac = rgNext(self->assoCaracs))) {
+    // archives are shared by documents rendered in parallel
+    while ((assoCarac = rgNext_r(arAssoCaracs(self), &curr))) {
       if (!strcmp(assoCarac->carac->label, "icon")) continue;
       if (!htmlAssoCarac(fd, assoCarac)) goto error;
     }
@@ -207,6 +208,7 @@ serializeHtmlRoleList(Collection* coll, AVLNode** node, int i, int n)
   int rc = FALSE;
   AssoRole* asso = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -224,10 +226,7 @@ serializeHtmlRoleList(Collection* coll, AVLNode** node, int i, int n)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   htmlPOpen(fd);
@@ -257,17 +256,14 @@ serializeHtmlRoleList(Collection* coll, AVLNode** node, int i, int n)
   htmlPClose(fd);
   htmlSSIFooter(fd, "../../../..");
 
-   ++env.progBar.cur;
+   __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlRoleList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -288,6 +284,7 @@ serializeHtmlRole(Collection* coll, Role* self)
   AssoRole* assoRole = 0;
   AVLNode* node = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char* path2 = 0;
   char tmp[128];
@@ -323,10 +320,7 @@ serializeHtmlRole(Collection* coll, Role* self)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2); 
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
   htmlSSIHeader2(fd, "../../..", "index");
   htmlPOpen(fd);
   htmlBold(fd, _("Role "));
@@ -335,11 +329,7 @@ serializeHtmlRole(Collection* coll, Role* self)
   htmlBr(fd);
   htmlPClose(fd);
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // serialize human lists for this role
   if ((node = self->assos->head)) {
@@ -361,6 +351,7 @@ serializeHtmlRole(Collection* coll, Role* self)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlRole fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   path2 = destroyString(path2);
   return rc;
@@ -369,20 +360,23 @@ serializeHtmlRole(Collection* coll, Role* self)
 /*=======================================================================
  * Function   : serializeHtmlHuman
  * Description: HTML for Human.
- * Synopsis   : static int serializeHtmlHuman(Collection* coll, Human* self)
+ * Synopsis   : static int serializeHtmlHuman(Collection* coll, void* item)
  * Input      : Collection* coll = context
- *              Human* self = what to latexalize
+ *              void* item = the Human to latexalize
  * Output     : TRUE on success
+ * Note       : called by htmlForEach (may run from several threads)
  =======================================================================*/
 static int 
-serializeHtmlHuman(Collection* coll, Human* self)
+serializeHtmlHuman(Collection* coll, void* item)
 {
   int rc = FALSE;
+  Human* self = (Human*)item;
   Category* category = 0;
   AssoCarac *assoCarac = 0;
   AssoRole* assoRole = 0;
   Role*     role = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[128];
   char text[128];
@@ -397,10 +391,7 @@ serializeHtmlHuman(Collection* coll, Human* self)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize: %s", path); 
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   htmlSSIHeader(fd, "../../..", "index");
 
@@ -473,17 +464,14 @@ serializeHtmlHuman(Collection* coll, Human* self)
 
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlHuman fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -492,20 +480,23 @@ serializeHtmlHuman(Collection* coll, Human* self)
  * Function   : serializeHtmlDocument
  * Description: HTML for Document.
  * Synopsis   : static int serializeHtmlDocument(Collection* coll, 
- *                                               Document* self)
+ *                                               void* item)
  * Input      : Collection* coll = context
- *              Document* self = what to serialize
+ *              void* item = the Document to serialize
  * Output     : TRUE on success
+ * Note       : called by htmlForEach (may run from several threads)
  =======================================================================*/
 static int 
-serializeHtmlDocument(Collection* coll, Document* self)
+serializeHtmlDocument(Collection* coll, void* item)
 {
   int rc = FALSE;
+  Document* self = (Document*)item;
   Category* category = 0;
   AssoCarac  *assoCarac  = 0;
   AssoRole* assoRole = 0;
   Archive *archive = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[128];
   char text[128];
@@ -519,10 +510,7 @@ serializeHtmlDocument(Collection* coll, Document* self)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize: %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   htmlSSIHeader(fd, "../../..", "index");
 
@@ -605,17 +593,14 @@ serializeHtmlDocument(Collection* coll, Document* self)
  
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlDocument fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -639,6 +624,7 @@ serializeHtmlCateList(Collection* coll, Category* self, AVLNode** node,
   int rc = FALSE;
   Document* document = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -654,10 +640,7 @@ serializeHtmlCateList(Collection* coll, Category* self, AVLNode** node,
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
 
@@ -685,17 +668,14 @@ serializeHtmlCateList(Collection* coll, Category* self, AVLNode** node,
  end:
   htmlSSIFooter(fd, "../../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlCateList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -718,6 +698,7 @@ serializeHtmlCategory(Collection* coll, Category* self)
   Category* cat = 0;
   AVLNode* node = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char* path2 = 0;
   char tmp[128];
@@ -745,10 +726,7 @@ serializeHtmlCategory(Collection* coll, Category* self)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2);
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno));
-    goto error;
-  }
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
   htmlSSIHeader2(fd, "../../..", "index");
   htmlPOpen(fd);
   htmlBold(fd, _("Class"));
@@ -827,11 +805,7 @@ serializeHtmlCategory(Collection* coll, Category* self)
   htmlPOpen(fd);
   if (!fprintf(fd, _("\nDocuments: %i\n"), nbDoc)) goto error;
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // serialize document lists for this category
   if ((node = self->documents->head)) {
@@ -860,6 +834,7 @@ serializeHtmlCategory(Collection* coll, Category* self)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlCategory fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   path2 = destroyString(path2);
   return rc;
@@ -883,6 +858,7 @@ serializeHtmlDocList(Collection* coll, AVLNode **node, int i, int n)
   int rc = FALSE;
   Document* document = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   int j = 0;
@@ -894,10 +870,7 @@ serializeHtmlDocList(Collection* coll, AVLNode **node, int i, int n)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   if (!node) goto end; // empty page if needed
@@ -923,17 +896,14 @@ serializeHtmlDocList(Collection* coll, AVLNode **node, int i, int n)
  end:
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlDocList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -952,6 +922,7 @@ serializeHtmlDocLists(Collection* coll, CatalogTree* self)
   int rc = FALSE;
   AVLNode *node = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char tmp[128];
   char* path = 0;
   char* path2 = 0;
@@ -978,10 +949,7 @@ serializeHtmlDocLists(Collection* coll, CatalogTree* self)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2); 
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
   htmlSSIHeader2(fd, "../..", "index");
   htmlPOpen(fd);
   htmlBold(fd, _("All documents "));
@@ -989,11 +957,7 @@ serializeHtmlDocLists(Collection* coll, CatalogTree* self)
   htmlBr(fd);
   htmlPClose(fd);
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // get the total number of lists of documents
   n = (nbDoc - 1) / MAX_INDEX_PER_PAGE +1;
@@ -1019,6 +983,7 @@ serializeHtmlDocLists(Collection* coll, CatalogTree* self)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlDocLists fails");
   }
+  htmlAbortPage(&page);
   path2 = destroyString(path2);
   path = destroyString(path);
   return rc;
@@ -1043,6 +1008,7 @@ serializeHtmlHumList(Collection* coll, AVLNode **node, int i, int n)
   CatalogTree* self = 0;
   Human* human = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -1056,10 +1022,7 @@ serializeHtmlHumList(Collection* coll, AVLNode **node, int i, int n)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   htmlPOpen(fd);
@@ -1086,17 +1049,14 @@ serializeHtmlHumList(Collection* coll, AVLNode **node, int i, int n)
   htmlPClose(fd);
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlHumList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -1116,6 +1076,7 @@ serializeHtmlHumLists(Collection* coll, CatalogTree* self)
   int rc = FALSE;
   AVLNode *node = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char tmp[128];
   char* path = 0;
   char* path2 = 0;
@@ -1142,10 +1103,7 @@ serializeHtmlHumLists(Collection* coll, CatalogTree* self)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2); 
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
   htmlSSIHeader2(fd, "../..", "index");
   htmlPOpen(fd);
   htmlBold(fd, _("All parteners "));
@@ -1153,11 +1111,7 @@ serializeHtmlHumLists(Collection* coll, CatalogTree* self)
   htmlBr(fd);
   htmlPClose(fd);
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // get the total number of lists of documents
   n = (nbHum - 1) / MAX_INDEX_PER_PAGE +1;
@@ -1180,6 +1134,7 @@ serializeHtmlHumLists(Collection* coll, CatalogTree* self)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlHumLists fails");
   }
+  htmlAbortPage(&page);
   path2 = destroyString(path2);
   path = destroyString(path);
   return rc;
@@ -1199,6 +1154,7 @@ serializeHtmlMainIndex(Collection* coll)
   int rc = FALSE;
   CatalogTree* self = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
 
   if (!(self = coll->catalogTree)) goto error;
@@ -1206,10 +1162,7 @@ serializeHtmlMainIndex(Collection* coll)
   if (!(path = createString(coll->htmlIndexDir))) goto error;
   if (!(path = catString(path, "/index.shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize: %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   htmlSSIHeader(fd, "..", "index");
 
@@ -1230,16 +1183,13 @@ serializeHtmlMainIndex(Collection* coll)
 
   htmlSSIFooter(fd, "..");
 
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlMainIndex fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -1303,6 +1253,7 @@ serializeHtmlIndexHeader(Collection* coll)
   Category* category = 0;
   Role* role = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[128];
 
@@ -1311,10 +1262,7 @@ serializeHtmlIndexHeader(Collection* coll)
   if (!(path = createString(coll->htmlDir))) goto error;
   if (!(path = catString(path, "/indexHeader.shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!htmlMainHead(fd, "Index")) goto error;
   if (!htmlLeftPageHead(fd, "index", 0, coll->serverTree->dnsUrl))
@@ -1363,16 +1311,13 @@ serializeHtmlIndexHeader(Collection* coll)
 
   if (!htmlLeftPageTail(fd)) goto error;
   if (!htmlRightHead(fd)) goto error;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlIndexHeader fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -1391,10 +1336,7 @@ serializeHtmlIndex(Collection* coll)
   int rc = FALSE;
   CatalogTree* self = 0;
   Category *category = 0;
-  Document *document = 0;
-  Human *human = 0;
   Role *role = 0;
-  AVLNode *node = 0;
   char tmp[128];
   char *path1 = 0;
   char *path2 = 0;
@@ -1463,18 +1405,13 @@ serializeHtmlIndex(Collection* coll)
 
   // documents
   if (nbDoc > 0) {
-    for(node = self->documents->head; node; node = node->next) {
-      document = (Document*)node->item;
-      if (!serializeHtmlDocument(coll, document)) goto error;
-    }
+    if (!htmlForEach(coll, self->documents, serializeHtmlDocument))
+      goto error;
   }
 
   // humans
   if (nbHum > 0) {
-    for(node = self->humans->head; node; node = node->next) {
-      human = (Human*)node->item;
-      if (!serializeHtmlHuman(coll, human)) goto error;
-    }
+    if (!htmlForEach(coll, self->humans, serializeHtmlHuman)) goto error;
   }
 
   // roles
@@ -24,6 +24,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "mediatex-config.h"
 #include "client/mediatex-client.h"
 
+typedef struct HtmlRenderer {
+  pthread_mutex_t mutex;
+  Collection* coll;
+  AVLNode* next;    // next item to render
+  int (*callback)(Collection* coll, void* item);
+  int isFailed;     // stop rendering after the first error
+} HtmlRenderer;
+
+// pages written or left unchanged by mdtx make
+static int htmlNbRebuilt = 0;
+static int htmlNbSkipped = 0;
+
 /*=======================================================================
  * Function   : getItemUri
  * Description: compute ending path for an item (not a list)
@@ -235,11 +247,11 @@ int getDocumentUri(char* buf, char* path, int id)
  * Description: print score into buffer and return it
  * Synopsis   : getArchiveScore(Archive* self) 
  *              Archive* self: related archive
- * Output     : char* buf = the static string buffer
+ * Output     : char* buf = the static (per thread) string buffer
  =======================================================================*/
 char* getArchiveScore(Archive* self)
 {
-  static char score[8];
+  static __thread char score[8];
 
   if (self->incInherency) {
     sprintf(score, "(%s)", "---");
@@ -256,11 +268,11 @@ char* getArchiveScore(Archive* self)
  * Description: print score into buffer and return it
  * Synopsis   : getContainerScore(Container* self) 
  *              Container* self: related container
- * Output     : char* buf = the static string buffer
+ * Output     : char* buf = the static (per thread) string buffer
  =======================================================================*/
 char* getContainerScore(Container* self)
 {
-  static char score[8];
+  static __thread char score[8];
 
   if (self->incInherency) {
     sprintf(score, "(%s)", "---");
@@ -273,6 +285,328 @@ char* getContainerScore(Container* self)
 }
 
 
+/*=======================================================================
+ * Function   : htmlStartMake
+ * Description: Reset the page counters
+ * Synopsis   : int htmlStartMake(Collection* coll)
+ * Input      : Collection* coll: the collection we are about to render
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+htmlStartMake(Collection* coll)
+{
+  int rc = FALSE;
+
+  checkCollection(coll);
+  htmlNbRebuilt = 0;
+  htmlNbSkipped = 0;
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "htmlStartMake fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : htmlStopMake
+ * Description: Report how many pages were re-written
+ * Synopsis   : int htmlStopMake(Collection* coll)
+ * Input      : Collection* coll: the collection we have rendered
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+htmlStopMake(Collection* coll)
+{
+  int rc = FALSE;
+
+  checkCollection(coll);
+  if (env.dryRun) goto end;
+  logMain(LOG_INFO, "%s: %i pages rebuilt, %i unchanged",
+	  coll->label, htmlNbRebuilt, htmlNbSkipped);
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "htmlStopMake fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : htmlOpenPage
+ * Description: Start rendering a page
+ * Synopsis   : FILE* htmlOpenPage(HtmlPage* page, char* path)
+ * Input      : HtmlPage* page: the page to initialise
+ *              char* path: file to write on close (not copied)
+ * Output     : the stream to print the page into, 0 on error
+ * Note       : the page is rendered into memory, so as htmlClosePage
+ *              may compare it with the file already written
+ =======================================================================*/
+FILE*
+htmlOpenPage(HtmlPage* page, char* path)
+{
+  FILE* rc = 0;
+
+  memset(page, 0, sizeof(HtmlPage));
+  page->path = path;
+
+  if (env.dryRun) {
+    page->fd = stdout;
+    goto end;
+  }
+
+  if (!(page->fd = open_memstream(&page->buf, &page->size))) {
+    logMain(LOG_ERR, "open_memstream fails: %s", strerror(errno));
+    goto error;
+  }
+ end:
+  rc = page->fd;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "htmlOpenPage fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : htmlIsSamePage
+ * Description: Compare a rendered page with the file already written
+ * Synopsis   : static int htmlIsSamePage(HtmlPage* page)
+ * Input      : HtmlPage* page: the rendered page
+ * Output     : TRUE if the file exists and has the same content
+ =======================================================================*/
+static int
+htmlIsSamePage(HtmlPage* page)
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  FILE* fd = 0;
+  char buffer[4096];
+  size_t offset = 0;
+  size_t len = 0;
+
+  if (stat(page->path, &statBuffer)) goto end;
+  if (statBuffer.st_size != (off_t)page->size) goto end;
+  if (!(fd = fopen(page->path, "r"))) goto end;
+
+  while ((len = fread(buffer, 1, sizeof(buffer), fd)) > 0) {
+    if (offset + len > page->size) goto end;
+    if (memcmp(buffer, page->buf + offset, len)) goto end;
+    offset += len;
+  }
+  rc = (offset == page->size);
+ end:
+  if (fd) fclose(fd);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : htmlClosePage
+ * Description: Write the rendered page if its content has changed
+ * Synopsis   : int htmlClosePage(HtmlPage* page)
+ * Input      : HtmlPage* page: the page to close
+ * Output     : TRUE on success
+ * Note       : the page is written into a temporary file that is
+ *              then renamed, so as apache never serves half a page.
+ *              The page is always rendered: only the write is saved
+ *              when the content did not change.
+ =======================================================================*/
+int
+htmlClosePage(HtmlPage* page)
+{
+  int rc = FALSE;
+  char* tmpPath = 0;
+  FILE* fd = 0;
+
+  if (page->fd == stdout) {
+    fflush(stdout);
+    goto end;
+  }
+
+  if (fclose(page->fd)) {
+    page->fd = 0;
+    logMain(LOG_ERR, "fclose fails: %s", strerror(errno));
+    goto error;
+  }
+  page->fd = 0;
+  remind(page->buf);
+
+  if (htmlIsSamePage(page)) {
+    logMain(LOG_DEBUG, "%s not modified", page->path);
+    __sync_add_and_fetch(&htmlNbSkipped, 1);
+    goto end;
+  }
+
+  if (!(tmpPath = createString(page->path)) 
+      || !(tmpPath = catString(tmpPath, ".tmp"))) goto error;
+  if (!(fd = fopen(tmpPath, "w"))) {
+    logMain(LOG_ERR, "fopen %s fails: %s", tmpPath, strerror(errno));
+    goto error;
+  }
+  if (page->size && fwrite(page->buf, page->size, 1, fd) != 1) {
+    logMain(LOG_ERR, "fwrite %s fails: %s", tmpPath, strerror(errno));
+    goto error;
+  }
+  if (fclose(fd)) {
+    fd = 0;
+    logMain(LOG_ERR, "fclose fails: %s", strerror(errno));
+    goto error;
+  }
+  fd = 0;
+  if (rename(tmpPath, page->path) == -1) {
+    logMain(LOG_ERR, "rename fails: %s", strerror(errno));
+    goto error;
+  }
+  __sync_add_and_fetch(&htmlNbRebuilt, 1);
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "htmlClosePage fails");
+  }
+  if (fd) fclose(fd);
+  if (page->buf) free(page->buf);
+  page->buf = 0;
+  tmpPath = destroyString(tmpPath);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : htmlAbortPage
+ * Description: Free a page that was not closed
+ * Synopsis   : void htmlAbortPage(HtmlPage* page)
+ * Input      : HtmlPage* page: the page to free
+ * Output     : N/A
+ * Note       : does nothing once htmlClosePage was called
+ =======================================================================*/
+void
+htmlAbortPage(HtmlPage* page)
+{
+  if (!page->fd || page->fd == stdout) goto end;
+  fclose(page->fd);
+  if (page->buf) {
+    remind(page->buf);
+    free(page->buf);
+  }
+ end:
+  page->fd = 0;
+  page->buf = 0;
+}
+
+/*=======================================================================
+ * Function   : htmlRenderItems
+ * Description: Thread that render the pages of the next tree items
+ * Synopsis   : static void* htmlRenderItems(void* arg)
+ * Input      : void* arg: the HtmlRenderer shared by the threads
+ * Output     : N/A
+ =======================================================================*/
+static void*
+htmlRenderItems(void* arg)
+{
+  HtmlRenderer* renderer = (HtmlRenderer*)arg;
+  AVLNode* node = 0;
+  int err = 0;
+
+  while (1) {
+    if ((err = pthread_mutex_lock(&renderer->mutex))) {
+      logMain(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+      break;
+    }
+    node = 0;
+    if (!renderer->isFailed && renderer->next) {
+      node = renderer->next;
+      renderer->next = node->next;
+    }
+    if ((err = pthread_mutex_unlock(&renderer->mutex))) {
+      logMain(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+      break;
+    }
+    if (!node) break;
+
+    if (!renderer->callback(renderer->coll, node->item)) {
+      pthread_mutex_lock(&renderer->mutex);
+      renderer->isFailed = TRUE;
+      pthread_mutex_unlock(&renderer->mutex);
+    }
+  }
+
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : htmlForEach
+ * Description: Render one page per tree item using a pool of threads
+ * Synopsis   : int htmlForEach(Collection* coll, AVLTree* tree, 
+ *                         int (*callback)(Collection* coll, void* item))
+ * Input      : Collection* coll: the collection we are rendering
+ *              AVLTree* tree: the items to render
+ *              callback: render the page of one item
+ * Output     : TRUE on success
+ * Note       : callbacks must only modify their own item. Pages are
+ *              rendered in order when they are sent to stdout.
+ =======================================================================*/
+int
+htmlForEach(Collection* coll, AVLTree* tree,
+	    int (*callback)(Collection* coll, void* item))
+{
+  int rc = FALSE;
+  HtmlRenderer renderer;
+  pthread_t threads[MAX_HTML_THREAD];
+  int nbThreads = 0;
+  long nbCpus = 0;
+  int isMutex = FALSE;
+  int nb = 0;
+  int err = 0;
+  int i = 0;
+
+  memset(&renderer, 0, sizeof(HtmlRenderer));
+  renderer.coll = coll;
+  renderer.next = tree->head;
+  renderer.callback = callback;
+
+  if ((err = pthread_mutex_init(&renderer.mutex, 0))) {
+    logMain(LOG_ERR, "pthread_mutex_init fails: %s", strerror(err));
+    goto error;
+  }
+  isMutex = TRUE;
+
+  if (env.dryRun || (nb = avl_count(tree)) < 2) {
+    htmlRenderItems(&renderer);
+    goto end;
+  }
+
+  if ((nbCpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1) nbCpus = 1;
+  if (nbCpus > MAX_HTML_THREAD) nbCpus = MAX_HTML_THREAD;
+  if (nbCpus > nb) nbCpus = nb;
+  logMain(LOG_DEBUG, "render %i pages using %li threads", nb, nbCpus);
+  for (nbThreads = 0; nbThreads < nbCpus; ++nbThreads) {
+    if ((err = pthread_create(threads + nbThreads, 0,
+			      htmlRenderItems, &renderer))) {
+      logMain(LOG_ERR, "pthread_create fails: %s", strerror(err));
+      break;
+    }
+  }
+  if (nbThreads == 0) {
+    // no thread available: render from here
+    htmlRenderItems(&renderer);
+  }
+  for (i = 0; i < nbThreads; ++i) {
+    if ((err = pthread_join(threads[i], 0))) {
+      logMain(LOG_ERR, "pthread_join fails: %s", strerror(err));
+      goto error;
+    }
+  }
+ end:
+  rc = !renderer.isFailed;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "htmlForEach fails");
+  }
+  if (isMutex) pthread_mutex_destroy(&renderer.mutex);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : serializeHtmlListBar
  * Description: Latexalize the Archive list bar.
@@ -474,6 +808,7 @@ serializeHtmlCacheHeader(Collection* coll)
   Server* localhost = 0;
   RGIT* curr = 0;
   FILE* fd = stdout; 
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[512];
   int itIs = FALSE;
@@ -483,10 +818,7 @@ serializeHtmlCacheHeader(Collection* coll)
   if (!(path = catString(path, "/cacheHeader.shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
   if (!(localhost = getLocalHost(coll))) goto error;
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!htmlMainHead(fd, _("Cache"))) goto error;
   if (!htmlLeftPageHead(fd, "cache", 0, self->dnsUrl)) goto error;
@@ -528,16 +860,13 @@ serializeHtmlCacheHeader(Collection* coll)
   if (!htmlLeftPageTail(fd)) goto error;
   if (!htmlRightHead(fd)) goto error;
   
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlCacheHeader fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -560,6 +889,7 @@ serializeHtmlCgiHeader(Collection* coll)
   Server *server = 0;
   RGIT* curr = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[512];
   int itIs = FALSE;
@@ -571,10 +901,7 @@ serializeHtmlCgiHeader(Collection* coll)
   if (!(self = coll->serverTree)) goto error;
   if (!(localhost = getLocalHost(coll))) goto error;
   
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!htmlMainHeadBasic(fd, _("Cache"), localhost->url))
     goto error;
@@ -612,16 +939,13 @@ serializeHtmlCgiHeader(Collection* coll)
   if (!htmlLeftPageTail(fd)) goto error;
   if (!htmlRightHeadBasic(fd, localhost->url)) goto error;
   
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlCgiHeader fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -646,6 +970,7 @@ serializeHtmlGitHeader(Collection* coll)
   char* path = 0;
   char url[512];
   FILE* fd = stdout; 
+  HtmlPage page = {0, 0, 0, 0};
   int itIs = FALSE;
 
   if (!(path = createString(coll->htmlDir))) goto error;
@@ -655,10 +980,7 @@ serializeHtmlGitHeader(Collection* coll)
   if (!(self = coll->serverTree)) goto error;
   if (!(localhost = getLocalHost(coll))) goto error;
   
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!htmlMainHeadBasic(fd, _("Version"), localhost->url))
     goto error;
@@ -687,16 +1009,13 @@ serializeHtmlGitHeader(Collection* coll)
   if (!htmlLeftPageTail(fd)) goto error;
   if (!htmlRightHeadBasic(fd, localhost->url)) goto error;
   
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlGitHeader fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -715,6 +1034,7 @@ serializeHtmlFooter(Collection* coll)
   int rc = TRUE;
   char* path = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   time_t now = 0;
   struct tm date;
   char string[11];
@@ -723,10 +1043,7 @@ serializeHtmlFooter(Collection* coll)
   if (!(path = catString(path, "/footer.html"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
 
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if ((now = currentTime()) == -1) goto error;
   if (localtime_r(&now, &date) == (struct tm*)0) {
@@ -740,16 +1057,13 @@ serializeHtmlFooter(Collection* coll)
 	  
   if (!htmlMainTail(fd, string)) goto error;
   
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlAllBottom fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -771,6 +1085,7 @@ serializeHtmlCacheHtaccess(Collection* coll)
   char* pathOut = 0;
   FILE* fdIn = 0;
   FILE* fdOut = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char buffer[256];
   int len = 0;
  
@@ -786,10 +1101,7 @@ serializeHtmlCacheHtaccess(Collection* coll)
     goto error;
   }
   
-  if (!env.dryRun && !(fdOut = fopen(pathOut, "w"))) {
-    logMain(LOG_ERR, "fopen %s fails: %s", pathOut, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fdOut = htmlOpenPage(&page, pathOut))) goto error;
   
   if (!fprintf(fdOut,
 	       "# fancy index for cache\n"
@@ -812,16 +1124,13 @@ serializeHtmlCacheHtaccess(Collection* coll)
   }
   
   fclose(fdIn);
-  if (!env.dryRun) {
-    fclose(fdOut);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlCacheHtaccess fails");
   }
+  htmlAbortPage(&page);
   pathOut = destroyString(pathOut);
   pathIn = destroyString(pathIn);
   return rc;
@@ -26,6 +26,14 @@
 
 #include "mediatex-types.h"
 
+// a page rendered into memory before being written
+typedef struct HtmlPage {
+  char* path;  // file to write (not owned)
+  FILE* fd;    // stream to render into (stdout on dry-run)
+  char* buf;   // rendered content
+  size_t size;
+} HtmlPage;
+
 int getItemUri(char* buf, int id, char* suffix);
 int getListUri(char* buf, int id);
 int htmlMakeDirs(char* path, int max);
@@ -37,6 +45,13 @@ int getArchiveUri(char* buf, char* path, Archive* archive);
 int getDocumentUri(char* buf, char* path, int id);
 char* getArchiveScore(Archive* self);
 char* getContainerScore(Container* self);
+int htmlStartMake(Collection* coll);
+int htmlStopMake(Collection* coll);
+FILE* htmlOpenPage(HtmlPage* page, char* path);
+int htmlClosePage(HtmlPage* page);
+void htmlAbortPage(HtmlPage* page);
+int htmlForEach(Collection* coll, AVLTree* tree,
+		int (*callback)(Collection* coll, void* item));
 int serializeHtmlListBar(Collection* coll, FILE* fd, int n, int N);
 int htmlAssoCarac(FILE* fd, AssoCarac* self);
 int serializeHtmlCache(Collection* coll);
@@ -84,6 +84,7 @@ htmlFromAsso(FromAsso* self, FILE* fd, int isHeader)
   int many = FALSE;
   char url[64];
   char label[16];
+  RGIT* curr = 0;
   int i = 0;
 
   if(self == 0) goto error;
@@ -100,7 +101,8 @@ htmlFromAsso(FromAsso* self, FILE* fd, int isHeader)
   // do not sort !
   if (many) htmlUlOpen(fd);
   
-  while ((archive = rgNext(container->parents))) {
+  // containers are shared by archives rendered in parallel
+  while ((archive = rgNext_r(container->parents, &curr))) {
     if (isHeader) {
       getArchiveUri(url, "../../../..", archive);
     } else {
@@ -201,6 +203,7 @@ serializeHtmlContentList(Collection* coll, AVLNode **node,
   FromAsso* asso = 0;
   Archive* archive = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -211,10 +214,7 @@ serializeHtmlContentList(Collection* coll, AVLNode **node,
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
-    goto error;
-  }
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   htmlPOpen(fd);
@@ -244,17 +244,14 @@ serializeHtmlContentList(Collection* coll, AVLNode **node,
   htmlPClose(fd);
   htmlSSIFooter(fd, "../../../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlContentList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -263,15 +260,17 @@ serializeHtmlContentList(Collection* coll, AVLNode **node,
 /*=======================================================================
  * Function   : serializeHtmlScoreArchive
  * Description: Latexalize a Archive.
- * Synopsis   : int serializeHtmlArchive(Collection* coll, Archive* self)
+ * Synopsis   : int serializeHtmlArchive(Collection* coll, void* item)
  * Input      : Collection* coll
- *              Archive* self = what to latexalize
+ *              void* item = the Archive to latexalize
  * Output     : TRUE on success
+ * Note       : called by htmlForEach (may run from several threads)
  =======================================================================*/
 static int 
-serializeHtmlScoreArchive(Collection* coll, Archive* self)
+serializeHtmlScoreArchive(Collection* coll, void* item)
 {
   int rc = FALSE;
+  Archive* self = (Archive*)item;
   Configuration* conf = 0;
   AssoCarac *assoCarac = 0;
   Document* document = 0;
@@ -279,6 +278,7 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   Image* image = 0;
   AVLNode *node = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[512];
   char text[128];
@@ -329,10 +329,7 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   if (!(path = createString(coll->htmlScoreDir))) goto error;
   if (!(path = catString(path, url))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno));
-    goto error;
-  }
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
   
   if (isHeader) {
     htmlSSIHeader2(fd, "../../../..", "score");
@@ -356,11 +353,11 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   if (!fprintf(fd, " %s", getArchiveScore(self))) goto error;
 
   /* latexalize caracs */
-  if (!isEmptyRing(self->assoCaracs)) {
-    rgRewind(self->assoCaracs);
+  if (!isEmptyRing(arAssoCaracs(self))) {
+    rgRewind(arAssoCaracs(self));
     htmlUlOpen(fd);
 
-    while ((assoCarac = rgNext(self->assoCaracs))) {
+    while ((assoCarac = rgNext(arAssoCaracs(self)))) {
       if (!htmlAssoCarac(fd, assoCarac)) goto error;
     }
 
@@ -374,9 +371,9 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   	       _("\nCatalog reference as documents:\n")))
     goto error;
   htmlUlOpen(fd);
-  if (!isEmptyRing(self->documents)) {
-    if (!rgSort(self->documents, cmpDocument)) goto error;
-    while ((document = rgNext(self->documents))) {
+  if (!isEmptyRing(arDocuments(self))) {
+    if (!rgSort(arDocuments(self), cmpDocument)) goto error;
+    while ((document = rgNext(arDocuments(self)))) {
       if (!sprintf(text, "%s/../index", home)) goto error;
       getDocumentUri(url, text, document->id);
 
@@ -397,9 +394,9 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   htmlPOpen(fd);
   if (!fprintf(fd, _("\nProvided by servers:\n"))) goto error;
   htmlUlOpen(fd);
-  if (!isEmptyRing(self->images)) {
-    if (!rgSort(self->images, cmpImage)) goto error;
-    while ((image = rgNext(self->images))) {
+  if (!isEmptyRing(arImages(self))) {
+    if (!rgSort(arImages(self), cmpImage)) goto error;
+    while ((image = rgNext(arImages(self)))) {
       if (!sprintf(text, "%s/servers/srv_%s.shtml", home,
   		   image->server->fingerPrint)) goto error;
 
@@ -421,10 +418,10 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
   htmlPOpen(fd);
   if (!fprintf(fd, _("\nComes from:\n"))) goto error;
   htmlUlOpen(fd);
-  if (!isEmptyRing(self->fromContainers)) {
+  if (!isEmptyRing(arFromContainers(self))) {
     // already sorted
-    rgRewind(self->fromContainers);
-    while ((asso = rgNext(self->fromContainers))) {
+    rgRewind(arFromContainers(self));
+    while ((asso = rgNext(arFromContainers(self)))) {
       htmlFromAsso(asso, fd, isHeader);
     }
   }
@@ -492,17 +489,14 @@ serializeHtmlScoreArchive(Collection* coll, Archive* self)
     htmlSSIFooter(fd, "../../..");
   }
   
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlScoreArchive fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -520,6 +514,7 @@ serializeHtmlServer(Collection* coll, Server* server)
 { 
   int rc = FALSE;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char* string = 0;
   Image* image = 0;
@@ -540,10 +535,7 @@ serializeHtmlServer(Collection* coll, Server* server)
   if (!(path = catString(path, server->fingerPrint))) goto error;
   if (!(path = catString(path, ".shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!sprintf(text, _("Server%s "),  
 	       (server == coll->serverTree->master)?_(" master"):""))
@@ -648,16 +640,13 @@ serializeHtmlServer(Collection* coll, Server* server)
 
   htmlSSIFooter(fd, "../..");
 
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlServer fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -679,6 +668,7 @@ serializeHtmlArchiveList(Collection* coll, AVLNode **node, int i, int n)
   int rc = FALSE;
   Archive* archive = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -688,10 +678,7 @@ serializeHtmlArchiveList(Collection* coll, AVLNode **node, int i, int n)
   if (!(path = createString(coll->htmlScoreDir))) goto error;
   if (!(path = catString(path, url))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   if (!node) goto end; // empty page if needed
@@ -721,17 +708,14 @@ serializeHtmlArchiveList(Collection* coll, AVLNode **node, int i, int n)
  end:
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlArchiveList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -750,6 +734,7 @@ serializeHtmlArchiveLists(Collection* coll)
   int rc = FALSE;
   AVLNode *node = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char tmp[128];
   char* path = 0;
   char* path2 = 0;
@@ -775,10 +760,7 @@ serializeHtmlArchiveLists(Collection* coll)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2); 
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
 
   htmlSSIHeader2(fd, "../..", "score");
   htmlPOpen(fd);
@@ -787,11 +769,7 @@ serializeHtmlArchiveLists(Collection* coll)
   htmlBr(fd);
   htmlPClose(fd);
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // get the total number of lists of archives
   n = (nb - 1) / MAX_INDEX_PER_PAGE +1;
@@ -817,6 +795,7 @@ serializeHtmlArchiveLists(Collection* coll)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlScoreScoreLists fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   path2 = destroyString(path2);
   return rc;
@@ -838,6 +817,7 @@ serializeHtmlBadList(Collection* coll, RG* ring, int i, int n)
   int rc = FALSE;
   Archive* archive = 0;
   FILE *fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char *path = 0;
   char url[128];
   char text[128];
@@ -850,10 +830,7 @@ serializeHtmlBadList(Collection* coll, RG* ring, int i, int n)
   if (!(path = catString(path, url))) goto error;
 
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   fprintf(fd, "<!--#include virtual='../header.shtml' -->");
   if (!ring) goto end; // empty page if needed
@@ -883,17 +860,14 @@ serializeHtmlBadList(Collection* coll, RG* ring, int i, int n)
  end:
   htmlSSIFooter(fd, "../../..");
 
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlBadList fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -912,6 +886,7 @@ serializeHtmlBadLists(Collection* coll)
   int rc = FALSE;
   RG* badArchives = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char tmp[128];
   char* text = 0;
   char* path = 0;
@@ -944,10 +919,7 @@ serializeHtmlBadLists(Collection* coll)
   if (!(path2 = createString(path))) goto error;
   if (!(path2 = catString(path2, "/header.shtml"))) goto error;
   logMain(LOG_DEBUG, "Serialize %s", path2); 
-  if (!env.dryRun && (fd = fopen(path2, "w")) == 0) {
-    logMain(LOG_ERR, "fopen %s fails: %s", path2, strerror(errno)); 
-    goto error;
-  }
+  if (!(fd = htmlOpenPage(&page, path2))) goto error;
   
   htmlSSIHeader2(fd, "../..", "score");
   htmlPOpen(fd);
@@ -965,11 +937,7 @@ serializeHtmlBadLists(Collection* coll)
       goto error;
   }
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
 
   // sort this new ring on scores
   rgSort(badArchives, cmpArchiveScore);
@@ -998,6 +966,7 @@ serializeHtmlBadLists(Collection* coll)
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlBadLists fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   path2 = destroyString(path2);
   text = destroyString(text);
@@ -1018,6 +987,7 @@ serializeHtmsScoreIndex(Collection* coll)
 { 
   int rc = FALSE;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   ServerTree* serverTree = 0;
   Archive* archive = 0;
@@ -1029,10 +999,7 @@ serializeHtmsScoreIndex(Collection* coll)
   if (!(path = createString(coll->htmlScoreDir))) goto error;
   if (!(path = catString(path, "/index.shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   htmlSSIHeader(fd, "..", _("score"));
 
@@ -1116,16 +1083,13 @@ serializeHtmsScoreIndex(Collection* coll)
 
   htmlSSIFooter(fd, "..");
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmsScoreIndex fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -1145,6 +1109,7 @@ serializeHtmlScoreHeader(Collection* coll)
   ServerTree* self = 0;
   Server* server = 0;
   FILE* fd = stdout;
+  HtmlPage page = {0, 0, 0, 0};
   char* path = 0;
   char url[512];
 
@@ -1154,10 +1119,7 @@ serializeHtmlScoreHeader(Collection* coll)
   if (!(path = createString(coll->htmlDir))) goto error;
   if (!(path = catString(path, "/scoreHeader.shtml"))) goto error;
   logMain(LOG_DEBUG, "serialize %s", path);
-  if (!env.dryRun && (fd = fopen(path, "w")) == 0) {
-    logMain(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno)); 
-    goto error;
-  }  
+  if (!(fd = htmlOpenPage(&page, path))) goto error;
 
   if (!htmlMainHead(fd, _("Score"))) goto error;
   if (!htmlLeftPageHead(fd, _("score"), 0, self->dnsUrl)) goto error;
@@ -1197,16 +1159,13 @@ serializeHtmlScoreHeader(Collection* coll)
   if (!htmlLeftPageTail(fd)) goto error;
   if (!htmlRightHead(fd)) goto error;
 
-  if (!env.dryRun) {
-    fclose(fd);
-  } else {
-    fflush(stdout);
-  }
+  if (!htmlClosePage(&page)) goto error;
   rc = TRUE;
  error:
   if (!rc) {
     logMain(LOG_ERR, "serializeHtmlScoreHeader fails");
   }
+  htmlAbortPage(&page);
   path = destroyString(path);
   return rc;
 }
@@ -1225,8 +1184,6 @@ serializeHtmlScore(Collection* coll)
   int rc = FALSE;
   ServerTree* self = 0;
   Server* server = 0;
-  Archive *archive = 0;
-  AVLNode *node = 0;
   char tmp[128];
   char *path1 = 0;
   char *path2 = 0;
@@ -1273,10 +1230,8 @@ serializeHtmlScore(Collection* coll)
 
   // archives
   if (nb) {
-    for(node = coll->archives->head; node; node = node->next) {
-      archive = (Archive*)node->item;
-      if (!serializeHtmlScoreArchive(coll, archive)) goto error;
-    }
+    if (!htmlForEach(coll, coll->archives, serializeHtmlScoreArchive))
+      goto error;
   }
 
   // others
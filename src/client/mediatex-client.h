@@ -31,6 +31,7 @@
 #include "client/commonHtml.h"
 #include "client/catalogHtml.h"
 #include "client/extractHtml.h"
+#include "client/searchIndex.h"
 #include "client/misc.h"
 #include "client/upload.h"
 
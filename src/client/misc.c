@@ -63,10 +63,13 @@ int mdtxMake(char* label)
   if (!becomeUser(env.confLabel, TRUE)) goto error2;
   sprintf(progBarLabel, "make %s", label);
   startProgBar(progBarLabel);
+  if (!htmlStartMake(coll)) goto error3;
   if (!serializeHtmlCache(coll)) goto error3;
   if (!serializeHtmlIndex(coll)) goto error3;
+  if (!saveSearchIndex(coll)) goto error3;
   if (!serializeHtmlScore(coll)) goto error3;
   stopProgBar();
+  if (!htmlStopMake(coll)) goto error3;
   logMain(LOG_DEBUG, "done: steps %lli / %lli", 
 	  env.progBar.cur, env.progBar.max);
 
@@ -590,8 +593,6 @@ mdtxAudit(char* label, char* mail)
   char* tmp = 0;
   time_t now = 0;
   struct tm date;
-  int socket = -1;
-  int n = 0;
   char reply[255] = "100 nobody";
   int status = 0;
   int uid = getuid();
@@ -681,15 +682,10 @@ mdtxAudit(char* label, char* mail)
 
   // connect server and write query
   if (env.noRegression) goto end;
-  if ((socket = connectServer(coll->localhost)) == -1) goto error3;
-  if (!upgradeServer(socket, tree, 0)) goto error3;
+  if (!exchangeServer(coll->localhost, tree, 0, reply, 255)) goto error3;
   
   // read reply
   if (env.dryRun) goto end;
-  n = tcpRead(socket, reply, 255);
-  // erase the \n send by server
-  if (n<=0) n = 1;
-  reply[n-1] = (char)0; 
   if (sscanf(reply, "%i", &status) < 1) {
     logMain(LOG_ERR, "error reading server reply: %s", reply);
     goto error;
@@ -352,9 +352,9 @@ int motdArchive(MotdSearch* data, Archive* archive, int depth)
   }
 
   // look for a matching image 
-  if (archive->images->nbItems > 0) {
+  if (arImages(archive)->nbItems > 0) {
     logMain(LOG_INFO, "%*s%i images matched", depth, "",
-	    archive->images->nbItems);
+	    arImages(archive)->nbItems);
 
     // look for matching physical supports (but not support files)
     rgRewind(data->coll->supports);
@@ -380,7 +380,7 @@ int motdArchive(MotdSearch* data, Archive* archive, int depth)
 
   // continue searching ; we stop at the first container already there
   while (!data->isAvailable && 
-	(asso = rgNext_r(archive->fromContainers, &curr))) {
+	(asso = rgNext_r(arFromContainers(archive), &curr))) {
     if (!motdContainer(data, asso->container, depth+1)) goto error;
   }
 
@@ -470,7 +470,7 @@ updateMotdFromMd5sumsDB(Motd* motd, Collection* coll,
     // if motd policy is ALL...
     if (motdPolicy == ALL &&
 	// ...looking for top container...
-	!archive->fromContainers->nbItems &&
+	!arFromContainers(archive)->nbItems &&
 	// ...that have no local image...
 	(!(image = getImage(coll, coll->localhost, archive)))) {
       doIt = TRUE;
@@ -501,7 +501,7 @@ updateMotdFromMd5sumsDB(Motd* motd, Collection* coll,
 
     // assert it is included into another safe support
     curr = 0;
-    while ((asso = rgNext_r(archive->fromContainers, &curr))) {
+    while ((asso = rgNext_r(arFromContainers(archive), &curr))) {
       if (asso->container->score >
 	  coll->serverTree->scoreParam.maxScore / 2) break;
     }
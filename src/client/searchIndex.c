@@ -0,0 +1,780 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : searchIndex
+ *
+ * Full-text search index over the catalog
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex-config.h"
+#include "client/mediatex-client.h"
+#include <sys/mman.h>
+
+// not isalnum nor tolower: make and the cgi do not share the locale
+#define isWordByte(c)						\
+  ((c) >= 0x80 || ((c) >= '0' && (c) <= '9') ||			\
+   ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+
+// file layout: header, entries, terms (sorted), postings and strings
+typedef struct SearchHeader {
+  char magic[8];
+  int  version;
+  int  nbEntries;
+  int  nbTerms;
+  int  nbPostings;
+  int  poolSize;
+} SearchHeader;
+
+typedef struct SearchEntry {
+  int type;  // CType
+  int id;
+  int label; // offsets into the strings
+  int url;
+} SearchEntry;
+
+typedef struct SearchTerm {
+  int word;  // offset into the strings
+  int first; // first posting
+  int nbPostings;
+} SearchTerm;
+
+typedef struct SearchPosting {
+  int entry;
+  int weight;
+} SearchPosting;
+
+// labels weight more than the carac values
+#define SEARCH_LABEL_WEIGHT 4
+#define SEARCH_VALUE_WEIGHT 1
+
+// a word collected by saveSearchIndex
+typedef struct SearchWord {
+  char* word;
+  SearchPosting* postings;
+  int nbPostings;
+  int maxPostings;
+} SearchWord;
+
+typedef struct SearchBuilder {
+  AVLTree*     words; // SearchWord*
+  SearchEntry* entries;
+  int          nbEntries;
+  int          maxEntries;
+  int          nbPostings;
+  FILE*        pool;  // strings
+  char*        poolBuf;
+  size_t       poolSize;
+} SearchBuilder;
+
+// the mapped index file
+struct SearchIndex {
+  void*          map;
+  size_t         size;
+  SearchHeader*  header;
+  SearchEntry*   entries;
+  SearchTerm*    terms;
+  SearchPosting* postings;
+  char*          pool;
+};
+
+/*=======================================================================
+ * Function   : nextWord
+ * Description: Extract the next word from a text
+ * Synopsis   : static int nextWord(char** text, char* word)
+ * Input      : char** text: where to start, updated
+ * Output     : char* word: the lower case word (MAX_SEARCH_WORD)
+ *              TRUE if a word is found
+ * Note       : words are alphanumeric or non-ASCII (UTF-8) sequences,
+ *              single letters are skipped. Only ASCII and latin-1
+ *              letters are lowered.
+ =======================================================================*/
+static int
+nextWord(char** text, char* word)
+{
+  unsigned char* ptr = (unsigned char*)*text;
+  int c = 0;
+  int l = 0;
+
+  while (*ptr) {
+    while (*ptr && !isWordByte(*ptr)) ++ptr;
+    l = 0;
+    while (*ptr && isWordByte(*ptr)) {
+      c = *ptr;
+      if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+      // UTF-8 latin-1 upper case letters (but the multiplication sign)
+      if (ptr > (unsigned char*)*text && ptr[-1] == 0xC3 &&
+	  c >= 0x80 && c <= 0x9E && c != 0x97) c += 0x20;
+      if (l < MAX_SEARCH_WORD-1) word[l++] = c;
+      ++ptr;
+    }
+    if (l > 1) break;
+  }
+
+  word[l] = (char)0;
+  *text = (char*)ptr;
+  return (l > 1);
+}
+
+/*=======================================================================
+ * Function   : cmpSearchWord
+ * Description: Compare 2 words
+ * Synopsis   : static int cmpSearchWord(const void *p1, const void *p2)
+ * Input      : const void *p1, const void *p2: SearchWord*
+ * Output     : like strcmp
+ =======================================================================*/
+static int
+cmpSearchWord(const void *p1, const void *p2)
+{
+  const SearchWord* w1 = p1;
+  const SearchWord* w2 = p2;
+
+  return strcmp(w1->word, w2->word);
+}
+
+/*=======================================================================
+ * Function   : destroySearchWord
+ * Description: Free a collected word
+ * Synopsis   : static SearchWord* destroySearchWord(SearchWord* self)
+ * Input      : SearchWord* self
+ * Output     : 0
+ =======================================================================*/
+static SearchWord*
+destroySearchWord(SearchWord* self)
+{
+  if (!self) goto error;
+  destroyString(self->word);
+  if (self->postings) free(self->postings);
+  free(self);
+ error:
+  return (SearchWord*)0;
+}
+
+/*=======================================================================
+ * Function   : addString
+ * Description: Copy a string into the strings of the index
+ * Synopsis   : static int addString(SearchBuilder* self, char* string)
+ * Input      : SearchBuilder* self
+ *              char* string
+ * Output     : the offset of the string, -1 on error
+ =======================================================================*/
+static int
+addString(SearchBuilder* self, char* string)
+{
+  int rc = -1;
+  long offset = 0;
+
+  if ((offset = ftell(self->pool)) == -1) goto error;
+  if (fwrite(string, strlen(string)+1, 1, self->pool) != 1) goto error;
+  rc = offset;
+ error:
+  if (rc == -1) {
+    logMain(LOG_ERR, "cannot store string: %s", strerror(errno));
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : addEntry
+ * Description: Add a document, human or category to the index
+ * Synopsis   : static int addEntry(SearchBuilder* self, CType type,
+ *                                  int id, char* label, char* url)
+ * Input      : SearchBuilder* self
+ *              CType type, int id: the catalog entity
+ *              char* label: label to display
+ *              char* url: page relative to htmlIndexDir
+ * Output     : TRUE on success
+ * Note       : next words will be attached to this entry
+ =======================================================================*/
+static int
+addEntry(SearchBuilder* self, CType type, int id, char* label, char* url)
+{
+  int rc = FALSE;
+  SearchEntry* entries = 0;
+  SearchEntry* entry = 0;
+  int max = 0;
+
+  if (self->nbEntries == self->maxEntries) {
+    max = self->maxEntries ? 2*self->maxEntries : 1024;
+    if (!(entries = realloc(self->entries, max * sizeof(SearchEntry)))) {
+      logMain(LOG_ERR, "cannot realloc search entries");
+      goto error;
+    }
+    self->entries = entries;
+    self->maxEntries = max;
+  }
+
+  entry = self->entries + self->nbEntries;
+  entry->type = type;
+  entry->id = id;
+  if ((entry->label = addString(self, label)) == -1) goto error;
+  if ((entry->url = addString(self, url)) == -1) goto error;
+  ++self->nbEntries;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "addEntry fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : addWord
+ * Description: Attach a word to the last entry
+ * Synopsis   : static int addWord(SearchBuilder* self, char* word,
+ *                                 int weight)
+ * Input      : SearchBuilder* self
+ *              char* word: as returned by nextWord
+ *              int weight: SEARCH_LABEL_WEIGHT or SEARCH_VALUE_WEIGHT
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+addWord(SearchBuilder* self, char* word, int weight)
+{
+  int rc = FALSE;
+  SearchWord* item = 0;
+  SearchWord* newItem = 0;
+  SearchPosting* postings = 0;
+  SearchWord key;
+  AVLNode* node = 0;
+  int entry = self->nbEntries-1;
+  int max = 0;
+
+  key.word = word;
+  if ((node = avl_search(self->words, &key))) {
+    item = node->item;
+  }
+  else {
+    if (!(newItem = malloc(sizeof(SearchWord)))) {
+      logMain(LOG_ERR, "cannot malloc search word");
+      goto error;
+    }
+    memset(newItem, 0, sizeof(SearchWord));
+    if (!(newItem->word = createString(word))) goto error;
+    if (!avl_insert(self->words, newItem)) {
+      logMain(LOG_ERR, "cannot add search word");
+      goto error;
+    }
+    item = newItem;
+    newItem = 0;
+  }
+
+  // same word several times into the same entry
+  if (item->nbPostings > 0 &&
+      item->postings[item->nbPostings-1].entry == entry) {
+    item->postings[item->nbPostings-1].weight += weight;
+    goto end;
+  }
+
+  if (item->nbPostings == item->maxPostings) {
+    max = item->maxPostings ? 2*item->maxPostings : 4;
+    if (!(postings = realloc(item->postings,
+			     max * sizeof(SearchPosting)))) {
+      logMain(LOG_ERR, "cannot realloc search postings");
+      goto error;
+    }
+    item->postings = postings;
+    item->maxPostings = max;
+  }
+
+  item->postings[item->nbPostings].entry = entry;
+  item->postings[item->nbPostings].weight = weight;
+  ++item->nbPostings;
+  ++self->nbPostings;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "addWord fails");
+  }
+  destroySearchWord(newItem);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : addText
+ * Description: Attach the words of a text to the last entry
+ * Synopsis   : static int addText(SearchBuilder* self, char* text,
+ *                                 int weight)
+ * Input      : SearchBuilder* self
+ *              char* text
+ *              int weight: SEARCH_LABEL_WEIGHT or SEARCH_VALUE_WEIGHT
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+addText(SearchBuilder* self, char* text, int weight)
+{
+  int rc = FALSE;
+  char word[MAX_SEARCH_WORD];
+
+  if (!text) goto end;
+  while (nextWord(&text, word)) {
+    if (!addWord(self, word, weight)) goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : addAssoCaracs
+ * Description: Attach the carac values to the last entry
+ * Synopsis   : static int addAssoCaracs(SearchBuilder* self, RG* ring)
+ * Input      : SearchBuilder* self
+ *              RG* ring: AssoCarac*
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+addAssoCaracs(SearchBuilder* self, RG* ring)
+{
+  int rc = FALSE;
+  AssoCarac* assoCarac = 0;
+  RGIT* curr = 0;
+
+  while ((assoCarac = rgNext_r(ring, &curr))) {
+    if (!addText(self, assoCarac->value, SEARCH_VALUE_WEIGHT)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : writeSearchIndex
+ * Description: Write the collected entries and words
+ * Synopsis   : static int writeSearchIndex(SearchBuilder* self,
+ *                                          FILE* fd)
+ * Input      : SearchBuilder* self
+ *              FILE* fd: the output file
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+writeSearchIndex(SearchBuilder* self, FILE* fd)
+{
+  int rc = FALSE;
+  SearchHeader header;
+  SearchTerm term;
+  SearchWord* word = 0;
+  AVLNode* node = 0;
+
+  if (fflush(self->pool)) goto error;
+
+  memset(&header, 0, sizeof(SearchHeader));
+  memcpy(header.magic, SEARCH_MAGIC, 8);
+  header.version = SEARCH_VERSION;
+  header.nbEntries = self->nbEntries;
+  header.nbTerms = avl_count(self->words);
+  header.nbPostings = self->nbPostings;
+  header.poolSize = self->poolSize;
+
+  if (fwrite(&header, sizeof(SearchHeader), 1, fd) != 1) goto error;
+  if (fwrite(self->entries, sizeof(SearchEntry), self->nbEntries, fd)
+      != self->nbEntries) goto error;
+
+  // terms are sorted by the AVL tree
+  term.first = 0;
+  for (node = self->words->head; node; node = node->next) {
+    word = node->item;
+    if ((term.word = addString(self, word->word)) == -1) goto error;
+    term.nbPostings = word->nbPostings;
+    if (fwrite(&term, sizeof(SearchTerm), 1, fd) != 1) goto error;
+    term.first += word->nbPostings;
+  }
+  for (node = self->words->head; node; node = node->next) {
+    word = node->item;
+    if (fwrite(word->postings, sizeof(SearchPosting), word->nbPostings,
+	       fd) != word->nbPostings) goto error;
+  }
+
+  // strings, including the terms added above
+  if (fflush(self->pool)) goto error;
+  if (fwrite(self->poolBuf, self->poolSize, 1, fd) != 1) goto error;
+
+  header.poolSize = self->poolSize;
+  if (fseek(fd, 0, SEEK_SET)) goto error;
+  if (fwrite(&header, sizeof(SearchHeader), 1, fd) != 1) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "write fails: %s", strerror(errno));
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : saveSearchIndex
+ * Description: Build the full-text search index of the catalog
+ * Synopsis   : int saveSearchIndex(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Note       : index document labels, human names, category labels
+ *              and their carac values. The index is written aside and
+ *              then renamed, so as the cgi never reads a partial file.
+ =======================================================================*/
+int
+saveSearchIndex(Collection* coll)
+{
+  int rc = FALSE;
+  CatalogTree* self = 0;
+  SearchBuilder builder;
+  Document* document = 0;
+  Human* human = 0;
+  Category* category = 0;
+  AVLNode* node = 0;
+  RGIT* curr = 0;
+  FILE* fd = 0;
+  char* path = 0;
+  char* tmp = 0;
+  char* label = 0;
+  char url[128];
+  char buf[32];
+
+  memset(&builder, 0, sizeof(SearchBuilder));
+  checkCollection(coll);
+  if (!(self = coll->catalogTree)) goto error;
+  logMain(LOG_DEBUG, "save %s search index", coll->label);
+  if (env.dryRun) goto end;
+
+  if (!(builder.words =
+	avl_alloc_tree(cmpSearchWord, (avl_freeitem_t)destroySearchWord))) {
+    logMain(LOG_ERR, "cannot alloc search words");
+    goto error;
+  }
+  if (!(builder.pool = open_memstream(&builder.poolBuf,
+				      &builder.poolSize))) {
+    logMain(LOG_ERR, "open_memstream fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // an empty string first, so as the strings are never empty
+  if (addString(&builder, "") == -1) goto error;
+
+  // documents
+  for (node = self->documents->head; node; node = node->next) {
+    document = node->item;
+    if (!getDocumentUri(url, "", document->id)) goto error;
+    if (!addEntry(&builder, DOC, document->id, document->label, url))
+      goto error;
+    if (!addText(&builder, document->label, SEARCH_LABEL_WEIGHT))
+      goto error;
+    if (!addAssoCaracs(&builder, document->assoCaracs)) goto error;
+  }
+
+  // humans
+  for (node = self->humans->head; node; node = node->next) {
+    human = node->item;
+    label = destroyString(label);
+    if (!(label = createString(human->firstName))) goto error;
+    if (!isEmptyString(human->secondName)) {
+      if (!(label = catString(label, " ")) ||
+	  !(label = catString(label, human->secondName))) goto error;
+    }
+    if (!getHumanUri(url, "", human->id)) goto error;
+    if (!addEntry(&builder, HUM, human->id, label, url)) goto error;
+    if (!addText(&builder, label, SEARCH_LABEL_WEIGHT)) goto error;
+    if (!addAssoCaracs(&builder, human->assoCaracs)) goto error;
+  }
+
+  // categories
+  while ((category = rgNext_r(self->categories, &curr))) {
+    if (!getCateListUri(url, "", category->id, 1)) goto error;
+    if (!addEntry(&builder, CATE, category->id, category->label, url))
+      goto error;
+    if (!addText(&builder, category->label, SEARCH_LABEL_WEIGHT))
+      goto error;
+    if (!addAssoCaracs(&builder, category->assoCaracs)) goto error;
+  }
+
+  // output file
+  sprintf(buf, ".%i", (int)getpid());
+  if (!(path = createString(coll->htmlIndexDir))
+      || !(path = catString(path, SEARCH_FILE))) goto error;
+  if (!(tmp = createString(path)) || !(tmp = catString(tmp, buf)))
+    goto error;
+  if (!(fd = fopen(tmp, "w"))) {
+    logMain(LOG_ERR, "cannot write %s: %s", tmp, strerror(errno));
+    goto error;
+  }
+  if (!writeSearchIndex(&builder, fd)) goto error2;
+  if (fclose(fd)) {
+    fd = 0;
+    logMain(LOG_ERR, "fclose fails: %s", strerror(errno));
+    goto error2;
+  }
+  fd = 0;
+  if (rename(tmp, path) == -1) {
+    logMain(LOG_ERR, "rename %s fails: %s", tmp, strerror(errno));
+    goto error2;
+  }
+  logMain(LOG_INFO, "search index written: %i entries, %i words",
+	  builder.nbEntries, avl_count(builder.words));
+
+ end:
+  rc = TRUE;
+ error2:
+  if (fd) fclose(fd);
+  if (!rc && unlink(tmp) == -1 && errno != ENOENT) {
+    logMain(LOG_ERR, "unlink fails: %s", strerror(errno));
+  }
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "saveSearchIndex fails");
+  }
+  if (builder.words) avl_free_tree(builder.words);
+  if (builder.entries) free(builder.entries);
+  if (builder.pool) fclose(builder.pool);
+  if (builder.poolBuf) free(builder.poolBuf);
+  label = destroyString(label);
+  path = destroyString(path);
+  tmp = destroyString(tmp);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : closeSearchIndex
+ * Description: Unmap the search index
+ * Synopsis   : SearchIndex* closeSearchIndex(SearchIndex* self)
+ * Input      : SearchIndex* self
+ * Output     : 0
+ =======================================================================*/
+SearchIndex*
+closeSearchIndex(SearchIndex* self)
+{
+  if (!self) goto end;
+  if (self->map != MAP_FAILED && munmap(self->map, self->size)) {
+    logMain(LOG_ERR, "munmap fails: %s", strerror(errno));
+  }
+  free(self);
+ end:
+  return (SearchIndex*)0;
+}
+
+/*=======================================================================
+ * Function   : openSearchIndex
+ * Description: Map the search index written by saveSearchIndex
+ * Synopsis   : SearchIndex* openSearchIndex(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : the mapped index, 0 on error
+ * Note       : the catalog is not loaded. Offsets are checked while
+ *              querying, so as to only read the pages we need.
+ =======================================================================*/
+SearchIndex*
+openSearchIndex(Collection* coll)
+{
+  SearchIndex* rc = 0;
+  SearchIndex* self = 0;
+  SearchHeader* header = 0;
+  struct stat statBuffer;
+  char* path = 0;
+  size_t size = 0;
+  int fd = -1;
+
+  checkCollection(coll);
+  logMain(LOG_DEBUG, "open %s search index", coll->label);
+
+  if (!(path = createString(coll->htmlIndexDir))
+      || !(path = catString(path, SEARCH_FILE))) goto error;
+  if (!(self = malloc(sizeof(SearchIndex)))) {
+    logMain(LOG_ERR, "cannot malloc search index");
+    goto error;
+  }
+  memset(self, 0, sizeof(SearchIndex));
+  self->map = MAP_FAILED;
+
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    logMain(LOG_ERR, "open %s fails: %s", path, strerror(errno));
+    goto error;
+  }
+  if (fstat(fd, &statBuffer)) {
+    logMain(LOG_ERR, "fstat fails: %s", strerror(errno));
+    goto error;
+  }
+  if (statBuffer.st_size < sizeof(SearchHeader)) goto corrupted;
+  self->size = statBuffer.st_size;
+  if ((self->map = mmap(0, self->size, PROT_READ, MAP_PRIVATE, fd, 0))
+      == MAP_FAILED) {
+    logMain(LOG_ERR, "mmap fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // header
+  header = self->header = self->map;
+  if (memcmp(header->magic, SEARCH_MAGIC, 8) ||
+      header->version != SEARCH_VERSION ||
+      header->nbEntries < 0 || header->nbTerms < 0 ||
+      header->nbPostings < 0 || header->poolSize < 1) goto corrupted;
+  size = sizeof(SearchHeader)
+    + (size_t)header->nbEntries * sizeof(SearchEntry)
+    + (size_t)header->nbTerms * sizeof(SearchTerm)
+    + (size_t)header->nbPostings * sizeof(SearchPosting)
+    + header->poolSize;
+  if (size != self->size) goto corrupted;
+
+  self->entries = (SearchEntry*)(header + 1);
+  self->terms = (SearchTerm*)(self->entries + header->nbEntries);
+  self->postings = (SearchPosting*)(self->terms + header->nbTerms);
+  self->pool = (char*)(self->postings + header->nbPostings);
+  if (self->pool[header->poolSize-1] != (char)0) goto corrupted;
+
+  rc = self;
+  self = 0;
+  goto error;
+ corrupted:
+  logMain(LOG_ERR, "corrupted search index: %s", path);
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "openSearchIndex fails");
+  }
+  if (fd != -1) close(fd);
+  self = closeSearchIndex(self);
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : getIndexString
+ * Description: Get a string from the mapped index
+ * Synopsis   : static char* getIndexString(SearchIndex* self,
+ *                                          int offset)
+ * Input      : SearchIndex* self
+ *              int offset
+ * Output     : the string, 0 if out of bounds
+ =======================================================================*/
+static char*
+getIndexString(SearchIndex* self, int offset)
+{
+  if (offset < 0 || offset >= self->header->poolSize) return 0;
+  return self->pool + offset;
+}
+
+/*=======================================================================
+ * Function   : querySearchIndex
+ * Description: Find the entries matching all the words of a query
+ * Synopsis   : int querySearchIndex(SearchIndex* self, char* query,
+ *                                   SearchHit* hits, int max)
+ * Input      : SearchIndex* self
+ *              char* query: words to look for (as prefixes)
+ *              int max: size of hits
+ * Output     : SearchHit* hits: best entries first
+ *              the number of hits, -1 on error
+ * Note       : an exact word match counts twice a prefix match
+ =======================================================================*/
+int
+querySearchIndex(SearchIndex* self, char* query, SearchHit* hits, int max)
+{
+  int rc = -1;
+  SearchHeader* header = 0;
+  SearchEntry* entry = 0;
+  SearchTerm* term = 0;
+  SearchPosting* posting = 0;
+  char words[MAX_SEARCH_QUERY][MAX_SEARCH_WORD];
+  int* scores = 0;
+  int* masks = 0;
+  char* word = 0;
+  int nbWords = 0;
+  int all = 0;
+  int exact = 0;
+  int lo = 0, hi = 0, mid = 0;
+  int i = 0, j = 0, k = 0, l = 0, n = 0;
+
+  if (!self || !query || !hits || max < 1) goto error;
+  header = self->header;
+  logMain(LOG_DEBUG, "querySearchIndex: %s", query);
+
+  while (nbWords < MAX_SEARCH_QUERY && nextWord(&query, words[nbWords]))
+    ++nbWords;
+  if (nbWords == 0 || header->nbEntries == 0) goto end;
+  all = (1 << nbWords) - 1;
+
+  if (!(scores = calloc(header->nbEntries, sizeof(int))) ||
+      !(masks = calloc(header->nbEntries, sizeof(int)))) {
+    logMain(LOG_ERR, "cannot calloc search scores");
+    goto error;
+  }
+
+  for (i = 0; i < nbWords; ++i) {
+    l = strlen(words[i]);
+
+    // first term not lower than the word
+    lo = 0;
+    hi = header->nbTerms;
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (!(word = getIndexString(self, self->terms[mid].word)))
+	goto corrupted;
+      if (strcmp(word, words[i]) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+
+    // all the terms starting with the word
+    for (j = lo; j < header->nbTerms; ++j) {
+      term = self->terms + j;
+      if (!(word = getIndexString(self, term->word))) goto corrupted;
+      if (strncmp(word, words[i], l)) break;
+      exact = (word[l] == (char)0);
+      if (term->first < 0 || term->nbPostings < 0 ||
+	  term->first > header->nbPostings - term->nbPostings)
+	goto corrupted;
+      for (k = 0; k < term->nbPostings; ++k) {
+	posting = self->postings + term->first + k;
+	if (posting->entry < 0 || posting->entry >= header->nbEntries)
+	  goto corrupted;
+	scores[posting->entry] += exact ? 2*posting->weight : posting->weight;
+	masks[posting->entry] |= 1 << i;
+      }
+    }
+  }
+
+  // keep the best entries matching all the words
+  for (i = 0; i < header->nbEntries; ++i) {
+    if (masks[i] != all) continue;
+    for (j = n; j > 0 && hits[j-1].score < scores[i]; --j) {
+      if (j < max) hits[j] = hits[j-1];
+    }
+    if (j >= max) continue;
+    entry = self->entries + i;
+    if (entry->type != DOC && entry->type != HUM && entry->type != CATE)
+      goto corrupted;
+    hits[j].type = entry->type;
+    hits[j].score = scores[i];
+    if (!(hits[j].label = getIndexString(self, entry->label)) ||
+	!(hits[j].url = getIndexString(self, entry->url))) goto corrupted;
+    if (n < max) ++n;
+  }
+
+ end:
+  rc = n;
+  goto error;
+ corrupted:
+  logMain(LOG_ERR, "corrupted search index");
+ error:
+  if (rc == -1) {
+    logMain(LOG_ERR, "querySearchIndex fails");
+  }
+  if (scores) free(scores);
+  if (masks) free(masks);
+  return rc;
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
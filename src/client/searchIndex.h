@@ -0,0 +1,57 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : searchIndex
+ *
+ * Full-text search index over the catalog
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef MDTX_CLIENT_SEARCHINDEX_H
+#define MDTX_CLIENT_SEARCHINDEX_H 1
+
+#include "mediatex-types.h"
+
+#define SEARCH_MAGIC     "MDTXSRCH"
+#define SEARCH_VERSION   1
+#define SEARCH_FILE      "/search.idx" // into htmlIndexDir
+#define MAX_SEARCH_WORD  32 // longer words are truncated
+#define MAX_SEARCH_QUERY 8  // words per query
+#define MAX_SEARCH_HITS  50 // answers per query
+
+typedef struct SearchIndex SearchIndex;
+
+// an answer, pointing into the mapped index
+typedef struct SearchHit {
+  CType type;  // DOC, HUM or CATE
+  int   score;
+  char* label;
+  char* url;   // relative to htmlIndexDir
+} SearchHit;
+
+int saveSearchIndex(Collection* coll);
+SearchIndex* openSearchIndex(Collection* coll);
+SearchIndex* closeSearchIndex(SearchIndex* self);
+int querySearchIndex(SearchIndex* self, char* query,
+		     SearchHit* hits, int max);
+
+#endif /* MDTX_CLIENT_SEARCHINDEX_H */
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
@@ -23,6 +23,7 @@
 
 #include "mediatex-config.h"
 #include "client/mediatex-client.h"
+#include <sys/file.h> // flock
 #include <sys/sem.h>
 
 typedef union semun {
@@ -216,11 +217,18 @@ mdtxUpdate(char* label)
 {
   int rc = FALSE;
   Collection* coll = 0;
+  int lock = -1;
 
   checkLabel(label);
   logMain(LOG_DEBUG, "update collection");
 
   if (!(coll = mdtxGetCollection(label))) goto error;
+  if (!expandCollection(coll)) goto error;
+
+  // the daemon may commit and pull it too (cf server/gitPush.c)
+  if (!env.noRegression && !env.dryRun) {
+    if ((lock = lockGitModule(coll->gitDir, LOCK_EX)) == -1) goto error;
+  }
   if (!callCommit(coll->user, "Manual user edition")) goto error;
   if (!callPull(coll->user)) goto error;
 
@@ -229,6 +237,7 @@ mdtxUpdate(char* label)
   if (!rc) {
     logMain(LOG_ERR, "fails to update collection");
   }
+  unlockGitModule(lock);
   return(rc);
 }
 
@@ -248,12 +257,19 @@ mdtxCommit(char* label)
   int rc = FALSE;
   Configuration* conf = 0;
   Collection* coll = 0;
+  int lock = -1;
 
   checkLabel(label);
   logMain(LOG_DEBUG, "commit collection");
 
   if (!(conf = getConfiguration())) goto error;
   if (!(coll = mdtxGetCollection(label))) goto error;
+  if (!expandCollection(coll)) goto error;
+
+  // the daemon may commit it too (cf server/gitPush.c)
+  if (!env.noRegression && !env.dryRun) {
+    if ((lock = lockGitModule(coll->gitDir, LOCK_EX)) == -1) goto error;
+  }
   if (!callCommit(coll->user, 0)) goto error;
   if (!callPush(coll->user)) goto error;
 
@@ -262,6 +278,7 @@ mdtxCommit(char* label)
   if (!rc) {
     logMain(LOG_ERR, "fails to commit collection");
   }
+  unlockGitModule(lock);
   return(rc);
 }
 
@@ -217,7 +217,7 @@ mdtxAddSupport(char* label, char* path)
   // create and complete support object
   if ((supp = addSupport(label)) == 0) goto error;
   supp->firstSeen = now;
-  if (!doCheckSupport(supp, path)) goto error;
+  if (!doCheckSupport(supp, path, 0)) goto error;
 
   rc = TRUE;
  error:
@@ -272,7 +272,7 @@ mdtxAddFile(char* path)
   // create and complete support object
   if ((supp = addSupport(absolutePath)) == 0) goto error;
   supp->firstSeen = now;
-  if (!doCheckSupport(supp, absolutePath)) goto error;
+  if (!doCheckSupport(supp, absolutePath, 0)) goto error;
 
   rc = TRUE;
  error:
@@ -354,7 +354,6 @@ static int
 notifyHave(Support* supp, char* path) 
 {
   int rc = FALSE;
-  int socket = 0;
   Configuration* conf = 0;
   Collection* coll = 0;
   RecordTree* tree = 0;
@@ -362,8 +361,6 @@ notifyHave(Support* supp, char* path)
   RGIT* curr2 = 0;
   char* name = 0;
   int isShared = FALSE;
-
-  // warning tcpRead seems to read more than 1 and erase the stack
   char reply[576];
 
   logMain(LOG_DEBUG, "notifyHave");
@@ -398,14 +395,13 @@ notifyHave(Support* supp, char* path)
     buildSocketAddressEasy(&coll->localhost->address, 
 			   0x7f000001, coll->localhost->mdtxPort);
     
-    if ((socket = connectServer(coll->localhost)) == -1) goto error;
-    if (!upgradeServer(socket, tree, 0)) goto error;
+    // wait until server replies (the connection is kept for the next
+    // collection)
+    if (!exchangeServer(coll->localhost, tree, 0, reply, sizeof(reply)))
+      goto error;
     
     // do not use 127.0.0.1 anymore
     coll->localhost->address.sin_family = 0;
-    
-    // wait until server shut down the sockect
-    if (!env.dryRun) tcpRead(socket, reply, 1);
 
     if (!diseaseRecordTree(tree)) goto error;
   }
@@ -420,7 +416,6 @@ notifyHave(Support* supp, char* path)
   logMain(LOG_ERR, "fails to launch extraction on the %s support", 
 	  supp?supp->name:"unknown");
   }
-  if (!env.dryRun && socket != -1) close(socket);
   tree = destroyRecordTree(tree);
   return rc;
 }
@@ -453,7 +448,7 @@ mdtxHaveSupport(char* label, char* path)
   if (supp == 0) goto error;
 
   if (isEmptyString(path)) goto error;
-  if (!doCheckSupport(supp, path)) goto error;
+  if (!doCheckSupport(supp, path, 0)) goto error;
   
   // maybe we should updgrade daemon's md5sumsDB 
   // before to launch extraction ?
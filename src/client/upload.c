@@ -25,6 +25,20 @@
 #include "mediatex-config.h"
 #include "client/mediatex-client.h"
 
+typedef struct UploadHash {
+  char* path;       // file to upload
+  CheckData md5;    // its size and full md5sum
+  int rc;           // TRUE if hashed
+} UploadHash;
+
+typedef struct UploadHasher {
+  pthread_mutex_t mutex;
+  UploadHash* hashes;
+  int nbHashes;
+  int next;         // next file to hash
+  int isFailed;     // stop hashing after the first error
+} UploadHasher;
+
 /*=======================================================================
  * Function   : createUploadFile 
  * Description: Create, by memory allocation an image file (ISO file)
@@ -136,21 +150,186 @@ uploadExtract(Collection* upload, char* path)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : hashFile
+ * Description: compute the size and md5sum of a file to upload
+ * Synopsis   : static int hashFile(UploadHash* hash)
+ * Input      : UploadHash* hash: having the path
+ * Output     : UploadHash* hash: having the size and the md5sum
+ *              TRUE on success
+ =======================================================================*/
+static int 
+hashFile(UploadHash* hash)
+{ 
+  int rc = FALSE;
+  struct stat statBuffer;
+
+  logMain(LOG_DEBUG, "hashFile");
+  checkLabel(hash->path);
+
+  // get file attributes (size)
+  if (stat(hash->path, &statBuffer)) {
+    logMain(LOG_ERR, "status error on %s: %s", 
+	    hash->path, strerror(errno));
+    goto error;
+  }
+
+  // compute hash
+  memset(&hash->md5, 0, sizeof(CheckData));
+  hash->md5.path = hash->path;
+  hash->md5.size = statBuffer.st_size;
+  hash->md5.opp = CHECK_CACHE_ID;
+  hash->md5.noProgBar = TRUE; // hashed by several threads
+  if (!doChecksum(&hash->md5)) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "hashFile fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : hashFiles
+ * Description: Thread that hash the files to upload
+ * Synopsis   : static void* hashFiles(void* arg)
+ * Input      : void* arg: the UploadHasher shared by the threads
+ * Output     : N/A
+ * Note       : files are taken in order, so as the first error stop
+ *              the remaining ones like the serial upload does
+ =======================================================================*/
+static void*
+hashFiles(void* arg)
+{
+  UploadHasher* hasher = (UploadHasher*)arg;
+  UploadHash* hash = 0;
+  int err = 0;
+
+  while (1) {
+    if ((err = pthread_mutex_lock(&hasher->mutex))) {
+      logMain(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+      break;
+    }
+    hash = 0;
+    if (!hasher->isFailed && hasher->next < hasher->nbHashes) {
+      hash = hasher->hashes + hasher->next++;
+    }
+    if ((err = pthread_mutex_unlock(&hasher->mutex))) {
+      logMain(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+      break;
+    }
+    if (!hash) break;
+
+    if (!(hash->rc = hashFile(hash))) {
+      pthread_mutex_lock(&hasher->mutex);
+      hasher->isFailed = TRUE;
+      pthread_mutex_unlock(&hasher->mutex);
+    }
+  }
+
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : hashUploads
+ * Description: Hash the files to upload concurrently
+ * Synopsis   : static UploadHash* hashUploads(RG* upFiles)
+ * Input      : RG* upFiles: ring of UploadFile*
+ * Output     : array of UploadHash, in the ring order, 0 on error
+ * Note       : caller have to free the returned array and to check
+ *              each rc, as files are hashed by a pool of threads
+ =======================================================================*/
+static UploadHash*
+hashUploads(RG* upFiles)
+{
+  UploadHash* rc = 0;
+  UploadHasher hasher;
+  UploadFile* upFile = 0;
+  RGIT* curr = 0;
+  pthread_t threads[MAX_HASH_THREAD];
+  int nbThreads = 0;
+  long nbCpus = 0;
+  int isMutex = FALSE;
+  int err = 0;
+  int i = 0;
+
+  logMain(LOG_DEBUG, "hashUploads");
+  memset(&hasher, 0, sizeof(UploadHasher));
+
+  hasher.nbHashes = upFiles->nbItems;
+  if (!(hasher.hashes = malloc(hasher.nbHashes * sizeof(UploadHash)))) {
+    logMain(LOG_ERR, "cannot malloc hashes array");
+    goto error;
+  }
+  memset(hasher.hashes, 0, hasher.nbHashes * sizeof(UploadHash));
+  while ((upFile = rgNext_r(upFiles, &curr))) {
+    hasher.hashes[i++].path = upFile->source;
+  }
+
+  // not worth it: hash the file directly
+  if (hasher.nbHashes < 2) {
+    hasher.hashes[0].rc = hashFile(hasher.hashes);
+    goto end;
+  }
+
+  if ((err = pthread_mutex_init(&hasher.mutex, 0))) {
+    logMain(LOG_ERR, "pthread_mutex_init fails: %s", strerror(err));
+    goto error;
+  }
+  isMutex = TRUE;
+
+  // hash
+  if ((nbCpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1) nbCpus = 1;
+  if (nbCpus > MAX_HASH_THREAD) nbCpus = MAX_HASH_THREAD;
+  if (nbCpus > hasher.nbHashes) nbCpus = hasher.nbHashes;
+  logMain(LOG_INFO, "hash %i files using %li threads",
+	  hasher.nbHashes, nbCpus);
+  for (nbThreads = 0; nbThreads < nbCpus; ++nbThreads) {
+    if ((err = pthread_create(threads + nbThreads, 0,
+			      hashFiles, &hasher))) {
+      logMain(LOG_ERR, "pthread_create fails: %s", strerror(err));
+      break;
+    }
+  }
+  if (nbThreads == 0) {
+    // no thread available: hash from here
+    hashFiles(&hasher);
+  }
+  for (i = 0; i < nbThreads; ++i) {
+    if ((err = pthread_join(threads[i], 0))) {
+      logMain(LOG_ERR, "pthread_join fails: %s", strerror(err));
+      goto error;
+    }
+  }
+
+ end:
+  rc = hasher.hashes;
+  hasher.hashes = 0;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "hashUploads fails");
+  }
+  if (isMutex) pthread_mutex_destroy(&hasher.mutex);
+  if (hasher.hashes) free(hasher.hashes);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : uploadContent
  * Description: add uploaded content file to extract metadata
  * Synopsis   : static Archive* uploadContent(
- *                               Collection* upload, UploadFile* upFile)
+ *                               Collection* upload, UploadFile* upFile,
+ *                               UploadHash* hash)
  * Input      : Collection* upload: collection used to parse upload
- *              char* path: input file to upload
+ *              UploadFile* upFile: input file to upload
+ *              UploadHash* hash: its size and md5sum (cf hashUploads)
  * Output     : Archive object on success ; NULL on error
  =======================================================================*/
 static Archive* 
-uploadContent(Collection* upload, UploadFile* upFile)
+uploadContent(Collection* upload, UploadFile* upFile, UploadHash* hash)
 { 
   Archive* rc = 0;
-  struct stat statBuffer;
-  CheckData md5; 
   Archive* archive = 0;
   time_t time = 0;
   struct tm date;
@@ -168,22 +347,11 @@ uploadContent(Collection* upload, UploadFile* upFile)
   if (!upload->extractTree) {
     if (!(upload->extractTree = createExtractTree())) goto error;
   }
-  
-  // get file attributes (size)
-  if (stat(path, &statBuffer)) {
-    logMain(LOG_ERR, "status error on %s: %s", path, strerror(errno));
-    goto error;
-  }
-
-  // compute hash
-  memset(&md5, 0, sizeof(CheckData));
-  md5.path = path;
-  md5.size = statBuffer.st_size;
-  md5.opp = CHECK_CACHE_ID;
-  if (!doChecksum(&md5)) goto error;
 
   // archive to upload
-  if (!(archive = addArchive(upload, md5.fullMd5sum, statBuffer.st_size)))
+  if (!hash->rc) goto error;
+  if (!(archive = addArchive(upload, hash->md5.fullMd5sum, 
+			     hash->md5.size)))
     goto error;
 
   // add incoming extraction rule
@@ -316,6 +484,70 @@ areNotAlreadyThere(Collection *coll, Collection* upload)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : streamContent
+ * Description: Send the content of a file to upload to the daemon
+ * Synopsis   : static int streamContent(int socket, Record* record, 
+ *                                       off_t offset)
+ * Input      : int socket: connection to the daemon
+ *              Record* record: file to upload ("/source[:target]")
+ *              off_t offset: content the daemon already have
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+streamContent(int socket, Record* record, off_t offset)
+{
+  int rc = FALSE;
+  char buffer[UPLOAD_CHUNK_SIZE];
+  char* source = 0;
+  char* ptr = 0;
+  off_t remaining = 0;
+  size_t len = 0;
+  int fd = -1;
+
+  checkRecord(record);
+  logMain(LOG_DEBUG, "streamContent");
+  if (!(source = createString(record->extra))) goto error;
+  for (ptr = source; *ptr && *ptr != ':'; ++ptr);
+  *ptr = 0;
+
+  if ((fd = open(source, O_RDONLY)) == -1) {
+    logMain(LOG_ERR, "open %s fails: %s", source, strerror(errno));
+    goto error;
+  }
+  if (offset && lseek(fd, offset, SEEK_SET) == -1) {
+    logMain(LOG_ERR, "lseek fails: %s", strerror(errno));
+    goto error;
+  }
+  if (offset) {
+    logMain(LOG_INFO, "resume upload of %s from %lli", 
+	    source, (long long int)offset);
+  }
+
+  remaining = record->archive->size - offset;
+  while (remaining > 0) {
+    len = (remaining < (off_t)sizeof(buffer))?remaining:sizeof(buffer);
+    if ((len = fdRead(fd, buffer, len)) == 0) {
+      logMain(LOG_ERR, "%s is shorter than expected", source);
+      goto error;
+    }
+    if (!sendChunk(socket, buffer, len)) goto error;
+    remaining -= len;
+  }
+
+  // end of content
+  if (!sendChunk(socket, buffer, 0)) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "streamContent fails");
+  }
+  if (fd != -1) close(fd);
+  destroyString(source);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : uploadFile 
  * Description: Ask daemon to upload the file
@@ -329,7 +561,6 @@ static int
 uploadFile(Collection* coll, RG* upFiles)
 {
   int rc = FALSE;
-  int socket = -1;
   RecordTree* tree = 0;
   Record* record = 0;
   UploadFile* upFile = 0;
@@ -341,7 +572,6 @@ uploadFile(Collection* coll, RG* upFiles)
   char* message = 0;
   char reply[576];
   int status = 0;
-  int n = 0;
 
   logMain(LOG_DEBUG, "uploadFile");
   checkCollection(coll);
@@ -350,13 +580,13 @@ uploadFile(Collection* coll, RG* upFiles)
     goto error;
   }
 
-  // build the UPLOAD message
+  // build the STREAM message
   if (!getLocalHost(coll)) goto error;
   if (!(tree = createRecordTree())) goto error; 
   tree->collection = coll;
-  tree->messageType = UPLOAD; 
+  tree->messageType = STREAM; 
 
-  // add files to the UPLOAD message
+  // add files to the STREAM message
   rgRewind(upFiles);
   while ((upFile = rgNext(upFiles))) {
     source = upFile->source;
@@ -384,20 +614,29 @@ uploadFile(Collection* coll, RG* upFiles)
     record = 0;
   }
   
-  // ask daemon to upload the file into the cache
-  if ((socket = connectServer(coll->localhost)) == -1) goto error;
-  if (!upgradeServer(socket, tree, 0)) goto error;
+  // send the files to the daemon, that upload them into the cache
+  if (!streamServer(coll->localhost, tree, streamContent, reply, 576))
+    goto error;
     
   // read reply
   if (env.dryRun) goto end;
-  if ((n = tcpRead(socket, reply, 255)) > 0) {
-    reply[n-1] = (char)0; // remove ending \n
-  }
   if (sscanf(reply, "%i", &status) < 1) {
     logMain(LOG_ERR, "error parsing daemon reply: %s", reply);
     goto error;
   }
   message = strstr(reply, " ");
+
+  // previous daemons copy the files from their paths
+  if (status == 301 || status == 305) {
+    logMain(LOG_NOTICE, "daemon do not manage streamed uploads");
+    tree->messageType = UPLOAD; 
+    if (!exchangeServer(coll->localhost, tree, 0, reply, 576)) goto error;
+    if (sscanf(reply, "%i", &status) < 1) {
+      logMain(LOG_ERR, "error parsing daemon reply: %s", reply);
+      goto error;
+    }
+    message = strstr(reply, " ");
+  }
     
   if (status != 210) {
     logMain(LOG_ERR, "daemon says (%i)%s", status, message);
@@ -414,7 +653,6 @@ uploadFile(Collection* coll, RG* upFiles)
   extra = destroyString(extra);
   if (record) delRecord(coll, record);
   tree = destroyRecordTree(tree);
-  if (!env.dryRun && socket != -1) close(socket);
   return rc;
 }
 
@@ -496,7 +734,9 @@ mdtxUpload(char* label, char* catalog, char* extract, RG* upFiles)
   Collection *coll = 0;
   Collection *upload = 0;
   UploadFile* upFile = 0;
+  UploadHash* hashes = 0;
   int isAllowed = 0;
+  int i = 0;
   
   logMain(LOG_DEBUG, "mdtxUpload");
   checkLabel(label);
@@ -518,8 +758,9 @@ mdtxUpload(char* label, char* catalog, char* extract, RG* upFiles)
   // uploaded contents to the new collection
   if (extract && !uploadExtract(upload, extract)) goto error;
   if (!isEmptyRing(upFiles)) {
+    if (!(hashes = hashUploads(upFiles))) goto error;
     while ((upFile = rgNext(upFiles))) {
-      if (!(upFile->archive = uploadContent(upload, upFile)))
+      if (!(upFile->archive = uploadContent(upload, upFile, hashes + i++)))
 	goto error;
     }
   }
@@ -569,6 +810,7 @@ mdtxUpload(char* label, char* catalog, char* extract, RG* upFiles)
   if (!rc) {
     logMain(LOG_ERR, "mdtxUpload fails");
   }
+  if (hashes) free(hashes);
   delCollection(upload);
   return rc;
 }
@@ -22,6 +22,31 @@
 =======================================================================*/
 
 #include "mediatex-config.h"
+#include <poll.h>
+
+typedef struct PeerConnection {
+  char fingerPrint[MAX_SIZE_MD5+1];
+  struct sockaddr_in address;
+  int sock;        // kept alive connection, -1 if none
+  time_t lastUsed;
+  int isUsed;      // entry is allocated
+  int isBusy;      // an exchange is running on it
+  int isLegacy;    // server do not understand frames
+} PeerConnection;
+
+typedef struct PeerHealth {
+  struct sockaddr_in address;
+  int rtt;         // smoothed connection time (ms), 0 if unknown
+  int nbFailures;  // consecutive failures
+  time_t downUntil;// fail fast until this date
+  time_t lastSeen;
+} PeerHealth;
+
+static struct {
+  pthread_mutex_t mutex;
+  PeerConnection peers[MAX_PEER_CONNECTION];
+  PeerHealth healths[MAX_PEER_CONNECTION];
+} pool = {PTHREAD_MUTEX_INITIALIZER};
 
 /*=======================================================================
  * Function   : buildServerAddress
@@ -64,20 +89,105 @@ buildServerAddress(Server* server)
 }
 
 /*=======================================================================
- * Function   : sigalarmManager
- * Description: Used to interrupt call to connectTcpSocket
- *              in order to stop connexion when server is not responding
- * Synopsis   : static void sigalarmManager(int unused)
- * Input      : int unused: not used
+ * Function   : getPeerHealth
+ * Description: Get the health entry of a server address
+ * Synopsis   : static PeerHealth* getPeerHealth(
+ *                                   struct sockaddr_in* address)
+ * Input      : struct sockaddr_in* address: server address
+ * Output     : the entry (the least recently seen one is recycled)
+ * Note       : pool.mutex must be locked
+ =======================================================================*/
+static PeerHealth*
+getPeerHealth(struct sockaddr_in* address)
+{
+  PeerHealth* rc = 0;
+  PeerHealth* health = 0;
+  int i = 0;
+
+  for (i = 0; i < MAX_PEER_CONNECTION; ++i) {
+    health = pool.healths + i;
+    if (health->address.sin_addr.s_addr == address->sin_addr.s_addr &&
+	health->address.sin_port == address->sin_port) {
+      rc = health;
+      goto end;
+    }
+    if (!rc || health->lastSeen < rc->lastSeen) rc = health;
+  }
+
+  memset(rc, 0, sizeof(PeerHealth));
+  rc->address = *address;
+ end:
+  rc->lastSeen = currentTime();
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : getConnectTimeout
+ * Description: Compute the timeout to use for a server
+ * Synopsis   : static int getConnectTimeout(struct sockaddr_in* address,
+ *                                           time_t* retry)
+ * Input      : struct sockaddr_in* address: server address
+ * Output     : time_t* retry: seconds before trying again if the 
+ *                             server is known to be down, else 0
+ *              the timeout in milli-seconds
+ * Note       : 4 times the observed connection time, bounded by
+ *              CONNECT_MIN_TIMEOUT and CONNECT_MAX_TIMEOUT
+ =======================================================================*/
+static int
+getConnectTimeout(struct sockaddr_in* address, time_t* retry)
+{
+  int rc = CONNECT_TIMEOUT;
+  PeerHealth* health = 0;
+  time_t now = 0;
+
+  now = currentTime();
+  pthread_mutex_lock(&pool.mutex);
+  health = getPeerHealth(address);
+  *retry = (health->downUntil > now)?health->downUntil - now:0;
+  if (health->rtt) {
+    rc = 4 * health->rtt;
+    if (rc < CONNECT_MIN_TIMEOUT) rc = CONNECT_MIN_TIMEOUT;
+    if (rc > CONNECT_MAX_TIMEOUT) rc = CONNECT_MAX_TIMEOUT;
+  }
+  pthread_mutex_unlock(&pool.mutex);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : setConnectResult
+ * Description: Record the result of a connection to a server
+ * Synopsis   : static void setConnectResult(struct sockaddr_in* address,
+ *                                           int isUp, int elapsed)
+ * Input      : struct sockaddr_in* address: server address
+ *              int isUp: TRUE if connected
+ *              int elapsed: milli-seconds spent to connect
  * Output     : N/A
+ * Note       : a server that fails is skipped for a backoff period
+ *              doubled on each consecutive failure
  =======================================================================*/
-static void 
-sigalarmManager(int unused)
+static void
+setConnectResult(struct sockaddr_in* address, int isUp, int elapsed)
 {
-  (void) unused;
-  // nothing to do
-   logCommon(LOG_INFO, "sigalarmManager get %i", unused);
-   return;
+  PeerHealth* health = 0;
+  time_t backoff = CONNECT_BACKOFF_MIN;
+  int i = 0;
+
+  pthread_mutex_lock(&pool.mutex);
+  health = getPeerHealth(address);
+  if (isUp) {
+    if (elapsed < 1) elapsed = 1;
+    health->rtt = health->rtt?(7 * health->rtt + elapsed) / 8:elapsed;
+    health->nbFailures = 0;
+    health->downUntil = 0;
+  }
+  else {
+    for (i = 0; i < health->nbFailures && backoff < CONNECT_BACKOFF_MAX; 
+	 ++i) backoff *= 2;
+    if (backoff > CONNECT_BACKOFF_MAX) backoff = CONNECT_BACKOFF_MAX;
+    ++health->nbFailures;
+    health->downUntil = currentTime() + backoff;
+  }
+  pthread_mutex_unlock(&pool.mutex);
 }
 
 /*=======================================================================
@@ -86,12 +196,18 @@ sigalarmManager(int unused)
  * Synopsis   : int connectServer(Server* server)
  * Input      : Server* server: server to connect
  * Output     : socket descriptor or -1 on error;
+ * Note       : thread safe: the connection is bounded by poll and
+ *              not by alarm. Servers that fail are skipped without
+ *              trying for a while (cf setConnectResult).
  =======================================================================*/
 int 
 connectServer(Server* server)
 {
   int rc = -1;
   int socket = -1;
+  int timeout = 0;
+  int elapsed = 0;
+  time_t retry = 0;
   int err = 0;
 
   checkServer(server);
@@ -101,21 +217,30 @@ connectServer(Server* server)
   if (server->address.sin_family == 0 && !buildServerAddress(server))
     goto error;
 
+  if (env.dryRun) {
+    socket = -2;
+    goto connected;
+  }
+
+  // fail fast if the server is known to be down
+  timeout = getConnectTimeout(&server->address, &retry);
+  if (retry) {
+    logCommon(LOG_NOTICE, "skip %s:%i (unreachable, retry in %lis)",
+	      server->host, server->mdtxPort, (long int)retry);
+    goto end;
+  }
+
   /* open connection to server */
-  if (!enableAlarm(sigalarmManager)) goto error;
-  alarm(1);
-  socket = env.dryRun?-2:connectTcpSocket(&server->address);
+  socket = connectTcpSocket(&server->address, timeout, &elapsed);
   err = errno;
-  alarm(0);
-  if (!disableAlarm()) goto error;
+  setConnectResult(&server->address, socket != -1, elapsed);
 
   if (socket == -1) { 
     //logCommon(LOG_DEBUG, "errno=%i: %s", err, strerror(err));
     switch (err) {
-    case EINTR:   // interupted by alarm
-    case SIGALRM:
-      logCommon(LOG_WARNING, "too much time to reach %s:%i", 
-	      server->host, server->mdtxPort);
+    case ETIMEDOUT:
+      logCommon(LOG_WARNING, "too much time to reach %s:%i (%ims)", 
+	      server->host, server->mdtxPort, timeout);
       break;
     default:
       logCommon(LOG_NOTICE, "cannot reach %s:%i",
@@ -125,6 +250,7 @@ connectServer(Server* server)
     goto end; // do not display error message */
   }
 
+ connected:
   rc = socket;
   logCommon(LOG_INFO, "connected to %s (%s)", 
 	  server->host, server->fingerPrint);
@@ -184,6 +310,631 @@ upgradeServer(int socket, RecordTree* tree, char* fingerPrint)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : sendFrame
+ * Description: Send records as a frame on a kept alive connection
+ * Synopsis   : static int sendFrame(int socket, 
+ *                                   RecordTree* tree, char* fingerPrint)
+ * Input      : int socket = socket to use
+ *              RecordTree* tree = what we send
+ *              fingerPrint      = original fingerprint when Natted
+ * Output     : TRUE on success
+ * Note       : the records are serialized into a temporary file first
+ *              so as we know the frame length
+ =======================================================================*/
+static int
+sendFrame(int socket, RecordTree* tree, char* fingerPrint)
+{
+  int rc = FALSE;
+  FILE* fd = 0;
+  off_t size = 0;
+  char header[MAX_SIZE_FRAME_HEADER+1];
+  char buffer[4096];
+  size_t len = 0;
+  char* key = 0;
+
+  logCommon(LOG_DEBUG, "sendFrame");
+  checkRecordTree(tree);
+  checkCollection(tree->collection);
+  
+  // log content to send
+  logRecordTree(LOG_COMMON, LOG_INFO, tree, fingerPrint);
+
+  // cypher the frame
+  key = tree->collection->serverTree->aesKey;
+  if (!aesInit(&tree->aes, key, ENCRYPT)) goto error;
+  tree->doCypher = env.noRegression?FALSE:TRUE;
+
+  if (!(fd = tmpfile())) {
+    logCommon(LOG_ERR, "tmpfile fails: %s", strerror(errno));
+    goto error;
+  }
+  tree->aes.fd = fileno(fd);
+  if (!serializeRecordTree(tree, 0, fingerPrint)) goto error;
+  if ((size = lseek(fileno(fd), 0, SEEK_END)) == -1 ||
+      lseek(fileno(fd), 0, SEEK_SET) == -1) {
+    logCommon(LOG_ERR, "lseek fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // send header and content
+  sprintf(header, "%s%010lli\n", FRAME_MAGIC, (long long int)size);
+  if (!tcpWrite(socket, header, MAX_SIZE_FRAME_HEADER)) goto error;
+  while ((len = fdRead(fileno(fd), buffer, sizeof(buffer))) > 0) {
+    if (!tcpWrite(socket, buffer, len)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "sendFrame fails");
+  }
+  if (fd) fclose(fd);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : sendChunk
+ * Description: Send a chunk of a streamed content
+ * Synopsis   : int sendChunk(int socket, char* buffer, size_t len)
+ * Input      : int socket = socket to use
+ *              char* buffer = content to send
+ *              size_t len = content length (0 to end the content)
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+sendChunk(int socket, char* buffer, size_t len)
+{
+  int rc = FALSE;
+  char header[MAX_SIZE_FRAME_HEADER+1];
+
+  sprintf(header, "%s%010lli\n", FRAME_MAGIC, (long long int)len);
+  if (!tcpWrite(socket, header, MAX_SIZE_FRAME_HEADER)) goto error;
+  if (len > 0 && !tcpWrite(socket, buffer, len)) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "sendChunk fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : readReply
+ * Description: Read the status line the server send back
+ * Synopsis   : static int readReply(int socket, char* reply, int size)
+ * Input      : int socket = socket to use
+ *              int size = size of the reply buffer
+ * Output     : char* reply = the status line, without its '\n'
+ *              TRUE on success
+ * Note       : read byte per byte so as to not consume the next reply
+ =======================================================================*/
+static int
+readReply(int socket, char* reply, int size)
+{
+  int rc = FALSE;
+  ssize_t n = 0;
+  int i = 0;
+
+  reply[0] = 0;
+  while (i < size-1) {
+    if ((n = recv(socket, reply+i, 1, 0)) == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	logCommon(LOG_WARNING, "no reply within %is", REPLY_TIMEOUT);
+	goto error;
+      }
+      logCommon(LOG_INFO, "reading reply fails: %s", strerror(errno));
+      goto error;
+    }
+    if (n == 0) goto error; // closed by server
+    if (reply[i] == '\n') break;
+    ++i;
+  }
+  reply[i] = 0;
+
+  rc = (i > 0);
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : closePeer
+ * Description: Close the kept alive connection of a pool entry
+ * Synopsis   : static void closePeer(PeerConnection* peer)
+ * Input      : PeerConnection* peer: entry of the pool
+ * Output     : N/A
+ =======================================================================*/
+static void
+closePeer(PeerConnection* peer)
+{
+  if (peer->sock != -1) {
+    logCommon(LOG_DEBUG, "close connection to %s", peer->fingerPrint);
+    close(peer->sock);
+  }
+  peer->sock = -1;
+}
+
+/*=======================================================================
+ * Function   : isPeerAlive
+ * Description: Tell if the server has closed a kept alive connection
+ * Synopsis   : static int isPeerAlive(int socket)
+ * Input      : int socket = kept alive connection
+ * Output     : FALSE if there is something to read (end of file or
+ *              unexpected data), so as the connection is not usable
+ =======================================================================*/
+static int
+isPeerAlive(int socket)
+{
+  struct pollfd fds;
+  int n = 0;
+
+  fds.fd = socket;
+  fds.events = POLLIN;
+  fds.revents = 0;
+  while ((n = poll(&fds, 1, 0)) == -1 && errno == EINTR);
+  return (n == 0);
+}
+
+/*=======================================================================
+ * Function   : takePeer
+ * Description: Get the pool entry for a server
+ * Synopsis   : static PeerConnection* takePeer(Server* server)
+ * Input      : Server* server: server to connect
+ * Output     : the entry (for us alone until givePeer), 
+ *              0 if the pool is full
+ =======================================================================*/
+static PeerConnection*
+takePeer(Server* server)
+{
+  PeerConnection* rc = 0;
+  PeerConnection* peer = 0;
+  PeerConnection* empty = 0;
+  time_t now = 0;
+  int i = 0;
+
+  now = currentTime();
+  pthread_mutex_lock(&pool.mutex);
+  for (i = 0; i < MAX_PEER_CONNECTION; ++i) {
+    peer = pool.peers + i;
+    if (!peer->isUsed) {
+      if (!empty) empty = peer;
+      continue;
+    }
+    if (peer->isBusy) continue;
+    if (peer->sock != -1 && now - peer->lastUsed >= PEER_CONNECTION_TTL)
+      closePeer(peer);
+    if (strncmp(peer->fingerPrint, server->fingerPrint, MAX_SIZE_MD5) ||
+	peer->address.sin_addr.s_addr != server->address.sin_addr.s_addr ||
+	peer->address.sin_port != server->address.sin_port) {
+      if (!empty && peer->sock == -1 && !peer->isLegacy) empty = peer;
+      continue;
+    }
+    rc = peer;
+    break;
+  }
+
+  // new entry
+  if (!rc && empty) {
+    rc = empty;
+    memset(rc, 0, sizeof(PeerConnection));
+    strncpy(rc->fingerPrint, server->fingerPrint, MAX_SIZE_MD5);
+    rc->address = server->address;
+    rc->sock = -1;
+    rc->isUsed = TRUE;
+  }
+
+  if (rc) rc->isBusy = TRUE;
+  pthread_mutex_unlock(&pool.mutex);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : givePeer
+ * Description: Give back the pool entry
+ * Synopsis   : static void givePeer(PeerConnection* peer)
+ * Input      : PeerConnection* peer: entry got from takePeer
+ * Output     : N/A
+ =======================================================================*/
+static void
+givePeer(PeerConnection* peer)
+{
+  pthread_mutex_lock(&pool.mutex);
+  peer->lastUsed = currentTime();
+  peer->isBusy = FALSE;
+  pthread_mutex_unlock(&pool.mutex);
+}
+
+/*=======================================================================
+ * Function   : exchangeOneShot
+ * Description: Send records and read the reply on a new connection
+ * Synopsis   : static int exchangeOneShot(Server* server, 
+ *                                 RecordTree* tree, char* fingerPrint,
+ *                                 char* reply, int size)
+ * Input      : Server* server: server to reach
+ *              RecordTree* tree = what we send
+ *              fingerPrint      = original fingerprint when Natted
+ *              int size = size of the reply buffer
+ * Output     : char* reply = the status line, without its '\n'
+ *              TRUE on success
+ * Note       : this is the protocol used by the previous versions
+ =======================================================================*/
+static int
+exchangeOneShot(Server* server, RecordTree* tree, char* fingerPrint,
+		char* reply, int size)
+{
+  int rc = FALSE;
+  int socket = -1;
+  int n = 0;
+
+  reply[0] = 0;
+  if ((socket = connectServer(server)) == -1) goto error;
+  if (!upgradeServer(socket, tree, fingerPrint)) goto error;
+
+  if (env.dryRun) goto end;
+  n = tcpRead(socket, reply, size-1);
+  // erase the \n send by server
+  if (n<=0) n = 1;
+  reply[n-1] = (char)0; 
+ end:
+  rc = TRUE;
+ error:
+  if (!env.dryRun && socket != -1) close(socket);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : exchangeServer
+ * Description: Send records to a server and read its reply
+ * Synopsis   : int exchangeServer(Server* server, 
+ *                                 RecordTree* tree, char* fingerPrint,
+ *                                 char* reply, int size)
+ * Input      : Server* server: server to reach
+ *              RecordTree* tree = what we send
+ *              fingerPrint      = original fingerprint when Natted
+ *              int size = size of the reply buffer
+ * Output     : char* reply = the status line, without its '\n'
+ *              TRUE on success
+ * Note       : connections are kept alive (PEER_CONNECTION_TTL) so as
+ *              the next exchanges with this server do not pay for the
+ *              TCP handshake. Servers that do not understand frames
+ *              are reached using one connection per exchange.
+ *              A frame is only sent again if it was not sent: once
+ *              sent, the server may have processed it (UPLOAD and
+ *              STREAM are not idempotent), so a lost reply is an error.
+ =======================================================================*/
+int 
+exchangeServer(Server* server, RecordTree* tree, char* fingerPrint,
+	       char* reply, int size)
+{
+  int rc = FALSE;
+  PeerConnection* peer = 0;
+  int isNew = FALSE;
+
+  checkServer(server);
+  logCommon(LOG_DEBUG, "exchangeServer %s", server->fingerPrint);
+  reply[0] = 0;
+
+  if (env.dryRun) {
+    if (!exchangeOneShot(server, tree, fingerPrint, reply, size)) 
+      goto error;
+    goto end;
+  }
+
+  // build server address if not already done (pool key)
+  if (server->address.sin_family == 0 && !buildServerAddress(server))
+    goto error;
+
+  if (!(peer = takePeer(server)) || peer->isLegacy) {
+    if (!exchangeOneShot(server, tree, fingerPrint, reply, size)) 
+      goto error;
+    goto end;
+  }
+
+  // re-use the kept alive connection, unless the server has closed it
+  if (peer->sock != -1 && !isPeerAlive(peer->sock)) closePeer(peer);
+  if (peer->sock != -1) {
+    logCommon(LOG_DEBUG, "re-use connection to %s", server->fingerPrint);
+    if (sendFrame(peer->sock, tree, fingerPrint)) {
+      if (readReply(peer->sock, reply, size)) goto end;
+      logCommon(LOG_WARNING, "reply from %s lost", server->host);
+      closePeer(peer);
+      goto error;
+    }
+    closePeer(peer);
+  }
+
+  // open a new one
+  if ((peer->sock = connectServer(server)) == -1) goto error;
+  isNew = TRUE;
+  if (!setRecvDeadline(peer->sock, REPLY_TIMEOUT)) goto error;
+  if (sendFrame(peer->sock, tree, fingerPrint) &&
+      readReply(peer->sock, reply, size) &&
+      strncmp(reply, FRAME_PARSER_ERROR, strlen(FRAME_PARSER_ERROR)))
+    goto end;
+
+  // old server: parser fails on the frame header
+  logCommon(LOG_NOTICE, "%s do not keep connections alive", server->host);
+  closePeer(peer);
+  peer->isLegacy = TRUE;
+  if (!exchangeOneShot(server, tree, fingerPrint, reply, size)) 
+    goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "exchangeServer fails");
+    if (peer && isNew) closePeer(peer);
+  }
+  if (peer) givePeer(peer);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : streamServer
+ * Description: Send records to a server and stream their contents
+ * Synopsis   : int streamServer(Server* server, RecordTree* tree, 
+ *                            StreamSender sendContent,
+ *                            char* reply, int size)
+ * Input      : Server* server: server to reach
+ *              RecordTree* tree = what we send
+ *              StreamSender sendContent = callback sending the
+ *                content of a record from the given offset
+ *              int size = size of the reply buffer
+ * Output     : char* reply = the final status line, without its '\n'
+ *              TRUE on success
+ * Note       : the server asks for the records' contents, in the
+ *              tree order, replying STREAM_CONTINUE and the offset
+ *              it already have. A dedicated connection is used so as
+ *              a long transfer do not hold an entry of the pool.
+ =======================================================================*/
+int 
+streamServer(Server* server, RecordTree* tree, StreamSender sendContent,
+	     char* reply, int size)
+{
+  int rc = FALSE;
+  int socket = -1;
+  AVLNode* node = 0;
+  long long int offset = 0;
+  int l = strlen(STREAM_CONTINUE);
+
+  checkServer(server);
+  logCommon(LOG_DEBUG, "streamServer %s", server->fingerPrint);
+  reply[0] = 0;
+
+  if (env.dryRun) {
+    if (!exchangeOneShot(server, tree, 0, reply, size)) goto error;
+    goto end;
+  }
+
+  if ((socket = connectServer(server)) == -1) goto error;
+  if (!sendFrame(socket, tree, 0)) goto error;
+
+  node = tree->records->head;
+  while (readReply(socket, reply, size)) {
+    if (strncmp(reply, STREAM_CONTINUE, l)) goto end; // final status
+    if (!node) {
+      logCommon(LOG_ERR, "server asks for more contents than sent");
+      goto error;
+    }
+    if (sscanf(reply + l, "%lli", &offset) != 1 || offset < 0) {
+      logCommon(LOG_ERR, "bad stream reply: %s", reply);
+      goto error;
+    }
+    if (!sendContent(socket, node->item, (off_t)offset)) goto error;
+    node = node->next;
+  }
+  logCommon(LOG_ERR, "connection closed by %s", server->host);
+  goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "streamServer fails");
+  }
+  if (socket != -1) close(socket);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : expireServerConnections
+ * Description: Close the kept alive connections no more used
+ * Synopsis   : void expireServerConnections(int all)
+ * Input      : int all: close even the recently used ones
+ * Output     : N/A
+ =======================================================================*/
+void 
+expireServerConnections(int all)
+{
+  PeerConnection* peer = 0;
+  time_t now = 0;
+  int i = 0;
+
+  now = currentTime();
+  pthread_mutex_lock(&pool.mutex);
+  for (i = 0; i < MAX_PEER_CONNECTION; ++i) {
+    peer = pool.peers + i;
+    if (!peer->isUsed || peer->isBusy || peer->sock == -1) continue;
+    if (all || now - peer->lastUsed >= PEER_CONNECTION_TTL) 
+      closePeer(peer);
+  }
+  pthread_mutex_unlock(&pool.mutex);
+}
+
+/*=======================================================================
+ * Function   : isFrame
+ * Description: Tell if a kept alive connection is used by the client
+ * Synopsis   : int isFrame(int socket)
+ * Input      : int socket = accepted socket
+ * Output     : TRUE if the next bytes are a frame header
+ * Note       : nothing is consumed, so as the one-shot message from
+ *              a previous version may still be parsed
+ =======================================================================*/
+int
+isFrame(int socket)
+{
+  int rc = FALSE;
+  char magic[sizeof(FRAME_MAGIC)];
+  ssize_t n = 0;
+  int l = strlen(FRAME_MAGIC);
+
+  while ((n = recv(socket, magic, l, MSG_PEEK | MSG_WAITALL)) == -1) {
+    if (errno != EINTR) goto error; // ie: not a socket
+  }
+  rc = (n == l && !strncmp(magic, FRAME_MAGIC, l));
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : waitFrame
+ * Description: Wait for the next frame on a kept alive connection
+ * Synopsis   : int waitFrame(int socket, int timeout)
+ * Input      : int socket = accepted socket
+ *              int timeout = seconds to wait
+ * Output     : 1 if a frame is coming, 0 on timeout, 
+ *              -1 if the connection is closed (or on error)
+ =======================================================================*/
+int
+waitFrame(int socket, int timeout)
+{
+  int rc = -1;
+  struct pollfd fds;
+  int n = 0;
+
+  fds.fd = socket;
+  fds.events = POLLIN;
+  fds.revents = 0;
+  if ((n = poll(&fds, 1, timeout * 1000)) == -1) {
+    if (errno == EINTR) rc = 0;
+    goto end;
+  }
+  if (n == 0) {
+    rc = 0;
+    goto end;
+  }
+  if (isFrame(socket)) rc = 1;
+ end:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : readFrame
+ * Description: Read a frame into a temporary file
+ * Synopsis   : int readFrame(int socket)
+ * Input      : int socket = accepted socket
+ * Output     : file descriptor having the records, -1 on error
+ * Note       : caller have to close the returned file descriptor
+ =======================================================================*/
+int
+readFrame(int socket)
+{
+  int rc = -1;
+  FILE* fd = 0;
+  char header[MAX_SIZE_FRAME_HEADER+1];
+  char buffer[4096];
+  long long int size = 0;
+  size_t len = 0;
+
+  logCommon(LOG_DEBUG, "readFrame");
+  if (fdRead(socket, header, MAX_SIZE_FRAME_HEADER) 
+      != MAX_SIZE_FRAME_HEADER) goto error;
+  header[MAX_SIZE_FRAME_HEADER] = 0;
+  if (sscanf(header + strlen(FRAME_MAGIC), "%lli", &size) != 1 ||
+      size < 0) {
+    logCommon(LOG_ERR, "bad frame header");
+    goto error;
+  }
+
+  if (!(fd = tmpfile())) {
+    logCommon(LOG_ERR, "tmpfile fails: %s", strerror(errno));
+    goto error;
+  }
+  while (size > 0) {
+    len = (size < (long long int)sizeof(buffer))?size:sizeof(buffer);
+    if (fdRead(socket, buffer, len) != len) {
+      logCommon(LOG_ERR, "frame is truncated");
+      goto error;
+    }
+    if (!fdWrite(fileno(fd), buffer, len)) goto error;
+    size -= len;
+  }
+  if (lseek(fileno(fd), 0, SEEK_SET) == -1) {
+    logCommon(LOG_ERR, "lseek fails: %s", strerror(errno));
+    goto error;
+  }
+
+  if ((rc = dup(fileno(fd))) == -1) {
+    logCommon(LOG_ERR, "dup fails: %s", strerror(errno));
+    goto error;
+  }
+ error:
+  if (rc == -1) {
+    logCommon(LOG_ERR, "readFrame fails");
+  }
+  if (fd) fclose(fd);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : readChunk
+ * Description: Read the header of the next chunk of a streamed content
+ * Synopsis   : off_t readChunk(int socket)
+ * Input      : int socket = accepted socket
+ * Output     : length of the chunk's content to read next, 
+ *              0 at the end of the content, -1 on error
+ =======================================================================*/
+off_t
+readChunk(int socket)
+{
+  off_t rc = -1;
+  char header[MAX_SIZE_FRAME_HEADER+1];
+  long long int size = 0;
+  int l = strlen(FRAME_MAGIC);
+
+  if (fdRead(socket, header, MAX_SIZE_FRAME_HEADER) 
+      != MAX_SIZE_FRAME_HEADER) goto error;
+  header[MAX_SIZE_FRAME_HEADER] = 0;
+  if (strncmp(header, FRAME_MAGIC, l) ||
+      sscanf(header + l, "%lli", &size) != 1 || size < 0) {
+    logCommon(LOG_ERR, "bad chunk header");
+    goto error;
+  }
+
+  rc = size;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : setRecvDeadline
+ * Description: Bound the time blocking reads wait on a socket
+ * Synopsis   : int setRecvDeadline(int socket, int timeout)
+ * Input      : int socket = accepted socket
+ *              int timeout = seconds, 0 to block again
+ * Output     : TRUE on success
+ * Note       : a read reaching the deadline fails with EAGAIN, so
+ *              fdRead returns a short count
+ =======================================================================*/
+int
+setRecvDeadline(int socket, int timeout)
+{
+  int rc = FALSE;
+  struct timeval tv;
+
+  tv.tv_sec = timeout;
+  tv.tv_usec = 0;
+  if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) {
+    logCommon(LOG_ERR, "setsockopt fails: %s", strerror(errno));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
 /* Local Variables: */
 /* mode: c */
 /* mode: font-lock */
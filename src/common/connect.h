@@ -26,9 +26,35 @@
 #ifndef MDTX_COMMON_CONNECT_H
 #define MDTX_COMMON_CONNECT_H 1
 
+// frame header: "MDTX" followed by the length on 10 digits and '\n'.
+// Previous versions fail to parse it and reply FRAME_PARSER_ERROR.
+#define FRAME_MAGIC "MDTX"
+#define MAX_SIZE_FRAME_HEADER 15
+#define FRAME_PARSER_ERROR "301"
+
+// streamed upload: the daemon asks for each record's content using
+// STREAM_CONTINUE followed by the offset to start from. The content
+// is sent as chunks having the frame header, ended by an empty one.
+#define STREAM_CONTINUE "211"
+
+typedef int (*StreamSender)(int socket, Record* record, off_t offset);
+
 int buildServerAddress(Server* server);
 int connectServer(Server* server);
 int upgradeServer(int socket, RecordTree* tree, char* fingerPrint);
+int exchangeServer(Server* server, RecordTree* tree, char* fingerPrint,
+		   char* reply, int size);
+int streamServer(Server* server, RecordTree* tree, 
+		 StreamSender sendContent, char* reply, int size);
+int sendChunk(int socket, char* buffer, size_t len);
+void expireServerConnections(int all);
+
+// daemon side of the kept alive connections
+int isFrame(int socket);
+int waitFrame(int socket, int timeout);
+int readFrame(int socket);
+off_t readChunk(int socket);
+int setRecvDeadline(int socket, int timeout);
 
 #endif /* MDTX_COMMON_CONNECT_H */
 
@@ -26,6 +26,96 @@
 int computeArchive(Collection* coll, Archive* self, int depth);
 
 
+/*=======================================================================
+ * Function   : isMuteServer
+ * Description: state if a server do not commit since a long time
+ * Synopsis   : static int isMuteServer(Collection* coll, Server* server,
+ *                                      time_t now)
+ * Input      : Collection* coll: to get serverTTL parameter
+ *              Server* server
+ *              time_t now: current date
+ * Output     : TRUE if server's images must be ignored
+ =======================================================================*/
+static int
+isMuteServer(Collection* coll, Server* server, time_t now)
+{
+  return server->lastCommit + coll->serverTree->serverTTL < now;
+}
+
+/*=======================================================================
+ * Function   : computeImageScore
+ * Description: Compute the image score of an archive
+ * Synopsis   : static void computeImageScore(Collection* coll, 
+ *                                          Archive* archive, time_t now)
+ * Input      : Collection* coll
+ *              Archive* archive
+ *              time_t now: current date, to ignore mute servers
+ * Output     : N/A
+ =======================================================================*/
+static void
+computeImageScore(Collection* coll, Archive* archive, time_t now)
+{
+  ServerTree* serverTree = coll->serverTree;
+  Image* image = 0;
+  RGIT* curr = 0;
+  int i = 0;
+
+  // archive->imageScore = sum (image's scores)
+  archive->imageScore = -1;
+  if (isEmptyRing(arImages(archive))) return;
+  archive->imageScore = 0;
+
+  logCommon(LOG_INFO, "local image score for %s:%lli",
+	    archive->hash, archive->size);
+
+  while ((image = rgNext_r(arImages(archive), &curr))) {
+
+    // ignore image from a mute server
+    if (isMuteServer(coll, image->server, now)) continue;
+	
+    archive->imageScore += image->score;
+    logCommon(LOG_INFO, "%c %5.2f", (i > 1)?'+':' ', image->score);
+    ++i;
+  }
+    
+  logCommon(LOG_INFO, "= %5.2f", archive->imageScore);
+
+  // archive->imageScore /= minGeoDup
+  archive->imageScore /= serverTree->minGeoDup;
+  logCommon(LOG_INFO, "/ %i", serverTree->minGeoDup);
+
+  // truncate it if more than maxScore
+  if (archive->imageScore > serverTree->scoreParam.maxScore) {
+    archive->imageScore = serverTree->scoreParam.maxScore;
+    logCommon(LOG_INFO, "> %5.2f", serverTree->scoreParam.maxScore);
+  }
+
+  logCommon(LOG_INFO, "-------", archive->imageScore);
+  logCommon(LOG_INFO, "= %5.2f", archive->imageScore);
+}
+
+/*=======================================================================
+ * Function   : computeServerScore
+ * Description: Compute the server score from its images
+ * Synopsis   : static void computeServerScore(Server* server)
+ * Input      : Server* server
+ * Output     : N/A
+ =======================================================================*/
+static void
+computeServerScore(Server* server)
+{
+  Image* image = 0;
+  RGIT* curr = 0;
+
+  // server->score = min (image's scores)
+  server->score = -1;
+  while ((image = rgNext_r(server->images, &curr))) {
+    if (server->score == -1 || image->score < server->score) {
+      server->score = image->score;
+    }
+  }
+}
+
 /*=======================================================================
  * Function   : populateExtractTree
  * Description: Compute the uniq image's extract score from server.txt
@@ -44,8 +134,6 @@ populateExtractTree(Collection* coll)
   ServerTree* serverTree = 0;
   Server* server = 0;
   Archive* archive = 0;
-  Image* image = 0;
-  int i = 0;
   time_t now = 0;
 
   checkCollection(coll);
@@ -70,60 +158,14 @@ populateExtractTree(Collection* coll)
   // for each server
   rgRewind(serverTree->servers);
   while ((server = rgNext(serverTree->servers))) {
-    
-    // server->score = min (image's scores)
-    server->score = -1;
-    if (server->images) {
-      rgRewind(server->images);
-      while ((image = rgNext(server->images))) {
-	if (server->score == -1 || image->score < server->score) {
-	  server->score = image->score;
-	}
-      }
-    }
+    computeServerScore(server);
+    server->isMute = isMuteServer(coll, server, now);
   }
 
   // for each archive related to images
   rgRewind(serverTree->archives);
   while ((archive = rgNext(serverTree->archives))) {
-
-    // archive->imageScore = sum (image's scores)
-    archive->imageScore = -1;
-    if (archive->images) {
-      archive->imageScore = 0;
-      rgRewind(archive->images);
-
-      logCommon(LOG_INFO, "local image score for %s:%lli",
-	      archive->hash, archive->size);
-
-      i=0;
-      while ((image = rgNext(archive->images))) {
-
-	// ignore image from a mute server
-	if (image->server->lastCommit + serverTree->serverTTL < now) 
-	  continue;
-	
-	archive->imageScore += image->score;
-	logCommon(LOG_INFO, "%c %5.2f", (i > 1)?'+':' ', image->score);
-	++i;
-      }
-    }
-    
-    logCommon(LOG_INFO, "= %5.2f", archive->imageScore);
-
-    // archive->imageScore /= minGeoDup
-    archive->imageScore /= serverTree->minGeoDup;
-    logCommon(LOG_INFO, "/ %i", serverTree->minGeoDup);
-
-    // truncate it if more than maxScore
-    if (archive->imageScore > coll->serverTree->scoreParam.maxScore) {
-      archive->imageScore = coll->serverTree->scoreParam.maxScore;
-      logCommon(LOG_INFO, "> %5.2f", 
-		coll->serverTree->scoreParam.maxScore);
-    }
-
-    logCommon(LOG_INFO, "-------", archive->imageScore);
-    logCommon(LOG_INFO, "= %5.2f", archive->imageScore);
+    computeImageScore(coll, archive, now);
   }    
 
   rc = TRUE;
@@ -134,7 +176,33 @@ populateExtractTree(Collection* coll)
   return rc;
 }
 
-
+/*=======================================================================
+ * Function   : indexScore
+ * Description: Index an archive by its score
+ * Synopsis   : static int indexScore(Collection* coll, Archive* archive)
+ * Input      : Collection* coll
+ *              Archive* archive: having its score computed
+ * Output     : TRUE on success
+ * Note       : new incomings are not indexed as they are ignored
+ *              into the global score computation
+ =======================================================================*/
+static int
+indexScore(Collection* coll, Archive* archive)
+{
+  int rc = FALSE;
+
+  if (archive->incInherency || archive->extractScore == -1) goto end;
+  if (!avl_insert(coll->extractTree->scores, archive)) {
+    logCommon(LOG_ERR, "fails to index %s:%lli score",
+	      archive->hash, (long long int)archive->size);
+    goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : computeContainer
  * Description: Compute container's scores (from its parents files)
@@ -237,15 +305,15 @@ computeArchive(Collection* coll, Archive* self, int depth)
   // score = max (image's scores)
   self->extractScore = (self->imageScore > 0)?self->imageScore:0;
 
-  if (isEmptyRing(self->fromContainers)) {
+  if (isEmptyRing(arFromContainers(self))) {
     self->incInherency = isNewIncoming(coll, self);
-    goto quit;
+    goto index;
   }
 
   // score = max (from container's scores)
   self->incInherency = TRUE;
-  rgRewind(self->fromContainers);
-  while ((asso = rgNext(self->fromContainers))) {
+  rgRewind(arFromContainers(self));
+  while ((asso = rgNext(arFromContainers(self)))) {
     if (asso->container->type == IMG) continue;
     if (!computeContainer(coll, asso->container, depth+1)) goto error;
     self->incInherency &= asso->container->incInherency;
@@ -254,6 +322,8 @@ computeArchive(Collection* coll, Archive* self, int depth)
     }
   }
 
+ index:
+  if (!indexScore(coll, self)) goto error;
  quit:
   logCommon(LOG_INFO, "%*s archive %s:%lli = %.2f", depth, "",
 	  self->hash, self->size, self->extractScore);
@@ -265,12 +335,233 @@ computeArchive(Collection* coll, Archive* self, int depth)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : rescoreArchive
+ * Description: Re-compute an archive score and propagate it to the
+ *              archives it contains
+ * Synopsis   : static int rescoreArchive(Collection* coll, 
+ *                                Archive* self, int doForce, int depth)
+ * Input      : Collection* coll
+ *              Archive* self
+ *              int doForce: propagate even if the score do not change
+ *              int depth: use to indent logs
+ * Output     : TRUE on success
+ =======================================================================*/
+static int rescoreContainer(Collection* coll, Container* self, int depth);
+
+static int 
+rescoreArchive(Collection* coll, Archive* self, int doForce, int depth)
+{
+  int rc = FALSE;
+  float score = 0;
+  int incInherency = FALSE;
+
+  checkArchive(self);
+  logCommon(LOG_DEBUG, "%*srescoreArchive: %s:%lli", 
+	    depth, "", self->hash, self->size);
+  score = self->extractScore;
+  incInherency = self->incInherency;
+
+  // compute it again (using the scores of its containers)
+  avl_delete(coll->extractTree->scores, self);
+  self->extractScore = -1;
+  if (!computeArchive(coll, self, depth)) goto error;
+
+  if (!doForce && self->extractScore == score && 
+      self->incInherency == incInherency) goto end;
+
+  // propagate to the container it provides
+  if (self->toContainer) {
+    if (!rescoreContainer(coll, self->toContainer, depth+1)) goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to rescoreArchive");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : rescoreContainer
+ * Description: Re-compute a container score and propagate it to its
+ *              contents
+ * Synopsis   : static int rescoreContainer(Collection* coll, 
+ *                                        Container* self, int depth)
+ * Input      : Collection* coll
+ *              Container* self
+ *              int depth: use to indent logs
+ * Output     : TRUE on success
+ =======================================================================*/
+static int 
+rescoreContainer(Collection* coll, Container* self, int depth)
+{
+  int rc = FALSE;
+  float score = 0;
+  int incInherency = FALSE;
+  FromAsso* asso = 0;
+  AVLNode *node = 0;
+
+  checkContainer(self);
+  score = self->score;
+  incInherency = self->incInherency;
+
+  // compute it again (using the scores of its parents)
+  self->score = -1;
+  if (!computeContainer(coll, self, depth)) goto error;
+  if (self->score == score && self->incInherency == incInherency) 
+    goto end;
+
+  // propagate to the contents
+  for (node = self->childs->head; node; node = node->next) {
+    asso = (FromAsso*)node->item;
+    if (!rescoreArchive(coll, asso->archive, FALSE, depth+1)) 
+      goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to rescoreContainer");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : hasMuteChanged
+ * Description: Remind the archives of servers becoming mute (or not)
+ * Synopsis   : static int hasMuteChanged(Collection* coll, time_t now)
+ * Input      : Collection* coll
+ *              time_t now: current date
+ * Output     : TRUE on success
+ * Note       : the other changes are reminded by the memory modules
+ *              (cf addToRescore)
+ =======================================================================*/
+static int 
+hasMuteChanged(Collection* coll, time_t now)
+{
+  int rc = FALSE;
+  Server* server = 0;
+  Image* image = 0;
+  RGIT* curr = 0;
+  RGIT* curr2 = 0;
+  int isMute = FALSE;
+
+  if (coll->fileState[iSERV] == DISEASED) goto end;
+  while ((server = rgNext_r(coll->serverTree->servers, &curr))) {
+    isMute = isMuteServer(coll, server, now);
+    if (isMute == server->isMute) continue;
+
+    logCommon(LOG_INFO, "%s server is %s mute", 
+	      server->fingerPrint, isMute?"now":"no more");
+    server->isMute = isMute;
+    curr2 = 0;
+    while ((image = rgNext_r(server->images, &curr2))) {
+      if (!addToRescore(coll, image->archive)) goto error;
+    }
+  }
+ end:
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : rescoreExtractTree
+ * Description: Re-compute the scores impacted by the changes
+ * Synopsis   : static int rescoreExtractTree(Collection* coll, 
+ *                                            time_t now)
+ * Input      : Collection* coll
+ *              time_t now: current date
+ * Output     : TRUE on success
+ * Requirement: loadCollection(coll, SERV|EXTR)
+ =======================================================================*/
+static int 
+rescoreExtractTree(Collection* coll, time_t now)
+{
+  int rc = FALSE;
+  ExtractTree* self = coll->extractTree;
+  Server* server = 0;
+  Archive* archive = 0;
+  RGIT* curr = 0;
+
+  logCommon(LOG_DEBUG, "rescoreExtractTree: %s (%i archives)", 
+	    coll->label, self->toRescore->nbItems);
+
+  // server->score = min (image's scores)
+  while ((server = rgNext_r(coll->serverTree->servers, &curr))) {
+    computeServerScore(server);
+  }
+
+  // new image's scores are propagated to the contents
+  while ((archive = rgHead(self->toRescore))) {
+    rgRemove(self->toRescore);
+    archive->toRescore = FALSE;
+    computeImageScore(coll, archive, now);
+    if (!rescoreArchive(coll, archive, TRUE, 0)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to rescoreExtractTree");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : scoreExtractTree
+ * Description: Compute the score of all the archives
+ * Synopsis   : static int scoreExtractTree(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Requirement: loadCollection(coll, SERV|EXTR)
+ =======================================================================*/
+static int 
+scoreExtractTree(Collection* coll)
+{
+  int rc = FALSE;
+  Archive* archive = 0;
+  AVLNode *node = 0;
+
+  // forget the scores computed from a previous extraction metadata
+  avl_free_nodes(coll->extractTree->scores);
+  for (node = coll->archives->head; node; node = node->next) {
+    ((Archive*)node->item)->imageScore = -1;
+    ((Archive*)node->item)->extractScore = -1;
+  }
+  for (node = coll->extractTree->containers->head; node;
+       node = node->next) {
+    ((Container*)node->item)->score = -1;
+  }
+
+  // copy scores from images to archives
+  if (!populateExtractTree(coll)) goto error;
+
+  // compute archives score recursively (they index themselves)
+  for (node = coll->archives->head; node; node = node->next) {
+    archive = (Archive*)node->item;
+    if (!computeArchive(coll, archive, 0)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to scoreExtractTree");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : computeExtractScore
  * Description: Compute score for each archive
  * Synopsis   : int computeExtractScore(Collection* coll)
  * Input      : Collection* coll
  * Output     : TRUE on success
+ * Note       : once computed, only the scores impacted by the changes
+ *              on images, servers and containers are computed again.
+ *              The global score is the lowest archive's score indexed.
  =======================================================================*/
 int 
 computeExtractScore(Collection* coll)
@@ -278,7 +569,8 @@ computeExtractScore(Collection* coll)
   int rc = FALSE;
   ExtractTree* self = 0;
   Archive* archive = 0;
-  AVLNode *node = 0;
+  time_t now = 0;
+  int err = 0;
 
   checkCollection(coll);
   self = coll->extractTree;
@@ -288,40 +580,49 @@ computeExtractScore(Collection* coll)
     goto error;
   }
 
-  // already computed (and not diseased since)
+  if ((err = pthread_mutex_lock(&self->mutex))) {
+    logCommon(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  if ((now = currentTime()) == -1) goto error2;
+
+  // already computed (and not diseased nor modified since)
   if (self->score != -1) {
-    rc = TRUE;
-    goto quit;
+    if (!hasMuteChanged(coll, now)) goto error2;
+    if (isEmptyRing(self->toRescore)) {
+      rc = TRUE;
+      goto error2;
+    }
   }
 
-  logCommon(LOG_DEBUG, "computeExtractScore: %s", coll->label);
-  if (!loadCollection(coll, SERV|EXTR)) goto error;
+  if (self->score == -1) {
+    logCommon(LOG_DEBUG, "computeExtractScore: %s", coll->label);
+  }
+  if (!loadCollection(coll, SERV|EXTR)) goto error2;
 
-  // copy scores from images to archives
-  if (!populateExtractTree(coll)) goto error2;
+  if (self->score == -1) {
+    if (!scoreExtractTree(coll)) goto error3;
+  }
+  else {
+    if (!rescoreExtractTree(coll, now)) goto error3;
+  }
 
-  // compute archives score recursively
+  // global score = min ( archive's score ), ignoring new incomings
   self->score = coll->serverTree->scoreParam.maxScore;
-  if (coll->archives) {
-    for (node = coll->archives->head; node; node = node->next) {
-      archive = (Archive*)node->item;
-      if (!computeArchive(coll, archive, 0)) goto error2;
-
-      // new incomings are ignored into score computation
-      if (archive->incInherency) continue;
-
-      // global score = min ( archive's score )
-      if (archive->extractScore > -1) {
-	if (self->score > archive->extractScore)
-	  self->score = archive->extractScore;
-      }
-    }
+  if (self->scores->head) {
+    archive = (Archive*)self->scores->head->item;
+    if (self->score > archive->extractScore)
+      self->score = archive->extractScore;
   }
 
   rc = TRUE;
- error2:
+ error3:
   if (!releaseCollection(coll, SERV|EXTR)) rc = FALSE;
- quit:
+ error2:
+  if ((err = pthread_mutex_unlock(&self->mutex))) {
+    logCommon(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
  error:
  if (!rc || self->score == -1) {
     logCommon(LOG_ERR, "fails to computeExtractScore");
@@ -365,7 +666,7 @@ getExtractStatus(Collection* coll, off_t* badSize, RG** badArchives)
     archive = (Archive*) node->item;
 
     // looking for top containers as content cannot have worse score
-    if (!isEmptyRing(archive->fromContainers)) continue;
+    if (!isEmptyRing(arFromContainers(archive))) continue;
 
     // do not display a global bad score due to incomings
     if (archive->incInherency) continue;
@@ -22,6 +22,7 @@
  =======================================================================*/
 
 #include "mediatex-config.h"
+#include <sys/file.h> // flock
 
 static char* CollFiles[] = {
   "    ", "   C", "  X ", "  XC", " S  ", " S C", " SX ", " SXC",
@@ -180,6 +181,129 @@ callPush(char* user)
   return(rc);
 }
 
+/*=======================================================================
+ * Function   : askPush
+ * Description: Let the daemon push the git modules
+ * Synopsis   : static int askPush()
+ * Input      : N/A
+ * Output     : TRUE if the daemon will push them
+ * Note       : the daemon batch the pushes (cf server/gitPush.c), so
+ *              as commands do not wait for the network. The daemon
+ *              then owns the push and retries it on failure.
+ *              It also commits the pending comments and pulls the
+ *              modules before to push them (cf deferCommit).
+ =======================================================================*/
+static int 
+askPush()
+{
+  if (env.noRegression || env.dryRun) return FALSE;
+  return mdtxAsyncQuery(REG_PUSH);
+}
+
+/*=======================================================================
+ * Function   : lockGitModule
+ * Description: Lock the working directory of a git module
+ * Synopsis   : int lockGitModule(char* gitDir, int operation)
+ * Input      : char* gitDir: the module's working directory
+ *              int operation: LOCK_SH to write the metadata files,
+ *                             LOCK_EX to commit or pull them
+ * Output     : the lock to release, -1 on error
+ * Note       : commands share the lock as they already exclude each
+ *              others (cf clientWriteLock), the daemon takes it
+ *              exclusive (cf server/gitPush.c)
+ =======================================================================*/
+int 
+lockGitModule(char* gitDir, int operation)
+{
+  int rc = -1;
+
+  logCommon(LOG_DEBUG, "lock %s (%s)", gitDir,
+	    operation == LOCK_EX?"exclusive":"shared");
+
+  if ((rc = open(gitDir, O_RDONLY)) == -1) {
+    logCommon(LOG_ERR, "open fails on %s: %s", gitDir, strerror(errno));
+    goto error;
+  }
+  while (flock(rc, operation) == -1) {
+    if (errno == EINTR) continue;
+    logCommon(LOG_ERR, "flock fails on %s: %s", gitDir, strerror(errno));
+    close(rc);
+    rc = -1;
+    goto error;
+  }
+ error:
+  if (rc == -1) {
+    logCommon(LOG_ERR, "lockGitModule fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : unlockGitModule
+ * Description: Release the lock taken by lockGitModule
+ * Synopsis   : void unlockGitModule(int lock)
+ * Input      : int lock: the lock (-1 if not taken)
+ * Output     : N/A
+ =======================================================================*/
+void
+unlockGitModule(int lock)
+{
+  if (lock != -1) close(lock);
+}
+
+/*=======================================================================
+ * Function   : deferCommit
+ * Description: Let the daemon commit a git module
+ * Synopsis   : static int deferCommit(char* gitDir, char* comment)
+ * Input      : char* gitDir: the module's working directory
+ *              char* comment: to overhide command line as comment
+ * Output     : TRUE if the daemon will commit, pull and push it
+ * Note       : the comments are appended to GIT_PENDING_COMMIT and
+ *              committed at once when the modules stay quiet.
+ *              The caller holds the module's lock, so as the daemon
+ *              cannot commit before the comment is written.
+ =======================================================================*/
+static int 
+deferCommit(char* gitDir, char* comment)
+{
+  int rc = FALSE;
+  char* path = 0;
+  int fd = -1;
+
+  if (env.noGitPullPush || !askPush()) goto end;
+
+  if (!(path = createString(gitDir))) goto error;
+  if (!(path = catString(path, "/" GIT_PENDING_COMMIT))) goto error;
+  if ((fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0660)) == -1) {
+    logCommon(LOG_ERR, "open fails on %s: %s", path, strerror(errno));
+    goto error;
+  }
+
+  // env.commandLine ends with \n
+  if (comment) {
+    if (!fdWrite(fd, comment, strlen(comment))) goto error;
+    if (!fdWrite(fd, "\n", 1)) goto error;
+  }
+  else {
+    if (!fdWrite(fd, env.commandLine, strlen(env.commandLine))) 
+      goto error;
+  }
+
+  logCommon(LOG_INFO, "the daemon will commit %s", gitDir);
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_WARNING, "deferCommit fails");
+  }
+  if (fd != -1 && close(fd) == -1) {
+    logCommon(LOG_ERR, "close fails: %s", strerror(errno));
+    rc = FALSE;
+  }
+  path = destroyString(path);
+ end:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : loadConfiguration
  * Description: Call the parser on private files
@@ -199,7 +323,8 @@ int loadConfiguration(int confFiles)
   }
   if (!(conf = getConfiguration())) goto error;
 
-  if (!env.noGit) {
+  // the daemon commits the manual editions and pulls (cf askPush)
+  if (!env.noGit && (env.noGitPullPush || !askPush())) {
     if (!callCommit(env.confLabel, "manual user edition")) goto error;
     if (!env.noGitPullPush) callPull(env.confLabel);
   }
@@ -223,9 +348,89 @@ int loadConfiguration(int confFiles)
 }
 
 
+/*=======================================================================
+ * Function   : loadJournal
+ * Description: Replay the records journal over the records file
+ * Synopsis   : static int loadJournal(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Note       : replay is idempotent: a journal that was already
+ *              compacted into the records file gives the same result
+ =======================================================================*/
+static int 
+loadJournal(Collection* coll)
+{
+  int rc = FALSE;
+  int fd = -1;
+  struct stat statBuffer;
+  RecordTree* tree = 0;
+  Record* record = 0;
+  Record* entry = 0;
+  int isRemove = FALSE;
+  int nb = 0;
+  
+  // we now know all the events
+  coll->cacheTree->journalSize = 0;
+  coll->cacheTree->isSharedJournal = FALSE;
+  if (access(coll->md5sumsJnl, R_OK) == -1) goto end;
+  logCommon(LOG_INFO, "parse records journal: %s", coll->md5sumsJnl);
+
+  if ((fd = open(coll->md5sumsJnl, O_RDONLY)) == -1) {
+    logCommon(LOG_ERR, "open: %s", strerror(errno));
+    logCommon(LOG_ERR, "cannot open records journal: %s", 
+	      coll->md5sumsJnl);
+    goto error;
+  }
+  if (!lock(fd, F_RDLCK)) goto error;
+
+  // events appended while parsing will look written by another tree
+  if (fstat(fd, &statBuffer)) {
+    logCommon(LOG_ERR, "fstat: %s", strerror(errno));
+    unLock(fd);
+    goto error;
+  }
+  coll->cacheTree->journalSize = statBuffer.st_size;
+  tree = parseRecordJournal(fd);
+  if (!unLock(fd)) goto error;
+  if (!tree) goto error;
+
+  // replay the events in order
+  while ((record = rgHead(tree->journal))) {
+    rgRemove(tree->journal);
+    ++nb;
+    isRemove = (record->type & REMOVE);
+    record->type &= ~REMOVE;
+
+    // an added record replace the previous one (new date)
+    if ((entry = getCacheEntry(coll, record))) {
+      if (!delCacheEntry(coll, entry)) goto error;
+    }
+
+    if (isRemove) {
+      if (!delRecord(coll, record)) goto error;
+    }
+    else {
+      if (!addCacheEntry(coll, record)) goto error;
+    }
+  }
+  coll->cacheTree->nbJournal = nb;
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to load records journal");   
+  }
+  if (fd != -1 && close(fd) == -1) {
+    logCommon(LOG_ERR, "close: %s", strerror(errno));
+  }
+  tree = destroyRecordTree(tree);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : loadRecords
- * Description: Call the parser on records file
+ * Description: Call the parser on records file and journal
  * Synopsis   : int loadRecords(Collection* coll)
  * Input      : N/A
  * Output     : TRUE on success
@@ -245,9 +450,12 @@ int loadRecords(Collection* coll)
   // compute scores (only once), as score will be used by addCacheEntry
   if (!computeExtractScore(coll)) goto error;
 
+  // we are reading the journal, not writing it
+  coll->cacheTree->noJournal = TRUE;
+
   if (access(coll->md5sumsDB, R_OK) == -1) {
     logCommon(LOG_NOTICE, "no md5sums file: %s", coll->md5sumsDB);
-    goto end;
+    goto next;
   }
 
   // open md5sumsDB file
@@ -277,13 +485,87 @@ int loadRecords(Collection* coll)
     record = node->item;
     if (!addCacheEntry(coll, record)) goto error;
   }
+
+ next:
+  // replay the changes done since the records file was written
+  if (!loadJournal(coll)) goto error;
    
- end:
   rc = TRUE;
  error:
   if (!rc) {
     logCommon(LOG_ERR, "fails to load records");   
   }
+  if (coll) coll->cacheTree->noJournal = FALSE;
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : saveRecords
+ * Description: Compact the records journal into the records file
+ * Synopsis   : int saveRecords(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Note       : this must only be done by the server !
+ *              As changes are already into the journal, the records
+ *              file is only re-written when the journal grows.
+ *              The compaction waits for the cache write lock, so it
+ *              runs from the signal jobs (SAVEMD5) or on TERM once
+ *              no job is running, but never on HUP from the thread
+ *              handling the signals, nor from an outdated
+ *              configuration (cf outdatedManager).
+ *              Not done while another cache tree writes the journal
+ *              too (cf checkCacheJournal).
+ =======================================================================*/
+int saveRecords(Collection* coll)
+{
+  int rc = FALSE;
+  char* path = 0;
+
+  checkCollection(coll);
+  logCommon(LOG_DEBUG, "save %s records", coll->label);
+
+  if (!env.dryRun && coll->cacheTree->nbJournal < MAX_JOURNAL_EVENTS) {
+    logCommon(LOG_INFO, "keep %i events into the records journal",
+	      coll->cacheTree->nbJournal);
+    goto end;
+  }
+
+  // no more journal writes until the journal is reset
+  if (!lockCacheWrite(coll)) goto error;
+  if (!env.dryRun && !checkCacheJournal(coll)) {
+    logCommon(LOG_NOTICE, "records journal also written by a previous "
+	      "configuration: keep it until the next load");
+    rc = TRUE;
+    goto error2;
+  }
+  coll->cacheTree->recordTree->collection = coll;
+  coll->cacheTree->recordTree->messageType = DISK;
+
+  // write aside, so as a crash never truncates the records file
+  if (!(path = createString(coll->md5sumsDB))
+      || !(path = catString(path, ".tmp"))) goto error2;
+  if (!serializeRecordTree(coll->cacheTree->recordTree, 
+			   env.dryRun?coll->md5sumsDB:path, 0)) goto error2;
+
+  if (!env.dryRun) {
+    if (rename(path, coll->md5sumsDB) == -1) {
+      logCommon(LOG_ERR, "rename %s fails: %s", path, strerror(errno));
+      goto error2;
+    }
+    if (!resetCacheJournal(coll)) goto error2;
+  }
+
+  rc = TRUE;
+ error2:
+  if (!unLockCache(coll)) rc = FALSE;
+  if (!rc) goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to save records");   
+  }
+  path = destroyString(path);
   return rc;
 }
 
@@ -372,6 +654,8 @@ releaseColl(Collection* coll, int i)
     goto error;
   }
 
+  if (i == iCACH && !releaseCacheOwner(coll)) goto error;
+
   rc = TRUE;
  error:
   if (!rc) {
@@ -409,6 +693,325 @@ releaseCollection(Collection* coll, int collFiles)
   return rc;
 }
 
+/* Staging parse of the extract part files (cf loadCvsFiles) */
+typedef struct ExtractPart {
+  char* path;       // part file to parse
+  Collection* coll; // private collection the part is parsed into
+  int rc;           // TRUE if parsed
+} ExtractPart;
+
+typedef struct ExtractLoader {
+  pthread_mutex_t mutex;
+  Configuration* conf; // pinned by the calling job (cf SIGHUP)
+  ExtractPart* parts;
+  int nbParts;
+  int next;         // next part to parse
+  int isFailed;     // stop parsing after the first error
+} ExtractLoader;
+
+/*=======================================================================
+ * Function   : createStagingCollection
+ * Description: Create a private collection to parse a part file into
+ * Synopsis   : static Collection* createStagingCollection(
+ *                                                Collection* coll)
+ * Input      : Collection* coll: the collection we are loading
+ * Output     : the staging collection, 0 on error
+ =======================================================================*/
+static Collection*
+createStagingCollection(Collection* coll)
+{
+  Collection* rc = 0;
+  Collection* part = 0;
+
+  if (!(part = createCollection())) goto error;
+  strncpy(part->label, coll->label, MAX_SIZE_COLL);
+  if (!(part->extractTree = createExtractTree())) goto error;
+  if (!(part->extractTree->stanzas = createRing())) goto error;
+
+  rc = part;
+  part = 0;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "createStagingCollection fails");
+  }
+  part = destroyCollection(part);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : parseExtractParts
+ * Description: Thread that parse part files into staging collections
+ * Synopsis   : static void* parseExtractParts(void* arg)
+ * Input      : void* arg: the ExtractLoader shared by the threads
+ * Output     : N/A
+ * Note       : parts are taken in order, so as the first error stop
+ *              the remaining ones like the serial loader does
+ =======================================================================*/
+static void*
+parseExtractParts(void* arg)
+{
+  ExtractLoader* loader = (ExtractLoader*)arg;
+  ExtractPart* part = 0;
+  int err = 0;
+
+  while (1) {
+    if ((err = pthread_mutex_lock(&loader->mutex))) {
+      logCommon(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+      break;
+    }
+    part = 0;
+    if (!loader->isFailed && loader->next < loader->nbParts) {
+      part = loader->parts + loader->next++;
+    }
+    if ((err = pthread_mutex_unlock(&loader->mutex))) {
+      logCommon(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+      break;
+    }
+    if (!part) break;
+
+    part->rc = parseExtractFile(part->coll, part->path);
+
+    if (!part->rc) {
+      pthread_mutex_lock(&loader->mutex);
+      loader->isFailed = TRUE;
+      pthread_mutex_unlock(&loader->mutex);
+    }
+  }
+
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : loaderThread
+ * Description: Thread of the pool parsing the part files
+ * Synopsis   : static void* loaderThread(void* arg)
+ * Input      : void* arg: the ExtractLoader shared by the threads
+ * Output     : N/A
+ * Note       : use the configuration of the job we are working for,
+ *              not the current one (cf SIGHUP)
+ =======================================================================*/
+static void*
+loaderThread(void* arg)
+{
+  ExtractLoader* loader = (ExtractLoader*)arg;
+
+  if (!useConfiguration(loader->conf)) {
+    pthread_mutex_lock(&loader->mutex);
+    loader->isFailed = TRUE;
+    pthread_mutex_unlock(&loader->mutex);
+    return (void*)0;
+  }
+  parseExtractParts(arg);
+  useConfiguration(0);
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : mergeExtractPart
+ * Description: Replay a staging collection into the collection
+ * Synopsis   : static int mergeExtractPart(Collection* coll, 
+ *                                          Collection* part)
+ * Input      : Collection* coll: the collection we are loading
+ *              Collection* part: the parsed part file
+ * Output     : TRUE on success
+ * Note       : archives are added in the order the parser meets them
+ *              and containers in the stanzas order, so as we obtain
+ *              the same ids and rings than the serial loader.
+ =======================================================================*/
+static int
+mergeExtractPart(Collection* coll, Collection* part)
+{
+  int rc = FALSE;
+  Archive** archives = 0;
+  Archive* archive = 0;
+  Archive* parent = 0;
+  Container* container = 0;
+  Container* target = 0;
+  FromAsso* asso = 0;
+  AVLNode* node = 0;
+  RGIT* curr = 0;
+  RGIT* curr2 = 0;
+  int i = 0;
+
+  // archives (ids are given by the parsing order)
+  if (part->maxId > 0) {
+    if (!(archives = malloc(part->maxId * sizeof(Archive*)))) {
+      logCommon(LOG_ERR, "cannot malloc archives array");
+      goto error;
+    }
+    memset(archives, 0, part->maxId * sizeof(Archive*));
+  }
+  for (node = part->archives->head; node; node = node->next) {
+    archive = (Archive*)node->item;
+    if (archive->id < 0 || archive->id >= part->maxId) goto error;
+    archives[archive->id] = archive;
+  }
+  for (i = 0; i < part->maxId; ++i) {
+    if (!archives[i]) continue;
+    if (!addArchive(coll, archives[i]->hash, archives[i]->size))
+      goto error;
+  }
+
+  // containers
+  while ((container = rgNext_r(part->extractTree->stanzas, &curr))) {
+    switch (container->type) {
+    case INC:
+      target = coll->extractTree->inc;
+      break;
+    case IMG:
+      target = coll->extractTree->img;
+      break;
+    default:
+      if (!(parent = addArchive(coll, container->parent->hash,
+				container->parent->size))) goto error;
+      if (!(target = addContainer(coll, container->type, parent)))
+	goto error;
+
+      // other parents (the first one is added by addContainer)
+      curr2 = 0;
+      while ((archive = rgNext_r(container->parents, &curr2))) {
+	if (archive == container->parent) continue;
+	if (!(parent = addArchive(coll, archive->hash, archive->size)))
+	  goto error;
+	if (!addFromArchive(coll, target, parent)) goto error;
+      }
+    }
+
+    for (node = container->childs->head; node; node = node->next) {
+      asso = (FromAsso*)node->item;
+      if (!(archive = addArchive(coll, asso->archive->hash, 
+				 asso->archive->size))) goto error;
+      if (!addFromAsso(coll, archive, target, asso->path)) goto error;
+    }
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "mergeExtractPart fails");
+  }
+  if (archives) free(archives);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : loadExtractParts
+ * Description: Parse the extract part files concurrently
+ * Synopsis   : static int loadExtractParts(Collection* coll, 
+ *                                    char* path, int l, int* nbParts)
+ * Input      : Collection* coll: collection to load
+ *              char* path: coll->extractDB followed by "000.txt"
+ *              int l: length of coll->extractDB
+ * Output     : int* nbParts: number of part files loaded
+ *              TRUE on success
+ * Note       : each part file is parsed into its own staging
+ *              collection by a pool of threads; staging collections
+ *              are then merged in the part files order.
+ =======================================================================*/
+static int
+loadExtractParts(Collection* coll, char* path, int l, int* nbParts)
+{
+  int rc = FALSE;
+  ExtractLoader loader;
+  pthread_t threads[MAX_LOAD_THREAD];
+  int nbThreads = 0;
+  long nbCpus = 0;
+  int isMutex = FALSE;
+  int nb = 0;
+  int err = 0;
+  int i = 0;
+
+  memset(&loader, 0, sizeof(ExtractLoader));
+  *nbParts = 0;
+  if (!(loader.conf = getConfiguration())) goto error;
+
+  // count the part files
+  do {
+    if (!sprintf(path+l, "%03i.txt", nb)) goto error;
+    if (access(path, R_OK)) break;
+  }
+  while (++nb < 1000);
+
+  // not worth it: parse the part file directly
+  if (nb < 2) {
+    if (nb == 1) {
+      if (!sprintf(path+l, "%03i.txt", 0)) goto error;
+      if (!parseExtractFile(coll, path)) goto error;
+    }
+    goto end;
+  }
+
+  if (!(loader.parts = malloc(nb * sizeof(ExtractPart)))) {
+    logCommon(LOG_ERR, "cannot malloc part files array");
+    goto error;
+  }
+  memset(loader.parts, 0, nb * sizeof(ExtractPart));
+  loader.nbParts = nb;
+  for (i = 0; i < nb; ++i) {
+    if (!sprintf(path+l, "%03i.txt", i)) goto error;
+    if (!(loader.parts[i].path = createString(path))) goto error;
+    if (!(loader.parts[i].coll = createStagingCollection(coll))) 
+      goto error;
+  }
+
+  if ((err = pthread_mutex_init(&loader.mutex, 0))) {
+    logCommon(LOG_ERR, "pthread_mutex_init fails: %s", strerror(err));
+    goto error;
+  }
+  isMutex = TRUE;
+
+  // parse
+  if ((nbCpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1) nbCpus = 1;
+  if (nbCpus > MAX_LOAD_THREAD) nbCpus = MAX_LOAD_THREAD;
+  if (nbCpus > nb) nbCpus = nb;
+  logCommon(LOG_INFO, "parse %i extract part files using %li threads",
+	    nb, nbCpus);
+  for (nbThreads = 0; nbThreads < nbCpus; ++nbThreads) {
+    if ((err = pthread_create(threads + nbThreads, 0,
+			      loaderThread, &loader))) {
+      logCommon(LOG_ERR, "pthread_create fails: %s", strerror(err));
+      break;
+    }
+  }
+  if (nbThreads == 0) {
+    // no thread available: parse from here
+    parseExtractParts(&loader);
+  }
+  for (i = 0; i < nbThreads; ++i) {
+    if ((err = pthread_join(threads[i], 0))) {
+      logCommon(LOG_ERR, "pthread_join fails: %s", strerror(err));
+      goto error;
+    }
+  }
+
+  // merge (in order)
+  for (i = 0; i < nb; ++i) {
+    if (!loader.parts[i].rc) goto error;
+    if (!mergeExtractPart(coll, loader.parts[i].coll)) {
+      logCommon(LOG_ERR, "please edit %s", loader.parts[i].path);
+      goto error;
+    }
+    loader.parts[i].coll = destroyCollection(loader.parts[i].coll);
+  }
+
+ end:
+  *nbParts = nb;
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "loadExtractParts fails");
+  }
+  if (isMutex) pthread_mutex_destroy(&loader.mutex);
+  if (loader.parts) {
+    for (i = 0; i < loader.nbParts; ++i) {
+      loader.parts[i].path = destroyString(loader.parts[i].path);
+      loader.parts[i].coll = destroyCollection(loader.parts[i].coll);
+    }
+    free(loader.parts);
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : loadCvsFiles
  * Description: Call the parser on shared files
@@ -423,6 +1026,9 @@ loadCvsFiles(Collection* coll, int fileIdx)
   int rc = FALSE;
   int (*parser)(Collection*, const char* path);
   char* path = 0;
+  time_t loadTime = 0;
+  int firstId = 0;
+  int isLoaded = FALSE;
   int l = 0;
   int i = 0;
 
@@ -445,13 +1051,23 @@ loadCvsFiles(Collection* coll, int fileIdx)
   l = strlen(path);
   if (!(path = catString(path, "000.txt"))) goto error;
 
-  // load from part files
-  do {
-    if (!sprintf(path+l, "%03i.txt", i)) goto error;
-    if (access(path, R_OK)) break;
-    if (!parser(coll, path)) goto error;
+  // load from the binary snapshot or from the part files
+  if (fileIdx == iEXTR) {
+    if (!loadExtractSnapshot(coll, &isLoaded, &i)) goto error;
+    if (!isLoaded) {
+      loadTime = currentTime();
+      firstId = coll->maxId;
+      if (!loadExtractParts(coll, path, l, &i)) goto error;
+    }
+  }
+  else {
+    do {
+      if (!sprintf(path+l, "%03i.txt", i)) goto error;
+      if (access(path, R_OK)) break;
+      if (!parser(coll, path)) goto error;
+    }
+    while (++i < 1000);
   }
-  while (++i < 1000);
   coll->fileState[fileIdx] = LOADED;
 
   // load last addon
@@ -470,6 +1086,13 @@ loadCvsFiles(Collection* coll, int fileIdx)
   if (!i) {
     logCommon(LOG_INFO, "no metadata file founded");
   }
+  else if (fileIdx == iEXTR && !isLoaded && !env.dryRun &&
+	   !env.noSnapshot && coll->fileState[fileIdx] == LOADED) {
+    // next loads will not have to parse the part files
+    if (!saveExtractSnapshot(coll, FALSE, loadTime, firstId)) {
+      logCommon(LOG_WARNING, "cannot write the extract snapshot");
+    }
+  }
   rc = (i >= 0);
  error:
   if (!rc) {
@@ -479,6 +1102,69 @@ loadCvsFiles(Collection* coll, int fileIdx)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : getMetadataMtime
+ * Description: Get the last modification time of metadata files
+ * Synopsis   : static int getMetadataMtime(Collection* coll, 
+ *                                    int fileIdx, time_t* mtime)
+ * Input      : Collection* coll: collection
+ *              int fileIdx: CTLG,EXTR or SERV
+ * Output     : time_t* mtime: most recent mtime of the part files
+ *              TRUE on success
+ =======================================================================*/
+static int 
+getMetadataMtime(Collection* coll, int fileIdx, time_t* mtime)
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  char* path = 0;
+  int l = 0;
+  int i = 0;
+
+  *mtime = 0;
+  switch (fileIdx) {
+  case iCTLG:
+    if (!(path = createString(coll->catalogDB))) goto error;
+    break;
+  case iEXTR:
+    if (!(path = createString(coll->extractDB))) goto error;
+    break;
+  case iSERV:
+    if (stat(coll->serversDB, &statBuffer) == 0) {
+      *mtime = statBuffer.st_mtime;
+    }
+    goto end;
+  default:
+    goto end; // records are only written by the daemon
+  }
+
+  l = strlen(path);
+  if (!(path = catString(path, "000.txt"))) goto error;
+
+  // part files
+  do {
+    if (!sprintf(path+l, "%03i.txt", i)) goto error;
+    if (stat(path, &statBuffer)) break;
+    if (statBuffer.st_mtime > *mtime) *mtime = statBuffer.st_mtime;
+  }
+  while (++i < 1000);
+
+  // last addon
+  if (!sprintf(path+l, "%s", "NNN.txt")) goto error;
+  if (stat(path, &statBuffer) == 0) {
+    if (statBuffer.st_mtime > *mtime) *mtime = statBuffer.st_mtime;
+  }
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "getMetadataMtime fails");
+  }
+  path = destroyString(path);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : loadColl
  * Description: Call the parser on shared files
@@ -491,6 +1177,9 @@ static int
 loadColl(Collection* coll, int fileIdx)
 {
   int rc = FALSE;
+  struct timespec start;
+  Server* server = 0;
+  RGIT* curr = 0;
   int nbInUse = 0;
   int err = 0;
 
@@ -499,8 +1188,12 @@ loadColl(Collection* coll, int fileIdx)
   logCommon(LOG_DEBUG, "do load %s collection (%s)", 
 	  coll->label, strCF(1<<fileIdx));
 
+  // only one configuration may use the records at once (cf SIGHUP)
+  if (fileIdx == iCACH && !acquireCacheOwner(coll)) goto error;
+
   if ((err = pthread_mutex_lock(&coll->mutex[fileIdx]))) {
     logCommon(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    if (fileIdx == iCACH) releaseCacheOwner(coll);
     goto error;
   }
 
@@ -514,7 +1207,10 @@ loadColl(Collection* coll, int fileIdx)
 
   // load if needed
   if (nbInUse == 1 && coll->fileState[fileIdx] == DISEASED) {
+    if (!getMetadataMtime(coll, fileIdx, &coll->fileMtime[fileIdx]))
+      goto error2;
     
+    perfBegin(start);
     switch (fileIdx) {
     case iCTLG:
       if (!loadCvsFiles(coll, iCTLG)) goto error2;
@@ -526,6 +1222,12 @@ loadColl(Collection* coll, int fileIdx)
       if (!parseServerFile(coll, coll->serversDB)) goto error2;
       coll->fileState[iSERV] = LOADED;
 
+      // resolve the peers before we need to connect them
+      curr = 0;
+      while ((server = rgNext_r(coll->serverTree->servers, &curr))) {
+	prefetchHostname(server->host);
+      }
+
       // cgi and server only read the meta-data
       if (!env.noGit) {
 	if (!upgradeCollection(coll)) goto error2;
@@ -541,6 +1243,7 @@ loadColl(Collection* coll, int fileIdx)
     default:
       goto error2;
     }
+    perfEnd(PERF_LOAD_CTLG + fileIdx, start, 0);
   }
   
   rc = TRUE;
@@ -555,6 +1258,240 @@ loadColl(Collection* coll, int fileIdx)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : isOutdatedCollection
+ * Description: Tell if metadata files changed since they were loaded
+ * Synopsis   : int isOutdatedCollection(Collection* coll, int fileIdx,
+ *                                       int* isOutdated)
+ * Input      : Collection* coll: collection
+ *              int fileIdx: CTLG,EXTR or SERV
+ * Output     : int* isOutdated: TRUE if files were modified on disk
+ *              TRUE on success
+ * Note       : used by long-running processes that only read the
+ *              metadata files (cgi worker)
+ =======================================================================*/
+int 
+isOutdatedCollection(Collection* coll, int fileIdx, int* isOutdated)
+{
+  int rc = FALSE;
+  time_t mtime = 0;
+
+  checkCollection(coll);
+  if (fileIdx < iCTLG || fileIdx > iCACH) goto error;
+  *isOutdated = FALSE;
+  
+  if (coll->fileState[fileIdx] == DISEASED) goto end;
+  if (!getMetadataMtime(coll, fileIdx, &mtime)) goto error;
+  *isOutdated = (mtime != coll->fileMtime[fileIdx]);
+  
+  if (*isOutdated) {
+    logCommon(LOG_INFO, "%s collection's %s files were modified",
+	      coll->label, strCF(1<<fileIdx));
+  }
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "isOutdatedCollection fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : isSameNetworks
+ * Description: Compare 2 rings of networks
+ * Synopsis   : static int isSameNetworks(RG* ring1, RG* ring2)
+ * Input      : RG* ring1, ring2: rings of network labels
+ * Output     : TRUE if both rings list the same labels
+ * Note       : labels are not shared between 2 configurations
+ =======================================================================*/
+static int 
+isSameNetworks(RG* ring1, RG* ring2)
+{
+  char *net1 = 0, *net2 = 0;
+  RGIT *curr1 = 0, *curr2 = 0;
+
+  if (ring1->nbItems != ring2->nbItems) return FALSE;
+  while ((net1 = rgNext_r(ring1, &curr1))) {
+    curr2 = 0;
+    while ((net2 = rgNext_r(ring2, &curr2))) {
+      if (!strcmp(net1, net2)) break;
+    }
+    if (!net2) return FALSE;
+  }
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : rebindNetworks
+ * Description: Make a ring use the network labels from current conf
+ * Synopsis   : static int rebindNetworks(RG* ring)
+ * Input      : RG* ring: ring of network labels
+ * Output     : TRUE on success
+ =======================================================================*/
+static int 
+rebindNetworks(RG* ring)
+{
+  int rc = FALSE;
+  RGIT* curr = 0;
+
+  while (rgNext_r(ring, &curr)) {
+    if (!(curr->it = addNetwork(curr->it))) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : adoptCollection
+ * Description: Reuse the trees already parsed by a previous 
+ *              configuration if the metadata files were not modified
+ * Synopsis   : int adoptCollection(Collection* coll, Collection* old)
+ * Input      : Collection* coll: collection from the new configuration
+ *              Collection* old: same collection from the previous one
+ * Output     : TRUE on success (even if old trees cannot be reused)
+ * Note       : call on SIGHUP. The old collection get new empty trees,
+ *              so jobs still using it will parse it again if needed.
+ *              Called again when the old configuration is released
+ *              (cf outdatedManager), so as the new one gets the trees
+ *              if it did not load its own meanwhile.
+ =======================================================================*/
+int 
+adoptCollection(Collection* coll, Collection* old)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Server* server = 0;
+  RGIT* curr = 0;
+  AVLTree* archives = 0;
+  ServerTree* serverTree = 0;
+  ExtractTree* extractTree = 0;
+  CatalogTree* catalogTree = 0;
+  CacheTree* cacheTree = 0;
+  time_t mtime = 0;
+  int isLocked[4] = {FALSE, FALSE, FALSE, FALSE};
+  int isNewLocked[4] = {FALSE, FALSE, FALSE, FALSE};
+  int doAdopt = FALSE;
+  int err = 0;
+  int i = 0;
+
+  checkCollection(coll);
+  checkCollection(old);
+  logCommon(LOG_DEBUG, "adopt %s collection", coll->label);
+  if (!(conf = getConfiguration())) goto error;
+
+  if (!(coll->memoryState & EXPANDED) || !(old->memoryState & EXPANDED))
+    goto end;
+
+  // parameters from configuration file must not change
+  if (strcmp(coll->masterLabel, old->masterLabel) ||
+      strncmp(coll->masterHost, old->masterHost, MAX_SIZE_HOST) ||
+      coll->masterPort != old->masterPort ||
+      coll->cacheSize != old->cacheSize ||
+      coll->cacheTTL != old->cacheTTL ||
+      coll->queryTTL != old->queryTTL ||
+      coll->motdPolicy != old->motdPolicy ||
+      strncmp(coll->userFingerPrint, old->userFingerPrint, MAX_SIZE_MD5) ||
+      !isSameNetworks(coll->networks, old->networks) ||
+      !isSameNetworks(coll->gateways, old->gateways))
+    goto end;
+
+  // assert no job is using the old trees
+  for (i=iCTLG; i<=iCACH; ++i) {
+    if ((err = pthread_mutex_lock(&old->mutex[i]))) {
+      logCommon(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+      goto error;
+    }
+    isLocked[i] = TRUE;
+    if (old->cptInUse[i]) goto end;
+  }
+
+  // nor the new ones, that must not be loaded yet
+  for (i=iCTLG; i<=iCACH; ++i) {
+    if ((err = pthread_mutex_lock(&coll->mutex[i]))) {
+      logCommon(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+      goto error;
+    }
+    isNewLocked[i] = TRUE;
+    if (coll->cptInUse[i] || coll->fileState[i] != DISEASED) goto end;
+  }
+
+  // records that another tree journals too are parsed again
+  if (old->fileState[iCACH] != DISEASED && !checkCacheJournal(old))
+    goto end;
+
+  // shared metadata files must not change
+  for (i=iCTLG; i<=iSERV; ++i) {
+    if (old->fileState[i] == MODIFIED) goto end;
+    if (old->fileState[i] == DISEASED) continue;
+    if (!getMetadataMtime(old, i, &mtime)) goto error;
+    if (mtime != old->fileMtime[i]) goto end;
+  }
+  doAdopt = TRUE;
+
+  // swap the trees
+  archives = coll->archives;
+  serverTree = coll->serverTree;
+  extractTree = coll->extractTree;
+  catalogTree = coll->catalogTree;
+  cacheTree = coll->cacheTree;
+  coll->archives = old->archives;
+  coll->serverTree = old->serverTree;
+  coll->extractTree = old->extractTree;
+  coll->catalogTree = old->catalogTree;
+  coll->cacheTree = old->cacheTree;
+  old->archives = archives;
+  old->serverTree = serverTree;
+  old->extractTree = extractTree;
+  old->catalogTree = catalogTree;
+  old->cacheTree = cacheTree;
+  coll->cacheTree->recordTree->collection = coll;
+  old->cacheTree->recordTree->collection = old;
+
+  coll->localhost = old->localhost;
+  coll->maxId = old->maxId;
+  old->localhost = 0;
+  old->maxId = 0;
+  for (i=iCTLG; i<=iCACH; ++i) {
+    coll->fileState[i] = old->fileState[i];
+    coll->fileMtime[i] = old->fileMtime[i];
+    old->fileState[i] = DISEASED;
+    old->fileMtime[i] = 0;
+  }
+
+  // servers must not use network labels from the old configuration
+  while ((server = rgNext_r(coll->serverTree->servers, &curr))) {
+    if (!rebindNetworks(server->networks)) goto error;
+    if (!rebindNetworks(server->gateways)) goto error;
+  }
+
+ end:
+  logCommon(LOG_INFO, "%s %s collection from previous configuration", 
+	    doAdopt?"reuse":"do not reuse", coll->label);
+  rc = TRUE;
+ error:
+  for (i=iCTLG; i<=iCACH; ++i) {
+    if (!isNewLocked[i]) continue;
+    if ((err = pthread_mutex_unlock(&coll->mutex[i]))) {
+      logCommon(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+      rc = FALSE;
+    }
+  }
+  for (i=iCTLG; i<=iCACH; ++i) {
+    if (!isLocked[i]) continue;
+    if ((err = pthread_mutex_unlock(&old->mutex[i]))) {
+      logCommon(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+      rc = FALSE;
+    }
+  }
+  if (!rc) {
+    logCommon(LOG_ERR, "fails to adopt collection");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : loadCollectionNbSteps
  * Description: Estimate the maximum number of steps for progBar
@@ -656,7 +1593,8 @@ loadCollection(Collection* coll, int collFiles)
 
   if (!expandCollection(coll)) goto error;
 
-  if (!env.noGit) {
+  // the daemon commits the manual editions and pulls (cf askPush)
+  if (!env.noGit && (env.noGitPullPush || !askPush())) {
     if (!callCommit(coll->user, "manual user edition")) goto error;
     if (!env.noGitPullPush) {
       if (coll->toUpdate && collFiles & (CTLG | EXTR | SERV)) {
@@ -769,10 +1707,17 @@ saveConfiguration()
   int rc = FALSE;
   Configuration* conf = 0;
   int change = FALSE;
+  int lock = -1;
 
   logCommon(LOG_DEBUG, "save configuration");
   if (!(conf = getConfiguration())) goto error;
 
+  // the daemon must not commit files we are writing
+  if (!env.noRegression && !env.dryRun && !env.noGit) {
+    if ((lock = lockGitModule(conf->mdtxGitDir, LOCK_SH)) == -1) 
+      goto error;
+  }
+
   if (conf->fileState[iCFG] == MODIFIED) {
     if (!expandConfiguration()) goto error;
     if (!populateConfiguration()) goto error;
@@ -791,9 +1736,11 @@ saveConfiguration()
   // commit changes
   if (change && !env.noGit) {
     if (!callUpgrade(env.confLabel, conf->hostFingerPrint, 0)) goto error;
-    if (!callCommit(env.confLabel, 0)) goto error;
-    if (!env.noGitPullPush) {
+    if (!deferCommit(conf->mdtxGitDir, 0)) {
+      if (!callCommit(env.confLabel, 0)) goto error;
+      if (!env.noGitPullPush && !askPush()) {
 	callPush(env.confLabel);
+      }
     }
   }
 
@@ -802,6 +1749,7 @@ saveConfiguration()
   if (!rc) {
     logCommon(LOG_ERR, "fails to save configuration");   
   }
+  unlockGitModule(lock);
   return rc;
 }
 
@@ -846,6 +1794,10 @@ saveColl(Collection* coll, int i)
     case iEXTR:
       if (!serializeExtractTree(coll, &fd)) goto error;
       coll->toCommit = TRUE;
+      if (!env.dryRun && !env.noSnapshot &&
+	  !saveExtractSnapshot(coll, TRUE, 0, 0)) {
+	logCommon(LOG_WARNING, "cannot write the extract snapshot");
+      }
       break;
     case iSERV:
       if (!serializeServerTree(coll)) goto error;
@@ -853,12 +1805,7 @@ saveColl(Collection* coll, int i)
       break;
     case iCACH:
       // this must only be done by the server !
-      if (!lockCacheRead(coll)) goto error;
-      coll->cacheTree->recordTree->collection = coll;
-      coll->cacheTree->recordTree->messageType = DISK;
-      if (!serializeRecordTree(coll->cacheTree->recordTree,
-			       coll->md5sumsDB, 0)) goto error;
-      if (!unLockCache(coll)) goto error;
+      if (!saveRecords(coll)) goto error;
       break;
     default:
       goto error;
@@ -943,12 +1890,19 @@ saveCollection(Collection* coll, int collFiles)
   int rc = FALSE;
   Configuration* conf = 0;
   char progBarLabel[MAX_SIZE_COLL+6];
+  int lock = -1;
 
   checkCollection(coll);
   logCommon(LOG_DEBUG, "save %s collection (%s)", 
 	    coll->label, strCF(collFiles));
 
   if (!(conf = getConfiguration())) goto error;
+
+  // the daemon must not commit files we are writing
+  if (!env.noRegression && !env.dryRun && !env.noGit &&
+      collFiles & (CTLG | EXTR | SERV)) {
+    if ((lock = lockGitModule(coll->gitDir, LOCK_SH)) == -1) goto error;
+  }
   if (!saveCollectionNbSteps(coll, collFiles)) goto error;
   if (env.progBar.max > 0) { // else nothing to do
     logMain(LOG_INFO, "serialize  %s collection (%s)", 
@@ -964,13 +1918,19 @@ saveCollection(Collection* coll, int collFiles)
 
   // commit changes
   if (coll->toCommit && !env.noGit) {
-    if (!callCommit(coll->user, 0)) goto error;
-    if (!env.noGitPullPush) {
-      logMain(LOG_INFO, "Git push %s collection", coll->label);
-      if (callPush(coll->user)) {
-	conf->toHup = TRUE;
-	coll->toCommit = FALSE;
-	coll->toUpdate = TRUE;
+    if (deferCommit(coll->gitDir, 0)) {
+      conf->toHup = TRUE;
+      coll->toCommit = FALSE;
+    }
+    else {
+      if (!callCommit(coll->user, 0)) goto error;
+      if (!env.noGitPullPush) {
+	logMain(LOG_INFO, "Git push %s collection", coll->label);
+	if (askPush() || callPush(coll->user)) {
+	  conf->toHup = TRUE;
+	  coll->toCommit = FALSE;
+	  coll->toUpdate = TRUE;
+	}
       }
     }
   }
@@ -980,6 +1940,7 @@ saveCollection(Collection* coll, int collFiles)
   if (!rc) {
     logCommon(LOG_ERR, "fails to save collection");
   }
+  unlockGitModule(lock);
   return rc;
 }
 
@@ -1189,6 +2150,47 @@ int serverDiseaseAll()
   return rc;
 }
 
+/*=======================================================================
+ * Function   : serverDiseaseIdle
+ * Description: Free the extraction metadata no more used
+ * Synopsis   : int serverDiseaseIdle()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : call by the daemon when no job is running. Records and
+ *              servers are kept, extraction metadata will be loaded
+ *              again (from its snapshot) by the next job needing it.
+ *              Records marked as removed are freed too.
+ *              This do not bound the memory: a job still loads all
+ *              the extraction metadata of its collection.
+ =======================================================================*/
+int serverDiseaseIdle()
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Collection* coll = 0;
+  RGIT* curr = 0;
+  
+  logCommon(LOG_DEBUG, "serverDiseaseIdle");
+  if (!(conf = env.confTree)) goto end; // do not malloc
+
+  while ((coll = rgNext_r(conf->collections, &curr))) {
+    if (!(coll->memoryState & EXPANDED)) continue;
+    if (coll->fileState[iCACH] != DISEASED && !reclaimCacheTree(coll))
+      goto error;
+    if (coll->fileState[iEXTR] != LOADED) continue;
+    logCommon(LOG_INFO, "free %s extraction metadata", coll->label);
+    if (!diseaseCollection(coll, CTLG|EXTR)) goto error;
+  }
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "serverDiseaseIdle fails");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : mdtxGetCollection
  * Description: load a collection
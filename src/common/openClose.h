@@ -30,6 +30,8 @@ int callUpgrade(char* user, char* fingerprint, char* url);
 int callCommit(char* user, char* comment);
 int callPull(char* user);
 int callPush(char* user);
+int lockGitModule(char* gitDir, int operation);
+void unlockGitModule(int lock);
 
 int loadConfiguration(int confFiles); // logical OR on confFiles
 int loadRecords(Collection* coll);
@@ -38,6 +40,8 @@ int saveRecords(Collection* coll);
 int loadCollection(Collection* coll, int collFiles);
 int wasModifiedCollection(Collection* coll, int collFiles);
 int releaseCollection(Collection* coll, int collFiles);
+int adoptCollection(Collection* coll, Collection* old);
+int isOutdatedCollection(Collection* coll, int fileIdx, int* isOutdated);
 
 int saveConfiguration();
 int saveCollection(Collection* coll, int collFiles);
@@ -46,6 +50,7 @@ int clientSaveAll();
 int diseaseCollection(Collection* coll, int collFiles);
 int clientDiseaseAll();
 int serverDiseaseAll();
+int serverDiseaseIdle();
 
 Collection* mdtxGetCollection(char* label);
 Support* mdtxGetSupport(char* label);
@@ -0,0 +1,267 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : perf
+ *
+ * Performance counters and latency histograms
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex-config.h"
+
+int perfIsEnabled = FALSE;
+static PerfStat perfStats[PERF_MAX_COUNTER];
+
+// PERF_EXTRACT + type must not overflow: fails to compile otherwise
+typedef char perfCheckETypeMax[(ETYPE_MAX <= PERF_MAX_ETYPE) ? 1 : -1];
+
+static char* perfNames[PERF_EXTRACT] = {
+  "load.catalog",
+  "load.extract",
+  "load.servers",
+  "load.records",
+  "lock.read",
+  "lock.write",
+  "lock.alloc",
+  "checksum",
+  "notify"
+};
+
+/*=======================================================================
+ * Function   : perfName
+ * Description: Get the label of a counter
+ * Synopsis   : static char* perfName(int counter, char* buf)
+ * Input      : int counter
+ *              char* buf: where to build the label (32 bytes)
+ * Output     : the label
+ =======================================================================*/
+static char* 
+perfName(int counter, char* buf)
+{
+  if (counter < PERF_EXTRACT) return perfNames[counter];
+  counter -= PERF_EXTRACT;
+  sprintf(buf, "extract.%s", 
+	  counter < ETYPE_MAX ? strEType(counter) : "???");
+  return buf;
+}
+
+/*=======================================================================
+ * Function   : perfEnable
+ * Description: Enable or disable the counters
+ * Synopsis   : void perfEnable(int isEnabled)
+ * Input      : int isEnabled
+ * Output     : N/A
+ * Note       : do not log, as it may be called before setEnv
+ =======================================================================*/
+void 
+perfEnable(int isEnabled)
+{
+  perfIsEnabled = isEnabled;
+}
+
+/*=======================================================================
+ * Function   : perfGetEnv
+ * Description: Enable the counters if MDTX_PERF is set to 1
+ * Synopsis   : void perfGetEnv(void)
+ * Input      : N/A
+ * Output     : N/A
+ * Requirement: setEnv (so as to log)
+ =======================================================================*/
+void 
+perfGetEnv(void)
+{
+  char* value = getenv("MDTX_PERF");
+
+  perfEnable(value && !strcmp(value, "1"));
+  logCommon(LOG_INFO, "%s performance counters", 
+	    perfIsEnabled?"enable":"disable");
+}
+
+/*=======================================================================
+ * Function   : perfNow
+ * Description: Start timing
+ * Synopsis   : void perfNow(struct timespec* start)
+ * Input      : N/A
+ * Output     : struct timespec* start
+ * Note       : call it using the perfBegin macro
+ =======================================================================*/
+void 
+perfNow(struct timespec* start)
+{
+  if (clock_gettime(CLOCK_MONOTONIC, start)) {
+    start->tv_sec = 0;
+    start->tv_nsec = 0;
+  }
+}
+
+/*=======================================================================
+ * Function   : perfAdd
+ * Description: Account the time elapsed since start
+ * Synopsis   : void perfAdd(int counter, struct timespec* start,
+ *                           off_t bytes)
+ * Input      : int counter: PerfCounter to update
+ *              struct timespec* start: set by perfNow
+ *              off_t bytes: processed bytes (or 0)
+ * Output     : N/A
+ * Note       : lock free, so as to be called by any thread. Call it
+ *              using the perfEnd macro.
+ =======================================================================*/
+void 
+perfAdd(int counter, struct timespec* start, off_t bytes)
+{
+  PerfStat* stat = 0;
+  struct timespec now;
+  unsigned long long usec = 0;
+  unsigned long long max = 0;
+  int i = 0;
+
+  if (counter < 0 || counter >= PERF_MAX_COUNTER) return;
+  if (!start->tv_sec && !start->tv_nsec) return; // not started
+  if (clock_gettime(CLOCK_MONOTONIC, &now)) return;
+  stat = perfStats + counter;
+
+  usec = (now.tv_sec - start->tv_sec) * 1000000LL
+    + (now.tv_nsec - start->tv_nsec) / 1000;
+  for (i = 0; i < PERF_BUCKETS-1 && (usec >> i); ++i);
+
+  __sync_fetch_and_add(&stat->count, 1);
+  __sync_fetch_and_add(&stat->sumUsec, usec);
+  __sync_fetch_and_add(&stat->buckets[i], 1);
+  if (bytes > 0) __sync_fetch_and_add(&stat->bytes, bytes);
+  while ((max = stat->maxUsec) < usec &&
+	 !__sync_bool_compare_and_swap(&stat->maxUsec, max, usec));
+}
+
+/*=======================================================================
+ * Function   : perfStatus
+ * Description: Log the counters
+ * Synopsis   : void perfStatus(int priority)
+ * Input      : int priority: log level
+ * Output     : N/A
+ =======================================================================*/
+void 
+perfStatus(int priority)
+{
+  PerfStat* stat = 0;
+  char buf[32];
+  int i = 0;
+
+  if (!perfIsEnabled) return;
+  logCommon(priority, "===");
+  logCommon(priority, "Performances: count, mean (us), max (us), MB/s");
+  for (i = 0; i < PERF_MAX_COUNTER; ++i) {
+    stat = perfStats + i;
+    if (!stat->count) continue;
+    logCommon(priority, "%-16s%11lu%11llu%11llu%11.2f", 
+	      perfName(i, buf), stat->count, stat->sumUsec / stat->count,
+	      stat->maxUsec, 
+	      stat->sumUsec ? (float)stat->bytes / stat->sumUsec : 0);
+  }
+  logCommon(priority, "===");
+}
+
+/*=======================================================================
+ * Function   : perfSerialize
+ * Description: Dump the counters in a machine-readable format
+ * Synopsis   : int perfSerialize(FILE* fd)
+ * Input      : FILE* fd: where to write
+ * Output     : TRUE on success
+ * Note       : one line by used counter: 
+ *              name count sum_us max_us bytes bucket0 ... bucket31
+ *              where bucketN counts durations into [2^(N-1), 2^N[ us
+ =======================================================================*/
+int 
+perfSerialize(FILE* fd)
+{
+  int rc = FALSE;
+  PerfStat* stat = 0;
+  char buf[32];
+  int i = 0;
+  int j = 0;
+
+  if (fprintf(fd, "# name count sum_us max_us bytes buckets(log2 us)\n")
+      < 0) goto error;
+  for (i = 0; i < PERF_MAX_COUNTER; ++i) {
+    stat = perfStats + i;
+    if (!stat->count) continue;
+    if (fprintf(fd, "%s %lu %llu %llu %llu", perfName(i, buf), 
+		stat->count, stat->sumUsec, stat->maxUsec, stat->bytes)
+	< 0) goto error;
+    for (j = 0; j < PERF_BUCKETS; ++j) {
+      if (fprintf(fd, " %lu", stat->buckets[j]) < 0) goto error;
+    }
+    if (fprintf(fd, "\n") < 0) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "perfSerialize fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : perfSave
+ * Description: Dump the counters into a file
+ * Synopsis   : int perfSave(char* path)
+ * Input      : char* path: file to write
+ * Output     : TRUE on success
+ =======================================================================*/
+int 
+perfSave(char* path)
+{
+  int rc = FALSE;
+  char* tmpPath = 0;
+  FILE* fd = 0;
+
+  if (!perfIsEnabled) goto end;
+  logCommon(LOG_DEBUG, "save performance counters into %s", path);
+
+  if (!(tmpPath = createString(path)) 
+      || !(tmpPath = catString(tmpPath, ".tmp"))) goto error;
+  if (!(fd = fopen(tmpPath, "w"))) {
+    logCommon(LOG_ERR, "fopen %s fails: %s", tmpPath, strerror(errno));
+    goto error;
+  }
+  if (!perfSerialize(fd)) goto error;
+  if (fclose(fd)) {
+    fd = 0;
+    logCommon(LOG_ERR, "fclose fails: %s", strerror(errno));
+    goto error;
+  }
+  fd = 0;
+  if (rename(tmpPath, path) == -1) {
+    logCommon(LOG_ERR, "rename fails: %s", strerror(errno));
+    goto error;
+  }
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "perfSave fails");
+  }
+  if (fd) fclose(fd);
+  tmpPath = destroyString(tmpPath);
+  return rc;
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
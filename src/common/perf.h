@@ -0,0 +1,88 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : perf
+ *
+ * Performance counters and latency histograms
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef MDTX_COMMON_PERF_H
+#define MDTX_COMMON_PERF_H 1
+
+#include "mediatex-types.h"
+#include <time.h>
+
+#define PERF_BUCKETS 32   // log2 scale of micro-seconds
+#define PERF_MAX_ETYPE 16 // room for the container types (>= ETYPE_MAX)
+
+// note: PERF_LOAD_* follow CollFileIdx and PERF_EXTRACT is indexed
+//       by EType
+typedef enum {
+  PERF_LOAD_CTLG,     // parse catalog files
+  PERF_LOAD_EXTR,     // parse (or map) extract files
+  PERF_LOAD_SERV,     // parse servers file
+  PERF_LOAD_CACH,     // parse md5sums file and journal
+  PERF_LOCK_READ,     // wait for lockCacheRead
+  PERF_LOCK_WRITE,    // wait for lockCacheWrite
+  PERF_LOCK_ALLOC,    // wait for cache's MUTEX_ALLOC
+  PERF_CHECKSUM,      // doChecksum (bytes)
+  PERF_NOTIFY,        // NOTIFY round-trip to a peer
+  PERF_EXTRACT,       // extraction, by container type
+  PERF_MAX_COUNTER = PERF_EXTRACT + PERF_MAX_ETYPE
+} PerfCounter;
+
+typedef struct PerfStat {
+  unsigned long count;
+  unsigned long long sumUsec;
+  unsigned long long maxUsec;
+  unsigned long long bytes;
+  unsigned long buckets[PERF_BUCKETS]; // [2^(i-1), 2^i[ usec
+} PerfStat;
+
+extern int perfIsEnabled;
+
+void perfEnable(int isEnabled);
+void perfGetEnv(void);
+void perfNow(struct timespec* start);
+void perfAdd(int counter, struct timespec* start, off_t bytes);
+void perfStatus(int priority);
+int perfSerialize(FILE* fd);
+int perfSave(char* path);
+
+/*=======================================================================
+ * Macro      : perfBegin, perfEnd
+ * Description: Time a code section (no-op when disabled)
+ * Synopsis   : perfBegin(struct timespec start)
+ *              perfEnd(int counter, struct timespec start, off_t bytes)
+ * Input      : N/A
+ * Output     : N/A
+ =======================================================================*/
+#define perfBegin(start) {					\
+    if (perfIsEnabled) perfNow(&(start));			\
+  }
+
+#define perfEnd(counter, start, bytes) {			\
+    if (perfIsEnabled) perfAdd(counter, &(start), bytes);	\
+  }
+
+#endif /* MDTX_COMMON_PERF_H */
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
@@ -273,6 +273,57 @@ int mdtxSyncSignal(int flag)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : mdtxAsyncQuery
+ * Description: Set a register and send SIGUSR1 signal to the daemon
+ *              without waiting for it
+ * Synopsis   : int mdtxAsyncQuery(int flag)
+ * Input      : int flag = register number
+ * Output     : TRUE if the daemon will perform the query
+ =======================================================================*/
+int mdtxAsyncQuery(int flag)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  ShmParam param;
+
+  if (!(conf = getConfiguration())) goto error;
+  logCommon(LOG_DEBUG, "mdtxAsyncQuery %i", flag);
+
+  // test if there is or not a pid file
+  if (access(conf->pidFile, R_OK) == -1) {
+    logCommon(LOG_INFO, "daemon looks stopped");
+    goto end;
+  }
+
+  // Read register
+  if (!shmRead(conf->confFile, REG_SHM_BUFF_SIZE, 
+	       mdtxShmRead, (void*)&param))
+      goto error;
+
+  // Do no set if register is already set
+  if (param.buf[flag] == REG_QUERY || param.buf[flag] == REG_PENDING) 
+    goto signal;
+
+  // Set registers
+  logCommon(LOG_INFO, "setting %i register", flag);
+  param.flag = flag;
+  if (!shmWrite(conf->confFile, REG_SHM_BUFF_SIZE, 
+		mdtxShmEnable, (void*)&param))
+    goto error;
+
+ signal:
+  // Send SIGUSR1 signal to the daemon
+  if (!mdtxAsyncSignal(SIGUSR1)) goto error;
+  rc = TRUE;
+ end:
+ error:
+  if (!rc) {
+    logCommon(LOG_INFO, "mdtxAsyncQuery not performed");
+  }
+  return rc;
+}
+
 /* Local Variables: */
 /* mode: c */
 /* mode: font-lock */
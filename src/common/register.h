@@ -36,7 +36,8 @@
 #define REG_CLEAN     6 // remove what if safe locally
 #define REG_PURGE     7 // remove what if safe
 #define REG_STATUS    8 // log the memory status
-#define REG_SHM_BUFF_SIZE 9
+#define REG_PUSH      9 // push the git modules
+#define REG_SHM_BUFF_SIZE 10
 
 // possible values into registers
 #define REG_DONE    '0'
@@ -58,6 +59,7 @@ int mdtxShmFree();
 
 int mdtxAsyncSignal(int signal);
 int mdtxSyncSignal(int flag);
+int mdtxAsyncQuery(int flag);
 
 #endif /* MDTX_COMMON_REGISTER_H */
 
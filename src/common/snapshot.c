@@ -0,0 +1,849 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : snapshot
+ *
+ * Binary snapshot of the extraction metadata
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "mediatex-config.h"
+#include <sys/mman.h>
+
+/* The snapshot is a sidecar of the extract part files, local to the
+ * host (it is not shared by git and use native types). Its layout is:
+ * - SnapshotHeader
+ * - SnapshotPart[nbParts]: signatures of the part files
+ * - SnapshotArchive[nbArchives]: in the order the text parser meets
+ *   them, so as the archives obtain the same ids (html URIs)
+ * - nbContainers times, in the extract files order:
+ *   - SnapshotContainer
+ *   - int[nbParents]: indexes into the archives above
+ *   - nbChilds times: int index, int length, path and '\0'
+ */
+
+typedef struct SnapshotHeader {
+  char magic[8];
+  int  version;
+  int  offSize;   // sizeof(off_t)
+  int  timeSize;  // sizeof(time_t)
+  int  nbParts;
+  int  nbArchives;
+  int  nbFirst;   // first archives, created before the extract parse
+  int  nbContainers;
+} SnapshotHeader;
+
+typedef struct SnapshotPart {
+  off_t  size;
+  time_t mtime;
+  char   md5[MAX_SIZE_MD5+1];
+} SnapshotPart;
+
+typedef struct SnapshotArchive {
+  off_t size;
+  char  hash[MAX_SIZE_MD5+1];
+} SnapshotArchive;
+
+typedef struct SnapshotContainer {
+  int type;
+  int nbParents;
+  int nbChilds;
+} SnapshotContainer;
+
+typedef struct SnapshotCursor {
+  char* ptr;
+  char* end;
+} SnapshotCursor;
+
+// archives to write, indexed by their ids
+typedef struct SnapshotTable {
+  Archive** archives;
+  int* index;     // archive id -> position into archives, -1 if not yet
+  int nbArchives;
+  int maxId;
+} SnapshotTable;
+
+/*=======================================================================
+ * Function   : getPartPath
+ * Description: Build the path of an extract part file
+ * Synopsis   : static char* getPartPath(Collection* coll, int nb)
+ * Input      : Collection* coll
+ *              int nb: part number (-1 for the NNN.txt file)
+ * Output     : the allocated path, 0 on error
+ =======================================================================*/
+static char*
+getPartPath(Collection* coll, int nb)
+{
+  char* rc = 0;
+  int l = 0;
+
+  l = strlen(coll->extractDB);
+  if (!(rc = createString(coll->extractDB))
+      || !(rc = catString(rc, "NNN.txt"))) goto error;
+  if (nb >= 0 && !sprintf(rc+l, "%03i.txt", nb)) {
+    rc = destroyString(rc);
+  }
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : signPart
+ * Description: Compute the signature of an extract part file
+ * Synopsis   : static int signPart(Collection* coll, int nb,
+ *                                  SnapshotPart* part, int doMd5)
+ * Input      : Collection* coll
+ *              int nb: part number
+ *              int doMd5: also compute the md5sum
+ * Output     : SnapshotPart* part: the signature
+ *              TRUE on success (FALSE if the part file is missing)
+ =======================================================================*/
+static int
+signPart(Collection* coll, int nb, SnapshotPart* part, int doMd5)
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  CheckData md5;
+  char* path = 0;
+
+  memset(part, 0, sizeof(SnapshotPart));
+  if (!(path = getPartPath(coll, nb))) goto error;
+  if (stat(path, &statBuffer)) goto error;
+  part->size = statBuffer.st_size;
+  part->mtime = statBuffer.st_mtime;
+
+  if (doMd5) {
+    memset(&md5, 0, sizeof(CheckData));
+    md5.path = path;
+    md5.size = part->size;
+    md5.opp = CHECK_CACHE_ID;
+    if (!doChecksum(&md5)) goto error;
+    strncpy(part->md5, md5.fullMd5sum, MAX_SIZE_MD5);
+  }
+
+  rc = TRUE;
+ error:
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : isWrittenChild
+ * Description: Filter the childs as serializeContainer does
+ * Synopsis   : static int isWrittenChild(Collection* coll, 
+ *                   Container* self, FromAsso* asso, int isFiltered)
+ * Input      : Collection* coll
+ *              Container* self: container providing the child
+ *              FromAsso* asso: the child
+ *              int isFiltered: filter the INC and IMG childs
+ * Output     : TRUE if the child is written
+ =======================================================================*/
+static int
+isWrittenChild(Collection* coll, Container* self, FromAsso* asso,
+	       int isFiltered)
+{
+  if (!isFiltered) return TRUE;
+  if (self->type == INC && !isIncoming(coll, asso->archive)) 
+    return FALSE;
+  if (self->type == IMG && arFromContainers(asso->archive)->nbItems > 0)
+    return FALSE;
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : indexArchive
+ * Description: Give a position into the snapshot to an archive
+ * Synopsis   : static int indexArchive(SnapshotTable* table, 
+ *                                      Archive* archive)
+ * Input      : SnapshotTable* table: positions given so far
+ *              Archive* archive: archive met
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+indexArchive(SnapshotTable* table, Archive* archive)
+{
+  if (archive->id < 0 || archive->id >= table->maxId) {
+    logCommon(LOG_ERR, "archive id out of range: %i", archive->id);
+    return FALSE;
+  }
+  if (table->index[archive->id] == -1) {
+    table->index[archive->id] = table->nbArchives;
+    table->archives[table->nbArchives++] = archive;
+  }
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : indexContainer
+ * Description: Index the archives of a container
+ * Synopsis   : static int indexContainer(Collection* coll, 
+ *                   SnapshotTable* table, Container* self, 
+ *                   int isFiltered)
+ * Input      : Collection* coll
+ *              SnapshotTable* table: positions given so far
+ *              Container* self: container to index
+ *              int isFiltered: filter the childs as serializeContainer
+ * Output     : TRUE on success
+ * Note       : archives are met in the same order as in the text
+ =======================================================================*/
+static int
+indexContainer(Collection* coll, SnapshotTable* table, Container* self,
+	       int isFiltered)
+{
+  FromAsso* asso = 0;
+  Archive* archive = 0;
+  AVLNode *node = 0;
+  RGIT* curr = 0;
+
+  if (self->type != INC && self->type != IMG) {
+    while ((archive = rgNext_r(self->parents, &curr))) {
+      if (!indexArchive(table, archive)) return FALSE;
+    }
+  }
+  for (node = self->childs->head; node; node = node->next) {
+    asso = node->item;
+    if (!isWrittenChild(coll, self, asso, isFiltered)) continue;
+    if (!indexArchive(table, asso->archive)) return FALSE;
+  }
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : cmpArchiveId
+ * Description: Sort the archives by ids (ie: creation order)
+ * Synopsis   : static int cmpArchiveId(const void *p1, const void *p2)
+ * Input      : p1 and p2 are pointers on Archive*
+ * Output     : p1 = p2 ? 0 : (p1 < p2 ? -1 : 1)
+ =======================================================================*/
+static int
+cmpArchiveId(const void *p1, const void *p2)
+{
+  Archive* v1 = *((Archive**)p1);
+  Archive* v2 = *((Archive**)p2);
+
+  return v1->id - v2->id;
+}
+
+/*=======================================================================
+ * Function   : indexArchives
+ * Description: Order the archives as the text parser meets them
+ * Synopsis   : static int indexArchives(Collection* coll, 
+ *                   SnapshotTable* table, int isFiltered, 
+ *                   time_t loadTime, int firstId, int* nbFirst)
+ * Input      : Collection* coll
+ *              int isFiltered: just after serializeExtractTree
+ *              time_t loadTime: not 0 just after the parse
+ *              int firstId: coll->maxId before the parse
+ * Output     : SnapshotTable* table: the archives, in order
+ *              int* nbFirst: archives created before the parse
+ *              TRUE on success
+ * Note       : just after serializeExtractTree, the text follows the
+ *              containers order. Just after the parse, the ids give
+ *              the order, but archives already known (ie: from the
+ *              catalog) were not created by the parser.
+ =======================================================================*/
+static int
+indexArchives(Collection* coll, SnapshotTable* table, int isFiltered,
+	      time_t loadTime, int firstId, int* nbFirst)
+{
+  int rc = FALSE;
+  ExtractTree* self = coll->extractTree;
+  AVLNode *node = 0;
+  int i = 0;
+
+  *nbFirst = 0;
+  table->maxId = coll->maxId;
+  if (table->maxId > 0) {
+    if (!(table->archives = malloc(table->maxId * sizeof(Archive*))) ||
+	!(table->index = malloc(table->maxId * sizeof(int)))) {
+      logCommon(LOG_ERR, "cannot malloc the archives table");
+      goto error;
+    }
+    for (i = 0; i < table->maxId; ++i) table->index[i] = -1;
+  }
+
+  // same order as serializeExtractTree
+  if (!indexContainer(coll, table, self->inc, isFiltered)) goto error;
+  if (!indexContainer(coll, table, self->img, isFiltered)) goto error;
+  for (node = self->containers->head; node; node = node->next) {
+    if (!indexContainer(coll, table, node->item, isFiltered)) 
+      goto error;
+  }
+
+  if (loadTime && table->nbArchives > 0) {
+    qsort(table->archives, table->nbArchives, sizeof(Archive*), 
+	  cmpArchiveId);
+    for (i = 0; i < table->nbArchives; ++i) {
+      table->index[table->archives[i]->id] = i;
+      if (table->archives[i]->id < firstId) ++*nbFirst;
+    }
+  }
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : writeArchive
+ * Description: Write an archive
+ * Synopsis   : static int writeArchive(FILE* fd, Archive* archive)
+ * Input      : FILE* fd: snapshot file
+ *              Archive* archive: archive to write
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+writeArchive(FILE* fd, Archive* archive)
+{
+  SnapshotArchive item;
+
+  memset(&item, 0, sizeof(SnapshotArchive));
+  strncpy(item.hash, archive->hash, MAX_SIZE_MD5);
+  item.size = archive->size;
+  return (fwrite(&item, sizeof(SnapshotArchive), 1, fd) == 1);
+}
+
+/*=======================================================================
+ * Function   : writeContainer
+ * Description: Write a container
+ * Synopsis   : static int writeContainer(Collection* coll, FILE* fd, 
+ *                   SnapshotTable* table, Container* self, 
+ *                   int isFiltered, int* nbContainers)
+ * Input      : Collection* coll
+ *              FILE* fd: snapshot file
+ *              SnapshotTable* table: archives positions
+ *              Container* self: container to write
+ *              int isFiltered: filter the childs as serializeContainer
+ * Output     : int* nbContainers: incremented if written
+ *              TRUE on success
+ =======================================================================*/
+static int
+writeContainer(Collection* coll, FILE* fd, SnapshotTable* table,
+	       Container* self, int isFiltered, int* nbContainers)
+{
+  int rc = FALSE;
+  SnapshotContainer item;
+  FromAsso* asso = 0;
+  Archive* archive = 0;
+  AVLNode *node = 0;
+  RGIT* curr = 0;
+  int length = 0;
+  int pass = 0;
+
+  memset(&item, 0, sizeof(SnapshotContainer));
+  item.type = self->type;
+  if (self->type != INC && self->type != IMG) {
+    item.nbParents = self->parents->nbItems;
+  }
+
+  // first pass count the childs, second one write them
+  for (pass = 0; pass < 2; ++pass) {
+    for (node = self->childs->head; node; node = node->next) {
+      asso = node->item;
+      if (!isWrittenChild(coll, self, asso, isFiltered)) continue;
+
+      if (pass == 0) {
+	++item.nbChilds;
+	continue;
+      }
+      length = strlen(asso->path);
+      if (fwrite(table->index + asso->archive->id, sizeof(int), 1, fd) 
+	  != 1) goto error;
+      if (fwrite(&length, sizeof(int), 1, fd) != 1) goto error;
+      if (fwrite(asso->path, length+1, 1, fd) != 1) goto error;
+    }
+    if (pass > 0) break;
+
+    // INC and IMG may have nothing to provide
+    if (item.nbChilds == 0 && item.nbParents == 0) goto end;
+
+    if (fwrite(&item, sizeof(SnapshotContainer), 1, fd) != 1) goto error;
+    while ((archive = rgNext_r(self->parents, &curr))) {
+      if (fwrite(table->index + archive->id, sizeof(int), 1, fd) != 1) 
+	goto error;
+    }
+  }
+  ++*nbContainers;
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "fwrite fails: %s", strerror(errno));
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : saveExtractSnapshot
+ * Description: Write the extract tree into a binary snapshot
+ * Synopsis   : int saveExtractSnapshot(Collection* coll, int isFiltered,
+ *                                      time_t loadTime, int firstId)
+ * Input      : Collection* coll
+ *              int isFiltered: TRUE just after serializeExtractTree,
+ *                so as to filter the INC and IMG childs the same way
+ *              time_t loadTime: when the part files were parsed (part
+ *                files modified since are not trusted), 0 if saved
+ *              int firstId: coll->maxId before the parse (if parsed)
+ * Output     : TRUE on success
+ * Note       : the snapshot is written aside and then renamed.
+ *              Only the server writes it (cf env.noSnapshot): clients
+ *              and cgi only read it.
+ =======================================================================*/
+int
+saveExtractSnapshot(Collection* coll, int isFiltered, time_t loadTime,
+		    int firstId)
+{
+  int rc = FALSE;
+  ExtractTree* self = 0;
+  SnapshotHeader header;
+  SnapshotPart* parts = 0;
+  SnapshotTable table;
+  AVLNode *node = 0;
+  FILE* fd = 0;
+  char* path = 0;
+  char buf[32];
+  int i = 0;
+
+  checkCollection(coll);
+  if (!(self = coll->extractTree)) goto error;
+  logCommon(LOG_DEBUG, "save %s extract snapshot", coll->label);
+
+  memset(&table, 0, sizeof(SnapshotTable));
+  memset(&header, 0, sizeof(SnapshotHeader));
+  memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+  header.version = SNAPSHOT_VERSION;
+  header.offSize = sizeof(off_t);
+  header.timeSize = sizeof(time_t);
+
+  // sign the part files
+  if (!(path = getPartPath(coll, -1))) goto error;
+  if (access(path, F_OK) == 0) {
+    logCommon(LOG_INFO, "do not snapshot while %s is there", path);
+    goto end;
+  }
+  while (header.nbParts < 1000) {
+    path = destroyString(path);
+    if (!(path = getPartPath(coll, header.nbParts))) goto error;
+    if (access(path, F_OK)) break;
+    ++header.nbParts;
+  }
+  if (header.nbParts == 0) goto end;
+  if (!(parts = malloc(header.nbParts * sizeof(SnapshotPart)))) {
+    logCommon(LOG_ERR, "cannot malloc part signatures");
+    goto error;
+  }
+  for (i = 0; i < header.nbParts; ++i) {
+    if (!signPart(coll, i, parts+i, TRUE)) goto error;
+    if (loadTime && parts[i].mtime >= loadTime) {
+      logCommon(LOG_INFO, "do not snapshot as extract files changed");
+      goto end;
+    }
+  }
+
+  // archives
+  if (!indexArchives(coll, &table, isFiltered, loadTime, firstId,
+		     &header.nbFirst)) goto error;
+  header.nbArchives = table.nbArchives;
+
+  // output file
+  path = destroyString(path);
+  sprintf(buf, ".%i", (int)getpid());
+  if (!(path = createString(coll->snapshotDB))
+      || !(path = catString(path, buf))) goto error;
+  if (!(fd = fopen(path, "w"))) {
+    logCommon(LOG_WARNING, "cannot write %s: %s", path, strerror(errno));
+    goto error;
+  }
+  if (fwrite(&header, sizeof(SnapshotHeader), 1, fd) != 1) goto error2;
+  if (fwrite(parts, sizeof(SnapshotPart), header.nbParts, fd) 
+      != header.nbParts) goto error2;
+  for (i = 0; i < table.nbArchives; ++i) {
+    if (!writeArchive(fd, table.archives[i])) goto error2;
+  }
+
+  // same order as serializeExtractTree
+  if (!writeContainer(coll, fd, &table, self->inc, isFiltered, 
+		      &header.nbContainers)) goto error3;
+  if (!writeContainer(coll, fd, &table, self->img, isFiltered, 
+		      &header.nbContainers)) goto error3;
+  for (node = self->containers->head; node; node = node->next) {
+    if (!writeContainer(coll, fd, &table, node->item, isFiltered,
+			&header.nbContainers)) goto error3;
+  }
+
+  if (fseek(fd, 0, SEEK_SET)) goto error2;
+  if (fwrite(&header, sizeof(SnapshotHeader), 1, fd) != 1) goto error2;
+  if (fclose(fd)) {
+    fd = 0;
+    goto error2;
+  }
+  fd = 0;
+  if (rename(path, coll->snapshotDB) == -1) {
+    logCommon(LOG_ERR, "rename %s fails: %s", path, strerror(errno));
+    goto error3;
+  }
+  logCommon(LOG_INFO, "extract snapshot written: %s", coll->snapshotDB);
+
+ end:
+  rc = TRUE;
+ error2:
+  if (!rc) {
+    logCommon(LOG_ERR, "write fails: %s", strerror(errno));
+  }
+ error3:
+  if (fd) fclose(fd);
+  if (!rc && path && unlink(path) == -1 && errno != ENOENT) {
+    logCommon(LOG_ERR, "unlink fails: %s", strerror(errno));
+  }
+ error:
+  if (!rc) {
+    logCommon(LOG_WARNING, "saveExtractSnapshot fails");
+  }
+  if (parts) free(parts);
+  if (table.archives) free(table.archives);
+  if (table.index) free(table.index);
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : readItem
+ * Description: Read from the mapped snapshot
+ * Synopsis   : static int readItem(SnapshotCursor* cursor, void* item,
+ *                                  size_t size)
+ * Input      : SnapshotCursor* cursor: where to read
+ *              size_t size: size to read
+ * Output     : void* item: where to copy (not aligned on the map)
+ *              FALSE if the snapshot is truncated
+ =======================================================================*/
+static int
+readItem(SnapshotCursor* cursor, void* item, size_t size)
+{
+  if (cursor->end - cursor->ptr < size) return FALSE;
+  memcpy(item, cursor->ptr, size);
+  cursor->ptr += size;
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : readArchives
+ * Description: Check or load the archives from the snapshot
+ * Synopsis   : static int readArchives(SnapshotCursor* cursor, 
+ *                   SnapshotHeader* header, Collection* coll, 
+ *                   Archive** archives)
+ * Input      : SnapshotCursor* cursor: where to read
+ *              SnapshotHeader* header: number of archives
+ *              Collection* coll
+ *              Archive** archives: where to load (0 to only check)
+ * Output     : FALSE if the snapshot cannot be used
+ * Note       : the first archives must already be there (ie: the
+ *              catalog is loaded), else the text parser would give
+ *              them other ids
+ =======================================================================*/
+static int
+readArchives(SnapshotCursor* cursor, SnapshotHeader* header,
+	     Collection* coll, Archive** archives)
+{
+  SnapshotArchive item;
+  int i = 0;
+
+  for (i = 0; i < header->nbArchives; ++i) {
+    if (!readItem(cursor, &item, sizeof(SnapshotArchive))) return FALSE;
+    item.hash[MAX_SIZE_MD5] = 0;
+    if (!archives) {
+      if (i < header->nbFirst && !getArchive(coll, item.hash, item.size))
+	return FALSE;
+      continue;
+    }
+    if (!(archives[i] = addArchive(coll, item.hash, item.size)))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : readIndex
+ * Description: Read an archive position
+ * Synopsis   : static int readIndex(SnapshotCursor* cursor, 
+ *                   int nbArchives, Archive** archives, 
+ *                   Archive** archive)
+ * Input      : SnapshotCursor* cursor: where to read
+ *              int nbArchives: size of the archives table
+ *              Archive** archives: the archives table (0 to check)
+ * Output     : Archive** archive: the archive (if archives provided)
+ *              TRUE on success
+ =======================================================================*/
+static int
+readIndex(SnapshotCursor* cursor, int nbArchives, Archive** archives,
+	  Archive** archive)
+{
+  int index = 0;
+
+  if (!readItem(cursor, &index, sizeof(int))) return FALSE;
+  if (index < 0 || index >= nbArchives) return FALSE;
+  if (archives) *archive = archives[index];
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : readPath
+ * Description: Read an extraction path
+ * Synopsis   : static int readPath(SnapshotCursor* cursor, char** path)
+ * Input      : SnapshotCursor* cursor: where to read
+ * Output     : char** path: the path (into the map)
+ *              TRUE on success
+ =======================================================================*/
+static int
+readPath(SnapshotCursor* cursor, char** path)
+{
+  int length = 0;
+
+  if (!readItem(cursor, &length, sizeof(int))) return FALSE;
+  if (length < 0 || length > MAX_SIZE_STRING) return FALSE;
+  if (cursor->end - cursor->ptr < length+1) return FALSE;
+  if (cursor->ptr[length] != 0) return FALSE;
+  *path = cursor->ptr;
+  cursor->ptr += length+1;
+  return TRUE;
+}
+
+/*=======================================================================
+ * Function   : readContainers
+ * Description: Check or load the containers from the snapshot
+ * Synopsis   : static int readContainers(SnapshotCursor* cursor, 
+ *                   SnapshotHeader* header, Collection* coll,
+ *                   Archive** archives)
+ * Input      : SnapshotCursor* cursor: where to read
+ *              SnapshotHeader* header: number of items to read
+ *              Collection* coll: where to load
+ *              Archive** archives: archives loaded (0 to only check)
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+readContainers(SnapshotCursor* cursor, SnapshotHeader* header,
+	       Collection* coll, Archive** archives)
+{
+  int rc = FALSE;
+  SnapshotContainer item;
+  Container* container = 0;
+  Archive* archive = 0;
+  char* path = 0;
+  int n = header->nbArchives;
+  int i = 0;
+  int j = 0;
+
+  for (i = 0; i < header->nbContainers; ++i) {
+    if (!readItem(cursor, &item, sizeof(SnapshotContainer))) goto error;
+    if (item.type <= UNDEF || item.type >= ETYPE_MAX) goto error;
+    if (item.nbParents < 0 || item.nbChilds < 0) goto error;
+    if ((item.type == INC || item.type == IMG) != (item.nbParents == 0))
+      goto error;
+
+    // container and its parents
+    for (j = 0; j < item.nbParents; ++j) {
+      if (!readIndex(cursor, n, archives, &archive)) goto error;
+      if (!archives) continue;
+      if (j == 0) {
+	if (!(container = addContainer(coll, item.type, archive))) 
+	  goto error;
+      }
+      else {
+	if (!addFromArchive(coll, container, archive)) goto error;
+      }
+    }
+    if (archives && item.type == INC) container = coll->extractTree->inc;
+    if (archives && item.type == IMG) container = coll->extractTree->img;
+
+    // childs
+    for (j = 0; j < item.nbChilds; ++j) {
+      if (!readIndex(cursor, n, archives, &archive)) goto error;
+      if (!readPath(cursor, &path)) goto error;
+      if (!archives) continue;
+      if (!addFromAsso(coll, archive, container, path)) goto error;
+    }
+  }
+  if (cursor->ptr != cursor->end) goto error;
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : refreshPart
+ * Description: Store the new mtime of a part file having the same md5
+ * Synopsis   : static void refreshPart(int fd, int nb, 
+ *                                      SnapshotPart* part)
+ * Input      : int fd: the snapshot file (opened for writing)
+ *              int nb: part number
+ *              SnapshotPart* part: the new signature
+ * Output     : N/A
+ * Note       : so as the next loads do not compute the md5sum again
+ =======================================================================*/
+static void
+refreshPart(int fd, int nb, SnapshotPart* part)
+{
+  off_t offset = sizeof(SnapshotHeader) + nb * sizeof(SnapshotPart);
+
+  logCommon(LOG_INFO, "refresh the signature of part file %03i", nb);
+  if (pwrite(fd, part, sizeof(SnapshotPart), offset) 
+      != sizeof(SnapshotPart)) {
+    logCommon(LOG_WARNING, "pwrite fails: %s", strerror(errno));
+  }
+}
+
+/*=======================================================================
+ * Function   : loadExtractSnapshot
+ * Description: Load the extract tree from the binary snapshot
+ * Synopsis   : int loadExtractSnapshot(Collection* coll, int* isLoaded,
+ *                                      int* nbParts)
+ * Input      : Collection* coll
+ * Output     : int* isLoaded: FALSE if the snapshot is missing or does
+ *                             not match the part files
+ *              int* nbParts: number of part files it replaces
+ *              TRUE on success
+ * Note       : part files are checked using their size and mtime, or
+ *              their md5sum when the mtime changes (ie: git checkout),
+ *              in which case the new mtime is stored
+ =======================================================================*/
+int
+loadExtractSnapshot(Collection* coll, int* isLoaded, int* nbParts)
+{
+  int rc = FALSE;
+  SnapshotHeader header;
+  SnapshotPart part;
+  SnapshotPart current;
+  SnapshotCursor cursor;
+  struct stat statBuffer;
+  Archive** archives = 0;
+  char* archivesPtr = 0;
+  void* map = MAP_FAILED;
+  char* path = 0;
+  int isWritable = FALSE;
+  int fd = -1;
+  int i = 0;
+
+  checkCollection(coll);
+  *isLoaded = FALSE;
+  *nbParts = 0;
+
+  if (access(coll->snapshotDB, R_OK)) goto end;
+  logCommon(LOG_DEBUG, "check %s extract snapshot", coll->label);
+
+  // a pending addon is never snapshoted
+  if (!(path = getPartPath(coll, -1))) goto error;
+  if (access(path, F_OK) == 0) goto end;
+
+  // writable so as to refresh the mtimes (only by the server)
+  if (!env.dryRun && !env.noSnapshot &&
+      (fd = open(coll->snapshotDB, O_RDWR)) != -1) {
+    isWritable = TRUE;
+  }
+  else if ((fd = open(coll->snapshotDB, O_RDONLY)) == -1) {
+    logCommon(LOG_ERR, "open %s fails: %s", 
+	      coll->snapshotDB, strerror(errno));
+    goto error;
+  }
+  if (fstat(fd, &statBuffer)) {
+    logCommon(LOG_ERR, "fstat fails: %s", strerror(errno));
+    goto error;
+  }
+  if (statBuffer.st_size < sizeof(SnapshotHeader)) goto outdated;
+  if ((map = mmap(0, statBuffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+      == MAP_FAILED) {
+    logCommon(LOG_ERR, "mmap fails: %s", strerror(errno));
+    goto error;
+  }
+  cursor.ptr = map;
+  cursor.end = cursor.ptr + statBuffer.st_size;
+
+  // header
+  if (!readItem(&cursor, &header, sizeof(SnapshotHeader))) goto outdated;
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) ||
+      header.version != SNAPSHOT_VERSION ||
+      header.offSize != sizeof(off_t) ||
+      header.timeSize != sizeof(time_t) ||
+      header.nbParts < 1 || header.nbParts > 999 ||
+      header.nbArchives < 0 || header.nbFirst < 0 ||
+      header.nbFirst > header.nbArchives ||
+      header.nbContainers < 0) goto outdated;
+
+  // part files
+  for (i = 0; i < header.nbParts; ++i) {
+    if (!readItem(&cursor, &part, sizeof(SnapshotPart))) goto outdated;
+    part.md5[MAX_SIZE_MD5] = 0;
+    if (!signPart(coll, i, &current, FALSE)) goto outdated;
+    if (current.size != part.size) goto outdated;
+    if (current.mtime == part.mtime) continue;
+    if (!signPart(coll, i, &current, TRUE)) goto outdated;
+    if (strncmp(current.md5, part.md5, MAX_SIZE_MD5)) goto outdated;
+    if (isWritable) refreshPart(fd, i, &current);
+  }
+  path = destroyString(path);
+  if (!(path = getPartPath(coll, header.nbParts))) goto error;
+  if (access(path, F_OK) == 0) goto outdated;
+
+  // check all the items first, so as to still use the part files
+  archivesPtr = cursor.ptr;
+  if (!readArchives(&cursor, &header, coll, 0)) {
+    logCommon(LOG_INFO, "archives already known have changed");
+    goto outdated;
+  }
+  if (!readContainers(&cursor, &header, coll, 0)) {
+    logCommon(LOG_WARNING, "corrupted snapshot: %s", coll->snapshotDB);
+    goto outdated;
+  }
+
+  logCommon(LOG_INFO, "load %s extraction data from %s", 
+	    coll->label, coll->snapshotDB);
+  if (header.nbArchives > 0 &&
+      !(archives = malloc(header.nbArchives * sizeof(Archive*)))) {
+    logCommon(LOG_ERR, "cannot malloc the archives table");
+    goto error;
+  }
+  cursor.ptr = archivesPtr;
+  if (!readArchives(&cursor, &header, coll, archives) ||
+      !readContainers(&cursor, &header, coll, archives)) {
+    logCommon(LOG_ERR, "please remove %s", coll->snapshotDB);
+    goto error;
+  }
+
+  *isLoaded = TRUE;
+  *nbParts = header.nbParts;
+  goto end;
+ outdated:
+  logCommon(LOG_INFO, "outdated snapshot: %s", coll->snapshotDB);
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logCommon(LOG_ERR, "loadExtractSnapshot fails");
+  }
+  if (map != MAP_FAILED && munmap(map, statBuffer.st_size)) {
+    logCommon(LOG_ERR, "munmap fails: %s", strerror(errno));
+  }
+  if (fd != -1) close(fd);
+  if (archives) free(archives);
+  path = destroyString(path);
+  return rc;
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
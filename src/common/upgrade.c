@@ -28,16 +28,18 @@
 /*=======================================================================
  * Function   : doCheckSupport 
  * Description: Do checksums on an available support
- * Synopsis   : int soCheckSupport(Support *supp, char* path)
+ * Synopsis   : int doCheckSupport(Support *supp, char* path, 
+ *                                  off_t rate)
  * Input      : Support *supp = the support object
  *              char* path = the device that host the support
+ *              off_t rate = disk bandwidth in b.s-1 (0: no limit)
  * Output     : TRUE on success
  *
  * Note       : supp->lastCheck: (O will force check)
  *              also call by supp module
  =======================================================================*/
 int 
-doCheckSupport(Support *supp, char* path)
+doCheckSupport(Support *supp, char* path, off_t rate)
 {
   int rc = FALSE;
   Configuration* conf = 0;
@@ -61,6 +63,7 @@ doCheckSupport(Support *supp, char* path)
  
   // by default do not exists: full computation (no check)
   data.opp = CHECK_SUPP_ADD;
+  data.rate = rate;
 
   // check if support need to be full checked or not
   if (supp->lastCheck > 0) {
@@ -203,15 +206,15 @@ scoreSupport(Support* supp, ScoreParam *p)
   // static score for support file
   if (isSupportFile(supp)) {
 
-    // check support file before they become obsolete
-    if (laps > ttl/2) {
-      if (!doCheckSupport(supp, supp->name)) {
-	logMain(LOG_WARNING, "\"%s\" support file seems lost", supp->name);
-	// score = 0: fails to check support file on disk
-	goto end;
-      }
+    // support files are checked in background by the daemon
+    // (cf server/checkSupp.c), so we use the last known result
+    if (laps > ttl) {
+      logCommon(LOG_WARNING, "\"%s\" support file not checked since %d days",
+		supp->name, laps/(60*60*24));
+      // score = 0: support file may be lost
+      goto end;
     }
-      
+
     supp->score = p->fileScore;
     logCommon(LOG_INFO, "file: = %.2f", supp->score);
     goto end;
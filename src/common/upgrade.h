@@ -26,7 +26,7 @@
 
 #include "mediatex-types.h"
 
-int doCheckSupport(Support *supp, char* path);
+int doCheckSupport(Support *supp, char* path, off_t rate);
 int scoreSupport(Support* supp, ScoreParam *p);
 int scoreLocalImages(Collection* coll);
 int upgradeCollection(Collection* collection);
@@ -23,8 +23,22 @@
 
 #include "mediatex-config.h"
 #include <regex.h>
+#include <sys/un.h>
+#include <poll.h>
+#include "client/searchIndex.h"
 
 static char* confLabel = 0;
+static char* workerLabel = 0; // only set by the persistent worker
+
+// CGI variables forwarded to the persistent worker
+static char* cgiVariables[] = {
+  "REQUEST_METHOD",
+  "QUERY_STRING",
+  "SCRIPT_FILENAME",
+  "CONTENT_TYPE",
+  "CONTENT_LENGTH",
+  0
+};
 
 
 /*=======================================================================
@@ -90,22 +104,13 @@ int sendTemplate(Collection* coll, char* filename)
 int queryServer(Server* server, RecordTree* tree, char* reply)
 {
   int rc = FALSE;
-  int socket = -1;
-  int n = 0;
   
   logMain(LOG_DEBUG, "queryServer");
   reply[0] = 0;
 
-  // connect server and write query
-  if ((socket = connectServer(server)) == -1) goto error;
-  if (!upgradeServer(socket, tree, 0)) goto error;
-
-  // read reply
+  // connect server, write query and read reply
+  if (!exchangeServer(server, tree, 0, reply, 255)) goto error;
   if (env.dryRun) goto end;
-  n = tcpRead(socket, reply, 255);
-  // erase the \n send by server
-  if (n<=0) n = 1;
-  reply[n-1] = (char)0; 
 
   logMain(LOG_INFO, "receive: %s", reply);
  end:
@@ -114,7 +119,6 @@ int queryServer(Server* server, RecordTree* tree, char* reply)
   if (!rc) {
     logMain(LOG_ERR, "queryServer fails");
   }
-  if (!env.dryRun && socket != -1) close(socket);
   return rc;
 }
 
@@ -438,6 +442,120 @@ RecordTree* scanCgiQuery(Collection* coll)
 }
 
 
+/*=======================================================================
+ * Function   : isSearchQuery
+ * Description: Tell if the CGI query is a full-text search
+ * Synopsis   : static int isSearchQuery()
+ * Input      : N/A
+ * Output     : TRUE for a ?q=WORDS get query
+ =======================================================================*/
+static int
+isSearchQuery()
+{
+  char* method = getenv("REQUEST_METHOD");
+  char* query = getenv("QUERY_STRING");
+
+  return (method && !strcmp(method, "GET") &&
+	  query && !strncmp(query, "q=", 2));
+}
+
+
+/*=======================================================================
+ * Function   : sendText
+ * Description: Send a text, escaping the HTML special characters
+ * Synopsis   : static void sendText(char* text)
+ * Input      : char* text: provided by the user or by the catalog
+ * Output     : N/A
+ =======================================================================*/
+static void
+sendText(char* text)
+{
+  for (; *text; ++text) {
+    switch (*text) {
+    case '<': fputs("&lt;", stdout); break;
+    case '>': fputs("&gt;", stdout); break;
+    case '&': fputs("&amp;", stdout); break;
+    case '"': fputs("&quot;", stdout); break;
+    default: fputc(*text, stdout);
+    }
+  }
+}
+
+
+/*=======================================================================
+ * Function   : searchCatalog
+ * Description: Answer a full-text search query
+ * Synopsis   : int searchCatalog(Collection* coll)
+ * Input      : Collection* coll
+ * Output     : TRUE on success
+ * Note       : the catalog is not loaded, only the search index
+ *              written by mdtx make (cf saveSearchIndex)
+ =======================================================================*/
+int searchCatalog(Collection* coll)
+{
+  int rc = FALSE;
+  SearchIndex* index = 0;
+  SearchHit hits[MAX_SEARCH_HITS];
+  char **cgivars = (char**)0;
+  char* type = 0;
+  int n = 0;
+  int i = 0;
+
+  logMain(LOG_DEBUG, "searchCatalog");
+
+  if ((cgivars = getcgivars()) == (char**)0) goto error;
+  if (cgivars[0] == 0 || strcmp(cgivars[0], "q") || cgivars[1] == 0) {
+    logMain(LOG_ERR, "bad usage: please use ?q=<words> syntax");
+    goto error;
+  }
+
+  if (!(index = openSearchIndex(coll))) goto error;
+  if ((n = querySearchIndex(index, cgivars[1], hits, MAX_SEARCH_HITS))
+      == -1) goto error;
+  logMain(LOG_INFO, "search %s: %i hits", cgivars[1], n);
+
+  fprintf(stdout, "Content-Type: text/html; charset=utf-8\r\n");
+  fprintf(stdout, "\r\n");
+  sendTemplate(coll, "cgiHeader.shtml");
+
+  fprintf(stdout, "<FORM method=get action=\"get.cgi\">\r\n");
+  fprintf(stdout, "<INPUT type=text name=q value=\"");
+  sendText(cgivars[1]);
+  fprintf(stdout, "\">\n");
+  fprintf(stdout, "<INPUT type=submit value=search>\n");
+  fprintf(stdout, "</FORM>\n");
+
+  if (n == 0) {
+    fprintf(stdout, "<br>Sorry, nothing match.\r\n<br>");
+  }
+  else {
+    fprintf(stdout, "<UL>\n");
+    for (i = 0; i < n; ++i) {
+      switch (hits[i].type) {
+      case DOC: type = "Document"; break;
+      case HUM: type = "Human"; break;
+      default: type = "Category";
+      }
+      fprintf(stdout, "<LI>%s: <A HREF=\"../index/%s\">", 
+	      type, hits[i].url);
+      sendText(hits[i].label);
+      fprintf(stdout, "</A></LI>\n");
+    }
+    fprintf(stdout, "</UL>\n");
+  }
+
+  sendTemplate(coll, "footer.html");
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "searchCatalog fails");
+  }
+  index = closeSearchIndex(index);
+  freecgivars(cgivars);
+  return rc;
+}
+
+
 /*=======================================================================
  * Function   : getIndexLabel
  * Description: Extract index's label from environement
@@ -548,7 +666,10 @@ static void usageHtml(Collection* coll, char* programName)
 	  "<h5><i>url?hash=HASH&size=SIZE<br>"
 	  "\twhere:\r\n<br>"
 	  "\t\tHASH   : the md5sum of the requested file\r\n<br>"
-	  "\t\tSIZE   : the size of the requested file\r\n<br></h5></i>");
+	  "\t\tSIZE   : the size of the requested file\r\n<br>"
+	  "url?q=WORDS<br>"
+	  "\twhere:\r\n<br>"
+	  "\t\tWORDS  : words to search into the catalog\r\n<br></h5></i>");
   
   sendTemplate(coll, "footer.html");
   return;
@@ -600,7 +721,10 @@ usage(char* programName)
 	  "draft and on the `NF Z 42-013' requirements.\n");
 
   mdtxUsage(programName);
+  fprintf(stderr, " [ -W ]");
+
   mdtxOptions();
+  fprintf(stderr, "  -W, --worker\t\trun as a persistent cgi worker\n");
 
   fprintf(stderr, "\nEnvironment:\n"
 	  "This program should be served by Apache "
@@ -611,6 +735,11 @@ usage(char* programName)
 	  " QUERY_STRING=\"hash=HASH&size=SIZE\""
 	  " SCRIPT_FILENAME=/MDTX-COLL/public_html/cgi/get.cgi"
 	  " cgi [OPTIONS]\n"
+	  "  search catalog:   (get query)\n"
+	  "REQUEST_METHOD=GET"
+	  " QUERY_STRING=\"q=WORDS\""
+	  " SCRIPT_FILENAME=/MDTX-COLL/public_html/cgi/get.cgi"
+	  " cgi [OPTIONS]\n"
 	  "  provide email:    (put query)\n"
 	  "echo \"hash=HASH&size=SIZE&mail=MAIL\" |"
 	  " REQUEST_METHOD=POST"
@@ -639,6 +768,556 @@ usage(char* programName)
 }
 
 
+/*=======================================================================
+ * Function   : serveRequest
+ * Description: Answer a CGI query
+ * Synopsis   : static int serveRequest(char* programName, char* label)
+ * Input      : char* programName: the name of the program
+ *              char* label: collection matched from SCRIPT_FILENAME
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+serveRequest(char* programName, char* label)
+{
+  int rc = FALSE;
+  Collection* coll = 0;
+  RecordTree* tree = 0;
+  Record* record = 0;
+
+  logMain(LOG_DEBUG, "%s-cgi lunched from %s collection",
+	  env.confLabel, label);
+
+  // load configuration (goto error as htmlError need a coll)
+  // (nothing to parse if the persistent worker already did it)
+  if (!(coll = mdtxGetCollection(label))) goto error;
+
+  // full-text search into the catalog
+  if (isSearchQuery()) {
+    if (!searchCatalog(coll)) goto htmlError;
+    rc = TRUE;
+    goto error;
+  }
+
+  // build record query from query parameters
+  if ((tree = scanCgiQuery(coll)) == 0) goto htmlError;
+  if (!(record = (Record*)tree->records->head->item)) goto htmlError;
+
+  // relay query to daemon(s)
+  if (isEmptyString(record->extra) || record->extra[0]=='!') {
+    // first call: ask if servers have the record in cache
+    if (!loadCollection(coll, SERV)) goto error;
+    if (!mdtxFind(tree)) goto iamAloneHtmlError;
+    if (!releaseCollection(coll, SERV)) goto error;
+  }
+  else {
+    // second call: ask local server remind the provided mail
+    if (!mdtxRegister(tree)) goto iamAloneHtmlError;
+  }
+
+  rc = TRUE;
+ iamAloneHtmlError:
+  if (!rc) iamAloneHtml(coll, programName);
+  goto error;
+ htmlError:
+  if (!rc) usageHtml(coll, programName);
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "serveRequest fails");
+  }
+  destroyRecordTree(tree);
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : restoreStdin
+ * Description: Give back the POST body to the one-shot processing
+ * Synopsis   : static int restoreStdin(FILE* body)
+ * Input      : FILE* body: copy of the POST body already read
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+restoreStdin(FILE* body)
+{
+  int rc = FALSE;
+
+  logMain(LOG_DEBUG, "restoreStdin");
+
+  if (fflush(body) || dup2(fileno(body), STDIN_FILENO) == -1) {
+    logMain(LOG_ERR, "dup2: %s", strerror(errno));
+    goto error;
+  }
+  clearerr(stdin);
+  rewind(stdin);
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "restoreStdin fails");
+  }
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : forwardRequest
+ * Description: Relay the CGI query to the persistent worker if any
+ * Synopsis   : static int forwardRequest(int* isDone)
+ * Input      : N/A
+ * Output     : int* isDone: TRUE if the worker answered the query
+ *              TRUE on success
+ * Note       : protocol: "NAME=VALUE\0" CGI variables, an empty "\0"
+ *              record, then the POST body. The worker answers the
+ *              CGI response and closes the socket.
+ *              If the worker does not start to answer within
+ *              CGI_WORKER_TIMEOUT (or fails), we serve the query
+ *              ourself: the POST body is kept for that.
+ *              Writes are not bounded, as the header and the form
+ *              fit into the socket buffer.
+ =======================================================================*/
+static int
+forwardRequest(int* isDone)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  struct sockaddr_un address;
+  struct pollfd pollFd;
+  int sock = -1;
+  FILE* body = 0;
+  char buffer[256];
+  char* value = 0;
+  long long int length = 0;
+  ssize_t n = 0;
+  int isRelayed = FALSE;
+  int i = 0;
+
+  logMain(LOG_DEBUG, "forwardRequest");
+  *isDone = FALSE;
+
+  if (!(conf = getConfiguration())) goto error;
+  if (strlen(conf->cgiSocket) >= sizeof(address.sun_path)) goto end;
+  memset(&address, 0, sizeof(struct sockaddr_un));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, conf->cgiSocket);
+
+  if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+    logMain(LOG_ERR, "socket: %s", strerror(errno));
+    goto error;
+  }
+
+  // not an error: fallback on the one-shot processing
+  if (connect(sock, (struct sockaddr*)&address,
+	      sizeof(struct sockaddr_un))) {
+    logMain(LOG_DEBUG, "no cgi worker on %s: %s",
+	    conf->cgiSocket, strerror(errno));
+    goto end;
+  }
+  logMain(LOG_INFO, "forward query to the cgi worker");
+
+  if (!(body = tmpfile())) {
+    logMain(LOG_ERR, "tmpfile: %s", strerror(errno));
+    goto error;
+  }
+
+  // send CGI variables
+  for (i=0; cgiVariables[i]; ++i) {
+    if (!(value = getenv(cgiVariables[i]))) continue;
+    if (!tcpWrite(sock, cgiVariables[i], strlen(cgiVariables[i])) ||
+	!tcpWrite(sock, "=", 1) ||
+	!tcpWrite(sock, value, strlen(value)+1)) goto fallback;
+  }
+  if (!tcpWrite(sock, "", 1)) goto fallback;
+
+  // send POST body (and keep a copy)
+  if ((value = getenv("CONTENT_LENGTH"))) {
+    if (sscanf(value, "%lli", &length) != 1) length = 0;
+  }
+  while (length > 0 &&
+	 (n = fread(buffer, 1, length < 256 ? length : 256, stdin)) > 0) {
+    if (fwrite(buffer, 1, n, body) != (size_t)n) {
+      logMain(LOG_ERR, "fwrite: %s", strerror(errno));
+      goto error;
+    }
+    length -= n;
+    if (!tcpWrite(sock, buffer, n)) goto fallback;
+  }
+  if (shutdown(sock, SHUT_WR)) {
+    logMain(LOG_WARNING, "shutdown: %s", strerror(errno));
+    goto fallback;
+  }
+
+  // relay the CGI response
+  while (TRUE) {
+    pollFd.fd = sock;
+    pollFd.events = POLLIN;
+    if ((n = poll(&pollFd, 1, CGI_WORKER_TIMEOUT)) == -1) {
+      if (errno == EINTR) continue;
+      logMain(LOG_ERR, "poll: %s", strerror(errno));
+      goto fallback;
+    }
+    if (n == 0) {
+      logMain(LOG_WARNING, "cgi worker do not answer");
+      goto fallback;
+    }
+    if ((n = recv(sock, buffer, 256, 0)) == -1) {
+      if (errno == EINTR) continue;
+      logMain(LOG_ERR, "recv: %s", strerror(errno));
+      goto fallback;
+    }
+    if (n == 0) break;
+    fwrite(buffer, 1, n, stdout);
+    isRelayed = TRUE;
+  }
+  if (!isRelayed) {
+    logMain(LOG_WARNING, "cgi worker gives no answer");
+    goto fallback;
+  }
+
+  *isDone = TRUE;
+  goto end;
+ fallback:
+  // too late if the worker has started to answer
+  if (isRelayed) goto error;
+  logMain(LOG_NOTICE, "serve the query without the cgi worker");
+  if (!restoreStdin(body)) goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "forwardRequest fails");
+  }
+  if (sock != -1) close(sock);
+  if (body) fclose(body);
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : loadWorker
+ * Description: Load configuration and servers for all collections
+ * Synopsis   : static int loadWorker(time_t* confMtime)
+ * Input      : N/A
+ * Output     : time_t* confMtime: configuration file mtime
+ *              TRUE on success
+ =======================================================================*/
+static int
+loadWorker(time_t* confMtime)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Collection* coll = 0;
+  RGIT* curr = 0;
+  struct stat statBuffer;
+
+  logMain(LOG_DEBUG, "loadWorker");
+  *confMtime = 0;
+
+  if (!(conf = getConfiguration())) goto error;
+  if (stat(conf->confFile, &statBuffer)) {
+    logMain(LOG_ERR, "stat fails on %s: %s",
+	    conf->confFile, strerror(errno));
+    goto error;
+  }
+  if (!loadConfiguration(CFG)) goto error;
+
+  // keep servers.txt loaded (cptInUse never reach 0)
+  while ((coll = rgNext_r(conf->collections, &curr))) {
+    if (!expandCollection(coll)) goto error;
+    if (!loadCollection(coll, SERV)) goto error;
+  }
+
+  *confMtime = statBuffer.st_mtime;
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "loadWorker fails");
+  }
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : isOutdatedWorker
+ * Description: Check if files loaded by the worker were modified
+ * Synopsis   : static int isOutdatedWorker(time_t confMtime,
+ *                                          int* isOutdated)
+ * Input      : time_t confMtime: configuration mtime when loaded
+ * Output     : int* isOutdated: TRUE if we need to reload
+ *              TRUE on success
+ =======================================================================*/
+static int
+isOutdatedWorker(time_t confMtime, int* isOutdated)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Collection* coll = 0;
+  RGIT* curr = 0;
+  struct stat statBuffer;
+
+  *isOutdated = TRUE;
+  if (!(conf = getConfiguration())) goto error;
+
+  if (stat(conf->confFile, &statBuffer)) {
+    logMain(LOG_WARNING, "stat fails on %s: %s",
+	    conf->confFile, strerror(errno));
+    goto end;
+  }
+  if (statBuffer.st_mtime != confMtime) goto end;
+
+  while ((coll = rgNext_r(conf->collections, &curr))) {
+    if (!isOutdatedCollection(coll, iSERV, isOutdated)) goto error;
+    if (*isOutdated) goto end;
+  }
+
+  *isOutdated = FALSE;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "isOutdatedWorker fails");
+  }
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : readWorkerHeader
+ * Description: Read the CGI variables sent by forwardRequest
+ * Synopsis   : static int readWorkerHeader(int sock)
+ * Input      : int sock: accepted socket
+ * Output     : TRUE on success
+ * Note       : read byte per byte so as to let the POST body on the
+ *              socket for getcgivars
+ =======================================================================*/
+static int
+readWorkerHeader(int sock)
+{
+  int rc = FALSE;
+  char buffer[1024];
+  char* value = 0;
+  size_t l = 0;
+  ssize_t n = 0;
+  int i = 0;
+
+  logMain(LOG_DEBUG, "readWorkerHeader");
+
+  while (TRUE) {
+    if ((n = recv(sock, buffer+l, 1, 0)) == -1) {
+      if (errno == EINTR) continue;
+      logMain(LOG_ERR, "recv: %s", strerror(errno));
+      goto error;
+    }
+    if (n == 0) {
+      logMain(LOG_ERR, "unexpected end of cgi header");
+      goto error;
+    }
+    if (buffer[l] != (char)0) {
+      if (++l >= sizeof(buffer)) {
+	logMain(LOG_ERR, "cgi variable too long");
+	goto error;
+      }
+      continue;
+    }
+
+    // end of header
+    if (l == 0) break;
+    l = 0;
+
+    if (!(value = strchr(buffer, '='))) {
+      logMain(LOG_ERR, "bad cgi variable: %s", buffer);
+      goto error;
+    }
+    *value++ = (char)0;
+    for (i=0; cgiVariables[i]; ++i) {
+      if (!strcmp(buffer, cgiVariables[i])) break;
+    }
+    if (!cgiVariables[i]) {
+      logMain(LOG_WARNING, "ignore %s cgi variable", buffer);
+      continue;
+    }
+    if (setenv(buffer, value, 1)) {
+      logMain(LOG_ERR, "setenv fails: %s", strerror(errno));
+      goto error;
+    }
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "readWorkerHeader fails");
+  }
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : serveWorkerRequest
+ * Description: Answer a query forwarded to the persistent worker
+ * Synopsis   : static int serveWorkerRequest(int sock,
+ *                                            char* programName)
+ * Input      : int sock: accepted socket
+ *              char* programName: the name of the program
+ * Output     : TRUE on success
+ * Note       : run by a forked child, so as to re-use the metadata
+ *              already loaded by the worker and to keep the one-shot
+ *              code (stdin, stdout and getenv)
+ =======================================================================*/
+static int
+serveWorkerRequest(int sock, char* programName)
+{
+  int rc = FALSE;
+  char* label = 0;
+
+  logMain(LOG_DEBUG, "serveWorkerRequest");
+
+  if (!readWorkerHeader(sock)) goto error;
+  if (dup2(sock, STDIN_FILENO) == -1 || dup2(sock, STDOUT_FILENO) == -1) {
+    logMain(LOG_ERR, "dup2: %s", strerror(errno));
+    goto error;
+  }
+  close(sock);
+
+  if ((label = getIndexLabel()) == 0) goto error;
+  if (strcmp(env.confLabel, workerLabel)) {
+    logMain(LOG_ERR, "worker do not serve %s configuration",
+	    env.confLabel);
+    goto error;
+  }
+  if (!serveRequest(programName, label)) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "serveWorkerRequest fails");
+  }
+  fflush(stdout);
+  destroyString(label);
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : cgiWorker
+ * Description: Persistent cgi worker (FastCGI like)
+ * Synopsis   : static int cgiWorker(char* programName)
+ * Input      : char* programName: the name of the program
+ * Output     : TRUE on success
+ * Note       : configuration and servers.txt are parsed once and
+ *              reloaded when the files change. Each query is served
+ *              by a forked child.
+ =======================================================================*/
+static int
+cgiWorker(char* programName)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  struct sockaddr_un address;
+  struct pollfd pollFd;
+  int sock = -1;
+  int conn = -1;
+  time_t confMtime = 0;
+  time_t lastCheck = 0;
+  time_t now = 0;
+  int isOutdated = FALSE;
+  int n = 0;
+
+  logMain(LOG_DEBUG, "cgiWorker");
+  workerLabel = env.confLabel;
+
+  if (!loadWorker(&confMtime)) goto error;
+  if (!(conf = getConfiguration())) goto error;
+  if (strlen(conf->cgiSocket) >= sizeof(address.sun_path)) {
+    logMain(LOG_ERR, "socket path too long: %s", conf->cgiSocket);
+    goto error;
+  }
+  memset(&address, 0, sizeof(struct sockaddr_un));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, conf->cgiSocket);
+
+  if (unlink(conf->cgiSocket) && errno != ENOENT) {
+    logMain(LOG_ERR, "unlink fails on %s: %s",
+	    conf->cgiSocket, strerror(errno));
+    goto error;
+  }
+  if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+    logMain(LOG_ERR, "socket: %s", strerror(errno));
+    goto error;
+  }
+  if (bind(sock, (struct sockaddr*)&address, sizeof(struct sockaddr_un))) {
+    logMain(LOG_ERR, "bind: %s", strerror(errno));
+    goto error;
+  }
+  if (chmod(conf->cgiSocket, 0660)) {
+    logMain(LOG_ERR, "chmod: %s", strerror(errno));
+    goto error;
+  }
+  if (listen(sock, 16)) {
+    logMain(LOG_ERR, "listen: %s", strerror(errno));
+    goto error;
+  }
+
+  // children are not waited (reset by them)
+  signal(SIGCHLD, SIG_IGN);
+  logMain(LOG_NOTICE, "cgi worker listening on %s", conf->cgiSocket);
+
+  while (env.running) {
+    pollFd.fd = sock;
+    pollFd.events = POLLIN;
+    if ((n = poll(&pollFd, 1, 1000)) == -1) {
+      if (errno == EINTR) continue;
+      logMain(LOG_ERR, "poll: %s", strerror(errno));
+      goto error;
+    }
+
+    // reload metadata if modified (at most once a second)
+    if ((now = time(0)) != lastCheck) {
+      lastCheck = now;
+      if (!isOutdatedWorker(confMtime, &isOutdated)) goto error;
+      if (isOutdated) {
+	logMain(LOG_NOTICE, "reload configuration");
+	freeConfiguration();
+
+	// on failure, children parse the files as the one-shot cgi do
+	if (!loadWorker(&confMtime)) {
+	  logMain(LOG_WARNING, "fails to reload configuration");
+	}
+      }
+    }
+    if (n == 0) continue;
+
+    if ((conn = accept(sock, 0, 0)) == -1) {
+      if (errno == EINTR) continue;
+      logMain(LOG_ERR, "accept: %s", strerror(errno));
+      goto error;
+    }
+
+    switch (fork()) {
+    case -1:
+      logMain(LOG_ERR, "fork: %s", strerror(errno));
+      break;
+    case 0:
+      // execScript must be able to wait its own childs
+      signal(SIGCHLD, SIG_DFL);
+      close(sock);
+      exit(serveWorkerRequest(conn, programName)?EXIT_SUCCESS:EXIT_FAILURE);
+    }
+    close(conn);
+    conn = -1;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "cgiWorker fails");
+  }
+  if (sock != -1) {
+    close(sock);
+    if (conf) unlink(conf->cgiSocket);
+  }
+  return rc;
+}
+
+
 /*=======================================================================
  * Function   : main 
  * Author     : Nicolas ROCHE
@@ -656,18 +1335,17 @@ usage(char* programName)
 int 
 main(int argc, char** argv)
 {
-  //Configuration* conf = 0;
-  Collection* coll = 0;
-  RecordTree* tree = 0;
-  Record* record = 0;
   char* label = 0;
+  int isWorker = FALSE;
+  int isDone = FALSE;
   // ---
   int rc = 0;
   int cOption = EOF;
   char* programName = *argv;
-  char* options = MDTX_SHORT_OPTIONS;
+  char* options = MDTX_SHORT_OPTIONS "W";
   struct option longOptions[] = {
     MDTX_LONG_OPTIONS,
+    {"worker", no_argument, 0, 'W'},
     {0, 0, 0, 0}
   };
 
@@ -680,6 +1358,10 @@ main(int argc, char** argv)
 	!= EOF) {
     switch(cOption) {
       
+    case 'W':
+      isWorker = TRUE;
+      break;
+
       GET_MDTX_OPTIONS; // generic options
     }
     if (rc) goto optError;
@@ -689,6 +1371,13 @@ main(int argc, char** argv)
   if (!setEnv(programName, &env)) goto optError;
 
   /************************************************************************/
+  if (isWorker) {
+    logMain(LOG_INFO, "* mediatex cgi worker *");
+    if (!cgiWorker(programName)) goto error;
+    rc = TRUE;
+    goto error;
+  }
+
   logMain(LOG_INFO, "* mediatex cgi script *");
 
   // match collection
@@ -697,39 +1386,15 @@ main(int argc, char** argv)
     goto error;
   }
 
-  logMain(LOG_DEBUG, "%s-cgi lunched from %s collection", 
-	  env.confLabel, label);
-
-  // load configuration (goto error as htmlError need a coll)
-  if (!(coll = mdtxGetCollection(label))) goto error;
-  
-  // build record query from query parameters
-  if ((tree = scanCgiQuery(coll)) == 0) goto htmlError;
-  if (!(record = (Record*)tree->records->head->item)) goto htmlError;
-  
-  // relay query to daemon(s)
-  if (isEmptyString(record->extra) || record->extra[0]=='!') {
-    // first call: ask if servers have the record in cache
-    if (!loadCollection(coll, SERV)) goto error;
-    if (!mdtxFind(tree)) goto iamAloneHtmlError;
-    if (!releaseCollection(coll, SERV)) goto error;
-  }
-  else {
-    // second call: ask local server remind the provided mail
-    if (!mdtxRegister(tree)) goto iamAloneHtmlError;
-  }
+  // use the persistent worker if running, else do the job ourself
+  if (!forwardRequest(&isDone)) goto error;
+  if (!isDone && !serveRequest(programName, label)) goto error;
 
   rc = TRUE;
   /************************************************************************/
 
- iamAloneHtmlError:
-  if (!rc) iamAloneHtml(coll, programName);
-  goto error;
- htmlError:
-  if (!rc) usageHtml(coll, programName);
  error:
   destroyString(label);
-  destroyRecordTree(tree);
   freeConfiguration();
   if (confLabel) free(confLabel);
   ENDINGS;
@@ -82,6 +82,8 @@
 #define CONF_HTMLDIR  "/public_html"
 #define CONF_CONFFILE ".conf"
 #define CONF_PIDFILE  "d.pid"
+#define CONF_CGISOCK  "-cgi.sock"
+#define CONF_PERFFILE "d.perf"
 #define CONF_SUPPD    ":supports/"
 #define CONF_AUDIT    "audit_"
 
@@ -131,6 +131,8 @@ typedef void* yyscan_t;
 #define DEFAULT_TTL_CHECK  6*MONTH   // support check TTL
 #define DEFAULT_TTL_UPLOAD 1*MONTH  // upload time (no score implication)
 #define DEFAULT_TTL_FILE   2*MONTH   // file support check TTL
+#define DEFAULT_CHECK_RATE 10*MEGA   // disk bandwidth for file checks
+#define DEFAULT_CHECK_NICE 7         // I/O priority for file checks
 #define DEFAULT_TTL_SUPP   5*YEAR    // support TTL
 #define DEFAULT_TTL_SERVER 2*WEEK   // server (last commit) TTL
 #define DEFAULT_MAX_SCORE  10 // cf above
@@ -143,6 +145,9 @@ typedef void* yyscan_t;
 // log defaults
 #define MISC_LOG_FILE 99 // log to stdout
 #define MISC_LOG_LINES 1 // log with line numbers
+#define LOG_QUEUE_SIZE 1024 // pending messages (asynchronous logs)
+#define LOG_BATCH_SIZE 64   // messages written at once by the logger
+#define LOG_LINE_SIZE 512   // queued messages are truncated
 
 // maximum allocated size before we try to disease memory
 // note: we deals with mediatex memory so not same as VMS, RSS
@@ -155,10 +160,48 @@ typedef void* yyscan_t;
 #define MISC_CHECKSUMS_MAX_NBLINK 10
 #define MISC_CHECKSUMS_MTAB       "/etc/mtab"
 #define MISC_CHECKSUMS_PROGBARSIZE 128
+#define MISC_CHECKSUMS_BUFSIZE 16384 // bytes read at once
 
 // threads
 #define MAX_TASK_SOCKET_THREAD 3
 #define MAX_TASK_SIGNAL_THREAD 3
+#define MAX_TASK_IDLE_THREAD 8 // kept alive connections waiting a frame
+#define MAX_LOAD_THREAD 4 // parsing of the extract part files
+#define MAX_HTML_THREAD 4 // rendering of the html pages
+#define MAX_HASH_THREAD 4 // hashing of the files to upload
+#define IDLE_METADATA_TTL 300 // free unused extract trees (daemon)
+#define CHECK_SUPP_DELAY 60   // first look at the support files (daemon)
+#define CHECK_SUPP_IDLE 3600  // look again at them (if none was due)
+#define CHECK_SUPP_RETRY DAY  // check again a support file that fails
+#define MAX_CHECK_FAILURE 16
+#define MAX_PUSH_JOB 64       // git modules the daemon will push
+#define MAX_CACHE_OWNER 64    // collections using their cache at once
+#define GIT_QUIET_DELAY 10    // seconds without commit before to push
+#define GIT_MAX_DELAY 120     // but do not postpone it more than that
+#define GIT_RETRY_DELAY 60    // first retry of a failed push (doubled)
+#define GIT_MAX_RETRY 3600    // then retry at least hourly
+#define MAX_HELPER_ARGS 8     // script and arguments run by the git helper
+#define MAX_HELPER_STRING 65536 // longest argument sent to the git helper
+#define GIT_PENDING_COMMIT ".pending-commit" // comments not committed yet
+
+// connections between servers
+#define MAX_PEER_CONNECTION 16 // connection pool size
+#define PEER_CONNECTION_TTL 3  // seconds a client keep an idle connection
+#define SOCKET_IDLE_TTL 5      // seconds the daemon wait for a new frame
+#define CONNECT_TIMEOUT 2000      // ms to connect a server not known yet
+#define CONNECT_MIN_TIMEOUT 500   // ms, bounds of the adaptive timeout
+#define CONNECT_MAX_TIMEOUT 10000
+#define CONNECT_BACKOFF_MIN 5     // seconds an unreachable server is
+#define CONNECT_BACKOFF_MAX 300   // skipped (doubled on each failure)
+#define MAX_DNS_ENTRY 64          // resolver cache size
+#define DNS_CACHE_TTL 3600        // seconds a DNS answer is kept
+#define DNS_FAILED_TTL 60         // seconds a DNS failure is kept
+#define UPLOAD_CHUNK_SIZE 65536   // bytes per chunk of a streamed upload
+#define UPLOAD_PART_PREFIX ".upload-" // partial upload (into the cache)
+#define UPLOAD_PART_TTL DAY       // a partial upload not resumed is removed
+#define UPLOAD_RECV_TIMEOUT 60    // seconds waiting for the next chunk
+#define REPLY_TIMEOUT 300         // seconds waiting for a reply to a frame
+#define CGI_WORKER_TIMEOUT 5000   // ms before get.cgi serves by itself
 
 // ipcs
 #define MISC_SHM_PROJECT_ID 6561
@@ -64,6 +64,8 @@
 #include "common/upgrade.h"
 #include "common/openClose.h"
 #include "common/extractScore.h"
+#include "common/snapshot.h"
+#include "common/perf.h"
 
 // alloc (alloc.h is not included by library user)
 extern void memoryStatus(int priority, char* file, int line);
@@ -76,6 +78,7 @@ extern int parseServerFile(Collection* coll, const char* path);
 extern int parseExtractFile(Collection* coll, const char* path);
 extern int parseCatalogFile(Collection* coll, const char* path);
 extern RecordTree* parseRecords(int fd);
+extern RecordTree* parseRecordJournal(int fd);
 
 // above struct related to command.h
 // do not free them (man 3 getenv)
@@ -102,6 +105,7 @@ typedef struct MdtxEnv {
   int noGit;         // do not use git (cgi and server)
   int noGitPullPush; // no pull/push (no network) but still do commits
   int cvsprintMax;   // maximum size for files handle by GIT
+  int noSnapshot;    // do not write the extract snapshot (but server)
 
   // debug options
   int debugLexer;
@@ -132,6 +136,7 @@ extern MdtxEnv envUnitTest; // only used for copy
 	0, (int (*)(long))0, 0,						\
 	/* configuration */						\
 	DEFAULT_MDTXUSER "1", TRUE, TRUE, TRUE, TRUE, TRUE, 500*KILO,	\
+	FALSE,								\
 	/* debug */							\
 	FALSE,								\
 	/* global data structure */					\
@@ -151,6 +156,7 @@ extern MdtxEnv envUnitTest; // only used for copy
 	256, (int (*)(long))0, 0,					\
 	/* configration */						\
 	DEFAULT_MDTXUSER, FALSE, FALSE, FALSE,TRUE, TRUE, 500*KILO,	\
+	TRUE,								\
 	/* debug */							\
 	FALSE,								\
 	/* global data structure */					\
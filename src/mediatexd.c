@@ -36,24 +36,24 @@
 #define OPEN_MAX 4096
 
 extern int taskSocketNumber;
+extern int hold;
 extern int taskSignalNumber;
 
 /*=======================================================================
  * Function   : serverSaveAll
  * Description: Call serializer on all modified files
- * Synopsis   : int serverSaveAll()
- * Input      : N/A
+ * Synopsis   : int serverSaveAll(Configuration* conf)
+ * Input      : Configuration* conf: configuration snapshot to save
  * Output     : TRUE on success
  =======================================================================*/
-static int serverSaveAll()
+static int serverSaveAll(Configuration* conf)
 {
   int rc = FALSE;
-  Configuration* conf = 0;
   Collection* coll = 0;
   RGIT* curr = 0;
   
   logCommon(LOG_DEBUG, "server save all");
-  if (!(conf = env.confTree)) goto end; // nothing was loaded
+  if (!conf) goto end; // nothing was loaded
 
   while ((coll = rgNext_r(conf->collections, &curr))) {
     if (!saveCollection(coll, CACH)) goto error;
@@ -161,7 +161,7 @@ signalJob(void* arg)
     char *name; // only for logs
   };
 
-  static struct job jobs[9] = {
+  static struct job jobs[10] = {
     {REG_SAVEMD5, saveCache, "SAVEMD5"},
     {REG_EXTRACT, extractArchives, "EXTRACT"},
     {REG_NOTIFY, sendRemoteNotify, "NOTIFY"},
@@ -170,12 +170,13 @@ signalJob(void* arg)
     {REG_TRIM, trimCache, "TRIM"},
     {REG_SCAN, scanCache, "SCAN"},
     {REG_QUICKSCAN, quickScanCache, "QUICK SCAN"},
-    {REG_STATUS, statusCache, "STATUS"}
+    {REG_STATUS, statusCache, "STATUS"},
+    {REG_PUSH, 0, "PUSH"}
   };
 
   (void) arg;
   logMain(LOG_DEBUG, "signalJob: %i", me);
-  if (!(conf = getConfiguration())) goto error;
+  if (!(conf = acquireConfiguration())) goto error;
   memset(mask, 0, REG_SHM_BUFF_SIZE);
 
   if (!shmRead(conf->confFile, REG_SHM_BUFF_SIZE,
@@ -183,7 +184,7 @@ signalJob(void* arg)
     goto error;
    
   // loop on jobs (as several jobs may be wanted here)
-  for (i=0; i<9 ; ++i) {
+  for (i=0; i<10 ; ++i) {
     if (param.buf[jobs[i].reg] != REG_QUERY) continue;
   
     logMain(LOG_NOTICE, "signalJob %i: %s", me, jobs[i].name);
@@ -212,8 +213,17 @@ signalJob(void* arg)
     // do the jobs
     if (jobs[i].reg == REG_STATUS) {
       memoryStatus(LOG_NOTICE, __FILE__, __LINE__);
+      perfStatus(LOG_NOTICE);
+      resolverStatus(LOG_NOTICE);
+      pusherStatus(LOG_NOTICE);
+      if (!perfSave(conf->perfFile)) rc2 = REG_ERROR;
+    }
+    if (jobs[i].reg == REG_PUSH) {
+      if (!queueAllPush(conf)) rc2 = REG_ERROR;
+    }
+    else {
+      if (!serverLoop(jobs[i].function)) rc2 = REG_ERROR;
     }
-    if (!serverLoop(jobs[i].function)) rc2 = REG_ERROR;
       
     // mark job as done
     for (j=0; j<REG_SHM_BUFF_SIZE; ++j) {
@@ -245,25 +255,52 @@ signalJob(void* arg)
  * Synopsis   : void hupManager()
  * Input      : N/A
  * Output     : N/A
- * Note       : not rentrant and not designed to support concurrency
+ * Note       : not rentrant and not designed to support concurrency.
+ *              Jobs still running keep the previous configuration
+ *              until they end (cf releaseConfiguration).
  =======================================================================*/
 int
 hupManager()
 {
   int rc = FALSE;
+  Configuration* conf = 0;
+  Configuration* oldConf = 0;
+  Collection* coll = 0;
+  Collection* oldColl = 0;
+  RGIT* curr = 0;
+  RGIT* curr2 = 0;
 
-  // save collection that was eventually loaded
-  if (!serverSaveAll()) goto error;
-
-  // free all memory
-  freeConfiguration();
+  // no save here: cache changes are already journaled, and compacting
+  // the journal would block the signal thread on the cache lock
+  oldConf = env.confTree;
 
-  // load only configuration (no collection yet)
+  // load only configuration into a new snapshot
+  if (!(conf = createConfiguration())) goto error;
+  if (!useConfiguration(conf)) goto error;
   if (!loadConfiguration(CFG)) goto error;
   if (!expandConfiguration()) goto error;
 
+  // reuse collections that were not modified
+  if (oldConf) {
+    while ((coll = rgNext_r(conf->collections, &curr))) {
+      curr2 = 0;
+      while ((oldColl = rgNext_r(oldConf->collections, &curr2))) {
+	if (!strncmp(oldColl->label, coll->label, MAX_SIZE_COLL)) break;
+      }
+      if (!oldColl) continue;
+      if (!adoptCollection(coll, oldColl)) goto error;
+    }
+  }
+
+  // publish it
+  oldConf = swapConfiguration(conf);
+  conf = 0;
+  oldConf = destroyConfiguration(oldConf);
+
   rc = TRUE;
  error:
+  conf = destroyConfiguration(conf);
+  useConfiguration(0);
   if (!rc) {
     logMain(LOG_ERR, "daemon HUP fails: exiting");
   }
@@ -273,7 +310,49 @@ hupManager()
   return rc;
 }
 
-
+/*=======================================================================
+ * Function   : outdatedManager
+ * Description: Free a configuration replaced while jobs were using it
+ * Synopsis   : int outdatedManager(Configuration* conf)
+ * Input      : Configuration* conf: the configuration to free
+ * Output     : TRUE on success
+ * Note       : called by the last job that was using it.
+ *              Its trees go to the current configuration if it did
+ *              not load its own meanwhile. They are never saved from
+ *              here: records are journaled, and writing the records
+ *              file from an old tree may overwrite the current state
+ *              (only the current configuration is saved).
+ =======================================================================*/
+int
+outdatedManager(Configuration* conf)
+{
+  int rc = FALSE;
+  Configuration* current = 0;
+  Collection* coll = 0;
+  Collection* oldColl = 0;
+  RGIT* curr = 0;
+  RGIT* curr2 = 0;
+
+  logMain(LOG_INFO, "free previous configuration");
+  if (!(current = acquireConfiguration())) goto error;
+
+  while ((oldColl = rgNext_r(conf->collections, &curr))) {
+    curr2 = 0;
+    while ((coll = rgNext_r(current->collections, &curr2))) {
+      if (!strncmp(oldColl->label, coll->label, MAX_SIZE_COLL)) break;
+    }
+    if (!coll) continue;
+    if (!adoptCollection(coll, oldColl)) goto error2;
+  }
+
+  rc = TRUE;
+ error2:
+  if ((current = releaseConfiguration())) outdatedManager(current);
+ error:
+  destroyConfiguration(conf);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : termManager
  * Description: Exit when receiving TERM signal
@@ -286,7 +365,7 @@ termManager()
 {
   int rc = FALSE;
 
-  if (!serverSaveAll()) {
+  if (!serverSaveAll(env.confTree)) {
     logMain(LOG_ERR, "Fails to save md5sums while exiting");
     goto error;
   }
@@ -299,30 +378,29 @@ termManager()
 
 
 /*=======================================================================
- * Function   : socketJob
- * Description: thread callback function
- * Synopsis   : void* socketJob(void* arg)
- * Input      : void* arg = (Connexion*) connection structure
- * Output     : N/A
+ * Function   : socketMessage
+ * Description: Parse and process one message
+ * Synopsis   : static int socketMessage(Connexion* con, int fd)
+ * Input      : Connexion* con = connection structure
+ *              int fd = where to read the message from
+ * Output     : TRUE on success, con->status is set
  =======================================================================*/
-void* 
-socketJob(void* arg)
+static int
+socketMessage(Connexion* con, int fd)
 {
   int me = taskSocketNumber;
-  long int rc = FALSE;
-  Connexion* con = (Connexion*)arg;
+  int rc = FALSE;
 
   static char status[][32] = {
     "301 message parser error",
     "305 unknown message type: %s",
-    "400 internal error"
+    "306 stream needs a frame",
   };
 
-  logMain(LOG_DEBUG, "socketJob %i", me);
   sprintf(con->status, "%s", status[1]);
 
   // read the socket
-  if ((con->message = parseRecords(con->sock)) == 0) {
+  if ((con->message = parseRecords(fd)) == 0) {
     sprintf(con->status, "%s", status[0]);
     goto error;
   }
@@ -343,6 +421,16 @@ socketJob(void* arg)
     if (!uploadFinaleArchive(con)) goto error;
     break;
 
+  case STREAM:
+    logMain(LOG_NOTICE, "socketJob %i: STREAM", me);
+    con->status[1] = '1';
+    if (fd == con->sock) {
+      sprintf(con->status, "%s", status[2]);
+      goto error;
+    }
+    if (!uploadStreamArchive(con)) goto error;
+    break;
+
   case CGI:
     logMain(LOG_NOTICE, "socketJob %i: CGI", me);
     con->status[1] = '2';
@@ -379,7 +467,88 @@ socketJob(void* arg)
   strcpy(con->status + strlen(con->status), "\n");
   tcpWrite(con->sock, con->status, strlen(con->status));
   con->message = destroyRecordTree(con->message);
+  con->server = 0;
+  return rc;
+}
 
+/*=======================================================================
+ * Function   : socketNextFrame
+ * Description: Wait for the next frame on a kept alive connection
+ * Synopsis   : static int socketNextFrame(Connexion* con)
+ * Input      : Connexion* con = connection structure
+ * Output     : TRUE if a frame is coming
+ * Note       : give up after SOCKET_IDLE_TTL or as soon as the daemon
+ *              stops. The socket thread slot is released meanwhile.
+ =======================================================================*/
+static int
+socketNextFrame(Connexion* con)
+{
+  int rc = 0;
+  int i = 0;
+
+  if (!socketJobIdles(con)) return FALSE;
+  for (i = 0; i < SOCKET_IDLE_TTL && rc == 0; ++i) {
+    if (!env.running || hold) break;
+    rc = waitFrame(con->sock, 1);
+  }
+
+  // socketJobEnds will release the idle slot if no frame is coming
+  return (rc == 1 && socketJobWakes(con));
+}
+
+/*=======================================================================
+ * Function   : socketJob
+ * Description: thread callback function
+ * Synopsis   : void* socketJob(void* arg)
+ * Input      : void* arg = (Connexion*) connection structure
+ * Output     : N/A
+ * Note       : previous versions send one message per connection,
+ *              current ones send frames on a kept alive connection.
+ *              The configuration is not kept between 2 frames, so as
+ *              a HUP is seen by the next frame.
+ =======================================================================*/
+void* 
+socketJob(void* arg)
+{
+  int me = taskSocketNumber;
+  long int rc = FALSE;
+  Connexion* con = (Connexion*)arg;
+  Configuration* conf = 0;
+  int fd = -1;
+
+  logMain(LOG_DEBUG, "socketJob %i", me);
+  if (!acquireConfiguration()) {
+    sprintf(con->status, "%s", "400 internal error\n");
+    tcpWrite(con->sock, con->status, strlen(con->status));
+    goto error;
+  }
+
+  // one-shot message
+  if (!isFrame(con->sock)) {
+    rc = socketMessage(con, con->sock);
+    goto error;
+  }
+
+  // frames
+  rc = TRUE;
+  while (TRUE) {
+    if ((fd = readFrame(con->sock)) == -1) {
+      rc = FALSE;
+      break;
+    }
+    if (!socketMessage(con, fd)) rc = FALSE;
+    close(fd);
+
+    // each frame uses the configuration published when it comes (HUP)
+    if ((conf = releaseConfiguration())) outdatedManager(conf);
+    if (!socketNextFrame(con)) break;
+    if (!acquireConfiguration()) {
+      rc = FALSE;
+      break;
+    }
+  }
+
+ error:
   socketJobEnds(con);
   return (void*)rc;
 }
@@ -493,6 +662,7 @@ main(int argc, char** argv)
 
   // import mdtx environment
   env.background = FALSE;
+  env.noSnapshot = FALSE; // only the server writes the snapshot
   env.allocDiseaseCallBack = serverDiseaseAll;
   getEnv(&env);
 
@@ -512,6 +682,7 @@ main(int argc, char** argv)
 
   // export mdtx environment
   if (!setEnv(programName, &env)) goto optError;
+  perfGetEnv();
 
   /************************************************************************/
   // if we are root, switch to mdtx user 
@@ -553,6 +724,12 @@ main(int argc, char** argv)
     if (!setEnv(programName, &env)) goto error;    
     logMain(LOG_INFO, "...I'm a daemon");
   }
+
+  // the git scripts are run as the modules' users by a child process
+  if (!startGitHelper()) goto error;
+
+  // write the logs from a dedicated thread (no more fork from here)
+  if (!logStartAsync(env.logHandler)) goto error;
     
   // write daemon's pid file
   if (!(conf = getConfiguration())) goto error;
@@ -596,6 +773,7 @@ main(int argc, char** argv)
     }
   }
  error:
+  if (!stopGitHelper()) rc = FALSE;
   free (buf1);
   freeConfiguration();
   ENDINGS;
@@ -35,19 +35,15 @@ Archive*
 createArchive(void)
 {
   Archive* rc = 0;
+  int i = 0;
 
   if ((rc = (Archive*)malloc(sizeof(Archive))) == 0)
     goto error;
    
   memset(rc, 0, sizeof(Archive));
-  if ((rc->images = createRing()) == 0) goto error;
-  if ((rc->fromContainers = createRing()) == 0) goto error;
-  if ((rc->documents = createRing()) == 0) goto error;
-  if ((rc->assoCaracs = createRing()) == 0) goto error;
-  if ((rc->records = createRing()) == 0) goto error;
-  if ((rc->demands = createRing()) == 0) goto error;
-  if ((rc->remoteSupplies = createRing()) == 0) goto error;
-  if ((rc->finalSupplies = createRing()) == 0) goto error;
+
+  // most rings only have 0, 1 or 2 items: embed them
+  for (i = 0; i < AR_RINGS_MAX; ++i) rgInitCompact(rc->rings + i);
   rc->imageScore = -1;   // still not computed
   rc->extractScore = -1; // still not computed
   rc->state = UNUSED;
@@ -70,6 +66,8 @@ Archive*
 destroyArchive(Archive* self)
 {
   Archive* rc = 0;
+  AssoCarac* aC = 0;
+  int i = 0;
 
   if(self == 0) goto error;
 
@@ -84,18 +82,14 @@ destroyArchive(Archive* self)
 #endif
 
   // delete assoCarac associations
-  self->assoCaracs
-    = destroyRing(self->assoCaracs,
-		  (void*(*)(void*)) destroyAssoCarac);
+  while ((aC = rgHead(arAssoCaracs(self)))) {
+    rgRemove(arAssoCaracs(self));
+    destroyAssoCarac(aC);
+  }
   
-  // we do not free the objects (owned by trees), just the rings
-  self->images = destroyOnlyRing(self->images);
-  self->fromContainers = destroyOnlyRing(self->fromContainers);
-  self->documents = destroyOnlyRing(self->documents);
-  self->records = destroyOnlyRing(self->records);
-  self->demands = destroyOnlyRing(self->demands);
-  self->remoteSupplies = destroyOnlyRing(self->remoteSupplies);
-  self->finalSupplies = destroyOnlyRing(self->finalSupplies);
+  // we do not free the objects (owned by trees), just the ring items
+  // (rings are embedded into the archive)
+  for (i = 0; i < AR_RINGS_MAX; ++i) rgDelete(&self->rings[i].ring);
   free(self);
   
 error:
@@ -173,6 +167,27 @@ cmpArchiveScore(const void *p1, const void *p2)
   return rc;
 }
 
+// same function for AVL trees (do not truncate the scores)
+int 
+cmpArchiveScoreAvl(const void *p1, const void *p2)
+{
+  int rc = 0;
+
+  /* p1 and p2 are pointers on items
+   * and items are suposed to be Archive* 
+   */
+  
+  Archive* a1 = (Archive*)p1;
+  Archive* a2 = (Archive*)p2;
+
+  if (a1->extractScore < a2->extractScore) rc = -1; // growing scores
+  if (a1->extractScore > a2->extractScore) rc = 1;
+  if (!rc) rc = strncmp(a1->hash, a2->hash, MAX_SIZE_MD5);
+  if (!rc) rc = (a1->size > a2->size) - (a1->size < a2->size);
+ 
+  return rc;
+}
+
 /*=======================================================================
  * Function   : strArchiveState
  * Description: return a string for the archive state
@@ -287,10 +302,10 @@ diseaseArchive(Collection* coll, Archive* self)
 	  self->hash, (long long int) self->size);
 
   // check images ring
-  if (self->images->nbItems >0) goto next;
+  if (arImages(self)->nbItems >0) goto next;
   
   // check container's rings
-  if (self->fromContainers->nbItems >0) goto next;
+  if (arFromContainers(self)->nbItems >0) goto next;
   if (self->toContainer) goto next;
 
   // check incoming flag
@@ -300,18 +315,22 @@ diseaseArchive(Collection* coll, Archive* self)
   if (self->imgExtractionPath) goto next;
   
   // check document's rings
-  if (self->documents->nbItems >0) goto next;
-  if (self->assoCaracs->nbItems >0) goto next;
+  if (arDocuments(self)->nbItems >0) goto next;
+  if (arAssoCaracs(self)->nbItems >0) goto next;
   
   // check records ring
-  if (self->records->nbItems >0) goto next;
+  if (arRecords(self)->nbItems >0) goto next;
   
   // check cache's rings
-  if (self->demands->nbItems >0) goto next;
-  if (self->remoteSupplies->nbItems >0) goto next;
-  if (self->finalSupplies->nbItems >0) goto next;
+  if (arDemands(self)->nbItems >0) goto next;
+  if (arRemoteSupplies(self)->nbItems >0) goto next;
+  if (arFinalSupplies(self)->nbItems >0) goto next;
   if (self->localSupply) goto next;
   
+  // delete archive from the incremental score's indexes
+  if (!delToRescore(coll, self)) goto error;
+  if (coll->extractTree) avl_delete(coll->extractTree->scores, self);
+
   // delete archive from collection ring and free it
   avl_delete(coll->archives, self);
 
@@ -391,7 +410,7 @@ int isIncoming(Collection* coll, Archive* self)
 int isBadTopContainer(Collection* coll, Archive* archive)
 {
   // looking for top containers (as content cannot have worse score)
-  return (!archive->fromContainers->nbItems &&
+  return (!arFromContainers(archive)->nbItems &&
 	  // looking for archive having a bad score
 	  archive->extractScore<=coll->serverTree->scoreParam.maxScore/2);
 }
@@ -30,6 +30,20 @@
 typedef enum {UNUSED = 0, USED, WANTED, ALLOCATED, AVAILABLE, TOKEEP,
 	      ASTATE_MAX} AState;
 
+// rings embedded into the archive (cf rgInitCompact)
+typedef enum {
+  AR_IMAGES = 0,      // serverTree: Image*
+  AR_FROM_CONTAINERS, // extractTree: FromAsso*
+  AR_DOCUMENTS,       // documentTree: Document*
+  AR_ASSO_CARACS,     // documentTree: AssoCarac*
+  AR_RECORDS,         // recordTree: related record to destroy if we
+		      //  remove this archive
+  AR_DEMANDS,         // cacheTree: Record*
+  AR_REMOTE_SUPPLIES, // cacheTree: Record*
+  AR_FINAL_SUPPLIES,  // cacheTree: Record*
+  AR_RINGS_MAX
+} ARing;
+
 struct Archive
 {
   // not easy to parse into uchar[16]
@@ -41,39 +55,42 @@ struct Archive
   off_t size;
 
   // serverTree related data
-  RG*   images;
   float imageScore;
 
   // extractTree related data
-  RG*        fromContainers; // (FromAsso*)
   Container* toContainer;    // only one: (choose a rule TGZ or TAR+GZ)
   time_t     uploadTime;     // uploaded archive (from INC container)
   char*      imgExtractionPath; // image extraction path (from IMG container)
   int        incInherency;   // is a new incoming (even by inherency)
   float      extractScore;   // computed value used by cache
-
-  // documentTree related data
-  RG* documents;
-  RG* assoCaracs;
-
-  // recordTree related data
-  RG* records; // related record to destroy if we remove this archive
+  int        toRescore;      // into the extractTree->toRescore ring
 
   // cacheTree related to data
   AState  state;
-  RG*     demands;        // Record*
-  RG*     remoteSupplies; // Record*
-  RG*     finalSupplies;  // Record*
   Record* localSupply;
   int     nbKeep;
   time_t  backupDate;     // date to set after last unkeep
+
+  // use the macros below to get them
+  RGS rings[AR_RINGS_MAX];
 };
 
+// access to the embedded rings
+#define arImages(self) (&(self)->rings[AR_IMAGES].ring)
+#define arFromContainers(self) (&(self)->rings[AR_FROM_CONTAINERS].ring)
+#define arDocuments(self) (&(self)->rings[AR_DOCUMENTS].ring)
+#define arAssoCaracs(self) (&(self)->rings[AR_ASSO_CARACS].ring)
+#define arRecords(self) (&(self)->rings[AR_RECORDS].ring)
+#define arDemands(self) (&(self)->rings[AR_DEMANDS].ring)
+#define arRemoteSupplies(self) (&(self)->rings[AR_REMOTE_SUPPLIES].ring)
+#define arFinalSupplies(self) (&(self)->rings[AR_FINAL_SUPPLIES].ring)
+
 /* API */
 char* strAState(AState state);
 int cmpArchive(const void *p1, const void *p2);
 int cmpArchiveAvl(const void *p1, const void *p2);
 int cmpArchiveScore(const void *p1, const void *p2);
+int cmpArchiveScoreAvl(const void *p1, const void *p2);
 Archive* getArchive(Collection* coll, char* hash, off_t size);
 Archive* addArchive(Collection* coll, char* hash, off_t size);
 
@@ -71,6 +71,61 @@ rgDestroy(RGIT* item)
 }
 
 
+/*=======================================================================
+ * Function   : rgAlloc
+ * Description: Get an item for the ring, from its inline cells if
+ *              one is free
+ * Synopsis   : static RGIT* rgAlloc(RG* ring)
+ * Input      : RG *ring = the ring the item is for
+ * Output     : RGIT *item = the item; nil if the allocation faled.
+ =======================================================================*/
+static RGIT* 
+rgAlloc(RG* ring)
+{
+  RGIT *item = 0;
+  int i = 0;
+
+  if (ring->cells) {
+    for (i = 0; i < RGS_CELLS; ++i) {
+      if (ring->cells & (2 << i)) continue;
+      ring->cells |= (2 << i);
+      item = ((RGS*)ring)->cells + i;
+      item->next = item->prev = (RGIT *)0;
+      item->it = (void *)0;
+      goto end;
+    }
+  }
+
+  item = rgCreate();
+ end:
+  return(item);
+}
+
+/*=======================================================================
+ * Function   : rgFree
+ * Description: Release an item of the ring
+ * Synopsis   : static void rgFree(RG* ring, RGIT* item)
+ * Input      : RG *ring = the ring the item was for
+ *              RGIT *item = address returned by rgAlloc()
+ * Output     : N/A
+ =======================================================================*/
+static void 
+rgFree(RG* ring, RGIT* item)
+{
+  RGIT* cells = 0;
+
+  if (ring->cells) {
+    cells = ((RGS*)ring)->cells;
+    if (item >= cells && item < cells + RGS_CELLS) {
+      ring->cells &= ~(2 << (item - cells));
+      return;
+    }
+  }
+
+  rgDestroy(item);
+}
+
+
 /* rg */
 
 /*=======================================================================
@@ -91,6 +146,31 @@ rgInit(RG* ring)
   /*	allocate ring, initialise :	*/
   ring->head = ring->curr = ring->tail = (RGIT *)0;
   ring->nbItems = 0;
+  ring->cells = 0;
+ error:
+  return;
+}
+
+/*=======================================================================
+ * Function   : rgInitCompact
+ * Description: Initialise a ring having inline cells, so as its first
+ *              RGS_CELLS items are not malloc'ed.
+ * Synopsis   : void rgInitCompact(RGS* self)
+ * Input      : RGS *self = address of the ring to initialise.
+ * Output     : N/A
+ * Note       : such a ring is embedded into its owner: use rgDelete
+ *              instead of destroyRing or destroyOnlyRing.
+ =======================================================================*/
+void 
+rgInitCompact(RGS* self)
+{
+  if(self == (RGS *)0) {	
+    logMemory(LOG_ERR, "please do not provide an empty ring");
+    goto error;
+  }
+
+  rgInit(&self->ring);
+  self->ring.cells = 1;
  error:
   return;
 }
@@ -114,7 +194,7 @@ rgDelete(RG* ring)
 
   while (ring->head != (RGIT *)0) {
     temp = ring->head->next;
-    rgDestroy(ring->head);
+    rgFree(ring, ring->head);
     ring->head = temp;
   }
 	
@@ -143,7 +223,7 @@ rgInsert(RG* ring, void* it)
     goto error;
   }
 
-  if ((item = rgCreate()) == 0) 
+  if ((item = rgAlloc(ring)) == 0) 
     goto error;
 
   item->it = it;	/*	:	content	*/
@@ -202,7 +282,7 @@ rgHeadInsert(RG* ring, void* it)
     goto error;
   }
 
-  if ((item = rgCreate()) == 0) 
+  if ((item = rgAlloc(ring)) == 0) 
     goto error;
 
   item->it = it;	/*	:	content	*/
@@ -246,12 +326,12 @@ rgRemove(RG* ring)
       /*	head of ring :	*/
       if(ring->head == ring->tail) {
 	/*	last element in ring :	*/
-	rgDestroy(ring->curr);
+	rgFree(ring, ring->curr);
 	ring->head = ring->tail = ring->curr = (RGIT *)0;
       }
       else {
 	temp = ring->head->next;
-	rgDestroy(ring->head);
+	rgFree(ring, ring->head);
 	ring->head = temp;
 	ring->head->prev = (RGIT *)0;
 	ring->curr = ring->head;
@@ -261,7 +341,7 @@ rgRemove(RG* ring)
       if(ring->curr == ring->tail) {	
 	/*	tail of ring :	*/
 	temp = ring->tail->prev;
-	rgDestroy(ring->tail);
+	rgFree(ring, ring->tail);
 	ring->tail = temp;
 	ring->tail->next = (RGIT *)0;
 	ring->curr = ring->tail;
@@ -271,7 +351,7 @@ rgRemove(RG* ring)
 	ring->curr->prev->next = ring->curr->next;
 	ring->curr->next->prev = ring->curr->prev;
 	temp = ring->curr->next;
-	rgDestroy(ring->curr);
+	rgFree(ring, ring->curr);
 	ring->curr = temp;
       }
     }
@@ -304,12 +384,12 @@ void rgRemove_r(RG* ring, RGIT** curr)
       // head of ring:
       if(ring->head == ring->tail) {
 	// last element in ring:
-	rgDestroy(*curr);
+	rgFree(ring, *curr);
 	ring->head = ring->tail = *curr = (RGIT *)0;
       }
       else {
 	temp = ring->head->next;
-	rgDestroy(ring->head);
+	rgFree(ring, ring->head);
 	ring->head = temp;
 	ring->head->prev = (RGIT *)0;
 	*curr = ring->head;
@@ -319,7 +399,7 @@ void rgRemove_r(RG* ring, RGIT** curr)
       if(*curr == ring->tail) {
 	// tail of ring:
 	temp = ring->tail->prev;
-	rgDestroy(ring->tail);
+	rgFree(ring, ring->tail);
 	ring->tail = temp;
 	ring->tail->next = (RGIT *)0;
 	*curr = ring->tail;
@@ -329,7 +409,7 @@ void rgRemove_r(RG* ring, RGIT** curr)
 	(*curr)->prev->next = (*curr)->next;
 	(*curr)->next->prev = (*curr)->prev;
 	temp = (*curr)->next;
-	rgDestroy(*curr);
+	rgFree(ring, *curr);
 	(*curr) = temp;
       }
     }
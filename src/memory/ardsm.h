@@ -39,8 +39,18 @@ typedef struct RG
   RGIT* curr;
   RGIT* tail;
   int nbItems;
+  int cells;  /*  inline cells: 1 if any, then one bit per used cell  */
 } RG;
 
+/* number of items a compact ring stores without malloc */
+#define RGS_CELLS 2
+
+typedef struct RGS
+{   /*  RinG with inline Storage (cf rgInitCompact) :  */
+  RG   ring;
+  RGIT cells[RGS_CELLS];
+} RGS;
+
 /* void* rgNext_r(RG* ring, RGIT** curr) provided as a macro */
 #define rgNext_r(ring, curr)				\
 (ring->head?						\
@@ -59,6 +69,7 @@ typedef struct RG
 RGIT* rgCreate(void);
 void rgDestroy(RGIT* item);
 void rgInit(RG* ring);
+void rgInitCompact(RGS* self);
 void rgDelete(RG* ring);
 int rgInsert(RG* ring, void *item);
 int rgInsert_r(RG* ring, void *item, RGIT** curr);
@@ -23,6 +23,150 @@
 
 #include "mediatex-config.h"
 
+// the trees of 2 configurations may write the same journal (cf SIGHUP)
+static pthread_mutex_t journalMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// collection whose cache tree is in use
+typedef struct CacheOwner {
+  Collection* coll;
+  int nbUsers;
+} CacheOwner;
+
+// only one configuration uses the cache of a collection at once, so
+// as 2 trees never account the same cache directory (cf SIGHUP)
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  CacheOwner owners[MAX_CACHE_OWNER];
+  int nbOwners;
+} cacheOwners = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+/*=======================================================================
+ * Function   : acquireCacheOwner
+ * Description: Wait until no other configuration uses the cache
+ * Synopsis   : int acquireCacheOwner(Collection* coll)
+ * Input      : Collection* coll: collection from our configuration
+ * Output     : TRUE on success
+ * Note       : call before to load the records.
+ *              After a SIGHUP, the new configuration waits for the jobs
+ *              of the previous one to release the cache; and then
+ *              parses the records again, with their journal. The
+ *              previous configuration cannot use it again, as its
+ *              trees would not see the new changes.
+ =======================================================================*/
+int
+acquireCacheOwner(Collection* coll)
+{
+  int rc = FALSE;
+  CacheOwner* owner = 0;
+  int isWaiting = FALSE;
+  int err = 0;
+  int i = 0;
+
+  checkCollection(coll);
+  logMemory(LOG_DEBUG, "acquire %s cache", coll->label);
+
+  if ((err = pthread_mutex_lock(&cacheOwners.mutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  while (1) {
+    owner = 0;
+    for (i = 0; i < cacheOwners.nbOwners; ++i) {
+      if (!strncmp(cacheOwners.owners[i].coll->label, coll->label, 
+		   MAX_SIZE_COLL)) {
+	owner = cacheOwners.owners + i;
+	break;
+      }
+    }
+    if (owner && owner->coll == coll) break;
+    if (!isCurrentConfiguration(getConfiguration())) {
+      logMemory(LOG_WARNING, "%s cache belongs to the new configuration",
+		coll->label);
+      goto error2;
+    }
+    if (!owner) break;
+
+    if (!isWaiting) {
+      logMemory(LOG_NOTICE, "wait for the previous configuration to "
+		"release the %s cache", coll->label);
+      isWaiting = TRUE;
+    }
+    pthread_cond_wait(&cacheOwners.cond, &cacheOwners.mutex);
+  }
+
+  if (!owner) {
+    if (cacheOwners.nbOwners == MAX_CACHE_OWNER) {
+      logMemory(LOG_ERR, "too many collections using their cache");
+      goto error2;
+    }
+    owner = cacheOwners.owners + cacheOwners.nbOwners++;
+    owner->coll = coll;
+    owner->nbUsers = 0;
+  }
+  ++owner->nbUsers;
+
+  rc = TRUE;
+ error2:
+  if ((err = pthread_mutex_unlock(&cacheOwners.mutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "acquireCacheOwner fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : releaseCacheOwner
+ * Description: Let other configurations use the cache
+ * Synopsis   : int releaseCacheOwner(Collection* coll)
+ * Input      : Collection* coll: collection from our configuration
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+releaseCacheOwner(Collection* coll)
+{
+  int rc = FALSE;
+  int err = 0;
+  int i = 0;
+
+  checkCollection(coll);
+  logMemory(LOG_DEBUG, "release %s cache", coll->label);
+
+  if ((err = pthread_mutex_lock(&cacheOwners.mutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  for (i = 0; i < cacheOwners.nbOwners; ++i) {
+    if (cacheOwners.owners[i].coll == coll) break;
+  }
+  if (i == cacheOwners.nbOwners) {
+    logMemory(LOG_ERR, "%s cache was not acquired", coll->label);
+    goto error2;
+  }
+  if (--cacheOwners.owners[i].nbUsers == 0) {
+    cacheOwners.owners[i] = cacheOwners.owners[--cacheOwners.nbOwners];
+    pthread_cond_broadcast(&cacheOwners.cond);
+  }
+
+  rc = TRUE;
+ error2:
+  if ((err = pthread_mutex_unlock(&cacheOwners.mutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "releaseCacheOwner fails");
+  }
+  return rc;
+}
+
 
 /*=======================================================================
  * Function   : lockCacheRead
@@ -37,16 +181,19 @@
 int lockCacheRead(Collection* coll)
 {
   int rc = FALSE;
+  struct timespec start;
   int err = 0;
  
   checkCollection(coll);
   logMemory(LOG_DEBUG, "lock cache for read");
  
   // lock R
+  perfBegin(start);
   if ((err = pthread_rwlock_rdlock(coll->cacheTree->rwlock))) {
     logMemory(LOG_ERR, "pthread_rdlock_rdlock fails: %s", strerror(err));
     goto error;
   }
+  perfEnd(PERF_LOCK_READ, start, 0);
 
   rc = TRUE;
  error:
@@ -66,16 +213,19 @@ int lockCacheRead(Collection* coll)
 int lockCacheWrite(Collection* coll)
 {
   int rc = FALSE;
+  struct timespec start;
   int err = 0;
  
   checkCollection(coll);
   logMemory(LOG_DEBUG, "lock cache for write");
  
   // lock W
+  perfBegin(start);
   if ((err = pthread_rwlock_wrlock(coll->cacheTree->rwlock))) {
     logMemory(LOG_ERR, "pthread_rwlock_wrlock fails: %s", strerror(err));
     goto error;
   }
+  perfEnd(PERF_LOCK_WRITE, start, 0);
 
   rc = TRUE;
  error:
@@ -116,6 +266,40 @@ int unLockCache(Collection* coll)
 }
 
 
+/*=======================================================================
+ * Function   : cmpCacheLookup
+ * Description: compare 2 cgi lookup results
+ * Synopsis   : int cmpCacheLookup(const void *p1, const void *p2)
+ * Input      : const void *p1, const void *p2 : the lookup results
+ * Output     : <, = or >0 respectively for lower, equal or greater
+ =======================================================================*/
+static int 
+cmpCacheLookup(const void *p1, const void *p2)
+{
+  int rc = 0;
+  CacheLookup* l1 = (CacheLookup*)p1;
+  CacheLookup* l2 = (CacheLookup*)p2;
+
+  rc = strncmp(l1->hash, l2->hash, MAX_SIZE_MD5);
+  if (!rc) rc = (l1->size > l2->size) - (l1->size < l2->size);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : destroyCacheLookup
+ * Description: free a cgi lookup result
+ * Synopsis   : static void destroyCacheLookup(CacheLookup* self)
+ * Input      : CacheLookup* self = what to free
+ * Output     : N/A
+ =======================================================================*/
+static void 
+destroyCacheLookup(CacheLookup* self)
+{
+  if (self == 0) return;
+  destroyString(self->status);
+  free(self);
+}
+
 /*=======================================================================
  * Function   : createCacheTree
  * Description: Create, by memory allocation a md5 merger
@@ -134,6 +318,7 @@ createCacheTree(void)
     goto error;
    
   memset(rc, 0, sizeof(CacheTree));
+  rc->journalFd = -1;
   
   if ((rc->recordTree = createRecordTree()) == 0)
     goto error;
@@ -143,6 +328,10 @@ createCacheTree(void)
 	avl_alloc_tree(cmpArchiveAvl, (avl_freeitem_t)0)))
     goto error;
 
+  if (!(rc->lookups =
+	avl_alloc_tree(cmpCacheLookup, (avl_freeitem_t)destroyCacheLookup)))
+    goto error;
+
   // init the locks
 
   if ((rc->attr = malloc(sizeof(pthread_rwlockattr_t))) == 0) {
@@ -174,6 +363,14 @@ createCacheTree(void)
     }
   }
 
+  for (i=0; i<CACHE_STATE_SHARDS; ++i) {
+    if ((err = pthread_mutex_init(&rc->stateMutex[i], 
+				  (pthread_mutexattr_t*)0)) != 0) {
+      logMemory(LOG_INFO, "pthread_mutex_init: %s", strerror(err));
+      goto error;
+    }
+  }
+
   return rc;
  error:
   logMemory(LOG_ERR, "malloc: cannot create Record");
@@ -197,9 +394,11 @@ destroyCacheTree(CacheTree* self)
   if(self == 0) goto error;
 
   self->recordTree = destroyRecordTree(self->recordTree);
+  if (self->journalFd != -1) close(self->journalFd);
 
   // do not free archives (freeitem callback = NULL)
   avl_free_tree(self->archives);
+  if (self->lookups) avl_free_tree(self->lookups);
   
   pthread_rwlock_destroy(self->rwlock);
   pthread_rwlockattr_destroy(self->attr);
@@ -214,12 +413,42 @@ destroyCacheTree(CacheTree* self)
       goto error;
     }
   }
+
+  for (i=0; i<CACHE_STATE_SHARDS; ++i) {
+    if ((err = pthread_mutex_destroy(&self->stateMutex[i]))) {
+      logMemory(LOG_INFO, "pthread_mutex_init: %s", strerror(err));
+      goto error;
+    }
+  }
   
   free(self);
  error:
   return (CacheTree*)0;
 }
 
+/*=======================================================================
+ * Function   : getArchiveMutex
+ * Description: Get the mutex protecting an archive's state
+ * Synopsis   : static pthread_mutex_t* getArchiveMutex(CacheTree* cache,
+ *                                                   Archive* archive)
+ * Input      : CacheTree* cache
+ *              Archive* archive
+ * Output     : the archive's shard mutex
+ * Note       : md5sums are uniformly distributed, so their first
+ *              digits are enough to spread the archives
+ =======================================================================*/
+static pthread_mutex_t*
+getArchiveMutex(CacheTree* cache, Archive* archive)
+{
+  unsigned int i = 0;
+  int j = 0;
+
+  for (j=0; j<4 && archive->hash[j]; ++j) {
+    i = i*31 + archive->hash[j];
+  }
+  return &cache->stateMutex[i % CACHE_STATE_SHARDS];
+}
+
 /*=======================================================================
  * Function   : haveRecords
  * Description: int haveRecords(RG* ring)
@@ -251,42 +480,42 @@ haveRecords(RG* ring)
  * Input      : Archive* self = the archive
  * Output     : TRUE on success
  * Requirement: loadCollection(coll, SERV)
- * Note       : This function and only this one use the
- *              MUTEX_COMPUTE mutex so as to be threads-safe
+ * Note       : Only the archive's state mutex is locked, so as
+ *              states of different archives are computed concurrently
  =======================================================================*/
 int 
 computeArchiveStatus(Collection* coll, Archive* archive)
 {
   int rc = FALSE;
-  CacheTree* cache = 0;
+  pthread_mutex_t* mutex = 0;
   AState previousState = UNUSED;
   time_t date = -1;
   int err = 0;
 
   checkCollection(coll);
   checkArchive(archive);
-  cache = coll->cacheTree;
-  previousState = archive->state;
+  mutex = getArchiveMutex(coll->cacheTree, archive);
   logMemory(LOG_DEBUG, "computeArchiveStatus %s:%lli",   
 	    archive->hash, archive->size);
 
   if ((date = currentTime()) == -1) goto error; 
 
-  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_COMPUTE]))) {
+  if ((err = pthread_mutex_lock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
+  previousState = archive->state;
 
   // default state: unused
   archive->state = UNUSED;
 
   // state1: used
-  if (haveRecords(archive->finalSupplies) ||
-      haveRecords(archive->remoteSupplies))
+  if (haveRecords(arFinalSupplies(archive)) ||
+      haveRecords(arRemoteSupplies(archive)))
     archive->state = USED;
 
   // state 2: wanted
-  if (haveRecords(archive->demands)) archive->state = WANTED;
+  if (haveRecords(arDemands(archive))) archive->state = WANTED;
   if (archive->localSupply == 0 ||
       (archive->localSupply->type & REMOVE)) goto end;
 
@@ -312,7 +541,7 @@ computeArchiveStatus(Collection* coll, Archive* archive)
   // - wanted
   // - having a bad score (incoming included)
   // - still in use for extraction
-  if (haveRecords(archive->demands) ||
+  if (haveRecords(arDemands(archive)) ||
       archive->extractScore <= coll->serverTree->scoreParam.maxScore /2
       || archive->localSupply->date > date) {
     archive->state = TOKEEP;
@@ -326,23 +555,23 @@ computeArchiveStatus(Collection* coll, Archive* archive)
 
   // become allocated
   if (previousState < ALLOCATED && archive->state >= ALLOCATED)
-    coll->cacheTree->useSize += archive->size;
+    __sync_add_and_fetch(&coll->cacheTree->useSize, archive->size);
 
   // become unavailable
   if (previousState >= ALLOCATED && archive->state < ALLOCATED)
-    coll->cacheTree->useSize -= archive->size;
+    __sync_sub_and_fetch(&coll->cacheTree->useSize, archive->size);
 
   // become to be keept
   if (previousState < TOKEEP && archive->state >= TOKEEP)
-    coll->cacheTree->frozenSize += archive->size;
+    __sync_add_and_fetch(&coll->cacheTree->frozenSize, archive->size);
 
   // become not to keept anymore
   if (previousState >= TOKEEP && archive->state < TOKEEP)
-    coll->cacheTree->frozenSize -= archive->size;
+    __sync_sub_and_fetch(&coll->cacheTree->frozenSize, archive->size);
 
   rc = TRUE;
  error2:
-  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_COMPUTE]))) {
+  if ((err = pthread_mutex_unlock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
@@ -354,6 +583,60 @@ computeArchiveStatus(Collection* coll, Archive* archive)
 }
 
 
+/*=======================================================================
+ * Function   : delCacheLookup
+ * Description: Forget the cgi lookup result for an archive
+ * Synopsis   : static int delCacheLookup(Collection* coll, 
+ *                                        Record* record)
+ * Input      : Collection* coll: the collection we use
+ *              Record* record: supply record added or removed
+ * Output     : TRUE on success
+ * Note       : demands are not related to the cgi lookup results
+ *              (cgi queries add and remove a temporary one).
+ *              Any supply may provide a container, so not found
+ *              results are all outdated by the epoch increment.
+ =======================================================================*/
+static int 
+delCacheLookup(Collection* coll, Record* record)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  CacheLookup lookup;
+  AVLNode* node = 0;
+  int err = 0;
+
+  if (!(getRecordType(record) & (ALL_SUPPLY | MALLOC_SUPPLY))) goto end;
+  cache = coll->cacheTree;
+
+  strncpy(lookup.hash, record->archive->hash, MAX_SIZE_MD5+1);
+  lookup.size = record->archive->size;
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  // results computed concurrently must not be recorded
+  ++cache->lookupEpoch;
+  if ((node = avl_search(cache->lookups, &lookup))) {
+    logMemory(LOG_DEBUG, "forget cgi lookup for %s:%lli",
+	      lookup.hash, (long long int)lookup.size);
+    avl_delete_node(cache->lookups, node);
+  }
+
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "delCacheLookup fails");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : addCacheEntry
  * Description: Add a record to the collection's cache tree
@@ -421,17 +704,17 @@ int addCacheEntry(Collection* coll, Record* record)
     break;
       
   case FINAL_SUPPLY:
-    if (!rgInsert(archive->finalSupplies, record)) goto error;
+    if (!rgInsert(arFinalSupplies(archive), record)) goto error;
     break;
 
   case REMOTE_SUPPLY:
-    if (!rgInsert(archive->remoteSupplies, record)) goto error;
+    if (!rgInsert(arRemoteSupplies(archive), record)) goto error;
     break;
 
   case FINAL_DEMAND:
   case LOCAL_DEMAND:
   case REMOTE_DEMAND:
-    if (!rgInsert(archive->demands, record)) goto error;
+    if (!rgInsert(arDemands(archive), record)) goto error;
     break;
 
   default:
@@ -441,6 +724,8 @@ int addCacheEntry(Collection* coll, Record* record)
 
   // update archive status
   if (!computeArchiveStatus(coll, archive)) goto error;
+  if (!delCacheLookup(coll, record)) goto error;
+  if (!journalCacheEntry(coll, record)) goto error;
 
   /*
   // openClose mutex
@@ -493,10 +778,15 @@ int delCacheEntry(Collection* coll, Record* record)
 	    strRecordType(record), record->server->fingerPrint, 
 	    record->archive->hash, (long long int)record->archive->size);
 
+  // callers may have set REMOVE before (cf deliverArchive):
+  // always count, unIndexRemoved resets the counter
   record->type |= REMOVE;
+  __sync_add_and_fetch(&coll->cacheTree->nbRemoved, 1);
 
   // update archive state
   if (!computeArchiveStatus(coll, record->archive)) goto error;
+  if (!delCacheLookup(coll, record)) goto error;
+  if (!journalCacheEntry(coll, record)) goto error;
 
   /*
     if ((err = pthread_mutex_lock(&coll->mutex[iCACH]))) {
@@ -522,6 +812,535 @@ int delCacheEntry(Collection* coll, Record* record)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : getCacheEntry
+ * Description: Find the cache record having the same ids
+ * Synopsis   : Record* getCacheEntry(Collection* coll, Record* record)
+ * Input      : Collection* coll: the collection we use
+ *              Record* record: record to match (date is not compared)
+ * Output     : the not removed record indexed into the cache, or 0
+ =======================================================================*/
+Record* 
+getCacheEntry(Collection* coll, Record* record)
+{
+  Record* rc = 0;
+  Record* entry = 0;
+  Archive* archive = 0;
+  RG* ring = 0;
+  RGIT* curr = 0;
+  int type = 0;
+
+  checkCollection(coll);
+  checkRecord(record);
+  archive = record->archive;
+  type = record->type & ~REMOVE;
+
+  switch (getRecordType(record)) {
+  case MALLOC_SUPPLY:
+  case LOCAL_SUPPLY:
+    entry = archive->localSupply;
+    if (entry && entry != record && !(entry->type & REMOVE) &&
+	entry->server == record->server && entry->type == type &&
+	!strcmp(entry->extra?entry->extra:"", 
+		record->extra?record->extra:"")) {
+      rc = entry;
+    }
+    goto end;
+  case FINAL_SUPPLY:
+    ring = arFinalSupplies(archive);
+    break;
+  case REMOTE_SUPPLY:
+    ring = arRemoteSupplies(archive);
+    break;
+  case FINAL_DEMAND:
+  case LOCAL_DEMAND:
+  case REMOTE_DEMAND:
+    ring = arDemands(archive);
+    break;
+  default:
+    goto end;
+  }
+
+  while ((entry = rgNext_r(ring, &curr))) {
+    if (entry == record || (entry->type & REMOVE)) continue;
+    if (entry->server != record->server || entry->type != type) continue;
+    if (strcmp(entry->extra?entry->extra:"", 
+	       record->extra?record->extra:"")) continue;
+    rc = entry;
+    break;
+  }
+ end:
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : openCacheJournal
+ * Description: Open the records journal for appending
+ * Synopsis   : static int openCacheJournal(Collection* coll)
+ * Input      : Collection* coll: the collection we use
+ * Output     : TRUE on success
+ * Note       : called with MUTEX_JOURNAL and journalMutex locked
+ =======================================================================*/
+static int 
+openCacheJournal(Collection* coll)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  struct stat statBuffer;
+  int fd = -1;
+
+  cache = coll->cacheTree;
+  logMemory(LOG_DEBUG, "open records journal: %s", coll->md5sumsJnl);
+
+  if ((fd = open(coll->md5sumsJnl, O_WRONLY|O_APPEND|O_CREAT, 
+		 S_IRWXU|S_IRGRP)) == -1) {
+    logMemory(LOG_ERR, "open %s fails: %s", 
+	      coll->md5sumsJnl, strerror(errno));
+    goto error;
+  }
+  if (!lock(fd, F_WRLCK)) goto error;
+  if (fstat(fd, &statBuffer)) {
+    logMemory(LOG_ERR, "fstat fails: %s", strerror(errno));
+    unLock(fd);
+    goto error;
+  }
+  if (statBuffer.st_size == 0 && !serializeJournalHeader(coll, fd)) {
+    unLock(fd);
+    goto error;
+  }
+
+  // only account for the header we just wrote
+  if (statBuffer.st_size == 0 && cache->journalSize == 0) {
+    if (fstat(fd, &statBuffer)) {
+      logMemory(LOG_ERR, "fstat fails: %s", strerror(errno));
+      unLock(fd);
+      goto error;
+    }
+    cache->journalSize = statBuffer.st_size;
+  }
+  if (!unLock(fd)) goto error;
+
+  cache->journalFd = fd;
+  fd = -1;
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "openCacheJournal fails");
+  }
+  if (fd != -1) close(fd);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : journalCacheEntry
+ * Description: Append a record event to the records journal
+ * Synopsis   : int journalCacheEntry(Collection* coll, Record* record)
+ * Input      : Collection* coll: the collection we use
+ *              Record* record: the added record (or removed one if
+ *                              marked REMOVE)
+ * Output     : TRUE on success
+ * Note       : call by addCacheEntry and delCacheEntry, and by the
+ *              server when it modify a record in place.
+ *              Only the records serialized on disk are journaled.
+ *              The journal must only grow by our own events, else
+ *              another tree writes it too (cf checkCacheJournal).
+ =======================================================================*/
+int 
+journalCacheEntry(Collection* coll, Record* record)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  struct stat statBuffer;
+  int isLocked = FALSE;
+  int err = 0;
+
+  checkCollection(coll);
+  checkRecord(record);
+  cache = coll->cacheTree;
+
+  // unit tests print the whole records tree (cf saveRecords)
+  if (env.dryRun || cache->noJournal) goto end;
+
+  switch (getRecordType(record)) {
+  case LOCAL_SUPPLY:
+  case REMOTE_SUPPLY:
+  case FINAL_DEMAND:
+  case LOCAL_DEMAND:
+  case REMOTE_DEMAND:
+    break;
+  default:
+    goto end; // not serialized on disk
+  }
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  if ((err = pthread_mutex_lock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error2;
+  }
+
+  // the journal was compacted by another tree: write a new one
+  if (cache->journalFd != -1) {
+    if (fstat(cache->journalFd, &statBuffer)) {
+      logMemory(LOG_ERR, "fstat fails: %s", strerror(errno));
+      goto error3;
+    }
+    if (statBuffer.st_nlink == 0) {
+      close(cache->journalFd);
+      cache->journalFd = -1;
+    }
+  }
+
+  if (cache->journalFd == -1 && !openCacheJournal(coll)) goto error3;
+  if (!lock(cache->journalFd, F_WRLCK)) goto error3;
+  isLocked = TRUE;
+
+  // events we did not write come from another tree
+  if (fstat(cache->journalFd, &statBuffer)) {
+    logMemory(LOG_ERR, "fstat fails: %s", strerror(errno));
+    goto error3;
+  }
+  if (statBuffer.st_size != cache->journalSize) cache->isSharedJournal = TRUE;
+
+  if (!serializeJournalRecord(record, cache->journalFd)) goto error3;
+  ++cache->nbJournal;
+  if (fstat(cache->journalFd, &statBuffer)) {
+    logMemory(LOG_ERR, "fstat fails: %s", strerror(errno));
+    goto error3;
+  }
+  cache->journalSize = statBuffer.st_size;
+  rc = TRUE;
+
+ error3:
+  if (isLocked && !unLock(cache->journalFd)) rc = FALSE;
+  if ((err = pthread_mutex_unlock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error2:
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+  if (!rc) goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "journalCacheEntry fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : resetCacheJournal
+ * Description: Remove the records journal
+ * Synopsis   : int resetCacheJournal(Collection* coll)
+ * Input      : Collection* coll: the collection we use
+ * Output     : TRUE on success
+ * Note       : to call once a new snapshot includes the journal.
+ *              The journal is kept if another tree wrote it meanwhile:
+ *              as replay is idempotent, the new snapshot plus the
+ *              whole journal still give all the events.
+ =======================================================================*/
+int 
+resetCacheJournal(Collection* coll)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  struct stat statBuffer;
+  int err = 0;
+
+  checkCollection(coll);
+  cache = coll->cacheTree;
+  logMemory(LOG_DEBUG, "reset records journal: %s", coll->md5sumsJnl);
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  if ((err = pthread_mutex_lock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error2;
+  }
+
+  if (stat(coll->md5sumsJnl, &statBuffer) == 0) {
+    if (statBuffer.st_size != cache->journalSize) {
+      cache->isSharedJournal = TRUE;
+      logMemory(LOG_NOTICE, "keep %s: written by another tree",
+		coll->md5sumsJnl);
+      rc = TRUE;
+      goto error3;
+    }
+    if (unlink(coll->md5sumsJnl) == -1 && errno != ENOENT) {
+      logMemory(LOG_ERR, "unlink %s fails: %s", 
+		coll->md5sumsJnl, strerror(errno));
+      goto error3;
+    }
+  }
+  else if (errno != ENOENT) {
+    logMemory(LOG_ERR, "stat %s fails: %s", 
+	      coll->md5sumsJnl, strerror(errno));
+    goto error3;
+  }
+
+  rc = TRUE;
+  if (cache->journalFd != -1) {
+    if (close(cache->journalFd)) {
+      logMemory(LOG_ERR, "close fails: %s", strerror(errno));
+      rc = FALSE;
+    }
+    cache->journalFd = -1;
+  }
+  cache->nbJournal = 0;
+  cache->journalSize = 0;
+
+ error3:
+  if ((err = pthread_mutex_unlock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error2:
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "resetCacheJournal fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : checkCacheJournal
+ * Description: Tell if another tree writes the records journal too
+ * Synopsis   : int checkCacheJournal(Collection* coll)
+ * Input      : Collection* coll: the collection we use
+ * Output     : TRUE if the journal only holds the events we know
+ * Note       : after a SIGHUP, a job still using the previous
+ *              configuration keeps its own cache tree (cf
+ *              adoptCollection). Compacting from one tree would lose
+ *              the events of the other one, so the journal is then
+ *              kept until the records are loaded again.
+ =======================================================================*/
+int 
+checkCacheJournal(Collection* coll)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  struct stat statBuffer;
+  off_t size = 0;
+  int err = 0;
+
+  checkCollection(coll);
+  cache = coll->cacheTree;
+  logMemory(LOG_DEBUG, "check records journal: %s", coll->md5sumsJnl);
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  if ((err = pthread_mutex_lock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error2;
+  }
+
+  if (stat(coll->md5sumsJnl, &statBuffer) == 0) {
+    size = statBuffer.st_size;
+  }
+  else if (errno != ENOENT) {
+    logMemory(LOG_ERR, "stat %s fails: %s", 
+	      coll->md5sumsJnl, strerror(errno));
+    cache->isSharedJournal = TRUE; // do not take the risk
+  }
+  if (size != cache->journalSize) cache->isSharedJournal = TRUE;
+  rc = !cache->isSharedJournal;
+
+  if ((err = pthread_mutex_unlock(&journalMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error2:
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_JOURNAL]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : getCacheLookup
+ * Description: Retrieve a previous cgi lookup result
+ * Synopsis   : int getCacheLookup(Collection* coll, Archive* archive, 
+ *                                 char* status, int* isHit, int* epoch)
+ * Input      : Collection* coll: the collection we use
+ *              Archive* archive: archive looked for
+ * Output     : char* status: the reply to send (on hit)
+ *              int* isHit: TRUE if a still valid result was found
+ *              int* epoch: to provide to addCacheLookup (on miss)
+ *              TRUE on success
+ * Note       : do not need the cache lock (MUTEX_LOOKUP only)
+ =======================================================================*/
+int 
+getCacheLookup(Collection* coll, Archive* archive, char* status,
+	       int* isHit, int* epoch)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  CacheLookup lookup;
+  CacheLookup* result = 0;
+  AVLNode* node = 0;
+  time_t now = 0;
+  int err = 0;
+
+  checkCollection(coll);
+  checkArchive(archive);
+  cache = coll->cacheTree;
+  *isHit = FALSE;
+  
+  if ((now = currentTime()) == -1) goto error;
+  strncpy(lookup.hash, archive->hash, MAX_SIZE_MD5+1);
+  lookup.size = archive->size;
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  if ((node = avl_search(cache->lookups, &lookup))) {
+    result = node->item;
+    if (result->date > now &&
+	(result->found || result->epoch == cache->lookupEpoch)) {
+      strcpy(status, result->status);
+      *isHit = TRUE;
+    }
+    else {
+      avl_delete_node(cache->lookups, node);
+    }
+  }
+
+  if (*isHit) {
+    ++cache->lookupHits;
+  }
+  else {
+    ++cache->lookupMisses;
+  }
+  *epoch = cache->lookupEpoch;
+
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    goto error;
+  }
+
+  logMemory(LOG_DEBUG, "cgi lookup for %s:%lli: %s", 
+	    archive->hash, (long long int)archive->size,
+	    *isHit?"hit":"miss");
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "getCacheLookup fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : addCacheLookup
+ * Description: Record a cgi lookup result
+ * Synopsis   : int addCacheLookup(Collection* coll, Archive* archive, 
+ *                                 char* status, int found, int epoch)
+ * Input      : Collection* coll: the collection we use
+ *              Archive* archive: archive looked for
+ *              char* status: the reply sent
+ *              int found: TRUE if the archive was available
+ *              int epoch: value provided by getCacheLookup
+ * Output     : TRUE on success
+ * Note       : nothing is recorded if a supply changed meanwhile.
+ *              When full, expired and then oldest results are dropped.
+ =======================================================================*/
+int 
+addCacheLookup(Collection* coll, Archive* archive, char* status,
+	       int found, int epoch)
+{
+  int rc = FALSE;
+  CacheTree* cache = 0;
+  CacheLookup* lookup = 0;
+  CacheLookup* result = 0;
+  AVLNode* node = 0;
+  AVLNode* next = 0;
+  AVLNode* oldest = 0;
+  time_t now = 0;
+  int err = 0;
+
+  checkCollection(coll);
+  checkArchive(archive);
+  cache = coll->cacheTree;
+
+  if ((now = currentTime()) == -1) goto error;
+  if (!(lookup = malloc(sizeof(CacheLookup)))) {
+    logMemory(LOG_ERR, "cannot malloc CacheLookup");
+    goto error;
+  }
+  memset(lookup, 0, sizeof(CacheLookup));
+  strncpy(lookup->hash, archive->hash, MAX_SIZE_MD5+1);
+  lookup->size = archive->size;
+  lookup->date = now + (found ? LOOKUP_TTL_FOUND : LOOKUP_TTL_NOTFOUND);
+  lookup->found = found;
+  lookup->epoch = epoch;
+  if (!(lookup->status = createString(status))) goto error;
+
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  if (epoch != cache->lookupEpoch) goto end;
+
+  // keep the tree bounded
+  if (avl_count(cache->lookups) >= MAX_CACHE_LOOKUPS) {
+    for (node = cache->lookups->head; node; node = next) {
+      next = node->next;
+      result = node->item;
+      if (result->date <= now ||
+	  (!result->found && result->epoch != cache->lookupEpoch)) {
+	avl_delete_node(cache->lookups, node);
+	continue;
+      }
+      if (!oldest || result->date < ((CacheLookup*)oldest->item)->date)
+	oldest = node;
+    }
+    if (avl_count(cache->lookups) >= MAX_CACHE_LOOKUPS && oldest) {
+      avl_delete_node(cache->lookups, oldest);
+    }
+  }
+
+  // replace a concurrent result if any
+  if ((node = avl_search(cache->lookups, lookup))) {
+    avl_delete_node(cache->lookups, node);
+  }
+  if (!avl_insert(cache->lookups, lookup)) {
+    logMemory(LOG_ERR, "cannot add cgi lookup result");
+    goto error2;
+  }
+  lookup = 0;
+ end:
+  rc = TRUE;
+ error2:
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = FALSE;
+  }
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "addCacheLookup fails");
+  }
+  destroyCacheLookup(lookup);
+  return rc;
+}
+
 /*=======================================================================
  * Function   : keepArchive
  * Description: keep archive on cache
@@ -532,8 +1351,8 @@ int delCacheEntry(Collection* coll, Record* record)
  *              RecordType type = use to compute time to keep
  * Output     : TRUE on success
  *
- * Note       : keepArchive and unKeepArchive are using MUTEX_KEEP
- *              manage the concurents calls.
+ * Note       : keepArchive and unKeepArchive are using the archive's
+ *              state mutex to manage the concurents calls.
  *              Keeping archive is only related to extraction delay, 
  *              but it is not related with scores 
  =======================================================================*/
@@ -543,7 +1362,9 @@ keepArchive(Collection* coll, Archive* archive)
   int rc = FALSE;
   CacheTree* cache = 0;
   Record* record = 0;
+  pthread_mutex_t* mutex = 0;
   time_t date = -1;
+  struct timespec start;
   int err = 0;
 
   checkCollection(coll);
@@ -551,6 +1372,7 @@ keepArchive(Collection* coll, Archive* archive)
   record = archive->localSupply;
   checkRecord(record);
   cache = coll->cacheTree;
+  mutex = getArchiveMutex(cache, archive);
   logMemory(LOG_DEBUG, "keep %s:%lli", archive->hash, archive->size); 
 
   if (record->type & REMOVE) {
@@ -559,12 +1381,14 @@ keepArchive(Collection* coll, Archive* archive)
     goto error;
   }
   
+  perfBegin(start);
   if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_ALLOC]))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
+  perfEnd(PERF_LOCK_ALLOC, start, 0);
   
-  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_KEEP]))) {
+  if ((err = pthread_mutex_lock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error2;
   }
@@ -572,7 +1396,7 @@ keepArchive(Collection* coll, Archive* archive)
   if (archive->nbKeep == 0) archive->backupDate = record->date;
   ++archive->nbKeep;
   
-  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_KEEP]))) {
+  if ((err = pthread_mutex_unlock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error2;
   }
@@ -616,7 +1440,7 @@ int
 unKeepArchive(Collection* coll, Archive* archive)
 {
   int rc = FALSE;
-  CacheTree* cache = 0;
+  pthread_mutex_t* mutex = 0;
   Record* record = 0;
   int err = 0;
 
@@ -624,7 +1448,7 @@ unKeepArchive(Collection* coll, Archive* archive)
   checkArchive(archive);
   record = archive->localSupply;
   checkRecord(record);
-  cache = coll->cacheTree;
+  mutex = getArchiveMutex(coll->cacheTree, archive);
   logMemory(LOG_DEBUG, "un keep %s:%lli",   
 	    archive->hash, archive->size); 
   
@@ -634,7 +1458,7 @@ unKeepArchive(Collection* coll, Archive* archive)
     goto error;
   }
  
-  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_KEEP]))) {
+  if ((err = pthread_mutex_lock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
@@ -643,7 +1467,7 @@ unKeepArchive(Collection* coll, Archive* archive)
   if (archive->nbKeep == 0) record->date = archive->backupDate;
   archive->backupDate = 0;
 
-  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_KEEP]))) {
+  if ((err = pthread_mutex_unlock(mutex))) {
     logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
@@ -659,13 +1483,15 @@ unKeepArchive(Collection* coll, Archive* archive)
 }
 
 /*=======================================================================
- * Function   : cleanCacheTree
+ * Function   : unIndexRemoved
  * Description: Remove record marked as removed from the cache tree
- * Synopsis   : int cleanCacheTree(Collection* coll)
+ * Synopsis   : static int unIndexRemoved(Collection* coll)
  * Input      : Collection* coll: the collection to use
  * Output     : TRUE on success
+ * Note       : the cache must be locked for writing
  =======================================================================*/
-int cleanCacheTree(Collection* coll)
+static int
+unIndexRemoved(Collection* coll)
 {
   int rc = FALSE;
   AVLTree* records = 0;
@@ -674,10 +1500,6 @@ int cleanCacheTree(Collection* coll)
   AVLNode* node = 0;
   AVLNode* next = 0;
 
-  checkCollection(coll);
-  logMemory(LOG_DEBUG, "cleanCacheTree %s", coll->label);
-  if (!lockCacheWrite(coll)) goto error;
-
   // for all records marked as "removed"
   records = coll->cacheTree->recordTree->records;
   node = records->head;
@@ -699,21 +1521,21 @@ int cleanCacheTree(Collection* coll)
       }
       break;
     case FINAL_SUPPLY:
-      rgDelItem(archive->finalSupplies, record);
+      rgDelItem(arFinalSupplies(archive), record);
       break;
     case REMOTE_SUPPLY:
-      rgDelItem(archive->remoteSupplies, record);
+      rgDelItem(arRemoteSupplies(archive), record);
       break;
     case FINAL_DEMAND:
     case LOCAL_DEMAND:
     case REMOTE_DEMAND:
-      rgDelItem(archive->demands, record);
+      rgDelItem(arDemands(archive), record);
       break;
       
     default:
       logMemory(LOG_ERR, "cannot unindex %s record",
 		strRecordType(record));
-      goto error2;
+      goto error;
     }
 
     // remove record (record free by delRecord bellow)
@@ -731,14 +1553,42 @@ int cleanCacheTree(Collection* coll)
     }
 
     // try to disease archive
-    if (!diseaseArchive(coll, record->archive)) goto error2;  
+    if (!diseaseArchive(coll, record->archive)) goto error;  
 
     // remove the record as owned by cache->recordTree->records
-    if (!delRecord(coll, record)) goto error2;
+    if (!delRecord(coll, record)) goto error;
 
     node = next;
   }
 
+  // no more record marked REMOVE (no concurrent writer)
+  coll->cacheTree->nbRemoved = 0;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "unIndexRemoved fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cleanCacheTree
+ * Description: Remove record marked as removed from the cache tree
+ * Synopsis   : int cleanCacheTree(Collection* coll)
+ * Input      : Collection* coll: the collection to use
+ * Output     : TRUE on success
+ * Note       : wait for all the readers (cf reclaimCacheTree)
+ =======================================================================*/
+int cleanCacheTree(Collection* coll)
+{
+  int rc = FALSE;
+
+  checkCollection(coll);
+  logMemory(LOG_DEBUG, "cleanCacheTree %s", coll->label);
+  if (!lockCacheWrite(coll)) goto error;
+  if (!unIndexRemoved(coll)) goto error2;
+
   rc = TRUE;
  error2:
   if (!unLockCache(coll)) rc = FALSE;
@@ -749,6 +1599,50 @@ int cleanCacheTree(Collection* coll)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : reclaimCacheTree
+ * Description: Remove record marked as removed, if no thread is
+ *              reading the cache
+ * Synopsis   : int reclaimCacheTree(Collection* coll)
+ * Input      : Collection* coll: the collection to use
+ * Output     : TRUE on success (even if deferred)
+ * Note       : removed records are ignored by the readers, so they
+ *              may wait for the next call: we never queue behind a
+ *              long reader (ie: an extraction), as this would also
+ *              block the new readers.
+ =======================================================================*/
+int reclaimCacheTree(Collection* coll)
+{
+  int rc = FALSE;
+  int err = 0;
+
+  checkCollection(coll);
+  if (!coll->cacheTree->nbRemoved) goto end;
+  logMemory(LOG_DEBUG, "reclaimCacheTree %s", coll->label);
+
+  if ((err = pthread_rwlock_trywrlock(coll->cacheTree->rwlock))) {
+    if (err != EBUSY) {
+      logMemory(LOG_ERR, "pthread_rwlock_trywrlock fails: %s",
+		strerror(err));
+      goto error;
+    }
+    logMemory(LOG_INFO, "cache in use: %i removed records kept for now",
+	      coll->cacheTree->nbRemoved);
+    goto end;
+  }
+
+  rc = unIndexRemoved(coll);
+  if (!unLockCache(coll)) rc = FALSE;
+  if (!rc) goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "reclaimCacheTree fails");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : diseaseCacheTree
  * Description: Disease the cache tree
@@ -764,11 +1658,14 @@ int diseaseCacheTree(Collection* coll)
   AVLTree* tree = 0;
   AVLNode* node = 0;
   Record* record = 0;
+  int noJournal = FALSE;
 
   checkCollection(coll);
   logMemory(LOG_DEBUG, "disease %s cache tree", coll->label);
 
-  // for all records
+  // for all records (only in memory: do not journal it)
+  noJournal = coll->cacheTree->noJournal;
+  coll->cacheTree->noJournal = TRUE;
   if (!expandCollection(coll)) goto error;
   tree = coll->cacheTree->recordTree->records;
   for (node = tree->head; node; node = node->next) {
@@ -781,6 +1678,7 @@ int diseaseCacheTree(Collection* coll)
 
   rc = TRUE;
  error:
+  if (coll) coll->cacheTree->noJournal = noJournal;
   if (!rc) logMemory(LOG_ERR, "diseaseCacheTree fails");
   return rc;
 }
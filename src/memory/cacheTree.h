@@ -30,12 +30,33 @@
 
 typedef enum {
   MUTEX_ALLOC=0, 
-  MUTEX_KEEP=1, 
-  MUTEX_COMPUTE=2,
-  MUTEX_TARGET=3,
+  MUTEX_TARGET=1,
+  MUTEX_LOOKUP=2,
+  MUTEX_JOURNAL=3,
   MUTEX_MAX=4
 } CacheMutex;
 
+// archive state and keep counters are protected by one of these
+// mutexes, chosen from the archive's hash (cf computeArchiveStatus)
+#define CACHE_STATE_SHARDS  64
+
+#define MAX_CACHE_LOOKUPS   1024       // cgi lookup results kept
+#define LOOKUP_TTL_FOUND    1*MINUTE   // so as to still call keepArchive
+#define LOOKUP_TTL_NOTFOUND 5*MINUTE
+
+#define MAX_JOURNAL_EVENTS  4096 // compact the journal above (saveRecords)
+
+// cgi lookup result (cf server/cgiSrv.c)
+typedef struct CacheLookup
+{
+  char   hash[MAX_SIZE_MD5+1];
+  off_t  size;
+  time_t date;   // expiration date
+  int    found;  // else only valid while no supply changes (epoch)
+  int    epoch;
+  char*  status; // reply sent back to the cgi
+} CacheLookup;
+
 // hight level type computed from type, host and path
 typedef enum {
   UNDEF_RECORD = 0,
@@ -54,10 +75,12 @@ typedef enum {
 // cache content
 struct CacheTree
 {
-  // cache occupancy (read only)
+  // cache occupancy (read only, useSize and frozenSize are updated
+  // with atomic builtins as archive states are computed concurrently)
   off_t totalSize;
   off_t useSize;
   off_t frozenSize;
+  off_t partSize; // partial uploads (computed by scanCollection)
 
   // cache parameters (from configuration and servers.txt)
   off_t  cacheSize; // maximum size for cache
@@ -68,17 +91,37 @@ struct CacheTree
   pthread_rwlockattr_t* attr;
   pthread_rwlock_t* rwlock;
   pthread_mutex_t mutex[MUTEX_MAX];
+  pthread_mutex_t stateMutex[CACHE_STATE_SHARDS];
 
   // serializer to load-from/save-to disk
   RecordTree* recordTree;
 
   // Archive* that define at less 1 Record
   AVLTree* archives; // Archive*
+
+  // cgi lookup results (using MUTEX_LOOKUP)
+  AVLTree* lookups;   // CacheLookup*
+  int  lookupEpoch;   // increased each time a supply changes
+  long lookupHits;
+  long lookupMisses;
+
+  // append-only journal of the records (using MUTEX_JOURNAL)
+  int journalFd;      // -1 while not opened
+  int nbJournal;      // events written since the last snapshot
+  int noJournal;      // do not journal (loading or diseasing)
+  off_t journalSize;  // journal length as written or read by this tree
+  int isSharedJournal; // another tree appends too (cf SIGHUP)
+
+  // delCacheEntry calls since the last unIndexRemoved scan: 
+  // 0 means there is nothing to reclaim (cf reclaimCacheTree)
+  int nbRemoved;
 };
 
 CacheTree* createCacheTree(void);
 CacheTree* destroyCacheTree(CacheTree* self);
 
+int acquireCacheOwner(Collection* coll);
+int releaseCacheOwner(Collection* coll);
 int lockCacheRead(Collection* coll);
 int lockCacheWrite(Collection* coll);
 int unLockCache(Collection* coll);
@@ -87,7 +130,18 @@ int computeArchiveStatus(Collection* coll, Archive* archive);
 
 int addCacheEntry(Collection* coll, Record* record);
 int delCacheEntry(Collection* coll, Record* record);
+Record* getCacheEntry(Collection* coll, Record* record);
+
+int journalCacheEntry(Collection* coll, Record* record);
+int checkCacheJournal(Collection* coll);
+int resetCacheJournal(Collection* coll);
+
+int getCacheLookup(Collection* coll, Archive* archive, char* status,
+		   int* isHit, int* epoch);
+int addCacheLookup(Collection* coll, Archive* archive, char* status,
+		   int found, int epoch);
 int cleanCacheTree(Collection* coll);
+int reclaimCacheTree(Collection* coll);
 
 int keepArchive(Collection* coll, Archive* archive);
 int unKeepArchive(Collection* coll, Archive* archive);
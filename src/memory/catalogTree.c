@@ -152,7 +152,7 @@ destroyAssoCarac(AssoCarac* self)
   AssoCarac* rc = 0;
 
   if(self) {
-    self->value = destroyString(self->value);
+    // value is owned by the catalog's pool
     free(self);
   }
 
@@ -176,7 +176,7 @@ cmpAssoCarac(const void *p1, const void *p2)
   AssoCarac* v2 = *((AssoCarac**)p2);
 
   rc = cmpCarac(&v1->carac, &v2->carac);
-  if (!rc) rc = strcmp(v1->value, v2->value);
+  if (!rc && v1->value != v2->value) rc = strcmp(v1->value, v2->value);
   return rc;
 }
 
@@ -416,10 +416,10 @@ serializeCatalogArchive(Archive* self, CvsFile* fd)
   fd->doCut = FALSE;
 
   // serialize assoCaracs
-  if (!isEmptyRing(self->assoCaracs)) {
-    rgSort(self->assoCaracs, cmpAssoCarac);
-    rgRewind(self->assoCaracs);
-    while ((assoCarac = rgNext(self->assoCaracs))) {
+  if (!isEmptyRing(arAssoCaracs(self))) {
+    rgSort(arAssoCaracs(self), cmpAssoCarac);
+    rgRewind(arAssoCaracs(self));
+    while ((assoCarac = rgNext(arAssoCaracs(self)))) {
       if (!serializeAssoCarac(assoCarac, fd)) goto error;
     }
   }
@@ -918,6 +918,7 @@ createCatalogTree(void)
       goto error;
 
   if ((rc->caracs = createRing()) == 0) goto error;
+  if (!(rc->values = createStringPool())) goto error;
 
   return rc;
  error:
@@ -960,6 +961,7 @@ destroyCatalogTree(CatalogTree* self)
       = destroyRing(self->caracs,
 		    (void*(*)(void*)) destroyCarac);
 
+    self->values = destroyStringPool(self->values);
     free(self);
   }
   return(rc);
@@ -1035,7 +1037,7 @@ serializeCatalogTree(Collection* coll, CvsFile* fd)
   if (avl_count(coll->archives)) {
     for (node = coll->archives->head; node; node = node->next) {
       archive = (Archive*)node->item;
-      if (!isEmptyRing(archive->assoCaracs)) {
+      if (!isEmptyRing(arAssoCaracs(archive))) {
 	if (!serializeCatalogArchive(archive, fd)) goto error;
       }
     }
@@ -1175,7 +1177,7 @@ getAssoCarac(Collection* coll, Carac* carac, CType type,
   RGIT* curr = 0;
 
   checkCollection(coll);
-  if (!carac || !entity || !value) goto error;
+  if (!coll->catalogTree || !carac || !entity || !value) goto error;
   logMemory(LOG_DEBUG, "getAssoCarac %s %s=%s", 
 	  strCType(type), carac->label, value);
 
@@ -1190,16 +1192,19 @@ getAssoCarac(Collection* coll, Carac* carac, CType type,
     ring = ((Human*)entity)->assoCaracs;
     break;
   case ARCH:
-    ring = ((Archive*)entity)->assoCaracs;
+    ring = arAssoCaracs((Archive*)entity);
     break;
   default:
     logMemory(LOG_ERR, "unknown type %i", type);
     goto error;
   }
 
+  // values are interned, so not into the pool means not used
+  if (!(value = getPoolString(coll->catalogTree->values, value))) goto error;
+
   // look for assoCarac
   while ((rc = rgNext_r(ring, &curr))) {
-    if (carac == rc->carac && !strcmp(rc->value, value)) break;
+    if (carac == rc->carac && rc->value == value) break;
   }
   
  error:
@@ -1226,7 +1231,7 @@ addAssoCarac(Collection* coll, Carac* carac, CType type,
   RG* ring = 0;
 
   checkCollection(coll);
-  if (!carac || !entity || !value) goto error;
+  if (!coll->catalogTree || !carac || !entity || !value) goto error;
   logMemory(LOG_DEBUG, "addAssoCarac %s %s=%s", 
 	  strCType(type), carac->label, value);
 
@@ -1235,7 +1240,8 @@ addAssoCarac(Collection* coll, Carac* carac, CType type,
 
   // add new one if not already there
   if ((asso = createAssoCarac()) == 0) goto error;
-  if (!(asso->value = createString(value))) goto error; 
+  if (!(asso->value = internString(coll->catalogTree->values, value)))
+    goto error;
   asso->carac = carac;
 
   // add it to the entity tree
@@ -1250,7 +1256,7 @@ addAssoCarac(Collection* coll, Carac* carac, CType type,
     ring = ((Human*)entity)->assoCaracs;
     break;
   case ARCH:
-    ring = ((Archive*)entity)->assoCaracs;
+    ring = arAssoCaracs((Archive*)entity);
     break;
   default:
     logMemory(LOG_INFO, "unknown carac type %i", type);
@@ -1715,8 +1721,8 @@ int addArchiveToDocument(Collection* coll,
       !rgInsert(document->archives, archive)) goto error;
   
   // add document to archive ring
-  if (!rgHaveItem(archive->documents, document) &&
-      !rgInsert(archive->documents, document)) goto error;
+  if (!rgHaveItem(arDocuments(archive), document) &&
+      !rgInsert(arDocuments(archive), document)) goto error;
 
   rc = TRUE;
  error:
@@ -1754,8 +1760,8 @@ int delArchiveFromDocument(Collection* coll,
   }
 
   // del document to archive ring
-  if ((curr = rgHaveItem(archive->documents, document))) {
-    rgRemove_r(archive->documents, &curr);
+  if ((curr = rgHaveItem(arDocuments(archive), document))) {
+    rgRemove_r(arDocuments(archive), &curr);
   }
 
   rc = TRUE;
@@ -1956,8 +1962,8 @@ delDocument(Collection* coll, Document* self)
   // delete document from archive rings
   curr = curr2 = 0;
   while ((arch = rgNext_r(self->archives, &curr))) {
-    if ((curr2 = rgHaveItem(arch->documents, self))) {
-      rgRemove_r(arch->documents, &curr2);
+    if ((curr2 = rgHaveItem(arDocuments(arch), self))) {
+      rgRemove_r(arDocuments(arch), &curr2);
     }
   }
 
@@ -1994,13 +2000,13 @@ delArchiveCatalog(Collection* coll, Archive* self)
 	  self->hash, (long long int)self->size);
 
   // delete assoCarac associations
-  while ((aC = rgHead(self->assoCaracs))) {
-    rgRemove(self->assoCaracs);
+  while ((aC = rgHead(arAssoCaracs(self)))) {
+    rgRemove(arAssoCaracs(self));
     destroyAssoCarac(aC);
   }
 
   // delete from document rings
-  while ((doc = rgHead(self->documents))) {
+  while ((doc = rgHead(arDocuments(self)))) {
     if (!delArchiveFromDocument(coll, self, doc)) goto error;
   }
 
@@ -2267,6 +2273,9 @@ diseaseCatalogTree(Collection* coll)
   while ((carac = rgHead(self->caracs)))
     if (!delCarac(coll, carac)) goto error;
 
+  // no more carac values
+  avl_clear_tree(self->values);
+
   // try to disease archives
   if (!diseaseArchives(coll)) goto error;
 
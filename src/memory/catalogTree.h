@@ -101,6 +101,7 @@ struct CatalogTree
   AVLTree* documents;  // Document*
   RG*      categories; // Category*
 
+  AVLTree* values;     // interned carac values (cf internString)
   int maxId[CTYPE_MAX];
 };
 
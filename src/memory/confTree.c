@@ -23,6 +23,28 @@
 
 #include "mediatex-config.h"
 
+// configuration snapshot pinned by each daemon's thread
+static pthread_once_t confKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t confKey;
+static pthread_mutex_t confMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*=======================================================================
+ * Function   : initConfKey
+ * Description: Create the thread specific key (only once)
+ * Synopsis   : static void initConfKey(void)
+ * Input      : N/A
+ * Output     : N/A
+ =======================================================================*/
+static void 
+initConfKey(void)
+{
+  int err = 0;
+
+  if ((err = pthread_key_create(&confKey, 0))) {
+    logMemory(LOG_ERR, "pthread_key_create fails: %s", strerror(err));
+  }
+}
+
 /*=======================================================================
  * Function   : cmpCollection
  * Description: Compare 2 collections
@@ -80,7 +102,7 @@ createCollection(void)
   if ((rc->supports = createRing()) == 0) goto error;
 
   // init the locks
-  for (i=iCTLG; i<iCACH; ++i) {
+  for (i=iCTLG; i<=iCACH; ++i) {
     if ((err = pthread_mutex_init(&rc->mutex[i], (pthread_mutexattr_t*)0))
 	!= 0) {
       logMemory(LOG_INFO, "pthread_mutex_init: %s", strerror(err));
@@ -132,6 +154,8 @@ destroyCollection(Collection* self)
   self->serversDB = destroyString(self->serversDB);
   self->extractDB = destroyString(self->extractDB);
   self->md5sumsDB = destroyString(self->md5sumsDB);
+  self->md5sumsJnl = destroyString(self->md5sumsJnl);
+  self->snapshotDB = destroyString(self->snapshotDB);
   
   self->sshAuthKeys = destroyString(self->sshAuthKeys);
   self->sshConfig = destroyString(self->sshConfig);
@@ -156,7 +180,7 @@ destroyCollection(Collection* self)
   self->cacheTree = destroyCacheTree(self->cacheTree);
   
   // free the locks
-  for (i=iCTLG; i<iCACH; ++i) {
+  for (i=iCTLG; i<=iCACH; ++i) {
     if ((err = pthread_mutex_destroy(&self->mutex[i]))) {
       logMemory(LOG_INFO, "pthread_mutex_destroy[%i]: %s", i, 
 		strerror(err));
@@ -259,6 +283,16 @@ expandCollection(Collection* self)
       || !(self->md5sumsDB =  catString(self->md5sumsDB, self->user))
       || !(self->md5sumsDB =  catString(self->md5sumsDB, ".md5")))
     goto error;
+  if (!(self->md5sumsJnl = createString(conf->md5sumDir)) 
+      || !(self->md5sumsJnl =  catString(self->md5sumsJnl, "/"))
+      || !(self->md5sumsJnl =  catString(self->md5sumsJnl, self->user))
+      || !(self->md5sumsJnl =  catString(self->md5sumsJnl, ".jnl")))
+    goto error;
+  if (!(self->snapshotDB = createString(conf->md5sumDir)) 
+      || !(self->snapshotDB =  catString(self->snapshotDB, "/"))
+      || !(self->snapshotDB =  catString(self->snapshotDB, self->user))
+      || !(self->snapshotDB =  catString(self->snapshotDB, ".bin")))
+    goto error;
 
   // metadata files
   for (j=0; j<3; ++j) {
@@ -576,6 +610,12 @@ createConfiguration(void)
       || !(conf->pidFile = createString(pidDir))
       || !(conf->pidFile = catString(conf->pidFile, label))
       || !(conf->pidFile = catString(conf->pidFile, CONF_PIDFILE))
+      || !(conf->cgiSocket = createString(pidDir))
+      || !(conf->cgiSocket = catString(conf->cgiSocket, label))
+      || !(conf->cgiSocket = catString(conf->cgiSocket, CONF_CGISOCK))
+      || !(conf->perfFile = createString(pidDir))
+      || !(conf->perfFile = catString(conf->perfFile, label))
+      || !(conf->perfFile = catString(conf->perfFile, CONF_PERFFILE))
       || !(conf->sshRsaPublicKey = createString(conf->hostSshDir))
       || !(conf->sshRsaPublicKey = 
 	   catString(conf->sshRsaPublicKey, CONF_RSAHOSTKEY))
@@ -591,6 +631,8 @@ createConfiguration(void)
   conf->queryTTL = DEFAULT_TTL_QUERY;
   conf->checkTTL = DEFAULT_TTL_CHECK;
   conf->fileTTL = DEFAULT_TTL_FILE;
+  conf->checkRate = DEFAULT_CHECK_RATE;
+  conf->checkNice = DEFAULT_CHECK_NICE;
   conf->scoreParam = defaultScoreParam;
   strncpy(conf->host, DEFAULT_HOST, MAX_SIZE_HOST);
   conf->sshPort = SSH_PORT;
@@ -642,6 +684,8 @@ destroyConfiguration(Configuration* self)
     // files
     self->confFile = destroyString(self->confFile);
     self->pidFile = destroyString(self->pidFile);
+    self->cgiSocket = destroyString(self->cgiSocket);
+    self->perfFile = destroyString(self->perfFile);
     self->supportDB = destroyString(self->supportDB);
     self->sshRsaPublicKey = destroyString(self->sshRsaPublicKey);
     self->sshDsaPublicKey = destroyString(self->sshDsaPublicKey);
@@ -656,6 +700,8 @@ destroyConfiguration(Configuration* self)
     self->queryTTL = 0;
     self->checkTTL = 0;
     self->fileTTL = 0;
+    self->checkRate = 0;
+    self->checkNice = 0;
     self->hostKey = destroyString(self->hostKey);
 
     self->allNetworks = 
@@ -873,6 +919,8 @@ serializeConfiguration(Configuration* self)
   fprintf(fd, "\n# local support parameters\n");
   printLapsTime(fd,  "%-10s", "checkTTL", self->checkTTL);
   printLapsTime(fd,  "%-10s", "fileTTL", self->fileTTL);
+  printCacheSize(fd, "%-10s", "checkRate", self->checkRate);
+  fprintf(fd, "%-10s %i\n", "checkNice", self->checkNice);
   printLapsTime(fd, "%-10s", "suppTTL",  self->scoreParam.suppTTL);
   fprintf(fd, "%-10s %.2f\n", "maxScore", self->scoreParam.maxScore);
   fprintf(fd, "%-10s %.2f\n", "badScore", self->scoreParam.badScore);
@@ -921,6 +969,10 @@ getConfiguration(void)
 {
   Configuration* rc = 0;
 
+  // daemon's jobs keep working on the snapshot they have acquired
+  pthread_once(&confKeyOnce, initConfKey);
+  if ((rc = pthread_getspecific(confKey))) goto end;
+
   if(env.confTree == 0) {
     if ((env.confTree = createConfiguration()) == 0) {
       logMemory(LOG_ERR, "cannot malloc default collection");
@@ -929,6 +981,7 @@ getConfiguration(void)
   }
 
   rc = env.confTree;
+ end:
  error:
   if (!rc) {
     logMemory(LOG_ERR, "fails to get configuration");
@@ -950,7 +1003,168 @@ freeConfiguration(void)
   env.confTree = destroyConfiguration(env.confTree);
 }
 
+/*=======================================================================
+ * Function   : useConfiguration
+ * Description: Make getConfiguration() return a given snapshot
+ * Synopsis   : int useConfiguration(Configuration* self)
+ * Input      : Configuration* self: snapshot to use for this thread
+ *                                   (0 to use the current one again)
+ * Output     : TRUE on success
+ * Note       : used by the daemon to parse a new configuration 
+ *              while jobs are still running on the previous one
+ =======================================================================*/
+int
+useConfiguration(Configuration* self)
+{
+  int rc = FALSE;
+  int err = 0;
+
+  pthread_once(&confKeyOnce, initConfKey);
+  if ((err = pthread_setspecific(confKey, self))) {
+    logMemory(LOG_ERR, "pthread_setspecific fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : acquireConfiguration
+ * Description: Pin the current configuration for the calling thread
+ * Synopsis   : Configuration* acquireConfiguration(void)
+ * Input      : N/A
+ * Output     : the pinned configuration, 0 on error
+ * Note       : a SIGHUP may publish a new configuration meanwhile,
+ *              the calling thread keeps this one until it release it
+ =======================================================================*/
+Configuration*
+acquireConfiguration(void)
+{
+  Configuration* rc = 0;
+  int err = 0;
+
+  if ((err = pthread_mutex_lock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  if(env.confTree == 0) {
+    if ((env.confTree = createConfiguration()) == 0) goto error2;
+  }
+  if (!useConfiguration(env.confTree)) goto error2;
+  ++env.confTree->cptInUse;
+  rc = env.confTree;
+
+ error2:
+  if ((err = pthread_mutex_unlock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    rc = 0;
+  }
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "fails to acquire configuration");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : releaseConfiguration
+ * Description: Unpin the configuration used by the calling thread
+ * Synopsis   : Configuration* releaseConfiguration(void)
+ * Input      : N/A
+ * Output     : the snapshot to free if we were its last user and it
+ *              was replaced meanwhile, 0 else
+ =======================================================================*/
+Configuration*
+releaseConfiguration(void)
+{
+  Configuration* rc = 0;
+  Configuration* conf = 0;
+  int err = 0;
+
+  pthread_once(&confKeyOnce, initConfKey);
+  if (!(conf = pthread_getspecific(confKey))) goto error;
+  if (!useConfiguration(0)) goto error;
+
+  if ((err = pthread_mutex_lock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  if (--conf->cptInUse < 0) {
+    logMemory(LOG_WARNING, "configuration cptInUse = %i !", 
+	      conf->cptInUse);
+  }
+  if (conf->cptInUse <= 0 && conf != env.confTree) rc = conf;
+
+  if ((err = pthread_mutex_unlock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+  }
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : swapConfiguration
+ * Description: Publish a new configuration
+ * Synopsis   : Configuration* swapConfiguration(Configuration* self)
+ * Input      : Configuration* self: the new configuration
+ * Output     : the previous configuration if no more used (so to be 
+ *              freed by the caller), 0 else
+ * Note       : the previous configuration is otherwise returned to 
+ *              its last user by releaseConfiguration()
+ =======================================================================*/
+Configuration*
+swapConfiguration(Configuration* self)
+{
+  Configuration* rc = 0;
+  int err = 0;
+
+  if ((err = pthread_mutex_lock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+
+  logMemory(LOG_INFO, "swap configuration");
+  if (env.confTree && env.confTree != self &&
+      env.confTree->cptInUse <= 0) rc = env.confTree;
+  env.confTree = self;
+
+  if ((err = pthread_mutex_unlock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+  }
+ error:
+  return rc;
+}
+
 
+/*=======================================================================
+ * Function   : isCurrentConfiguration
+ * Description: Tell if a configuration was replaced by a SIGHUP
+ * Synopsis   : int isCurrentConfiguration(Configuration* self)
+ * Input      : Configuration* self: snapshot used by a thread
+ * Output     : TRUE if it is still the published configuration
+ =======================================================================*/
+int
+isCurrentConfiguration(Configuration* self)
+{
+  int rc = FALSE;
+  int err = 0;
+
+  if ((err = pthread_mutex_lock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  rc = (self == env.confTree);
+  if ((err = pthread_mutex_unlock(&confMutex))) {
+    logMemory(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+  }
+ error:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : getCollection
  * Description: Find a collection
@@ -88,6 +88,7 @@ struct Collection {
   FileState fileState[4];
   pthread_mutex_t mutex[4];
   int cptInUse[4];
+  time_t fileMtime[4]; // metadata files mtime when loaded
   int toUpdate;
   int toCommit;
 
@@ -110,6 +111,8 @@ struct Collection {
   char *serversDB;  // servers.txt path
   char *extractDB;  // extract.txt path
   char *md5sumsDB;  // {COLL}.md5 path
+  char *md5sumsJnl; // {COLL}.jnl path (records journal)
+  char *snapshotDB; // {COLL}.bin path (extract snapshot)
   char *sshAuthKeys;     // "~/.ssh/authorized_keys"
   char *sshConfig;       // "~/.ssh/config"
   char *sshKnownHosts;   // "~/.ssh/known_hosts"
@@ -147,6 +150,8 @@ struct Configuration {
   /* local parameters */
   time_t checkTTL;  // time period between 2 md5 checks on supports
   time_t fileTTL;   // time period between 2 md5 checks on support files
+  off_t  checkRate; // disk bandwidth for background checks (b.s-1)
+  int    checkNice; // I/O priority for background checks (0 to 7)
   ScoreParam scoreParam; // parameter use to compute score
   MotdPolicy motdPolicy; // retrieve all images locally or not (default)
 
@@ -169,6 +174,8 @@ struct Configuration {
   /* -files */
   char* confFile;
   char* pidFile;
+  char* cgiSocket; // persistent cgi worker's socket
+  char* perfFile;  // daemon's performance counters
   char* sshRsaPublicKey; // "/etc/ssh/ssh_host_rsa.pub"
   char* sshDsaPublicKey; // "/etc/ssh/ssh_host_dsa.pub"
   char *supportDB;
@@ -185,6 +192,7 @@ struct Configuration {
   MemoryState memoryState;
   FileState fileState[2];
   int toHup;
+  int cptInUse; // number of daemon's jobs using this configuration
 };
 
 
@@ -208,6 +216,12 @@ int expandConfiguration(void);
 int populateConfiguration(void);
 void freeConfiguration(void);
 
+int useConfiguration(Configuration* self);
+Configuration* acquireConfiguration(void);
+Configuration* releaseConfiguration(void);
+Configuration* swapConfiguration(Configuration* self);
+int isCurrentConfiguration(Configuration* self);
+
 Collection* getCollection(char* label);
 Collection* addCollection(char* label);
 int delCollection(Collection* self);
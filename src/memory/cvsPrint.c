@@ -23,19 +23,180 @@
 
 #include "mediatex-config.h"
 
+// FNV-1a
+#define CVS_HASH_INIT  2166136261U
+#define CVS_HASH_PRIME 16777619U
+
 /*=======================================================================
- * Function   : cvsClose
- * Description: Cut a big file into several ones
- * Synopsis   : int cvsClose(CvsFile* fd)
+ * Function   : cvsCutPath
+ * Description: Build a part file path
+ * Synopsis   : static char* cvsCutPath(CvsFile* fd, int nb)
  * Input      : CvsFile* fd
+ *              int nb: part number (-1 for the NNN.txt file)
+ * Output     : the allocated path, 0 on error
+ =======================================================================*/
+static char*
+cvsCutPath(CvsFile* fd, int nb)
+{
+  char* rc = 0;
+  int l = 0;
+
+  l = strlen(fd->path);
+  if (!(rc = createString(fd->path))
+      || !(rc = catString(rc, "NNN.txt"))) goto error;
+  if (nb >= 0 && !sprintf(rc+l, "%03i.txt", nb)) {
+    rc = destroyString(rc);
+  }
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cvsCutWrite
+ * Description: Write a part file only if its content changes
+ * Synopsis   : static int cvsCutWrite(CvsFile* fd)
+ * Input      : CvsFile* fd: having the part content in fd->fd
  * Output     : TRUE on success
+ * Note       : so as unchanged part files keep their mtime and are
+ *              not re-written nor re-diffed by git
  =======================================================================*/
-int cvsClose(CvsFile* fd)
+static int
+cvsCutWrite(CvsFile* fd)
+{
+  int rc = FALSE;
+  char* path = 0;
+  FILE* part = 0;
+  char buf1[4096];
+  char buf2[4096];
+  size_t n1 = 0;
+  size_t n2 = 0;
+  int isSame = FALSE;
+
+  if (!(path = cvsCutPath(fd, fd->nb-1))) goto error;
+  if (fflush(fd->fd)) {
+    logMemory(LOG_ERR, "fflush fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // compare with the current part file
+  if ((part = fopen(path, "r"))) {
+    rewind(fd->fd);
+    isSame = TRUE;
+    do {
+      n1 = fread(buf1, 1, sizeof(buf1), fd->fd);
+      n2 = fread(buf2, 1, sizeof(buf2), part);
+      if (n1 != n2 || memcmp(buf1, buf2, n1)) isSame = FALSE;
+    }
+    while (isSame && n1 > 0);
+    if (fclose(part)) {
+      logMemory(LOG_ERR, "fclose fails: %s", strerror(errno));
+      goto error;
+    }
+    part = 0;
+  }
+
+  if (isSame) {
+    logMemory(LOG_DEBUG, "%s not modified", path);
+    goto end;
+  }
+
+  logMemory(LOG_DEBUG, "write %s", path);
+  if ((part = fopen(path, "w")) == 0) {
+    logMemory(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno));
+    goto error;
+  }
+  if (!lock(fileno(part), F_WRLCK)) goto error;
+  rewind(fd->fd);
+  while ((n1 = fread(buf1, 1, sizeof(buf1), fd->fd)) > 0) {
+    if (fwrite(buf1, 1, n1, part) != n1) {
+      logMemory(LOG_ERR, "fwrite %s fails: %s", path, strerror(errno));
+      goto error;
+    }
+  }
+  if (!unLock(fileno(part))) goto error;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "cvsCutWrite fails");
+  }
+  if (part && fclose(part)) {
+    logMemory(LOG_ERR, "fclose fails: %s", strerror(errno));
+    rc = FALSE;
+  }
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cvsCutClean
+ * Description: Empty the part files that are no more used
+ * Synopsis   : static int cvsCutClean(CvsFile* fd)
+ * Input      : CvsFile* fd: after the last part was written
+ * Output     : TRUE on success
+ * Note       : nothing is modified on dry-run
+ =======================================================================*/
+static int
+cvsCutClean(CvsFile* fd)
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  char* path = 0;
+  FILE* part = 0;
+  int i = 0;
+
+  if (env.dryRun) goto end;
+
+  // empty remaining part files
+  for (i = fd->nb; i < 1000; ++i) {
+    path = destroyString(path);
+    if (!(path = cvsCutPath(fd, i))) goto error;
+    if (stat(path, &statBuffer)) break;
+    if (statBuffer.st_size == 0) continue;
+    logMemory(LOG_INFO, "empty %s", path);
+    if ((part = fopen(path, "w")) == 0) {
+      logMemory(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno));
+      goto error;
+    }
+    if (fclose(part)) {
+      logMemory(LOG_ERR, "fclose fails: %s", strerror(errno));
+      goto error;
+    }
+  }
+
+  // unlink last addon
+  path = destroyString(path);
+  if (!(path = cvsCutPath(fd, -1))) goto error;
+  if (access(path, R_OK) == 0) {
+    logMemory(LOG_INFO, "unlink %s", path);
+    if (unlink(path) == -1) {
+      logMemory(LOG_ERR, "unlink fails %s:", strerror(errno));
+      goto error;
+    }
+  }
+
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "cvsCutClean fails");
+  }
+  path = destroyString(path);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cvsCloseFile
+ * Description: Close the current file
+ * Synopsis   : static int cvsCloseFile(CvsFile* fd)
+ * Input      : CvsFile* fd
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+cvsCloseFile(CvsFile* fd)
 {
   int rc = FALSE;
 
-  if (!fd) goto error;
-  logMemory(LOG_DEBUG, "cvsClose %s", fd->path);
   if (!(fd->fd)) goto end;
 
   fprintf(fd->fd, "\n# Local Variables:\n"
@@ -48,7 +209,12 @@ int cvsClose(CvsFile* fd)
     goto end;
   }
 
-  if (!unLock(fileno(fd->fd))) rc = FALSE;
+  if (fd->isTmp) {
+    if (!cvsCutWrite(fd)) goto error;
+  }
+  else {
+    if (!unLock(fileno(fd->fd))) goto error;
+  }
   if (fclose(fd->fd)) {
     logMemory(LOG_ERR, "fclose fails: %s", strerror(errno));
     goto error;
@@ -57,6 +223,35 @@ int cvsClose(CvsFile* fd)
   fd->fd = 0;
  end:
   rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "cvsCloseFile fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cvsClose
+ * Description: Close the last file
+ * Synopsis   : int cvsClose(CvsFile* fd)
+ * Input      : CvsFile* fd
+ * Output     : TRUE on success
+ =======================================================================*/
+int cvsClose(CvsFile* fd)
+{
+  int rc = FALSE;
+  int isCut = FALSE;
+
+  if (!fd) goto error;
+  logMemory(LOG_DEBUG, "cvsClose %s", fd->path);
+  if (!(fd->fd)) goto end;
+
+  isCut = fd->isTmp;
+  if (!cvsCloseFile(fd)) goto error;
+  fd->isTmp = FALSE;
+  if (isCut && !cvsCutClean(fd)) goto error;
+ end:
+  rc = TRUE;
 error:
   if (!rc) {
     logMemory(LOG_ERR, "cvsClose fails");
@@ -70,77 +265,43 @@ error:
  * Synopsis   : int cvsCutOpen(CvsFile* fd)
  * Input      : CvsFile* fd
  * Output     : TRUE on success
+ * Note       : parts are first written into a temporary file and
+ *              only copied if modified (cf cvsCutWrite). Remaining
+ *              parts are emptied by cvsClose.
  =======================================================================*/
 int cvsCutOpen(CvsFile* fd)
 {
   int rc = FALSE;
   char* path = 0;
-  int l = 0;
-  int i = 0;
 
   if (!fd) goto error;
-  if (isEmptyString(fd->path)) goto error; 
+  if (isEmptyString(fd->path)) goto error;
   logMemory(LOG_DEBUG, "cvsCutOpen %s %i", fd->path, fd->nb);
 
-  l = strlen(fd->path);
-  if (!(path = createString(fd->path))
-      || !(path = catString(path, "000.txt"))) goto error;
-
-  // first call: empty existing files
-  if (fd->nb == 0 && fd->fd != stdout) {
-    // empty part files
-    do {
-      if (!sprintf(path+l, "%03i.txt", i)) goto error;
-      if (access(path, R_OK)) break;
-      if (!env.dryRun) {
-	logMemory(LOG_INFO, "empty %s", path);
-	if ((fd->fd = fopen(path, "w")) == 0) {
-	  logMemory(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno));
-	  goto error;
-	}
-	if (fclose(fd->fd)) {
-	  logMemory(LOG_ERR, "fclose fails: %s", strerror(errno));
-	  goto error;
-	}
-	fd->fd = 0;
-      }
-      if (i == 999) {
-	logMemory(LOG_CRIT, "%s", 
-		  "you win: too much metadata files, I can't believe it!");
-	goto error;
-      }
-    }
-    while (++i < 1000);
-    
-    // unlink last addon
-    if (!sprintf(path+l, "%s", "NNN.txt")) goto error;
-    if (access(path, R_OK) == 0) {
-      logMemory(LOG_INFO, "unlink %s", path);
-      if (unlink(path) == -1) {
-	logMemory(LOG_ERR, "unlink fails %s:", strerror(errno));
-	goto error;
-      }
-    }
+  if (fd->nb > 999) {
+    logMemory(LOG_CRIT, "%s",
+	      "you win: too much metadata files, I can't believe it!");
+    goto error;
   }
 
   // not first call
   if (fd->nb > 0) {
-    if (!cvsClose(fd)) goto error;
+    if (!cvsCloseFile(fd)) goto error;
   }
 
   // open file
-  if (!sprintf(path+l, "%03i.txt", fd->nb)) goto error;
+  if (!(path = cvsCutPath(fd, fd->nb))) goto error;
   logMemory(LOG_INFO, "serialize into %s", path);
   if (fd->fd == stdout) goto end;
-  if ((fd->fd = fopen(path, "w")) == 0) {
-    logMemory(LOG_ERR, "fdopen %s fails: %s", path, strerror(errno));
+  if ((fd->fd = tmpfile()) == 0) {
+    logMemory(LOG_ERR, "tmpfile fails: %s", strerror(errno));
     goto error;
   }
-
-  if (!lock(fileno(fd->fd), F_WRLCK)) goto error;
+  fd->isTmp = TRUE;
  end:
   ++fd->nb;
   fd->offset = 0;
+  fd->objSize = 0;
   rc = TRUE;
 error:
   if (!rc) {
@@ -189,6 +350,31 @@ error:
   return rc;
 }
 
+/*=======================================================================
+ * Function   : cvsCutHere
+ * Description: Tell if a new part begins before the next object
+ * Synopsis   : static int cvsCutHere(CvsFile* fd)
+ * Input      : CvsFile* fd: having the last object hash and size
+ * Output     : TRUE if we have to cut here
+ * Note       : the cut points depend on the objects content and not 
+ *              on their offset, so as an edit do not shift the next 
+ *              parts: only its own part is re-written. Parts are
+ *              about cvsprintMax bytes (at least the half, at most 4
+ *              times, the later bound shifting the next parts).
+ =======================================================================*/
+static int
+cvsCutHere(CvsFile* fd)
+{
+  long int min = env.cvsprintMax / 2;
+
+  if (min < 1) return (fd->offset > env.cvsprintMax);
+  if (fd->offset > 4 * (long int)env.cvsprintMax) return TRUE;
+  if (fd->offset <= min) return FALSE;
+
+  // a big object is more likely to end a part
+  return ((long int)(fd->hash % min) < fd->objSize);
+}
+
 /*=======================================================================
  * Function   : cvsCutPrint
  * Description: Cut a big file into several ones
@@ -197,21 +383,47 @@ error:
  *              const char* format : as printf
  *              ... : as printf
  * Output     : TRUE on success
+ * Note       : doCut is set between the objects. Objects are hashed
+ *              on their text, but only on the first 1023 bytes of
+ *              each print.
  =======================================================================*/
 int cvsCutPrint(CvsFile* fd, const char* format, ...)
 {
   int rc = FALSE;
   va_list args;
+  char buf[1024];
+  int n = 0;
+  int i = 0;
 
   if (!fd) goto error;
 
-  if (fd->doCut && fd->offset > env.cvsprintMax) {
-    if (!cvsCutOpen(fd)) goto error;
+  if (fd->doCut) {
+    if (cvsCutHere(fd) && !cvsCutOpen(fd)) goto error;
+    fd->objSize = 0; // next object
   }
+  if (!fd->objSize) fd->hash = CVS_HASH_INIT;
 
   va_start(args, format);
-  fd->offset += vfprintf(fd->fd, format, args);
+  n = vsnprintf(buf, sizeof(buf), format, args);
   va_end(args);
+  if (n < 0) goto error;
+
+  for (i = 0; i < n && i < (int)sizeof(buf)-1; ++i) {
+    fd->hash = (fd->hash ^ (unsigned char)buf[i]) * CVS_HASH_PRIME;
+  }
+
+  // print it (once again if it was truncated)
+  if (n < (int)sizeof(buf)) {
+    if (fputs(buf, fd->fd) == EOF) goto error;
+  }
+  else {
+    va_start(args, format);
+    n = vfprintf(fd->fd, format, args);
+    va_end(args);
+    if (n < 0) goto error;
+  }
+  fd->offset += n;
+  fd->objSize += n;
   rc = TRUE;
 error:
   if (!rc) {
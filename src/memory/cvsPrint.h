@@ -37,6 +37,9 @@ struct CvsFile
   long int offset;
   int (*open)(CvsFile*);
   int (*print)(CvsFile*, const char*, ...);
+  int      isTmp; // cvsCutOpen: part written only if its content change
+  unsigned int hash;  // of the last object printed (cf cvsCutPrint)
+  long int objSize;   // its size
 };
 
 int cvsCutOpen(CvsFile* fd);
@@ -248,7 +248,7 @@ serializeContainer(Collection* coll, Container* self, CvsFile* fd)
       if (self->type == INC && !isIncoming(coll, asso->archive)) continue;
 
       // remove image extraction path whan available from another rule
-      if (self->type == IMG && asso->archive->fromContainers->nbItems > 0) continue;
+      if (self->type == IMG && arFromContainers(asso->archive)->nbItems > 0) continue;
       
       if (!serializeExtractRecord(asso->archive, fd)) goto error;
       fd->print(fd, "\t%s\n", asso->path);
@@ -257,7 +257,7 @@ serializeContainer(Collection* coll, Container* self, CvsFile* fd)
 
   fd->print(fd, ")\n");
   fd->doCut = TRUE;
-  ++env.progBar.cur;
+  __sync_add_and_fetch(&env.progBar.cur, 1);
   rc = TRUE;
  error:
   if (!rc) {
@@ -350,6 +350,11 @@ createExtractTree(void)
 
   rc->score = -1;
 
+  if (!(rc->scores = avl_alloc_tree(cmpArchiveScoreAvl, 0))) goto error;
+  if (!(rc->toRescore = createRing())) goto error;
+  if (pthread_mutex_init(&rc->mutex, (pthread_mutexattr_t*)0))
+    goto error;
+
   return rc;
  error:
   logMemory(LOG_ERR, "malloc: cannot create ExtractTree");
@@ -372,6 +377,10 @@ destroyExtractTree(ExtractTree* self)
   avl_free_tree(self->containers);
   self->inc = destroyContainer(self->inc);
   self->img = destroyContainer(self->img);
+  self->stanzas = destroyOnlyRing(self->stanzas);
+  if (self->scores) avl_free_tree(self->scores);
+  self->toRescore = destroyOnlyRing(self->toRescore);
+  pthread_mutex_destroy(&self->mutex);
 
   free(self);
 
@@ -517,6 +526,9 @@ addFromArchive(Collection* coll, Container* container, Archive* archive)
   }
   if (!rgInsert(container->parents, archive)) goto error;
 
+  // container's score depends on its parents
+  if (!addToRescore(coll, archive)) goto error;
+
   // link container to archive
   if (archive->toContainer) {
     logMemory(LOG_ERR, "archive already comes from %s/%s:%lli container",
@@ -581,6 +593,10 @@ delFromArchive(Collection* coll, Container* container, Archive* archive)
   if (archive == container->parent) {
     if (!delContainer(coll, container)) goto error;
   }
+  else {
+    // re-score the container from its remaining parents
+    if (!addToRescore(coll, container->parent)) goto error;
+  }
 
   rc = TRUE;
  error:
@@ -664,11 +680,11 @@ addFromAsso(Collection* coll, Archive* archive, Container* container,
 
   case INC:
     // having 1 INC asso and 1 normal asso => remove the INC asso
-    if (archive->fromContainers->nbItems > 0) {
+    if (arFromContainers(archive)->nbItems > 0) {
       logMemory(LOG_NOTICE, 
 		"%s:%lli file is now archived (no more an incoming)",
 		archive->hash, (long long int)archive->size);
-      asso = archive->fromContainers->head->it;
+      asso = arFromContainers(archive)->head->it;
       goto end;
     }
 
@@ -734,7 +750,7 @@ addFromAsso(Collection* coll, Archive* archive, Container* container,
     break;
   default:
     // INC and IMG asso are already linked to archive
-    if (!rgInsert(archive->fromContainers, asso)) goto error;
+    if (!rgInsert(arFromContainers(archive), asso)) goto error;
   }
 
   // only provide archives once by container
@@ -750,6 +766,7 @@ addFromAsso(Collection* coll, Archive* archive, Container* container,
     goto error;
   }
  end:
+  if (!addToRescore(coll, archive)) goto error;
   rc = asso;
  error:
   if (!rc) {
@@ -792,11 +809,14 @@ delFromAsso(Collection* coll, FromAsso* self)
     self->archive->uploadTime = 0;
     break;
   default:
-    if ((curr = rgHaveItem(self->archive->fromContainers, self))) {
-      rgRemove_r(self->archive->fromContainers, &curr);
+    if ((curr = rgHaveItem(arFromContainers(self->archive), self))) {
+      rgRemove_r(arFromContainers(self->archive), &curr);
     }
   }
 
+  // archive's score depends on its containers
+  if (!addToRescore(coll, self->archive)) goto error;
+
   // delete asso from container and free the fromAsso
   avl_delete(self->container->childs, self);
     
@@ -943,6 +963,71 @@ delContainer(Collection* coll, Container* self)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : addToRescore
+ * Description: Remind an archive which score must be re-computed
+ * Synopsis   : int addToRescore(Collection* coll, Archive* archive)
+ * Input      : Collection* coll: where to remind
+ *              Archive* archive: having images or containers changed
+ * Output     : TRUE on success
+ * Note       : nothing to do while scores are not computed, as the
+ *              next computation will not be incremental
+ =======================================================================*/
+int
+addToRescore(Collection* coll, Archive* archive)
+{
+  int rc = FALSE;
+  ExtractTree* self = 0;
+
+  checkCollection(coll);
+  checkArchive(archive);
+  self = coll->extractTree;
+  if (!self || self->score == -1 || archive->toRescore) goto end;
+
+  logMemory(LOG_DEBUG, "addToRescore %s:%lli",
+	    archive->hash, (long long int)archive->size);
+  if (!rgInsert(self->toRescore, archive)) goto error;
+  archive->toRescore = TRUE;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "addToRescore fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : delToRescore
+ * Description: Forget an archive which score must be re-computed
+ * Synopsis   : int delToRescore(Collection* coll, Archive* archive)
+ * Input      : Collection* coll: where to forget
+ *              Archive* archive: archive to forget
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+delToRescore(Collection* coll, Archive* archive)
+{
+  int rc = FALSE;
+  RGIT* curr = 0;
+
+  checkCollection(coll);
+  checkArchive(archive);
+  if (!archive->toRescore) goto end;
+
+  if ((curr = rgHaveItem(coll->extractTree->toRescore, archive))) {
+    rgRemove_r(coll->extractTree->toRescore, &curr);
+  }
+  archive->toRescore = FALSE;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "delToRescore fails");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : diseaseExtractTree
  * Description: Disease a ExtractTree by freeing all the allocate memory.
@@ -955,20 +1040,26 @@ int
 diseaseExtractTree(Collection* coll)
 {
   int rc = FALSE;
+  Archive* arch = 0;
   AVLNode *node = 0;
 
   if(coll == 0) goto error;
   logMemory(LOG_DEBUG, "diseaseExtractTree %s", coll);
 
+  // force scores to be re-computed next (not incrementally)
+  coll->extractTree->score = -1;
+  while ((arch = rgHead(coll->extractTree->toRescore))) {
+    arch->toRescore = FALSE;
+    rgRemove(coll->extractTree->toRescore);
+  }
+  avl_free_nodes(coll->extractTree->scores);
+
   // diseases containers
   if (!delContainer(coll, coll->extractTree->inc)) goto error;
   if (!delContainer(coll, coll->extractTree->img)) goto error;
   while ((node = coll->extractTree->containers->head))
     if (!delContainer(coll, node->item)) goto error;
 
-  // force scores to be re-computed next
-  coll->extractTree->score = -1;
-
   // try to disease archives
   if (!diseaseArchives(coll)) goto error;
 
@@ -68,7 +68,13 @@ struct ExtractTree {
   Container* inc;        // provides unsafe incomings
   Container* img;        // provides top image extraction's path
 
+  RG* stanzas;           // containers in parsing order (staging only)
   float score;           // global score for the collection
+
+  // incremental scores (cf extractScore.c)
+  AVLTree* scores;       // scored archives, by growing extractScore
+  RG* toRescore;         // archives having images or containers changed
+  pthread_mutex_t mutex; // serialize the score computations
 };
 
 char* strEType(EType self);
@@ -103,6 +109,9 @@ int delFromAsso(Collection* coll, FromAsso* self);
 Container* addContainer(Collection* coll, EType type, Archive* parent);
 int delContainer(Collection* coll, Container* self);
 
+int addToRescore(Collection* coll, Archive* archive);
+int delToRescore(Collection* coll, Archive* archive);
+
 int diseaseExtractTree(Collection* coll);
 
 #endif /* MDTX_MEMORY_EXTRACT_H */
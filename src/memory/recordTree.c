@@ -449,6 +449,9 @@ destroyRecordTree(RecordTree* self)
       avl_free_tree(self->records); // records items are freed
       self->records = 0;
     }
+    // not replayed journal events
+    self->journal = destroyRing(self->journal,
+				(void*(*)(void*)) destroyRecord);
     free(self);
   }
   
@@ -476,6 +479,8 @@ strMessageType(MessageType self)
     return "NOTIFY";
   case UPLOAD:
     return "UPLOAD";
+  case STREAM:
+    return "STREAM";
   default:
     return "UNKNOWN";
   }
@@ -643,6 +648,102 @@ serializeRecordTree(RecordTree* self, char* path, char* fingerPrint)
 }
 
 
+/*=======================================================================
+ * Function   : serializeJournalHeader
+ * Description: Write the headers of a new records journal
+ * Synopsis   : int serializeJournalHeader(Collection* coll, int fd)
+ * Input      : Collection* coll: the journal's collection
+ *              int fd: the (empty) journal file
+ * Output     : TRUE on success
+ * Note       : the journal is a DISK records file (without cypher)
+ *              where new lines are appended (cf serializeJournalRecord)
+ =======================================================================*/
+int 
+serializeJournalHeader(Collection* coll, int fd)
+{ 
+  int rc = FALSE;
+  RecordTree* tree = 0;
+
+  checkCollection(coll);
+  logMemory(LOG_DEBUG, "serialize %s journal headers", coll->label);
+
+  if (!(tree = createRecordTree())) goto error;
+  tree->collection = coll;
+  tree->messageType = DISK;
+  tree->aes.fd = fd;
+  if (!serializeRecordTree(tree, 0, 0)) goto error;
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "serializeJournalHeader fails");
+  }
+  tree = destroyRecordTree(tree);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : serializeJournalRecord
+ * Description: Append a record event to a records journal
+ * Synopsis   : int serializeJournalRecord(Record* self, int fd)
+ * Input      : Record* self: the added record (or removed one if
+ *                            marked REMOVE)
+ *              int fd: the journal file
+ * Output     : TRUE on success
+ * Note       : removed records are prefixed by a '-'
+ =======================================================================*/
+int 
+serializeJournalRecord(Record* self, int fd)
+{
+  int rc = FALSE;
+  struct tm date;
+  char buf[MAX_SIZE_STRING + 2*MAX_SIZE_MD5 + MAX_SIZE_SIZE + 32];
+  int l = 0;
+
+  checkRecord(self);
+  logMemory(LOG_DEBUG, "journal Record: %s%s, %s %s:%lli",
+	    (self->type & REMOVE)?"-":"", strRecordType(self), 
+	    self->server->fingerPrint, 
+	    self->archive->hash, (long long int)self->archive->size);
+  
+  if (localtime_r(&self->date, &date) == (struct tm*)0) {
+    logMemory(LOG_ERR, "localtime_r returns on error");
+    goto error;
+  }
+
+  l = snprintf(buf, sizeof(buf), "%s%c "
+	       "%04i-%02i-%02i,%02i:%02i:%02i "
+	       "%*s %*s %*llu %s\n",
+	       (self->type & REMOVE)?"-":"",
+	       (self->type & 0x3) == DEMAND?'D':
+	       (self->type & 0x3) == SUPPLY?'S':'?',
+	       date.tm_year + 1900, date.tm_mon+1, date.tm_mday,
+	       date.tm_hour, date.tm_min, date.tm_sec,
+	       MAX_SIZE_MD5, self->server->fingerPrint, 
+	       MAX_SIZE_MD5, self->archive->hash, 
+	       MAX_SIZE_SIZE, 
+	       (long long unsigned int)self->archive->size,
+	       self->extra?self->extra:"");
+  if (l < 0 || l >= sizeof(buf)) {
+    logMemory(LOG_ERR, "record too long for the journal");
+    goto error;
+  }
+
+  // only one write, so as a line is never half-written by a thread
+  if (write(fd, buf, l) != l) {
+    logMemory(LOG_ERR, "write fails: %s", strerror(errno));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMemory(LOG_ERR, "fails to journal a record");
+  }
+  return rc;
+}
+
+
 /*=======================================================================
  * Function   : newRecord
  * Description: find a record 
@@ -723,7 +824,7 @@ Record* addRecord(Collection* coll, Server* server, Archive* archive,
   if (!(record = newRecord(server, archive, type, extra))) goto error;
 
   // add record to archive ring
-  if (!rgInsert(archive->records, record)) goto error;
+  if (!rgInsert(arRecords(archive), record)) goto error;
   
   /* // add record to server btree */
   /* if (!avl_insert(server->records, record)) { */
@@ -762,8 +863,8 @@ int delRecord(Collection* coll, Record* self)
 	  self->archive->hash, (long long int)self->archive->size);
 
   // del record from archive ring
-  if ((curr = rgHaveItem(self->archive->records, self))) {
-    rgRemove_r(self->archive->records, &curr);
+  if ((curr = rgHaveItem(arRecords(self->archive), self))) {
+    rgRemove_r(arRecords(self->archive), &curr);
   }
 
   /* // del record from server ring */
@@ -28,7 +28,7 @@
 //#include <netinet/in.h>
 
 // message type
-typedef enum {UNKNOWN, DISK, CGI, HAVE, NOTIFY, UPLOAD} MessageType;
+typedef enum {UNKNOWN, DISK, CGI, HAVE, NOTIFY, UPLOAD, STREAM} MessageType;
 
 // type write into Record struct
 typedef enum {
@@ -59,6 +59,7 @@ struct RecordTree
   AESData     aes;
   int         doCypher;   // do AES cypher the body when serializing
   AVLTree*    records;
+  RG*         journal;    // events in order (journal parsing only)
 };
 
 int cmpRecord(const void *p1, const void *p2);
@@ -70,6 +71,8 @@ Record* createRecord(void);
 Record* destroyRecord(Record* self);
 Record* copyRecord(Record* destination, Record* source);
 int serializeRecordTree(RecordTree* self, char* path, char* fingerPrint);
+int serializeJournalHeader(Collection* coll, int fd);
+int serializeJournalRecord(Record* self, int fd);
 void logRecordTree(int logModule, int logPriority,
 		   RecordTree* self, char* fingerPrint);
 
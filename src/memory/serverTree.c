@@ -600,7 +600,7 @@ addImage(Collection* coll, Server* server, Archive* archive)
   if (!rgInsert(server->images, image)) goto error;
     
   // add image to archive
-  if (!rgInsert(archive->images, image)) goto error;
+  if (!rgInsert(arImages(archive), image)) goto error;
 
   // add archive to serverTree, if not already there
   if (!rgHaveItem(coll->serverTree->archives, archive)) {
@@ -608,6 +608,8 @@ addImage(Collection* coll, Server* server, Archive* archive)
   }
 
  end:
+  // archive's score depends on its images (caller may set the score)
+  if (!addToRescore(coll, archive)) goto error;
   rc = image;
  error:
   if (!rc) {
@@ -647,12 +649,13 @@ delImage(Collection* coll, Image* image)
   }
 
   // delete image from archive
-  if ((curr = rgHaveItem(image->archive->images, image))) {
-    rgRemove_r(image->archive->images, &curr);
+  if ((curr = rgHaveItem(arImages(image->archive), image))) {
+    rgRemove_r(arImages(image->archive), &curr);
   }
+  if (!addToRescore(coll, image->archive)) goto error;
 
   // delete archive from serverTree (if last related image)
-  if (isEmptyRing(image->archive->images)) {
+  if (isEmptyRing(arImages(image->archive))) {
     if ((curr = rgHaveItem(coll->serverTree->archives, image->archive))) {
       rgRemove_r(coll->serverTree->archives, &curr);
     }
@@ -812,9 +815,10 @@ diseaseServer(Collection* coll, Server* server)
     }
 
     // delete image from archive
-    if ((curr = rgHaveItem(image->archive->images, image))) {
-      rgRemove_r(image->archive->images, &curr);
+    if ((curr = rgHaveItem(arImages(image->archive), image))) {
+      rgRemove_r(arImages(image->archive), &curr);
     }
+    if (!addToRescore(coll, image->archive)) goto error;
 
     // try to disease archive
     if (!diseaseArchive(coll, image->archive)) goto error;    
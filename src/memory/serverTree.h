@@ -65,6 +65,7 @@ struct Server {
   struct sockaddr_in address; // manage by connect.c
   float score;                // manage by extractHtml.c
   time_t lastCommit;
+  int isMute;                 // lastCommit older than serverTTL
 
   // manage by cache.c
   off_t  cacheSize; // maximum size for cache
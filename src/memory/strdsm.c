@@ -256,6 +256,103 @@ cmpString(const void *p1, const void *p2)
   return strcmp(w1, w2);
 }
 
+/*=======================================================================
+ * Function   : cmpStringAvl
+ * Description: compare two strings from a pool
+ * Synopsis   : static int cmpStringAvl(const void *p1, const void *p2)
+ * Input      : p1 and p2 are char*
+ * Output     : strcmp result
+ =======================================================================*/
+static int 
+cmpStringAvl(const void *p1, const void *p2)
+{
+  return strcmp((char*)p1, (char*)p2);
+}
+
+/*=======================================================================
+ * Function   : createStringPool (strdsm) [MediaTeX]
+ * Description: Create a pool to store identical strings only once
+ * Synopsis   : AVLTree* createStringPool()
+ * Input      : N/A
+ * Output     : Address of the pool or nil if the creation fails.
+ =======================================================================*/
+AVLTree* 
+createStringPool()
+{
+  AVLTree* rc = 0;
+
+  if (!(rc = avl_alloc_tree(cmpStringAvl, (avl_freeitem_t)destroyString))) {
+    logMemory(LOG_ERR, "malloc: cannot create string pool");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : destroyStringPool (strdsm) [MediaTeX]
+ * Description: Destroy a pool and all the strings it stores
+ * Synopsis   : AVLTree* destroyStringPool(AVLTree* self)
+ * Input      : AVLTree* self = the pool to destroy
+ * Output     : Nil address of a pool.
+ =======================================================================*/
+AVLTree* 
+destroyStringPool(AVLTree* self)
+{
+  if (self) avl_free_tree(self);
+  return (AVLTree*)0;
+}
+
+/*=======================================================================
+ * Function   : getPoolString (strdsm) [MediaTeX]
+ * Description: Find a string into a pool
+ * Synopsis   : char* getPoolString(AVLTree* pool, const char* content)
+ * Input      : AVLTree* pool = where to find
+ *              char* content = the content to find
+ * Output     : Address of the pool's string or nil if not there.
+ =======================================================================*/
+char* 
+getPoolString(AVLTree* pool, const char* content)
+{
+  AVLNode* node = 0;
+
+  if (!pool || !content) return (char*)0;
+  if (!(node = avl_search(pool, content))) return (char*)0;
+  return (char*)node->item;
+}
+
+/*=======================================================================
+ * Function   : internString (strdsm) [MediaTeX]
+ * Description: Get the pool's string having a given content, adding
+ *              it if not already there
+ * Synopsis   : char* internString(AVLTree* pool, const char* content)
+ * Input      : AVLTree* pool = where to store the string
+ *              char* content = the content of the string
+ * Output     : Address of the pool's string or nil if the creation
+ *              fails.
+ * Note       : the returned string is owned by the pool: it must not
+ *              be modified nor freed, and may be compared by pointer
+ *              with other strings from the same pool.
+ =======================================================================*/
+char* 
+internString(AVLTree* pool, const char* content)
+{
+  char* rc = 0;
+  char* string = 0;
+
+  if (!pool || !content) goto error;
+  if ((rc = getPoolString(pool, content))) goto error;
+
+  if (!(string = createString(content))) goto error;
+  if (!avl_insert(pool, string)) {
+    logMemory(LOG_ERR, "cannot add \"%s\" to the string pool", content);
+    goto error;
+  }
+  rc = string;
+  string = 0;
+ error:
+  string = destroyString(string);
+  return rc;
+}
+
 /* Local Variables: */
 /* mode: c */
 /* mode: font-lock */
@@ -35,6 +35,11 @@ char* destroyString(char* self);
 inline int isEmptyString(const char* content);
 int cmpString(const void *p1, const void *p2);
 
+AVLTree* createStringPool();
+AVLTree* destroyStringPool(AVLTree* self);
+char* getPoolString(AVLTree* pool, const char* content);
+char* internString(AVLTree* pool, const char* content);
+
 #endif /* MDTX_MEMORY_STRDSM_H */
 
 /* Local Variables: */
@@ -29,6 +29,7 @@
 #include <sys/socket.h>  //
 #include <netinet/tcp.h> // inet_ntoa
 #include <arpa/inet.h>   //
+#include <signal.h>      // pthread_sigmask
 
 // It seems that gethostby*_r functions are obsolete too:
 //  https://sourceware.org/bugzilla/show_bug.cgi?id=515
@@ -36,73 +37,489 @@
 #define GETHOSTBY_BUFFER_SIZE 1024
 
 
+// resolver cache (shared by all the threads of a process)
+typedef struct DnsEntry {
+  int    isReverse;  // key is ipv4 (else key is host)
+  char   host[MAX_SIZE_HOST+1];
+  struct in_addr ipv4;
+  int    error;      // h_errno of the last failure, 0 if resolved
+  int    isPending;  // queued for the resolver thread
+  time_t expire;     // 0 if never resolved
+  time_t lastSeen;
+} DnsEntry;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  pthread_t thread;
+  int isRunning;     // a resolver thread is there (daemon only)
+  unsigned long nbHits;
+  unsigned long nbMisses;
+  DnsEntry entries[MAX_DNS_ENTRY];
+} dns = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+
 /*=======================================================================
- * Function   : getHostNameByAddr
- * Description: Retrieve the host name from the IP address
- * Synopsis   : getHostNameByAddr(struct in_addr* inAddr)
+ * Function   : resolveAddr
+ * Description: Ask the DNS for the host name of an IP address
+ * Synopsis   : static int resolveAddr(struct in_addr* inAddr, 
+ *                                     char* host, int* error)
  * Input      : struct in_addr* inAddr
- * Output     : an allocated string for the host name
+ * Output     : char* host: the host name (the IP if not found)
+ *              int* error: h_errno on failure, 0 on success
+ *              TRUE on success
  * Note       : Need an entry in /etc/hosts for local machine.
  *              Maybe need /etc/host.conf: order hosts,bind
  *              We should prefer to retrieve IP from hostname if possible
  =======================================================================*/
-char*
-getHostNameByAddr(struct in_addr* inAddr)
+static int
+resolveAddr(struct in_addr* inAddr, char* host, int* error)
 {
-  char* rc = 0;
+  int rc = FALSE;
   struct hostent sHost;
   struct hostent *result = 0;
   char buf[GETHOSTBY_BUFFER_SIZE];
   int h_errnop = 0;
 
+  *error = 0;
+  inet_ntop(AF_INET, inAddr, host, MAX_SIZE_HOST+1);
   if ((gethostbyaddr_r(inAddr, sizeof(struct in_addr), AF_INET,
 		       &sHost, buf, GETHOSTBY_BUFFER_SIZE, &result, &h_errnop)) 
       || !result) {
     logMisc(LOG_NOTICE, 
 	    "gethostbyaddr_r: cannot retrieve host name for %s: %s",
-	    inet_ntoa(*inAddr), hstrerror(h_errnop));
+	    host, hstrerror(h_errnop));
 
     switch (h_errnop) {
     case HOST_NOT_FOUND:
-      logMisc(LOG_INFO, "gethostbyaddr: %s", "HOST_NOT_FOUND");
-      
       // do not found an hostname: use IP instead
-      if ((rc = (char*)malloc(16)) == 0) {
-	logMisc(LOG_ERR, "malloc cannot allocate string for IP");
-	goto error;
-      }
-      memset(rc, 0, 16);
-      strcpy(rc, inet_ntoa(*inAddr));
-      goto end;
+      logMisc(LOG_INFO, "gethostbyaddr: %s", "HOST_NOT_FOUND");
+      break;
     case NO_ADDRESS:
       logMisc(LOG_ERR, "gethostbyaddr: %s", "NO_ADDRESS");
-      goto error;
+      break;
     case NO_RECOVERY:
       logMisc(LOG_ERR, "gethostbyaddr: %s", "NO_RECOVERY");
-      goto error;
+      break;
     case TRY_AGAIN:
       logMisc(LOG_ERR, "gethostbyaddr: %s", "TRY_AGAIN");
-      goto error;
+      break;
     case ERANGE:
       logMisc(LOG_ERR, "gethostbyaddr: %s", "ERANGE");
-      goto error;
+      break;
     }
+    *error = h_errnop ? h_errnop : NO_RECOVERY;
     goto error;
   }
 
   // normal case (found a hostname)
-  if ((rc = (char*)malloc(strlen(sHost.h_name)+1)) == 0) {
-    logMisc(LOG_ERR, "malloc cannot allocate string of len %i+1",
-	    strlen(sHost.h_name));
+  strncpy(host, sHost.h_name, MAX_SIZE_HOST);
+  host[MAX_SIZE_HOST] = (char)0;
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : resolveName
+ * Description: Ask the DNS for the IP address of a host name
+ * Synopsis   : static int resolveName(const char* hostname, 
+ *                                     struct in_addr* ipv4, int* error)
+ * Input      : const char* hostname
+ * Output     : struct in_addr* ipv4: the IP address
+ *              int* error: h_errno on failure, 0 on success
+ *              TRUE on success
+ =======================================================================*/
+static int
+resolveName(const char* hostname, struct in_addr* ipv4, int* error)
+{
+  int rc = FALSE;
+  struct hostent sHost;
+  struct hostent *result = 0;
+  char buf[GETHOSTBY_BUFFER_SIZE];
+  int h_errnop = 0;
+
+  *error = 0;
+  memset(ipv4, 0, sizeof(struct in_addr));
+  if (gethostbyname_r(hostname, &sHost, buf, GETHOSTBY_BUFFER_SIZE,
+		      &result, &h_errnop)
+      || !result) {
+    logMisc(LOG_ERR, "gethostbyname_r %s: %s", 
+	    hostname, hstrerror(h_errnop));
+    *error = h_errnop ? h_errnop : NO_RECOVERY;
+    goto error;
+  }
+  *ipv4 = *((struct in_addr *) sHost.h_addr);
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : findDnsEntry
+ * Description: Look for an entry into the resolver cache
+ * Synopsis   : static DnsEntry* findDnsEntry(int isReverse, 
+ *                    const char* host, struct in_addr* ipv4, int doCreate)
+ * Input      : int isReverse: key is ipv4, else key is host
+ *              const char* host, struct in_addr* ipv4: the key
+ *              int doCreate: add an (unresolved) entry if not found
+ * Output     : the entry, 0 if not found
+ * Note       : dns.mutex must be locked.
+ *              The least recently seen entry is recycled.
+ =======================================================================*/
+static DnsEntry*
+findDnsEntry(int isReverse, const char* host, struct in_addr* ipv4, 
+	     int doCreate)
+{
+  DnsEntry* rc = 0;
+  DnsEntry* entry = 0;
+  int i = 0;
+
+  for (i = 0; i < MAX_DNS_ENTRY; ++i) {
+    entry = dns.entries + i;
+    if (!entry->lastSeen || entry->isReverse != isReverse) continue;
+    if (isReverse) {
+      if (entry->ipv4.s_addr != ipv4->s_addr) continue;
+    }
+    else {
+      if (strncmp(entry->host, host, MAX_SIZE_HOST)) continue;
+    }
+    rc = entry;
+    goto end;
+  }
+  if (!doCreate) goto end;
+
+  for (i = 0; i < MAX_DNS_ENTRY; ++i) {
+    entry = dns.entries + i;
+    if (!rc || entry->lastSeen < rc->lastSeen) rc = entry;
+  }
+  memset(rc, 0, sizeof(DnsEntry));
+  rc->isReverse = isReverse;
+  if (isReverse) {
+    rc->ipv4 = *ipv4;
+  }
+  else {
+    strncpy(rc->host, host, MAX_SIZE_HOST);
+  }
+  rc->lastSeen = currentTime();
+ end:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : storeDnsEntry
+ * Description: Cache a DNS answer
+ * Synopsis   : static void storeDnsEntry(DnsEntry* answer)
+ * Input      : DnsEntry* answer: key, value and error
+ * Output     : N/A
+ * Note       : dns.mutex must be locked.
+ *              Failures are kept less time than the answers.
+ =======================================================================*/
+static void
+storeDnsEntry(DnsEntry* answer)
+{
+  DnsEntry* entry = 0;
+
+  entry = findDnsEntry(answer->isReverse, answer->host, &answer->ipv4, 
+		       TRUE);
+  if (answer->isReverse) {
+    strcpy(entry->host, answer->host);
+  }
+  else {
+    entry->ipv4 = answer->ipv4;
+  }
+  entry->error = answer->error;
+  entry->isPending = FALSE;
+  entry->expire = currentTime() + 
+    (answer->error ? DNS_FAILED_TTL : DNS_CACHE_TTL);
+}
+
+/*=======================================================================
+ * Function   : lookupDnsEntry
+ * Description: Get a DNS answer from the resolver cache
+ * Synopsis   : static int lookupDnsEntry(DnsEntry* query, int doQueue)
+ * Input      : DnsEntry* query: the key
+ *              int doQueue: let the resolver thread resolve it if
+ *                           not already cached
+ * Output     : DnsEntry* query: value and error
+ *              TRUE if cached
+ * Note       : outdated answers are still used when a resolver thread
+ *              is there, as it is asked to refresh them.
+ =======================================================================*/
+static int
+lookupDnsEntry(DnsEntry* query, int doQueue)
+{
+  int rc = FALSE;
+  DnsEntry* entry = 0;
+  time_t now = currentTime();
+
+  pthread_mutex_lock(&dns.mutex);
+  doQueue = doQueue && dns.isRunning;
+  if (!(entry = findDnsEntry(query->isReverse, query->host, &query->ipv4,
+			     doQueue))) goto end;
+  entry->lastSeen = now;
+
+  if (entry->expire > now || (entry->expire && dns.isRunning)) {
+    if (query->isReverse) {
+      strcpy(query->host, entry->host);
+    }
+    else {
+      query->ipv4 = entry->ipv4;
+    }
+    query->error = entry->error;
+    rc = TRUE;
+  }
+
+  // refresh it from the resolver thread
+  if (entry->expire <= now && dns.isRunning && !entry->isPending
+      && (rc || doQueue)) {
+    entry->isPending = TRUE;
+    pthread_cond_signal(&dns.cond);
+  }
+ end:
+  if (rc) ++dns.nbHits; else ++dns.nbMisses;
+  pthread_mutex_unlock(&dns.mutex);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : resolverThread
+ * Description: Resolve the queued entries
+ * Synopsis   : static void* resolverThread(void* arg)
+ * Input      : void* arg: N/A
+ * Output     : N/A
+ =======================================================================*/
+static void*
+resolverThread(void* arg)
+{
+  DnsEntry job;
+  char ip[INET_ADDRSTRLEN];
+  int i = 0;
+
+  (void) arg;
+  pthread_mutex_lock(&dns.mutex);
+  while (dns.isRunning) {
+    for (i = 0; i < MAX_DNS_ENTRY && !dns.entries[i].isPending; ++i);
+    if (i == MAX_DNS_ENTRY) {
+      pthread_cond_wait(&dns.cond, &dns.mutex);
+      continue;
+    }
+    job = dns.entries[i];
+    dns.entries[i].isPending = FALSE;
+    pthread_mutex_unlock(&dns.mutex);
+
+    if (job.isReverse) {
+      resolveAddr(&job.ipv4, job.host, &job.error);
+    }
+    else {
+      resolveName(job.host, &job.ipv4, &job.error);
+    }
+    inet_ntop(AF_INET, &job.ipv4, ip, INET_ADDRSTRLEN);
+    logMisc(LOG_DEBUG, "resolver: %s is %s", job.host, ip);
+
+    pthread_mutex_lock(&dns.mutex);
+    storeDnsEntry(&job);
+  }
+  pthread_mutex_unlock(&dns.mutex);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : startResolver
+ * Description: Resolve the DNS queries from a dedicated thread
+ * Synopsis   : int startResolver()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : only for the daemon. Without it, queries are resolved
+ *              on the calling thread (and cached).
+ =======================================================================*/
+int
+startResolver()
+{
+  int rc = FALSE;
+  sigset_t mask;
+  sigset_t oldMask;
+  int err = 0;
+
+  logMisc(LOG_DEBUG, "startResolver");
+  pthread_mutex_lock(&dns.mutex);
+  if (dns.isRunning) goto end;
+  dns.isRunning = TRUE;
+
+  // the resolver must not catch the signals managed by sigwait
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+  err = pthread_create(&dns.thread, 0, resolverThread, 0);
+  pthread_sigmask(SIG_SETMASK, &oldMask, 0);
+  if (err) {
+    logMisc(LOG_ERR, "pthread_create fails: %s", strerror(err));
+    dns.isRunning = FALSE;
     goto error;
   }
-  strcpy(rc, sHost.h_name);
  end:
+  rc = TRUE;
  error:
+  pthread_mutex_unlock(&dns.mutex);
+  if (!rc) {
+    logMisc(LOG_ERR, "startResolver fails");
+  }
   return rc;
 }
 
-
+/*=======================================================================
+ * Function   : stopResolver
+ * Description: Stop the resolver thread
+ * Synopsis   : int stopResolver()
+ * Input      : N/A
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+stopResolver()
+{
+  int rc = FALSE;
+  int isRunning = FALSE;
+  int err = 0;
+
+  logMisc(LOG_DEBUG, "stopResolver");
+  pthread_mutex_lock(&dns.mutex);
+  isRunning = dns.isRunning;
+  dns.isRunning = FALSE;
+  pthread_cond_broadcast(&dns.cond);
+  pthread_mutex_unlock(&dns.mutex);
+
+  if (isRunning && (err = pthread_join(dns.thread, 0))) {
+    logMisc(LOG_ERR, "pthread_join fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMisc(LOG_ERR, "stopResolver fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : prefetchHostname
+ * Description: Ask the resolver thread to resolve a host name
+ * Synopsis   : void prefetchHostname(const char* hostname)
+ * Input      : const char* hostname
+ * Output     : N/A
+ * Note       : do nothing without resolver thread, or if already cached
+ =======================================================================*/
+void
+prefetchHostname(const char* hostname)
+{
+  DnsEntry query;
+  struct in_addr ipv4;
+
+  if (!dns.isRunning || !hostname || !*hostname) return;
+  if (inet_aton(hostname, &ipv4)) return;
+
+  memset(&query, 0, sizeof(DnsEntry));
+  strncpy(query.host, hostname, MAX_SIZE_HOST);
+  lookupDnsEntry(&query, TRUE);
+}
+
+/*=======================================================================
+ * Function   : resolverStatus
+ * Description: Log the resolver cache
+ * Synopsis   : void resolverStatus(int priority)
+ * Input      : int priority: log level
+ * Output     : N/A
+ =======================================================================*/
+void
+resolverStatus(int priority)
+{
+  DnsEntry* entry = 0;
+  char ip[INET_ADDRSTRLEN];
+  time_t now = currentTime();
+  int i = 0;
+
+  pthread_mutex_lock(&dns.mutex);
+  logMisc(priority, "===");
+  logMisc(priority, "DNS cache: %lu hits, %lu misses", 
+	  dns.nbHits, dns.nbMisses);
+  for (i = 0; i < MAX_DNS_ENTRY; ++i) {
+    entry = dns.entries + i;
+    if (!entry->lastSeen) continue;
+    inet_ntop(AF_INET, &entry->ipv4, ip, INET_ADDRSTRLEN);
+    logMisc(priority, "%s %-15s %s: %s (%lis)", 
+	    entry->isReverse ? "<" : ">", ip, entry->host,
+	    !entry->expire ? "pending" : 
+	    entry->error ? hstrerror(entry->error) : "ok",
+	    entry->expire ? (long int)(entry->expire - now) : 0L);
+  }
+  logMisc(priority, "===");
+  pthread_mutex_unlock(&dns.mutex);
+}
+
+/*=======================================================================
+ * Function   : ageResolver
+ * Description: Make the cached answers older
+ * Synopsis   : void ageResolver(time_t delay)
+ * Input      : time_t delay: seconds to remove from the expiration dates
+ * Output     : N/A
+ * Note       : for unit tests, as currentTime() never changes there
+ =======================================================================*/
+void
+ageResolver(time_t delay)
+{
+  int i = 0;
+
+  pthread_mutex_lock(&dns.mutex);
+  for (i = 0; i < MAX_DNS_ENTRY; ++i) {
+    if (dns.entries[i].expire) dns.entries[i].expire -= delay;
+  }
+  pthread_mutex_unlock(&dns.mutex);
+}
+
+/*=======================================================================
+ * Function   : getHostNameByAddr
+ * Description: Retrieve the host name from the IP address
+ * Synopsis   : getHostNameByAddr(struct in_addr* inAddr)
+ * Input      : struct in_addr* inAddr
+ * Output     : an allocated string for the host name (the IP if not
+ *              found or not resolved yet)
+ * Note       : when a resolver thread is there, never wait for the
+ *              DNS: the IP is returned until the name is cached.
+ =======================================================================*/
+char*
+getHostNameByAddr(struct in_addr* inAddr)
+{
+  char* rc = 0;
+  DnsEntry query;
+
+  memset(&query, 0, sizeof(DnsEntry));
+  query.isReverse = TRUE;
+  query.ipv4 = *inAddr;
+
+  if (!lookupDnsEntry(&query, TRUE)) {
+    if (dns.isRunning) {
+      inet_ntop(AF_INET, inAddr, query.host, MAX_SIZE_HOST+1);
+    }
+    else {
+      resolveAddr(inAddr, query.host, &query.error);
+      pthread_mutex_lock(&dns.mutex);
+      storeDnsEntry(&query);
+      pthread_mutex_unlock(&dns.mutex);
+    }
+  }
+  if (query.error && query.error != HOST_NOT_FOUND) goto error;
+
+  if ((rc = (char*)malloc(strlen(query.host)+1)) == 0) {
+    logMisc(LOG_ERR, "malloc cannot allocate string of len %i+1",
+	    strlen(query.host));
+    goto error;
+  }
+  strcpy(rc, query.host);
+ error:
+  return rc;
+}
+
+
 /*=======================================================================
  * Function   : getIpFromHostname
  * Author     : Nicolas ROCHE
@@ -111,16 +528,14 @@ getHostNameByAddr(struct in_addr* inAddr)
  * Input      : char* hostname = the hostname
  *              struct in_addr *ipv4 = structure to fill
  * Output     : TRUE on success
+ * Note       : failures are cached too, so as to fail fast
  =======================================================================*/
 int
 getIpFromHostname(struct in_addr *ipv4, const char* hostname)
 {
   int rc = FALSE;
   int a,b,c,d;
-  struct hostent sHost;
-  struct hostent *result = 0;
-  char buf[GETHOSTBY_BUFFER_SIZE];
-  int h_errnop = 0;
+  DnsEntry query;
 
   logMisc(LOG_DEBUG, "getIpFromHostname %s", hostname);
   memset(ipv4, 0, sizeof(struct in_addr));
@@ -133,14 +548,22 @@ getIpFromHostname(struct in_addr *ipv4, const char* hostname)
     }
   }
   else {
-    if (gethostbyname_r(hostname, &sHost, buf, GETHOSTBY_BUFFER_SIZE,
-			&result, &h_errnop)
-	|| !result) {
-      logMisc(LOG_ERR, "gethostbyname_r %s: %s", 
-	      hostname, hstrerror(h_errnop));
-      goto error;
+    memset(&query, 0, sizeof(DnsEntry));
+    strncpy(query.host, hostname, MAX_SIZE_HOST);
+    if (lookupDnsEntry(&query, FALSE)) {
+      if (query.error) {
+	logMisc(LOG_ERR, "gethostbyname_r %s: %s (cached)", 
+		hostname, hstrerror(query.error));
+      }
+    }
+    else {
+      resolveName(hostname, &query.ipv4, &query.error);
+      pthread_mutex_lock(&dns.mutex);
+      storeDnsEntry(&query);
+      pthread_mutex_unlock(&dns.mutex);
     }
-    *ipv4 = *((struct in_addr *) sHost.h_addr);
+    if (query.error) goto error;
+    *ipv4 = query.ipv4;
   }
 
   rc = TRUE;
@@ -151,7 +574,7 @@ getIpFromHostname(struct in_addr *ipv4, const char* hostname)
   return rc;
 }
 
-
+
 /*=======================================================================
  * Function   : buildSocketAddressEasy 
  * Author     : Nicolas ROCHE
@@ -27,6 +27,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>  // for inet_ntoa
 
+int startResolver();
+int stopResolver();
+void prefetchHostname(const char* hostname);
+void resolverStatus(int priority);
+void ageResolver(time_t delay);
+
 char* getHostNameByAddr(struct in_addr* inAddr);
 
 int getIpFromHostname(struct in_addr *ipv4, const char* hostname);
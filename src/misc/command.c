@@ -24,6 +24,9 @@
 #include "mediatex-config.h"
 #include <libgen.h>    // basename
 #include <sys/wait.h>  // waitpid
+#ifdef HAVE_POSIX_SPAWN
+#include <spawn.h>     // posix_spawn
+#endif
 
 extern char **environ;
 
@@ -371,6 +374,109 @@ execChild(char** argv, int doHideStderr)
   }
 }
 
+#ifdef HAVE_POSIX_SPAWN
+/*=======================================================================
+ * Function   : spawnChild
+ * Description: posix_spawn call providing the MDTX environment variables
+ * Synopsis   : static int spawnChild(char** argv, char* pwd, 
+ *                                    int doHideStderr, pid_t* childId)
+ * Input      : argv = the command line to run
+ *              pwd = directory to change to before exec
+ *              doHideStderr = close stderr before exec
+ * Output     : pid_t* childId = the new process
+ *              TRUE on success
+ * Note       : same redirections as execChild. Unlike fork, the cost
+ *              does not depend on the daemon's heap size and the child
+ *              do not inherit the allocator's locks.
+ =======================================================================*/
+static int
+spawnChild(char** argv, char* pwd, int doHideStderr, pid_t* childId)
+{
+  int rc = FALSE;
+  posix_spawn_file_actions_t actions;
+  int isInit = FALSE;
+  int doHideStdout = FALSE;
+  int err = 0;
+
+  logMisc(LOG_DEBUG, "spawnChild: %s (do%s hide stderr)",
+	  argv[0], doHideStderr?"":"nt");
+
+  if (argv[0][0] != '/') {
+    logMisc(LOG_ERR, "refuse to exec from a relative path");
+    goto error;
+  }
+
+  if ((err = posix_spawn_file_actions_init(&actions))) {
+    logMisc(LOG_ERR, "posix_spawn_file_actions_init fails: %s", 
+	    strerror(err));
+    goto error;
+  }
+  isInit = TRUE;
+
+  // - close stdout by default
+  if (env.background) doHideStdout = TRUE;
+  if (env.logHandler->severity[LOG_SCRIPT]->code <= LOG_INFO) {
+    logMisc(LOG_INFO,
+	    "hide stdout from child (use '-sdebug:script' to show)");
+    doHideStdout = TRUE;
+  }
+
+  // - close stderr when it introduce noise
+  if (doHideStderr &&
+      env.logHandler->severity[LOG_SCRIPT]->code <= LOG_NOTICE) {
+    logMisc(LOG_INFO, "hide stderr from child "
+	    "(use '-sinfo:script' to show)");
+  }
+  else {
+    doHideStderr = env.background;
+  }
+
+  if (doHideStdout &&
+      (err = posix_spawn_file_actions_addopen(&actions, 1, "/dev/null",
+					      O_WRONLY, 0))) {
+    logMisc(LOG_ERR, "posix_spawn_file_actions_addopen fails: %s", 
+	    strerror(err));
+    goto error;
+  }
+  if (doHideStderr &&
+      (err = posix_spawn_file_actions_addopen(&actions, 2, "/dev/null",
+					      O_WRONLY, 0))) {
+    logMisc(LOG_ERR, "posix_spawn_file_actions_addopen fails: %s", 
+	    strerror(err));
+    goto error;
+  }
+
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+  // change working directory
+  if (pwd && (err = posix_spawn_file_actions_addchdir_np(&actions, pwd))) {
+    logMisc(LOG_ERR, "posix_spawn_file_actions_addchdir_np fails: %s", 
+	    strerror(err));
+    goto error;
+  }
+#else
+  if (pwd) {
+    logMisc(LOG_ERR, "cannot spawn from another directory");
+    goto error;
+  }
+#endif
+
+  logMisc(LOG_INFO, "--- exec system call begin ---");
+  if ((err = posix_spawn(childId, argv[0], &actions, 0, argv, environ))) {
+    logMisc(LOG_ERR, "posix_spawn fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (isInit && (err = posix_spawn_file_actions_destroy(&actions))) {
+    logMisc(LOG_ERR, "posix_spawn_file_actions_destroy fails: %s", 
+	    strerror(err));
+    rc = FALSE;
+  }
+  return rc;
+}
+#endif
+
 /*=======================================================================
  * Function   : execScript
  * Description: system call providing the MDTX environment variables
@@ -380,6 +486,8 @@ execChild(char** argv, int doHideStderr)
  *              pwd = directory to change to before exec
  *              doHideStderr = close stderr before exec
  * Output     : TRUE on success
+ * Note       : fork is only used when we have to change user (or
+ *              when posix_spawn is not available)
  =======================================================================*/
 int 
 execScript(char** argv, char* user, char* pwd, int doHideStderr)
@@ -406,6 +514,18 @@ execScript(char** argv, char* user, char* pwd, int doHideStderr)
     logMisc(LOG_INFO, " arg%i: %s", i, argv[i]);
   }
   
+#ifdef HAVE_POSIX_SPAWN
+  // spawn: new process
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+  if (!user) {
+#else
+  if (!user && !pwd) {
+#endif
+    if (!spawnChild(argv, pwd, doHideStderr, &childId)) goto error;
+    goto reap;
+  }
+#endif
+
   // fork: new process
   if ((childId = fork()) == -1) {
       logMisc(LOG_ERR, "fork failed: ", strerror(errno));
@@ -417,12 +537,12 @@ execScript(char** argv, char* user, char* pwd, int doHideStderr)
     // child
 
     // change user
-    if (user && !becomeUser(user, FALSE)) goto error;
+    if (user && !becomeUser(user, FALSE)) exit(EXIT_FAILURE);
 
     // change working directory
     if (pwd && chdir(pwd)) {
       logMisc(LOG_ERR, "chdir fails: %s", strerror(errno));
-      goto error;
+      exit(EXIT_FAILURE);
     }
 
     logMisc(LOG_INFO, "--- exec system call begin ---");
@@ -433,16 +553,22 @@ execScript(char** argv, char* user, char* pwd, int doHideStderr)
  
   default:
    // father
-    if ((pid = waitpid(childId, &status, 0)) == -1) {
-      logMisc(LOG_ERR, "wait failed (%i): %s", errno, strerror(errno));
-      goto error;
-    }
-    if (pid != childId) {
-      logMisc(LOG_ERR, 
-	      "wait exit with unexpected process %i (waiting for %i)", 
-	      rc, childId);
-      goto error;
-    }
+    break;
+  }
+
+#ifdef HAVE_POSIX_SPAWN
+ reap:
+#endif
+  while ((pid = waitpid(childId, &status, 0)) == -1 && errno == EINTR);
+  if (pid == -1) {
+    logMisc(LOG_ERR, "wait failed (%i): %s", errno, strerror(errno));
+    goto error;
+  }
+  if (pid != childId) {
+    logMisc(LOG_ERR, 
+	    "wait exit with unexpected process %i (waiting for %i)", 
+	    pid, childId);
+    goto error;
   }
 
   logMisc(LOG_INFO, "--- exec system call end ---");
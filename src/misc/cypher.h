@@ -45,6 +45,8 @@ typedef struct AESData {
 	      - DECRYPT: aesInit will read from fr */		 
 } AESData;
 
+int fdWrite(int fd, void* buffer, size_t bufferSize);
+size_t fdRead(int fd, void* buffer, size_t bufferSize);
 int aesInit(AESData* data, char key[MAX_SIZE_AES+1], MDTX_AES_WAY way);
 int aesPrint(AESData* data, const char* format, ...);
 int aesFlush(AESData* data);
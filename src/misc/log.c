@@ -363,6 +363,230 @@ logOpen(char* name, int facility, int* logSeverity,
 }
 
 
+/*=======================================================================
+ * Function   : logWrite
+ * Description: Write a formated message to syslog or to the log file
+ * Synopsis   : static void logWrite(LogHandler* logHandler, 
+ *                                   int priority, const char* text)
+ * Input      : LogHandler* logHandler = the log handler
+ *              int priority = the priority of the message
+ *              const char* text = the message
+ * Output     : N/A
+ =======================================================================*/
+static void
+logWrite(LogHandler* logHandler, int priority, const char* text)
+{
+  if (!(logHandler->hlog)) {
+    syslog(priority, "%s", text);
+  }
+  else {
+    fprintf(logHandler->hlog, "%s\n", text);
+  }
+}
+
+/*=======================================================================
+ * Function   : logReportDrops
+ * Description: Log how many messages were dropped
+ * Synopsis   : static void logReportDrops(LogHandler* logHandler,
+ *                                         unsigned long nbDropped)
+ * Input      : LogHandler* logHandler = the log handler
+ *              unsigned long nbDropped = messages dropped meanwhile
+ * Output     : N/A
+ =======================================================================*/
+static void
+logReportDrops(LogHandler* logHandler, unsigned long nbDropped)
+{
+  char text[128];
+
+  if (!nbDropped) return;
+  sprintf(text, "[%s log.c] %lu log messages dropped (%lu since start)",
+	  LogSeverities[LOG_WARNING].name, nbDropped, 
+	  logHandler->queue->nbDropped);
+  logWrite(logHandler, LOG_WARNING, text);
+}
+
+/*=======================================================================
+ * Function   : logThread
+ * Description: Write the queued messages by batches
+ * Synopsis   : static void* logThread(void* arg)
+ * Input      : void* arg = the log handler
+ * Output     : 0
+ * Note       : exit when the queue is stopped and empty
+ =======================================================================*/
+static void*
+logThread(void* arg)
+{
+  LogHandler* logHandler = (LogHandler*)arg;
+  LogQueue* queue = logHandler->queue;
+  LogLine batch[LOG_BATCH_SIZE];
+  unsigned long nbDropped = 0;
+  int nb = 0;
+  int i = 0;
+
+  while (TRUE) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->isRunning && !queue->count && !queue->nbToReport)
+      pthread_cond_wait(&queue->notEmpty, &queue->mutex);
+    if (!queue->isRunning && !queue->count && !queue->nbToReport) {
+      pthread_mutex_unlock(&queue->mutex);
+      break;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    // pop a batch (logFlush may have emptied the queue meanwhile)
+    pthread_mutex_lock(&queue->writeMutex);
+    pthread_mutex_lock(&queue->mutex);
+    for (nb = 0; nb < LOG_BATCH_SIZE && queue->count; ++nb) {
+      batch[nb] = queue->lines[queue->head];
+      queue->head = (queue->head + 1) % LOG_QUEUE_SIZE;
+      --queue->count;
+    }
+    nbDropped = queue->nbToReport;
+    queue->nbToReport = 0;
+    pthread_cond_broadcast(&queue->notFull);
+    pthread_mutex_unlock(&queue->mutex);
+
+    // write it without blocking the emitters
+    for (i = 0; i < nb; ++i) {
+      logWrite(logHandler, batch[i].priority, batch[i].text);
+    }
+    logReportDrops(logHandler, nbDropped);
+    if (logHandler->hlog) fflush(logHandler->hlog);
+    pthread_mutex_unlock(&queue->writeMutex);
+  }
+
+  return (void*)0;
+}
+
+/*=======================================================================
+ * Function   : logEnqueue
+ * Description: Queue a message for the logger thread
+ * Synopsis   : static int logEnqueue(LogQueue* queue, LogLine* line)
+ * Input      : LogQueue* queue = the asynchronous sink
+ *              LogLine* line = the formated message
+ * Output     : FALSE if the message must be written synchronously
+ * Note       : when the queue is full, info and debug messages are
+ *              dropped (and counted) while the others wait for room.
+ =======================================================================*/
+static int
+logEnqueue(LogQueue* queue, LogLine* line)
+{
+  int rc = FALSE;
+
+  pthread_mutex_lock(&queue->mutex);
+  if (!queue->isRunning) goto end;
+  rc = TRUE;
+
+  while (queue->count == LOG_QUEUE_SIZE) {
+    if (line->priority >= LOG_INFO) {
+      ++queue->nbDropped;
+      ++queue->nbToReport;
+      goto end;
+    }
+    pthread_cond_wait(&queue->notFull, &queue->mutex);
+  }
+
+  queue->lines[(queue->head + queue->count) % LOG_QUEUE_SIZE] = *line;
+  ++queue->count;
+  pthread_cond_signal(&queue->notEmpty);
+ end:
+  pthread_mutex_unlock(&queue->mutex);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : logStartAsync
+ * Description: Write the logs from a dedicated thread
+ * Synopsis   : int logStartAsync(LogHandler* logHandler)
+ * Input      : LogHandler* logHandler = the log handler
+ * Output     : TRUE on success
+ * Note       : only for the daemon. Do not fork after this call (the
+ *              childs log synchronously as they have no logger).
+ =======================================================================*/
+int
+logStartAsync(LogHandler* logHandler)
+{
+  int rc = FALSE;
+  LogQueue* queue = 0;
+  sigset_t mask;
+  sigset_t oldMask;
+  int err = 0;
+
+  if (!logHandler || logHandler->queue) goto error;
+  if (!(queue = (LogQueue*)malloc(sizeof(LogQueue)))) goto error;
+  memset(queue, 0, sizeof(LogQueue));
+  if (!(queue->lines = (LogLine*)malloc(sizeof(LogLine)*LOG_QUEUE_SIZE)))
+    goto error;
+  
+  pthread_mutex_init(&queue->mutex, 0);
+  pthread_mutex_init(&queue->writeMutex, 0);
+  pthread_cond_init(&queue->notEmpty, 0);
+  pthread_cond_init(&queue->notFull, 0);
+  queue->pid = getpid();
+  queue->isRunning = TRUE;
+  logHandler->queue = queue;
+
+  // the logger must not catch the signals managed by sigwait
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+  err = pthread_create(&queue->thread, 0, logThread, logHandler);
+  pthread_sigmask(SIG_SETMASK, &oldMask, 0);
+  if (err) {
+    logHandler->queue = 0;
+    logEmitMacro(logHandler, LOG_ERR, __FILE__, __LINE__,
+		 "pthread_create fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    if (queue) {
+      if (queue->lines) free(queue->lines);
+      free(queue);
+    }
+    if (logHandler) {
+      logEmitMacro(logHandler, LOG_ERR, __FILE__, __LINE__,
+		   "fails to start the asynchronous logs");
+    }
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : logFlush
+ * Description: Write all the pending messages now
+ * Synopsis   : void logFlush(LogHandler* logHandler)
+ * Input      : LogHandler* logHandler = the log handler
+ * Output     : N/A
+ * Note       : to call before exiting on fatal errors
+ =======================================================================*/
+void
+logFlush(LogHandler* logHandler)
+{
+  LogQueue* queue = 0;
+  unsigned long nbDropped = 0;
+
+  if (!logHandler) return;
+  if (!(queue = logHandler->queue) || queue->pid != getpid()) goto end;
+
+  pthread_mutex_lock(&queue->writeMutex);
+  pthread_mutex_lock(&queue->mutex);
+  for (; queue->count; --queue->count) {
+    logWrite(logHandler, queue->lines[queue->head].priority,
+	     queue->lines[queue->head].text);
+    queue->head = (queue->head + 1) % LOG_QUEUE_SIZE;
+  }
+  nbDropped = queue->nbToReport;
+  queue->nbToReport = 0;
+  logReportDrops(logHandler, nbDropped);
+  pthread_cond_broadcast(&queue->notFull);
+  pthread_mutex_unlock(&queue->mutex);
+  pthread_mutex_unlock(&queue->writeMutex);
+ end:
+  if (logHandler->hlog) fflush(logHandler->hlog);
+}
+
 /*=======================================================================
  * Function   : logEmitFunc
  * Description: Emit a log message.
@@ -383,6 +607,7 @@ void
 logEmitFunc(LogHandler* logHandler, int priority, const char* format, ...)
 {
   va_list args;
+  LogLine line;
 
   // print messages to stderr if logger is not yet initialise
   if(!logHandler) {
@@ -394,6 +619,17 @@ logEmitFunc(LogHandler* logHandler, int priority, const char* format, ...)
     goto end;
   }
 
+  // asynchronous sink (not inherited by forked childs)
+  if (logHandler->queue && logHandler->queue->pid == getpid()) {
+    va_start(args, format);
+    vsnprintf(line.text, LOG_LINE_SIZE, format, args);
+    va_end(args);
+    line.priority = priority;
+    if (logEnqueue(logHandler->queue, &line)) goto end;
+    logWrite(logHandler, priority, line.text);
+    goto end;
+  }
+
   va_start(args, format);
 
   if (!(logHandler->hlog)) {
@@ -424,8 +660,26 @@ logEmitFunc(LogHandler* logHandler, int priority, const char* format, ...)
 LogHandler* 
 logClose(LogHandler* logHandler)
 {
+  LogQueue* queue = 0;
+
   if(logHandler) {
     // "stopped"
+
+    // write the pending messages and stop the logger thread
+    if ((queue = logHandler->queue) && queue->pid == getpid()) {
+      pthread_mutex_lock(&queue->mutex);
+      queue->isRunning = FALSE;
+      pthread_cond_signal(&queue->notEmpty);
+      pthread_mutex_unlock(&queue->mutex);
+      pthread_join(queue->thread, 0);
+      pthread_mutex_destroy(&queue->mutex);
+      pthread_mutex_destroy(&queue->writeMutex);
+      pthread_cond_destroy(&queue->notEmpty);
+      pthread_cond_destroy(&queue->notFull);
+      free(queue->lines);
+      free(queue);
+    }
+    logHandler->queue = 0;
 		
     if(logHandler->hlog == 0) {
       closelog();
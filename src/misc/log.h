@@ -59,11 +59,33 @@ int getLogSeverity(char* name);
 LogSeverity* getLogSeverityByName(char* name);
 LogSeverity* getLogSeverityByCode(int code);
 
+typedef struct LogLine {
+  int priority;
+  char text[LOG_LINE_SIZE];
+} LogLine;
+
+// asynchronous sink: ring of pending messages written by a thread
+typedef struct LogQueue {
+  pthread_mutex_t mutex;
+  pthread_mutex_t writeMutex; // keep order between logger and flush
+  pthread_cond_t  notEmpty;
+  pthread_cond_t  notFull;
+  pthread_t thread;
+  LogLine* lines;
+  int head;
+  int count;
+  int isRunning;
+  pid_t pid;                  // process owning the logger thread
+  unsigned long nbDropped;    // total since started
+  unsigned long nbToReport;   // not already reported
+} LogQueue;
+
 typedef struct LogHandler {
   char* name;
   LogFacility* facility;
   LogSeverity* severity[LOG_MAX_MODULE];
   FILE* hlog;
+  LogQueue* queue;
 } LogHandler;
 
 int parseLogSeverityOption(char* parameter, int* logSeverity);
@@ -72,6 +94,8 @@ LogHandler* logOpen(char* name, int facility, int* logSeverity,
 void logEmitFunc(LogHandler* logHandler, int priority,
 		 const char* format, ...);
 LogHandler* logClose(LogHandler* logHandler);
+int logStartAsync(LogHandler* logHandler);
+void logFlush(LogHandler* logHandler);
 
 extern LogSeverity LogSeverities[];
 
@@ -174,9 +174,11 @@ sha1sum2string(unsigned char sha1sum[SHA_DIGEST_LENGTH],
  * Description: Compute checksum(s) on first mega byte
  * Synopsis   : static int quickChecksum(int fd, off_t size, ssize_t *sum,
  *                   MD5_CTX *md5Ctx, char quickMd5sum[MAX_SIZE_MD5 + 1],
-                     SHA_CTX *shaCtx, char quickShasum[MAX_SIZE_SHA + 1])
+                     SHA_CTX *shaCtx, char quickShasum[MAX_SIZE_SHA + 1],
+                     MdtxProgBar* progBar)
  * Input      : int fd: file descriptor to use for computation
  *              off_t size: maximum size of the file
+ *              MdtxProgBar* progBar: progression to update
  * Output     : ssize_t *sum: size used for computation
  *              MD5_CTX *md5Ctx: md5sum data at the end (to be re-use next)
  *              char quickMd5sum[MAX_SIZE_MD5 + 1]: the resulting md5sum
@@ -188,10 +190,11 @@ sha1sum2string(unsigned char sha1sum[SHA_DIGEST_LENGTH],
 static int 
 quickChecksum(int fd, off_t size, ssize_t *sum,
 	      MD5_CTX *md5Ctx, char quickMd5sum[MAX_SIZE_MD5 + 1],
-	      SHA_CTX *shaCtx, char quickShasum[MAX_SIZE_SHA + 1])
+	      SHA_CTX *shaCtx, char quickShasum[MAX_SIZE_SHA + 1],
+	      MdtxProgBar* progBar)
 {
   int rc = FALSE;
-  char buf[512];
+  char buf[MISC_CHECKSUMS_BUFSIZE];
   ssize_t bytes;
   unsigned char md5sum[MD5_DIGEST_LENGTH];
   unsigned char shasum[SHA_DIGEST_LENGTH];
@@ -201,7 +204,7 @@ quickChecksum(int fd, off_t size, ssize_t *sum,
 
   logMisc(LOG_DEBUG, "quickChecksum");
   doSha1 = (shaCtx && quickShasum);
-  env.progBar.max = size;
+  progBar->max = size;
 
   if (fd <= 0) {
     logMisc(LOG_ERR, "please provide a file descriptor");
@@ -227,15 +230,16 @@ quickChecksum(int fd, off_t size, ssize_t *sum,
   }
 
   *sum = 0;
-  bytes=read(fd, buf, 512);
+  bytes=read(fd, buf, MISC_CHECKSUMS_BUFSIZE);
   while ((!size || *sum < size) &&
 	*sum < MEGA && bytes > 0) {
     if (*sum + bytes > MEGA) bytes -= ((*sum + bytes) - MEGA);
+    if (size && *sum + bytes > size) bytes = size - *sum;
     *sum += bytes;
     MD5_Update(md5Ctx, buf, bytes);
     if (doSha1) SHA1_Update(shaCtx, buf, bytes);
-    env.progBar.cur = *sum;
-    bytes=read(fd, buf, 512);
+    progBar->cur = *sum;
+    bytes=read(fd, buf, MISC_CHECKSUMS_BUFSIZE);
   }
   
   memcpy(&tmpMd5, md5Ctx, sizeof(MD5_CTX));
@@ -260,15 +264,51 @@ quickChecksum(int fd, off_t size, ssize_t *sum,
   return(rc);
 }
 
+/*=======================================================================
+ * Function   : throttle
+ * Description: Wait so as not to read faster than the given rate
+ * Synopsis   : static int throttle(off_t rate, ssize_t bytes, 
+ *                                  struct timespec* start)
+ * Input      : off_t rate: bandwidth in b.s-1
+ *              ssize_t bytes: bytes read since start
+ *              struct timespec* start: when we start reading
+ * Output     : FALSE if we should stop reading (daemon is exiting)
+ =======================================================================*/
+static int 
+throttle(off_t rate, ssize_t bytes, struct timespec* start)
+{
+  struct timespec now;
+  struct timespec delay;
+  double late = 0;
+
+  if (!env.running) return FALSE;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  late = (double)bytes / rate
+    - (now.tv_sec - start->tv_sec) 
+    - (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+
+  // do not sleep too much at once, so as to stop on time
+  if (late > 1) late = 1;
+  if (late > 0) {
+    delay.tv_sec = (time_t)late;
+    delay.tv_nsec = (long)((late - delay.tv_sec) * 1000000000.0);
+    nanosleep(&delay, 0);
+  }
+  return TRUE;
+}
+
 /*=======================================================================
  * Function   : fullChecksum
  * Description: Continue to compute checksum(s) after the first mega byte
  * Synopsis   : static int fullChecksum(int fd, ssize_t *sum, off_t size,
  *                    MD5_CTX *md5Ctx, char fullMd5sum[MAX_SIZE_MD5 + 1],
- *                    SHA_CTX *shaCtx, char fullShasum[MAX_SIZE_SHA + 1])
+ *                    SHA_CTX *shaCtx, char fullShasum[MAX_SIZE_SHA + 1],
+ *                    off_t rate, MdtxProgBar* progBar)
  * Input      : int fd: file descriptor to use for computation
  *              ssize_t *sum: off_t size: maximum size of the file 
  *              off_t size: size where we continue computation
+ *              off_t rate: disk bandwidth in b.s-1 (0: no limit)
+ *              MdtxProgBar* progBar: progression to update
  * Output     : MD5_CTX *md5Ctx: md5sum at the end of quick computation
  *              char fullMd5sum[MAX_SIZE_MD5 + 1]: the resuling md5sum
  *              SHA_CTX *shaCtx: shasum at the end of quick computation
@@ -279,18 +319,22 @@ quickChecksum(int fd, off_t size, ssize_t *sum,
 static int 
 fullChecksum(int fd, off_t size, ssize_t *sum,
 	       MD5_CTX *md5Ctx, char fullMd5sum[MAX_SIZE_MD5 + 1],
-	       SHA_CTX *shaCtx, char fullShasum[MAX_SIZE_SHA + 1])
+	       SHA_CTX *shaCtx, char fullShasum[MAX_SIZE_SHA + 1],
+	       off_t rate, MdtxProgBar* progBar)
 {
   int rc = FALSE;
-  char buf[512];
+  char buf[MISC_CHECKSUMS_BUFSIZE];
   ssize_t bytes;
   unsigned char md5sum[MD5_DIGEST_LENGTH];
   unsigned char shasum[SHA_DIGEST_LENGTH];
   int doSha1 = FALSE;
+  struct timespec start;
+  ssize_t first = 0;
+  unsigned long nbBlocks = 0;
 
   logMisc(LOG_DEBUG, "fullChecksum");
   doSha1 = (shaCtx && fullShasum);
-  env.progBar.max = size;
+  progBar->max = size;
 
   if (fd <= 0) {
     logMisc(LOG_ERR, "please provide a file descriptor");
@@ -317,13 +361,24 @@ fullChecksum(int fd, off_t size, ssize_t *sum,
     goto error;
   }
   
-  bytes=read(fd, buf, 512);
+  first = *sum;
+  if (rate) clock_gettime(CLOCK_MONOTONIC, &start);
+  bytes=read(fd, buf, MISC_CHECKSUMS_BUFSIZE);
   while ((!size || *sum < size) && bytes > 0) {
+    if (size && *sum + bytes > size) bytes = size - *sum;
     *sum += bytes;
     MD5_Update(md5Ctx, buf, bytes);
     if (doSha1) SHA1_Update(shaCtx, buf, bytes);
-    env.progBar.cur = *sum;
-    bytes=read(fd, buf, 512);
+    progBar->cur = *sum;
+
+    // check the bandwidth every 64Ko
+    if (rate && !(++nbBlocks % (65536 / MISC_CHECKSUMS_BUFSIZE))) {
+      if (!throttle(rate, *sum - first, &start)) {
+	logMisc(LOG_NOTICE, "checksum interrupted");
+	goto error;
+      }
+    }
+    bytes=read(fd, buf, MISC_CHECKSUMS_BUFSIZE);
   }
   
   MD5_Final(md5sum, md5Ctx);
@@ -352,6 +407,8 @@ fullChecksum(int fd, off_t size, ssize_t *sum,
  * Synopsis   : int doChecksum(CheckData* data)
  * Input      : CheckData* data: see md5sum.h
  * Output     : TRUE on success
+ * Note       : concurrent callers must set data->noProgBar, as there
+ *              is only one progression bar (env.progBar)
  =======================================================================*/
 int 
 doChecksum(CheckData* data)
@@ -370,8 +427,16 @@ doChecksum(CheckData* data)
   int isBlockDev = FALSE;
   unsigned short int bs = 0;
   unsigned long int count = 0;
+  struct timespec start;
+  MdtxProgBar localBar;
+  MdtxProgBar* progBar = &env.progBar;
 
   logMisc(LOG_DEBUG, "doChecksum");
+  perfBegin(start);
+  if (data->noProgBar) {
+    memset(&localBar, 0, sizeof(MdtxProgBar));
+    progBar = &localBar;
+  }
 
   // backup the parameter values
   backupPath = data->path;
@@ -412,24 +477,24 @@ doChecksum(CheckData* data)
     }
 
     // start progbar
-    if (!startProgBar(data->path)) goto error;
+    if (!data->noProgBar && !startProgBar(data->path)) goto error;
   }
   
   data->rc = 0; // CHECK_SUCCESS
   switch (data->opp) {
   case CHECK_CACHE_ID:
     rc = quickChecksum(fd, data->size, &sum, 
-		       &md5Ctx, data->quickMd5sum, 0, 0);
+		       &md5Ctx, data->quickMd5sum, 0, 0, progBar);
     rc&= fullChecksum(fd, data->size, &sum, 
-		      &md5Ctx, data->fullMd5sum, 0, 0);
+		      &md5Ctx, data->fullMd5sum, 0, 0, data->rate, progBar);
     break;
   case CHECK_SUPP_ADD:
     rc = quickChecksum(fd, data->size, &sum, 
 		       &md5Ctx, data->quickMd5sum, 
-		       &shaCtx, data->quickShasum);
+		       &shaCtx, data->quickShasum, progBar);
     rc&= fullChecksum(fd, data->size, &sum, 
 		      &md5Ctx, data->fullMd5sum, 
-		      &shaCtx, data->fullShasum);
+		      &shaCtx, data->fullShasum, data->rate, progBar);
     break;
   case CHECK_SUPP_ID:
   case CHECK_SUPP_CHECK:
@@ -444,7 +509,7 @@ doChecksum(CheckData* data)
 
     rc = quickChecksum(fd, data->size, &sum, 
 		       &md5Ctx, data->quickMd5sum, 
-		       &shaCtx, data->quickShasum);
+		       &shaCtx, data->quickShasum, progBar);
     
     if (strncmp(data->quickMd5sum, quickMd5sum, MAX_SIZE_MD5)) {
       logMisc(LOG_INFO, "quick md5sum doesn't match: %s vs %s expected", 
@@ -463,7 +528,7 @@ doChecksum(CheckData* data)
     
     rc&= fullChecksum(fd, data->size, &sum, 
 		      &md5Ctx, data->quickMd5sum, 
-		      &shaCtx, data->quickShasum);
+		      &shaCtx, data->quickShasum, data->rate, progBar);
 
     if (strncmp(data->fullMd5sum, fullMd5sum, MAX_SIZE_MD5)) {
       logMisc(LOG_INFO, "full md5sum doesn't match: %s vs %s expected", 
@@ -485,7 +550,8 @@ doChecksum(CheckData* data)
   }
 
  error:
-  stopProgBar(); // stop progBar
+  if (!data->noProgBar) stopProgBar(); // stop progBar
+  if (rc) perfEnd(PERF_CHECKSUM, start, data->size);
   if (fd != -1 && close(fd) == -1) {
     logMisc(LOG_ERR, "close: %s", strerror(errno));
     rc = FALSE;
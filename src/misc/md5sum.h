@@ -53,6 +53,8 @@ typedef struct CheckData {
   char quickShasum[MAX_SIZE_SHA + 1];
   char fullShasum[MAX_SIZE_SHA + 1];
   CheckRc rc;           // only used by CHECK_SUPP_CHECK
+  off_t rate;           // disk bandwidth in b.s-1 (0: no limit)
+  int noProgBar;        // do not use env.progBar (concurrent callers)
 } CheckData;
 
 typedef struct MdtxProgBar {
@@ -181,6 +181,7 @@ manageSignals(void* manager(void*), pthread_t* thread)
 {
   int rc = FALSE;
   int err = 0;
+  struct sigaction action;
 
   logMisc(LOG_DEBUG, "manageSignals");
  
@@ -188,6 +189,16 @@ manageSignals(void* manager(void*), pthread_t* thread)
   //  SIGHUP, SIGUSR1, SIGTERM, SIGSEGV, SIGINT and SIGALRM
   if (!disableALL()) goto error;
 
+  // writing to a socket closed by the peer only returns EPIPE
+  // (fdWrite is used on sockets too)
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  action.sa_handler = SIG_IGN;
+  if (sigaction(SIGPIPE, &action, 0)) {
+    logMisc(LOG_ERR, "sigaction fails: %s", strerror(errno));
+    goto error;
+  }
+
   // new thread that will have to explicitely manage (or not) blocked 
   // signals using sigwaitinfo
   if ((err = pthread_create(thread, 0, manager, (void *)0))) {
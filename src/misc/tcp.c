@@ -22,6 +22,7 @@
  ======================================================================= */
 
 #include "mediatex-config.h"
+#include <poll.h>
 
 /*=======================================================================
  * Function   : acceptTcpSocket
@@ -104,17 +105,32 @@ acceptTcpSocket(const struct sockaddr_in* address_listening,
 /*=======================================================================
  * Function   : connectTcpSocket
  * Description: connect a tcp client socket
- * Synopsis   : connectTcpSocket(const struct sockaddr_in* address_server)
+ * Synopsis   : connectTcpSocket(const struct sockaddr_in* address_server,
+ *                               int timeout, int* elapsed)
  * Input      : the server address to connect
+ *              int timeout: milli-seconds to wait for the connection
  * Output     : a descriptor on the opened socket
- *              -1 on error
+ *              -1 on error (errno is ETIMEDOUT on timeout)
+ *              int* elapsed: milli-seconds spent to connect (may be 0)
+ * Note       : the connection is done on a non-blocking socket and
+ *              bounded using poll, so as no signal is needed. The
+ *              socket is returned in blocking mode.
  =======================================================================*/
 int 
-connectTcpSocket(const struct sockaddr_in* address_server)
+connectTcpSocket(const struct sockaddr_in* address_server, 
+		 int timeout, int* elapsed)
 {
   int rc = -1;
+  int flags = 0;
+  int err = 0;
+  socklen_t len = sizeof(int);
+  struct pollfd fds;
+  struct timespec start;
+  struct timespec stop;
+  int n = 0;
   
   if ((rc = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    err = errno;
     logMisc(LOG_ERR, "socket: %s", strerror(errno));
     goto error;
   }
@@ -123,17 +139,57 @@ connectTcpSocket(const struct sockaddr_in* address_server)
 	  inet_ntoa(address_server->sin_addr),
 	  ntohs(address_server->sin_port));
 
+  if ((flags = fcntl(rc, F_GETFL, 0)) == -1 ||
+      fcntl(rc, F_SETFL, flags | O_NONBLOCK) == -1) {
+    err = errno;
+    logMisc(LOG_ERR, "fcntl: %s", strerror(errno));
+    goto error;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
   if (connect(rc, (struct sockaddr*) address_server, 
 	      sizeof(struct sockaddr_in))) {
-    logMisc(LOG_INFO, "connect fails: %s", strerror(errno));
+    if ((err = errno) != EINPROGRESS) goto fails;
+
+    // wait for the connection (or the deadline)
+    fds.fd = rc;
+    fds.events = POLLOUT;
+    fds.revents = 0;
+    while ((n = poll(&fds, 1, timeout)) == -1 && errno == EINTR);
+    if (n == -1) {
+      err = errno;
+      goto fails;
+    }
+    if (n == 0) {
+      err = ETIMEDOUT;
+      goto fails;
+    }
+    if (getsockopt(rc, SOL_SOCKET, SO_ERROR, &err, &len) == -1) {
+      err = errno;
+      goto fails;
+    }
+    if (err) goto fails;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  if (elapsed) {
+    *elapsed = (stop.tv_sec - start.tv_sec) * 1000 
+      + (stop.tv_nsec - start.tv_nsec) / 1000000;
+  }
+
+  if (fcntl(rc, F_SETFL, flags) == -1) {
+    err = errno;
+    logMisc(LOG_ERR, "fcntl: %s", strerror(errno));
     goto error;
   }
 
   return rc; // please don't forget to close it next
+ fails:
+  logMisc(LOG_INFO, "connect fails: %s", strerror(err));
  error:
-  close(rc);
+  if (rc != -1) close(rc);
   // not really an error as remote server may be offline
   //logMisc(LOG_ERR, "connectTcpSocket fails");
+  errno = err;
   return -1;
 }
 
@@ -145,6 +201,8 @@ connectTcpSocket(const struct sockaddr_in* address_server)
  *              buffer:     string to write
  *              bufferSize: number of char to write
  * Output     : TRUE on success
+ * Note       : a peer that closed a kept alive connection give EPIPE
+ *              here, not a SIGPIPE that would kill us
  =======================================================================*/
 int 
 tcpWrite(int sd, char* buffer, size_t bufferSize)
@@ -156,7 +214,7 @@ tcpWrite(int sd, char* buffer, size_t bufferSize)
   int errorNb = 0;
 
   while (remaining > 0){
-    while ((writen = send(sd, next, remaining, 0)) == -1)
+    while ((writen = send(sd, next, remaining, MSG_NOSIGNAL)) == -1)
       {
 	errorNb = errno;
 
@@ -28,7 +28,8 @@
 
 int acceptTcpSocket(const struct sockaddr_in* address_listening, 
 		    int (*server)(int, struct sockaddr_in*));
-int connectTcpSocket(const struct sockaddr_in* address_server);
+int connectTcpSocket(const struct sockaddr_in* address_server, 
+		     int timeout, int* elapsed);
 int tcpWrite(int sd, char* buffer, size_t bufferSize);
 size_t tcpRead(int sd, char* buffer, size_t bufferSize);
 
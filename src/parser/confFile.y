@@ -101,6 +101,8 @@ void conf_error(yyscan_t yyscanner, Collection* coll,
 %token          confQUERYTTL
 %token          confCHECKTTL
 %token          confFILETTL
+%token          confCHECKRATE
+%token          confCHECKNICE
 %token          confSUPPTTL
 %token          confMAXSCORE
 %token          confBADSCORE
@@ -264,6 +266,16 @@ confLine: confHOST confSTRING
 {
   logParser(LOG_DEBUG, "line %-3i %s", LINENO, "check TTL");
   getConfiguration()->fileTTL = $2*$3;
+}
+       | confCHECKRATE confNUMBER confSIZE
+{
+  logParser(LOG_DEBUG, "line %-3i %s", LINENO, "check rate");
+  getConfiguration()->checkRate = $2*$3;
+}
+       | confCHECKNICE confNUMBER
+{
+  logParser(LOG_DEBUG, "line %-3i checkNice = %i", LINENO, $2);
+  getConfiguration()->checkNice = $2;
 }
        | confSUPPTTL confNUMBER confTIME
 {
@@ -130,6 +130,12 @@ stanza: extrOPEN container extrIMPLIES childs extrCLOSE
   logParser(LOG_DEBUG, "line %i: %s", LINENO, 
 	    "stanza: (container => childs)");
 
+  // staging parse (cf loadCvsFiles): remind the containers order
+  if (coll->extractTree->stanzas &&
+      ((container->type != INC && container->type != IMG) ||
+       !rgHaveItem(coll->extractTree->stanzas, container))) {
+    if (!rgInsert(coll->extractTree->stanzas, container)) YYERROR;
+  }
 }
 ;
 
@@ -181,7 +181,17 @@ newLine: line
 	    MAX_SIZE_SIZE, (long long int)$1->archive->size, 
 	    $1->extra?$1->extra:"");
 
-  if (getRecordType($1) == MALLOC_SUPPLY) {
+  if (recordTree->journal) {
+    // journal events are replayed in order by loadRecords
+    if (!rgInsert(recordTree->journal, $1)) YYERROR;
+  }
+  else if ($1->type & REMOVE) {
+    logParser(LOG_ERR, "line %i: removed record out of a journal",
+	      LINENO);
+    if (!delRecord(recordTree->collection, $1)) YYERROR;
+    YYERROR;
+  }
+  else if (getRecordType($1) == MALLOC_SUPPLY) {
     logParser(LOG_WARNING, "ignore malloc record");
     if (!delRecord(recordTree->collection, $1)) YYERROR;
   }
@@ -245,22 +255,21 @@ record_error(yyscan_t yyscanner, RecordTree* recordTree,
 
 
 /*=======================================================================
- * Function   : parseRecords
+ * Function   : parseRecordFile
  * Description: Parse records from a file or a socket
- * Synopsis   : int parseRecords(int fd)
+ * Synopsis   : static RecordTree* parseRecordFile(int fd, int isJournal)
  * Input      : int fd: file or socket handler
+ *              int isJournal: keep the events order into tree->journal
  * Output     : return a RecordTree on success
 =======================================================================*/
-RecordTree* 
-parseRecords(int fd)
+static RecordTree* 
+parseRecordFile(int fd, int isJournal)
 { 
   RecordTree* rc = 0;
   yyscan_t scanner;
   RecordExtra extra;
   RecordTree* tree = 0;
 
-  logParser(LOG_INFO, "parse records");
-
   // scanner input file
   if (fd == -1) {
     logParser(LOG_ERR, "%s", 
@@ -280,6 +289,7 @@ parseRecords(int fd)
 
   // initialise parser parameter
   if (!(tree = createRecordTree())) goto error2;
+  if (isJournal && !(tree->journal = createRing())) goto error2;
 
   // use extra data with reentrant scanner
   extra.aesData = &tree->aes;
@@ -308,6 +318,35 @@ parseRecords(int fd)
   return rc;
 }
 
+/*=======================================================================
+ * Function   : parseRecords
+ * Description: Parse records from a file or a socket
+ * Synopsis   : RecordTree* parseRecords(int fd)
+ * Input      : int fd: file or socket handler
+ * Output     : return a RecordTree on success
+=======================================================================*/
+RecordTree* 
+parseRecords(int fd)
+{ 
+  logParser(LOG_INFO, "parse records");
+  return parseRecordFile(fd, FALSE);
+}
+
+/*=======================================================================
+ * Function   : parseRecordJournal
+ * Description: Parse a records journal
+ * Synopsis   : RecordTree* parseRecordJournal(int fd)
+ * Input      : int fd: journal file handler
+ * Output     : return a RecordTree on success, having the events
+ *              into its journal ring (and not into its records tree)
+=======================================================================*/
+RecordTree* 
+parseRecordJournal(int fd)
+{ 
+  logParser(LOG_INFO, "parse records journal");
+  return parseRecordFile(fd, TRUE);
+}
+
 /* Local Variables: */
 /* mode: c */
 /* mode: font-lock */
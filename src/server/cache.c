@@ -356,6 +356,51 @@ scanFile(Collection* coll, char* absolutePath, char* relativePath,
   return rc;
 }
 
+/*=======================================================================
+ * Function   : scanPartFile
+ * Description: Expire or account a partial upload
+ * Synopsis   : int scanPartFile(Collection* coll, char* absolutePath,
+ *                               char* relativePath) 
+ * Input      : Collection* coll
+ *              char* absolutePath
+ *              char* relativePath
+ * Output     : TRUE on success
+ * Note       : the partial is kept UPLOAD_PART_TTL after its last
+ *              chunk so as the client may resume; until then its size
+ *              is reserved on the cache (cf cacheSizes)
+ =======================================================================*/
+static int 
+scanPartFile(Collection* coll, char* absolutePath, char* relativePath) 
+{
+  int rc = FALSE;
+  struct stat statBuffer;
+  time_t date = 0;
+
+  logMain(LOG_DEBUG, "scanPartFile %s", relativePath);
+  if (!(date = currentTime())) goto error;
+
+  if (stat(absolutePath, &statBuffer)) {
+    logMain(LOG_ERR, "status error on %s: %s", 
+	    absolutePath, strerror(errno));
+    goto error;
+  }
+
+  if (statBuffer.st_mtime + UPLOAD_PART_TTL < date) {
+    if (!removeFile(absolutePath, relativePath, "expired upload")) 
+      goto error;
+    goto end;
+  }
+
+  coll->cacheTree->partSize += statBuffer.st_size;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "scanPartFile fails");
+  }
+  return rc;
+}
+
 /*=======================================================================
  * Function   : scanRepository
  * Description: Recursively scan a cache directory 
@@ -432,6 +477,11 @@ scanRepository(Collection* coll, const char* path,
       if ((absolutePath2 = createString(absolutePath)) == 0 ||
 	  (absolutePath2 = catString(absolutePath2, entry->d_name)) 
 	  == 0) goto error;
+      if (!strncmp(entry->d_name, UPLOAD_PART_PREFIX,
+		   strlen(UPLOAD_PART_PREFIX))) {
+	if (!scanPartFile(coll, absolutePath2, relativePath)) goto error;
+	break;
+      }
       if (!scanFile(coll, absolutePath2, relativePath, localSuppliesOk))
 	goto error;
       break;
@@ -584,7 +634,7 @@ scanSupportFiles(Collection* coll)
   for (node = coll->cacheTree->archives->head; node; node = node->next) {
     archive = node->item;
     curr = 0;
-    while ((supply = rgNext_r(archive->finalSupplies, &curr))) {
+    while ((supply = rgNext_r(arFinalSupplies(archive), &curr))) {
       if (!delCacheEntry(coll, supply)) goto error;
     }
   } 
@@ -635,7 +685,8 @@ scanCollection(Collection* coll, int doQuick)
   // check archive are really here as expected
   if (!scanMd5sumFiles(coll, localSuppliesOk, doQuick)) goto error3;
 
-  // add archive if new ones founded
+  // add archive if new ones founded (and recount partial uploads)
+  coll->cacheTree->partSize = 0;
   if (!scanRepository(coll, "", localSuppliesOk)) goto error3;
 
   rc = TRUE;
@@ -700,15 +751,20 @@ loadCache(Collection* coll)
  =======================================================================*/
 static void cacheSizes(CacheTree* self, off_t* free, off_t* available)
 {
-  *free = self->totalSize - self->useSize;
-  *available = self->totalSize - self->frozenSize;
+  // partial uploads are not indexed but still take place on disk
+  *free = self->totalSize - self->useSize - self->partSize;
+  *available = self->totalSize - self->frozenSize - self->partSize;
 
   logMain(LOG_INFO, "cache sizes:");
   logMain(LOG_INFO, "  total  %12llu", self->totalSize);
   logMain(LOG_INFO, "- used   %12llu", self->useSize);
+  if (self->partSize)
+    logMain(LOG_INFO, "- parts  %12llu", self->partSize);
   logMain(LOG_INFO, "= free   %12llu", *free);
   logMain(LOG_INFO, "  total  %12llu", self->totalSize);
   logMain(LOG_INFO, "- frozen %12llu", self->frozenSize);
+  if (self->partSize)
+    logMain(LOG_INFO, "- parts  %12llu", self->partSize);
   logMain(LOG_INFO, "= avail  %12llu", *available);
 }
 
@@ -783,7 +839,7 @@ freeCache(Collection* coll, off_t need, int* success)
     if (!(path = getAbsoluteRecordPath(coll, record))) goto error;
     if (!removeFile(path, record->extra, "free")) goto error;
     path = destroyString(path);
-    free = self->totalSize - self->useSize;
+    free = self->totalSize - self->useSize - self->partSize;
   }
   
   cacheSizes(self, &free, &available);
@@ -824,6 +880,7 @@ cacheAlloc(Record** record, Collection* coll, Archive* archive)
 {
   int rc = FALSE;
   CacheTree* cache = 0;
+  struct timespec start;
   int success = FALSE;
   char* extra = 0;
   int err = 0;
@@ -834,10 +891,12 @@ cacheAlloc(Record** record, Collection* coll, Archive* archive)
   logMain(LOG_DEBUG, "allocate new record into %s cache", coll->label);
   *record = 0; // default output (allocation fails)
 
+  perfBegin(start);
   if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_ALLOC]))) {
     logMain(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
     goto error;
   }
+  perfEnd(PERF_LOCK_ALLOC, start, 0);
 
   // look for already available record
   if (archive->state >= ALLOCATED) {
@@ -921,6 +980,10 @@ int statusCache(Collection* coll)
   char max[30];
   char froz[30];
   char avail[30];
+  long hits = 0;
+  long misses = 0;
+  unsigned int kept = 0;
+  int err = 0;
   
   checkCollection(coll);
   cache = coll->cacheTree;
@@ -935,6 +998,23 @@ int statusCache(Collection* coll)
   logMain(LOG_NOTICE, "%s cache's sizes: max, frozen, available",
 	  coll->label);
   logMain(LOG_NOTICE, "%11s%11s%11s", max, froz, avail);
+
+  // cgi lookup results
+  if ((err = pthread_mutex_lock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMain(LOG_ERR, "pthread_mutex_lock fails: %s", strerror(err));
+    goto error;
+  }
+  hits = cache->lookupHits;
+  misses = cache->lookupMisses;
+  kept = avl_count(cache->lookups);
+  if ((err = pthread_mutex_unlock(&cache->mutex[MUTEX_LOOKUP]))) {
+    logMain(LOG_ERR, "pthread_mutex_unlock fails: %s", strerror(err));
+    goto error;
+  }
+
+  logMain(LOG_NOTICE, "%s cgi lookups: hits, misses, kept",
+	  coll->label);
+  logMain(LOG_NOTICE, "%11li%11li%11u", hits, misses, kept);
   logMain(LOG_NOTICE, "---");
   
   rc = TRUE;
@@ -1112,7 +1192,7 @@ isSafeArchive(Collection* coll, Archive* self,
   
   logMain(LOG_DEBUG, "isSafeArchive %s:%lli", self->hash, self->size);
 
-  if (isEmptyRing(self->fromContainers)) {
+  if (isEmptyRing(arFromContainers(self))) {
     *isSafe = callback(coll, self);
     goto end;
   }
@@ -1120,7 +1200,7 @@ isSafeArchive(Collection* coll, Archive* self,
   // look for at less one safe container
   *isSafe = FALSE;
   while (!*isSafe &&
-	 (asso = rgNext_r(self->fromContainers, &curr))) {
+	 (asso = rgNext_r(arFromContainers(self), &curr))) {
     if (!isSafeContainer(coll, asso->container, callback, isSafe))
       goto error;
   }
@@ -1184,7 +1264,7 @@ trimCache(Collection* coll)
     logMain(LOG_INFO, "try to trim: %s", record->extra);
     isSafe = FALSE;
     while (!isSafe &&
-	   (asso = rgNext_r(archive->fromContainers, &curr))) {
+	   (asso = rgNext_r(arFromContainers(archive), &curr))) {
       if (!isSafeContainer(coll, asso->container, isSafeTrim, &isSafe)) 
 	goto error;
     }
@@ -1262,7 +1342,7 @@ int cleanCache(Collection* coll)
     logMain(LOG_INFO, "try to clean: %s", record->extra);
     isSafe = (getImage(coll, coll->localhost, archive) != 0);
     while (!isSafe &&
-	   (asso = rgNext_r(archive->fromContainers, &curr))) {
+	   (asso = rgNext_r(arFromContainers(archive), &curr))) {
       if (!isSafeContainer(coll, asso->container, isSafeClean, &isSafe)) 
 	goto error;
     }
@@ -148,6 +148,9 @@ cgiServer(Connexion* connexion)
   AVLNode* node = 0;
   int found = FALSE;
   char* extra = 0;
+  int isHit = FALSE;
+  int epoch = 0;
+  int isQuery = FALSE;
 
   static char status[][32] = {
     "120 not found %s:%lli",
@@ -168,11 +171,25 @@ cgiServer(Connexion* connexion)
   // only process the first archive
   if (!(record = connexion->message->records->head->item)) goto error;
   if (!(archive = record->archive)) goto error;
+  isQuery = 
+    isEmptyString(record->extra) || !strncmp(record->extra, "!w", 2);
+
+  // hot links: answer without touching the cache
+  if (isQuery) {
+    if (!getCacheLookup(coll, archive, connexion->status, &isHit, &epoch))
+      goto error;
+    if (isHit) {
+      logMain(LOG_INFO, "reuse cgi lookup result");
+      rc = TRUE;
+      goto error;
+    }
+  }
+
   if (!loadCollection(coll, CACH)) goto error;
   if (!lockCacheRead(coll)) goto error2;
 
   // Cgi-server handle 2 calls:
-  if (isEmptyString(record->extra) || !strncmp(record->extra, "!w", 2)) {
+  if (isQuery) {
 
     // case1: query without mail => try to extract archive
     if (!extractCgiArchive(coll, archive, &found)) goto error3;
@@ -188,6 +205,8 @@ cgiServer(Connexion* connexion)
       escapeUrl(archive->localSupply->extra, extra);
       extra = 0;
     }
+    if (!addCacheLookup(coll, archive, connexion->status, found, epoch))
+      goto error3;
   }
   else {
     // case2: query providing a mail => register the query
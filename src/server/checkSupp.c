@@ -0,0 +1,482 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : checkSupp
+ *
+ * Check the support files in background, so as clients do not read
+ * them while computing the scores (cf scoreSupport)
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex-config.h"
+#include "server/mediatex-server.h"
+
+#include <sys/syscall.h> // ioprio_set
+
+// support files that failed to be checked (not retried at once)
+typedef struct CheckFailure {
+  char   name[MAX_SIZE_STRING+1];
+  time_t retry;
+} CheckFailure;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  pthread_t thread;
+  int isRunning;
+  CheckFailure failures[MAX_CHECK_FAILURE]; // only used by the checker
+} checker = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+
+/*=======================================================================
+ * Function   : setIoPriority
+ * Description: Lower the I/O priority of the calling thread
+ * Synopsis   : static void setIoPriority(int level)
+ * Input      : int level: best-effort level, from 0 (high) to 7 (low)
+ * Output     : N/A
+ * Note       : as ionice -c2 -n level, but only for this thread
+ =======================================================================*/
+static void
+setIoPriority(int level)
+{
+#ifdef SYS_ioprio_set
+  if (level < 0) level = 0;
+  if (level > 7) level = 7;
+
+  // IOPRIO_WHO_PROCESS=1 (0: calling thread), IOPRIO_CLASS_BE=2 << 13
+  if (syscall(SYS_ioprio_set, 1, 0, (2 << 13) | level) == -1) {
+    logMain(LOG_WARNING, "ioprio_set fails: %s", strerror(errno));
+  }
+#else
+  (void) level;
+#endif
+}
+
+/*=======================================================================
+ * Function   : getFailure
+ * Description: Get the failure entry of a support file
+ * Synopsis   : static CheckFailure* getFailure(char* name, int doCreate)
+ * Input      : char* name: the support file
+ *              int doCreate: recycle the oldest entry if not found
+ * Output     : the entry, 0 if not found
+ =======================================================================*/
+static CheckFailure*
+getFailure(char* name, int doCreate)
+{
+  CheckFailure* rc = 0;
+  int i = 0;
+
+  for (i = 0; i < MAX_CHECK_FAILURE; ++i) {
+    if (!strncmp(checker.failures[i].name, name, MAX_SIZE_STRING)) {
+      rc = checker.failures + i;
+      goto end;
+    }
+  }
+  if (!doCreate) goto end;
+
+  for (i = 0; i < MAX_CHECK_FAILURE; ++i) {
+    if (!rc || checker.failures[i].retry < rc->retry) {
+      rc = checker.failures + i;
+    }
+  }
+  strncpy(rc->name, name, MAX_SIZE_STRING);
+ end:
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : failSupportCheck
+ * Description: Do not check again a support file before a while
+ * Synopsis   : void failSupportCheck(char* name, time_t now)
+ * Input      : char* name: the support file that fails to be checked
+ *              time_t now: current date
+ * Output     : N/A
+ * Note       : only called by the checker thread (or unit tests)
+ =======================================================================*/
+void
+failSupportCheck(char* name, time_t now)
+{
+  getFailure(name, TRUE)->retry = now + CHECK_SUPP_RETRY;
+}
+
+/*=======================================================================
+ * Function   : nextSupportCheck
+ * Description: Choose the next support file to check
+ * Synopsis   : Support* nextSupportCheck(Configuration* conf, 
+ *                             time_t now, time_t* wait, int* nbFiles)
+ * Input      : Configuration* conf: private snapshot
+ *              time_t now: current date
+ *              time_t* wait: delay we will wait at most
+ * Output     : time_t* wait: delay before the next one will be due
+ *              int* nbFiles: number of support files
+ *              the support file to check (the most outdated), 
+ *              0 if none is due
+ * Note       : checks are due when half of the fileTTL is reached
+ =======================================================================*/
+Support*
+nextSupportCheck(Configuration* conf, time_t now, time_t* wait,
+		 int* nbFiles)
+{
+  Support* rc = 0;
+  Support* supp = 0;
+  CheckFailure* failure = 0;
+  time_t due = 0;
+  RGIT* curr = 0;
+
+  *nbFiles = 0;
+  while ((supp = rgNext_r(conf->supports, &curr))) {
+    if (!isSupportFile(supp)) continue;
+    ++*nbFiles;
+
+    due = supp->lastCheck + conf->fileTTL/2;
+    if ((failure = getFailure(supp->name, FALSE)) && failure->retry > due)
+      due = failure->retry;
+
+    if (due > now) {
+      if (due - now < *wait) *wait = due - now;
+      continue;
+    }
+    if (!rc || supp->lastCheck < rc->lastCheck) rc = supp;
+  }
+
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : spreadSupportChecks
+ * Description: Do not check all the support files at once
+ * Synopsis   : time_t spreadSupportChecks(Configuration* conf, 
+ *                                         int nbFiles, time_t wait)
+ * Input      : Configuration* conf: private snapshot
+ *              int nbFiles: number of support files
+ *              time_t wait: delay before the next one will be due
+ * Output     : delay before the next check
+ * Note       : checks are spread over half of the fileTTL
+ =======================================================================*/
+time_t
+spreadSupportChecks(Configuration* conf, int nbFiles, time_t wait)
+{
+  time_t rc = wait;
+
+  if (nbFiles > 0 && rc > conf->fileTTL/2 / nbFiles) {
+    rc = conf->fileTTL/2 / nbFiles;
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : isSameFile
+ * Description: Tell if a file was not modified since a previous stat
+ * Synopsis   : static int isSameFile(struct stat* before, 
+ *                                    struct stat* after)
+ * Input      : struct stat* before, after: the two stats to compare
+ * Output     : TRUE if it was not modified
+ * Note       : st_mtime only has a one second precision
+ =======================================================================*/
+static int
+isSameFile(struct stat* before, struct stat* after)
+{
+  return before->st_ino == after->st_ino
+    && before->st_size == after->st_size
+    && before->st_mtim.tv_sec == after->st_mtim.tv_sec
+    && before->st_mtim.tv_nsec == after->st_mtim.tv_nsec;
+}
+
+/*=======================================================================
+ * Function   : writeSupports
+ * Description: Write the snapshot back, unless a client modified it
+ * Synopsis   : static int writeSupports(Configuration* conf, 
+ *                               struct stat* before, int* isWritten)
+ * Input      : Configuration* conf: private snapshot
+ *              struct stat* before: stat done before parsing it
+ * Output     : int* isWritten: FALSE if supports.txt was modified
+ *              or is currently used by a client
+ *              TRUE on success
+ * Note       : the clients' write lock is held on supports.txt while
+ *              comparing it, and the snapshot is written into a
+ *              temporary file renamed over it, so as readers never
+ *              see a partial file
+ =======================================================================*/
+static int
+writeSupports(Configuration* conf, struct stat* before, int* isWritten)
+{
+  int rc = FALSE;
+  struct stat after;
+  char* supportDB = 0;
+  char* tmpPath = 0;
+  int fd = -1;
+
+  *isWritten = FALSE;
+  supportDB = conf->supportDB;
+  if (!(tmpPath = createString(supportDB)) ||
+      !(tmpPath = catString(tmpPath, ".tmp"))) goto error;
+
+  if ((fd = open(supportDB, O_RDWR)) == -1) {
+    logMain(LOG_ERR, "open %s fails: %s", supportDB, strerror(errno));
+    goto error;
+  }
+  if (!lock(fd, F_WRLCK)) {
+    logMain(LOG_NOTICE, "%s is used by a client", supportDB);
+    goto end;
+  }
+  if (fstat(fd, &after)) {
+    logMain(LOG_ERR, "fstat %s fails: %s", supportDB, strerror(errno));
+    goto error;
+  }
+  if (!isSameFile(before, &after)) {
+    logMain(LOG_NOTICE, "%s was modified", supportDB);
+    goto end;
+  }
+
+  // our lock is on supports.txt, not on the temporary file
+  conf->supportDB = tmpPath;
+  if (!serializeSupports()) goto error;
+  if (!env.dryRun && rename(tmpPath, supportDB)) {
+    logMain(LOG_ERR, "rename %s fails: %s", tmpPath, strerror(errno));
+    goto error;
+  }
+  *isWritten = TRUE;
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "writeSupports fails");
+    if (conf->supportDB == tmpPath) unlink(tmpPath);
+  }
+  conf->supportDB = supportDB;
+  if (fd != -1) close(fd); // release the lock
+  tmpPath = destroyString(tmpPath);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : publishCheck
+ * Description: Give the check result to the current configuration
+ * Synopsis   : static int publishCheck(Support* result)
+ * Input      : Support* result: the checked support from our snapshot
+ * Output     : TRUE on success
+ * Note       : so as the daemon's scores use it without reloading
+ =======================================================================*/
+static int
+publishCheck(Support* result)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Support* supp = 0;
+
+  if (!(conf = acquireConfiguration())) goto error;
+  if (conf->fileState[iSUPP] == DISEASED) goto end;
+  if (!(supp = getSupport(result->name))) goto end;
+  supp->lastCheck = result->lastCheck;
+  supp->lastSeen = result->lastSeen;
+ end:
+  rc = TRUE;
+  if ((conf = releaseConfiguration())) outdatedManager(conf);
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "publishCheck fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : checkSupportFiles
+ * Description: Check the next support file that is due
+ * Synopsis   : static int checkSupportFiles(time_t* wait)
+ * Input      : N/A
+ * Output     : time_t* wait: delay before the next call
+ *              TRUE on success
+ * Note       : supports are read from a private snapshot and are only
+ *              written back if supports.txt was not modified meanwhile
+ *              (cf writeSupports). Checks are spread over half of the
+ *              fileTTL.
+ =======================================================================*/
+static int
+checkSupportFiles(time_t* wait)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  Support* supp = 0;
+  Support result;
+  struct stat statBuffer;
+  time_t now = 0;
+  int nbFiles = 0;
+  int isChecked = FALSE;
+
+  logMain(LOG_DEBUG, "checkSupportFiles");
+  *wait = CHECK_SUPP_IDLE;
+  if ((now = currentTime()) == -1) goto error;
+
+  // read metadata only (no git), as jobs do
+  if (!(conf = createConfiguration())) goto error;
+  if (!useConfiguration(conf)) goto error;
+  if (!parseConfiguration(conf->confFile)) goto error;
+  conf->fileState[iCFG] = LOADED;
+  if (stat(conf->supportDB, &statBuffer)) {
+    logMain(LOG_ERR, "stat %s fails: %s", 
+	    conf->supportDB, strerror(errno));
+    goto error;
+  }
+  if (!parseSupports(conf->supportDB)) goto error;
+  conf->fileState[iSUPP] = LOADED;
+
+  if (!(supp = nextSupportCheck(conf, now, wait, &nbFiles))) goto end;
+
+  // do not use all the disk bandwidth
+  logMain(LOG_NOTICE, "background check of \"%s\"", supp->name);
+  setIoPriority(conf->checkNice);
+  if (!doCheckSupport(supp, supp->name, conf->checkRate)) {
+    if (!env.running) goto end; // interrupted
+    logMain(LOG_WARNING, "\"%s\" support file seems lost", supp->name);
+    failSupportCheck(supp->name, now);
+    goto next;
+  }
+  result = *supp;
+
+  // do not overwrite a modification done by a client
+  if (!writeSupports(conf, &statBuffer, &isChecked)) goto error;
+  if (!isChecked) {
+    logMain(LOG_NOTICE, "will check \"%s\" again", supp->name);
+    goto next;
+  }
+  conf->fileState[iSUPP] = LOADED;
+
+ next:
+  *wait = spreadSupportChecks(conf, nbFiles, *wait);
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "checkSupportFiles fails");
+  }
+  useConfiguration(0);
+  conf = destroyConfiguration(conf);
+  if (isChecked && !publishCheck(&result)) rc = FALSE;
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : checkerThread
+ * Description: Check the support files from time to time
+ * Synopsis   : static void* checkerThread(void* arg)
+ * Input      : void* arg: N/A
+ * Output     : N/A
+ =======================================================================*/
+static void*
+checkerThread(void* arg)
+{
+  struct timespec until;
+  time_t wait = CHECK_SUPP_DELAY;
+
+  (void) arg;
+  pthread_mutex_lock(&checker.mutex);
+  while (checker.isRunning) {
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += wait;
+    pthread_cond_timedwait(&checker.cond, &checker.mutex, &until);
+    if (!checker.isRunning) break;
+    pthread_mutex_unlock(&checker.mutex);
+
+    if (!checkSupportFiles(&wait)) wait = CHECK_SUPP_IDLE;
+    if (wait < 1) wait = 1;
+
+    pthread_mutex_lock(&checker.mutex);
+  }
+  pthread_mutex_unlock(&checker.mutex);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : startChecker
+ * Description: Check the support files from a dedicated thread
+ * Synopsis   : int startChecker()
+ * Input      : N/A
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+startChecker()
+{
+  int rc = FALSE;
+  sigset_t mask;
+  sigset_t oldMask;
+  int err = 0;
+
+  logMain(LOG_DEBUG, "startChecker");
+  pthread_mutex_lock(&checker.mutex);
+  if (checker.isRunning) goto end;
+  checker.isRunning = TRUE;
+
+  // the checker must not catch the signals managed by sigwait
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+  err = pthread_create(&checker.thread, 0, checkerThread, 0);
+  pthread_sigmask(SIG_SETMASK, &oldMask, 0);
+  if (err) {
+    logMain(LOG_ERR, "pthread_create fails: %s", strerror(err));
+    checker.isRunning = FALSE;
+    goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  pthread_mutex_unlock(&checker.mutex);
+  if (!rc) {
+    logMain(LOG_ERR, "startChecker fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : stopChecker
+ * Description: Stop the checker thread
+ * Synopsis   : int stopChecker()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : a running check is interrupted as env.running is FALSE
+ *              (only if bandwidth is limited)
+ =======================================================================*/
+int
+stopChecker()
+{
+  int rc = FALSE;
+  int isRunning = FALSE;
+  int err = 0;
+
+  logMain(LOG_DEBUG, "stopChecker");
+  pthread_mutex_lock(&checker.mutex);
+  isRunning = checker.isRunning;
+  checker.isRunning = FALSE;
+  pthread_cond_broadcast(&checker.cond);
+  pthread_mutex_unlock(&checker.mutex);
+
+  if (isRunning && (err = pthread_join(checker.thread, 0))) {
+    logMain(LOG_ERR, "pthread_join fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "stopChecker fails");
+  }
+  return rc;
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
@@ -0,0 +1,44 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : checkSupp
+ *
+ * Background checks of the support files
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef MDTX_SERVER_CHECKSUPP_H
+#define MDTX_SERVER_CHECKSUPP_H 1
+
+#include "mediatex-types.h"
+
+/* API */
+
+Support* nextSupportCheck(Configuration* conf, time_t now, time_t* wait,
+			  int* nbFiles);
+time_t spreadSupportChecks(Configuration* conf, int nbFiles, time_t wait);
+void failSupportCheck(char* name, time_t now);
+
+int startChecker();
+int stopChecker();
+
+#endif /* MDTX_SERVER_CHECKSUPP_H */
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
@@ -182,7 +182,7 @@ int deliverArchive(Collection* coll, Archive* archive)
   if ((date = currentTime()) == -1) goto error; 
 
   // find longer to-Keep time to honnor all demands
-  while ((record = rgNext_r(archive->demands, &curr))) {
+  while ((record = rgNext_r(arDemands(archive), &curr))) {
     if (record->type & REMOVE) continue;
 
     switch (getRecordType(record)) {
@@ -223,8 +223,10 @@ int deliverArchive(Collection* coll, Archive* archive)
 
   // adjust the to-keep date
   if (todo >= localDemand) {
-    if (archive->localSupply->date < date)
+    if (archive->localSupply->date < date) {
       archive->localSupply->date = date;
+      if (!journalCacheEntry(coll, archive->localSupply)) goto error;
+    }
     if (archive->backupDate < date)
       archive->backupDate = date;
     if (!computeArchiveStatus(coll, archive)) goto error;
@@ -232,7 +234,7 @@ int deliverArchive(Collection* coll, Archive* archive)
 
   // deliver mails (for all final-demands but not on audit)
   curr = 0;
-  while ((record = rgNext_r(archive->demands, &curr))) {
+  while ((record = rgNext_r(arDemands(archive), &curr))) {
     if (record->type & REMOVE) continue;
     if (getRecordType(record) != FINAL_DEMAND) continue;
     if (!strncmp(record->extra, CONF_AUDIT, strlen(CONF_AUDIT))) continue;
@@ -120,7 +120,7 @@ getAbsoluteArchivePath(Collection* coll, Archive* archive)
   }
   else {
     // final supply
-    if (!(record = rgHead(archive->finalSupplies)) ||
+    if (!(record = rgHead(arFinalSupplies(archive))) ||
 	isEmptyString(record->extra)) goto error;      
   }
 
@@ -781,6 +781,7 @@ cacheSet(ExtractData* data, Record* record,
   relativeCachePath = absoluteCachePath + strlen(coll->cacheDir) + 1;
   record->extra = destroyString(record->extra);
   if (!(record->extra = createString(relativeCachePath))) goto error;
+  if (!journalCacheEntry(coll, record)) goto error;
 
   // add a toKepp on the new extracted archive
   if (!extractAddToKeep(data, record->archive)) goto error;
@@ -850,7 +851,7 @@ extractRecord(ExtractData* data, Record* sourceRecord)
   }
   // - first canonical target name (may be severals)
   if (sourceRecord->archive &&
-      (asso = rgHead(sourceRecord->archive->fromContainers))) {
+      (asso = rgHead(arFromContainers(sourceRecord->archive)))) {
     relativeCanonicalPath = asso->path;
     goto next;
   }
@@ -923,6 +924,7 @@ extractFromAsso(ExtractData* data, FromAsso* asso)
   Collection* coll = 0;
   Record* targetRecord = 0;
   char* absoluteExtractPath = 0;
+  struct timespec start;
  
   coll = data->coll;
   checkCollection(coll);
@@ -938,6 +940,7 @@ extractFromAsso(ExtractData* data, FromAsso* asso)
     goto error;
 
   // extract record into temporary extraction directory
+  perfBegin(start);
   switch (asso->container->type) {
   case ISO:
     if (!extractIso(coll, asso, absoluteExtractPath)) goto error;
@@ -990,6 +993,8 @@ extractFromAsso(ExtractData* data, FromAsso* asso)
 	    strEType(asso->container->type));
     goto error;
   }
+  perfEnd(PERF_EXTRACT + asso->container->type, start, 
+	  asso->archive->size);
   
   // toggle !malloc record to local supply
   if (!cacheSet(data, targetRecord, absoluteExtractPath, asso->path)) 
@@ -1052,7 +1057,7 @@ extractContainer(ExtractData* data, Container* container)
     curr = 0;
     while ((archive = rgNext_r(container->parents, &curr))) {
       if (archive->state >= AVAILABLE) continue;
-      if (archive->finalSupplies->nbItems == 0) continue;
+      if (arFinalSupplies(archive)->nbItems == 0) continue;
       
       logMain(LOG_INFO, "extract part from support");
       if (!extractArchive(data, archive, TRUE)) goto error;
@@ -1106,7 +1111,7 @@ extractArchive(ExtractData* data, Archive* archive, int doCp)
   // deliver this archive if extraction success,
   // if it match any CGI or local user demands
   curr = 0;
-  while ((record = rgNext_r(archive->demands, &curr))) {
+  while ((record = rgNext_r(arDemands(archive), &curr))) {
     if (getRecordType(record) & (LOCAL_DEMAND | FINAL_DEMAND)) {
       toDeliver = TRUE;
       break;
@@ -1130,7 +1135,7 @@ extractArchive(ExtractData* data, Archive* archive, int doCp)
   }
 
   // final supply
-  if (archive->finalSupplies->nbItems > 0) {
+  if (arFinalSupplies(archive)->nbItems > 0) {
 
     // copy archive into the cache if it helps
     if (archive->state == WANTED // localy (toDeliver) or remotely 
@@ -1141,7 +1146,7 @@ extractArchive(ExtractData* data, Archive* archive, int doCp)
       {
 	curr = 0;
 	while (!data->found &&
-	       (record = rgNext_r(archive->finalSupplies, &curr))) {	  
+	       (record = rgNext_r(arFinalSupplies(archive), &curr))) {	  
 	  data->found = extractRecord(data, record);
 	}
       }
@@ -1159,7 +1164,7 @@ extractArchive(ExtractData* data, Archive* archive, int doCp)
     else {
       curr = 0;
       while (!data->found &&
-	     (record = rgNext_r(archive->remoteSupplies, &curr))) {
+	     (record = rgNext_r(arRemoteSupplies(archive), &curr))) {
 	if (record->type & REMOVE) continue;
 
 	// nat server scp from nat clients on remote demand
@@ -1189,7 +1194,7 @@ extractArchive(ExtractData* data, Archive* archive, int doCp)
 
   curr = 0;
   while (!data->found && 
-	 (asso = rgNext_r(archive->fromContainers, &curr))) {
+	 (asso = rgNext_r(arFromContainers(archive), &curr))) {
     if (!extractContainer(data, asso->container)) goto error;
   }
 
@@ -1251,7 +1256,7 @@ extractArchives(Collection* coll)
   // try to extract/deliver all demands
   for (node = coll->cacheTree->archives->head; node; node = node->next) {
     archive = node->item;
-    if (isEmptyRing(archive->demands) &&
+    if (isEmptyRing(arDemands(archive)) &&
 	  // candidates for (local or remote) final supplies
 	!(archive->state < WANTED && isBadTopContainer(coll, archive)))
       continue;
@@ -1264,7 +1269,7 @@ extractArchives(Collection* coll)
 
     // but also do scp when archive is locally wanted...
     curr = 0;
-    while ((record = rgNext_r(archive->demands, &curr))) {
+    while ((record = rgNext_r(arDemands(archive), &curr))) {
       if (getRecordType(record) == FINAL_DEMAND) {
 	data.scpContext = X_DO_REMOTE_COPY;
 	break;
@@ -1274,7 +1279,7 @@ extractArchives(Collection* coll)
     // ...or if it is a top container having bad score,
     // not already burned locally
     if (isBadTopContainer(coll, archive) &&
-	!haveRecords(archive->finalSupplies))
+	!haveRecords(arFinalSupplies(archive)))
       data.scpContext = X_DO_REMOTE_COPY;
     
     rc2 = extractArchive(&data, archive, isBadTopContainer(coll, archive));
@@ -1289,6 +1294,9 @@ extractArchives(Collection* coll)
   rc = TRUE;
  error3:
   if (!unLockCache(coll)) rc = FALSE;
+
+  // free the records removed, unless another job is reading the cache
+  if (!reclaimCacheTree(coll)) rc = FALSE;
  error2:
   if (!releaseCollection(coll, SERV|EXTR|CACH)) goto error;
  error:
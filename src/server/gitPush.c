@@ -0,0 +1,746 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : gitPush
+ *
+ * Batch the git commits, pulls and pushes of the metadata modules, so
+ * as clients do not wait for git nor for the network (cf openClose.c)
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ =======================================================================*/
+
+#include "mediatex-config.h"
+#include "server/mediatex-server.h"
+#include <sys/wait.h>  // waitpid
+#include <sys/file.h>  // LOCK_EX
+
+// push wanted on a git module
+typedef struct PushJob {
+  char*  user;  // git module
+  time_t first; // first query not pushed yet
+  time_t due;   // end of the quiet period (or of the backoff)
+  int nbFailures;
+} PushJob;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  pthread_t thread;
+  int isRunning;
+  PushJob jobs[MAX_PUSH_JOB];
+  int nbJobs;
+  unsigned long nbPushes;  // done
+  unsigned long nbRetries; // failed and queued again
+} pusher = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+// process running the git scripts, forked before the threads
+static struct {
+  pthread_mutex_t mutex;
+  pid_t pid;
+  int query; // daemon -> helper
+  int reply; // helper -> daemon
+} helper = {PTHREAD_MUTEX_INITIALIZER, 0, -1, -1};
+
+/*=======================================================================
+ * Function   : writeString
+ * Description: Send a string to the helper (or back)
+ * Synopsis   : static int writeString(int fd, char* string)
+ * Input      : int fd: pipe to write
+ *              char* string: may be 0
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+writeString(int fd, char* string)
+{
+  size_t len = string?strlen(string):0;
+
+  return fdWrite(fd, &len, sizeof(len)) && fdWrite(fd, string, len);
+}
+
+/*=======================================================================
+ * Function   : readString
+ * Description: Get a string sent by writeString
+ * Synopsis   : static char* readString(int fd)
+ * Input      : int fd: pipe to read
+ * Output     : the string to free, 0 on error
+ =======================================================================*/
+static char*
+readString(int fd)
+{
+  char* rc = 0;
+  size_t len = 0;
+
+  if (fdRead(fd, &len, sizeof(len)) != sizeof(len)) goto error;
+  if (len > MAX_HELPER_STRING) goto error;
+  if (!(rc = malloc(len+1))) goto error;
+  if (fdRead(fd, rc, len) != len) goto error;
+  rc[len] = 0;
+  return rc;
+ error:
+  free(rc);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : helperLoop
+ * Description: Run the scripts asked by the daemon
+ * Synopsis   : static void helperLoop(int query, int reply)
+ * Input      : int query: pipe providing the scripts to run
+ *              int reply: pipe to return their status
+ * Output     : N/A (exit when the daemon closes the query pipe)
+ * Note       : this process has no thread, so execScript can fork
+ *              and change the user
+ =======================================================================*/
+static void
+helperLoop(int query, int reply)
+{
+  char* argv[MAX_HELPER_ARGS+1];
+  char* user = 0;
+  int argc = 0;
+  int rc = FALSE;
+  int i = 0;
+
+  memset(argv, 0, sizeof(argv));
+  while (fdRead(query, &argc, sizeof(argc)) == sizeof(argc)) {
+    if (argc < 1 || argc > MAX_HELPER_ARGS) break;
+    if (!(user = readString(query))) break;
+    for (i = 0; i < argc; ++i) {
+      if (!(argv[i] = readString(query))) goto error;
+    }
+
+    rc = execScript(argv, *user?user:0, 0, FALSE);
+    if (!fdWrite(reply, &rc, sizeof(rc))) goto error;
+
+    for (i = 0; i < argc; ++i) {
+      free(argv[i]);
+      argv[i] = 0;
+    }
+    free(user);
+    user = 0;
+  }
+ error:
+  _exit(EXIT_SUCCESS);
+}
+
+/*=======================================================================
+ * Function   : startGitHelper
+ * Description: Fork the process that will run the git scripts
+ * Synopsis   : int startGitHelper()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : must be called before any thread is started, as the
+ *              scripts run as the modules' users: forking from the
+ *              threaded daemon may dead-lock the child on a lock
+ *              (malloc, stdio, syslog) held by another thread.
+ =======================================================================*/
+int
+startGitHelper()
+{
+  int rc = FALSE;
+  int query[2] = {-1, -1};
+  int reply[2] = {-1, -1};
+
+  logMain(LOG_DEBUG, "startGitHelper");
+  if (helper.pid) goto end;
+  if (pipe(query) || pipe(reply)) {
+    logMain(LOG_ERR, "pipe fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // no other process must keep the pipes open
+  if (fcntl(query[0], F_SETFD, FD_CLOEXEC) == -1 ||
+      fcntl(query[1], F_SETFD, FD_CLOEXEC) == -1 ||
+      fcntl(reply[0], F_SETFD, FD_CLOEXEC) == -1 ||
+      fcntl(reply[1], F_SETFD, FD_CLOEXEC) == -1) {
+    logMain(LOG_ERR, "fcntl fails: %s", strerror(errno));
+    goto error;
+  }
+
+  fflush(stdout);
+  if ((helper.pid = fork()) == -1) {
+    logMain(LOG_ERR, "fork fails: %s", strerror(errno));
+    helper.pid = 0;
+    goto error;
+  }
+  if (helper.pid == 0) {
+    close(query[1]);
+    close(reply[0]);
+
+    // signals from the terminal are for the daemon only
+    if (setpgid(0, 0)) {
+      logMain(LOG_WARNING, "setpgid fails: %s", strerror(errno));
+    }
+    helperLoop(query[0], reply[1]);
+  }
+
+  close(query[0]);
+  close(reply[1]);
+  helper.query = query[1];
+  helper.reply = reply[0];
+ end:
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "startGitHelper fails");
+    if (query[0] != -1) close(query[0]);
+    if (query[1] != -1) close(query[1]);
+    if (reply[0] != -1) close(reply[0]);
+    if (reply[1] != -1) close(reply[1]);
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : stopGitHelper
+ * Description: End the process running the git scripts
+ * Synopsis   : int stopGitHelper()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : call it once the pusher is stopped
+ =======================================================================*/
+int
+stopGitHelper()
+{
+  int rc = FALSE;
+  pid_t pid = 0;
+
+  logMain(LOG_DEBUG, "stopGitHelper");
+  pthread_mutex_lock(&helper.mutex);
+  if (!helper.pid) goto end;
+
+  // the helper exits on end of file
+  close(helper.query);
+  close(helper.reply);
+  helper.query = helper.reply = -1;
+  while ((pid = waitpid(helper.pid, 0, 0)) == -1 && errno == EINTR);
+  if (pid == -1) {
+    logMain(LOG_ERR, "waitpid fails: %s", strerror(errno));
+    goto error;
+  }
+  helper.pid = 0;
+ end:
+  rc = TRUE;
+ error:
+  pthread_mutex_unlock(&helper.mutex);
+  if (!rc) {
+    logMain(LOG_ERR, "stopGitHelper fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : askGitHelper
+ * Description: Run a script from the helper process
+ * Synopsis   : int askGitHelper(char** argv, char* user)
+ * Input      : char** argv: the command line to run
+ *              char* user: user to become to before exec (or 0)
+ * Output     : TRUE if the script succeeds
+ =======================================================================*/
+int
+askGitHelper(char** argv, char* user)
+{
+  int rc = FALSE;
+  int rcHelper = FALSE;
+  int argc = 0;
+  int i = 0;
+
+  pthread_mutex_lock(&helper.mutex);
+  if (helper.query == -1) {
+    logMain(LOG_ERR, "the git helper is not started");
+    goto error;
+  }
+
+  while (argv[argc]) ++argc;
+  if (argc < 1 || argc > MAX_HELPER_ARGS) goto error;
+  if (!fdWrite(helper.query, &argc, sizeof(argc))) goto error;
+  if (!writeString(helper.query, user)) goto error;
+  for (i = 0; i < argc; ++i) {
+    if (!writeString(helper.query, argv[i])) goto error;
+  }
+
+  if (fdRead(helper.reply, &rcHelper, sizeof(rcHelper))
+      != sizeof(rcHelper)) {
+    logMain(LOG_ERR, "the git helper has gone");
+    goto error;
+  }
+  rc = rcHelper;
+ error:
+  pthread_mutex_unlock(&helper.mutex);
+  if (!rc) {
+    logMain(LOG_WARNING, "askGitHelper fails on %s", argv[0]);
+  }
+  return rc;
+}
+
+
+/*=======================================================================
+ * Function   : callScript
+ * Description: Run a git script from the helper process
+ * Synopsis   : static int callScript(Configuration* conf, char* script,
+ *                                    char* user, char* comment)
+ * Input      : Configuration* conf
+ *              char* script: "/commit.sh", "/pull.sh" or "/push.sh"
+ *              char* user: the git module
+ *              char* comment: commit message (or 0)
+ * Output     : TRUE on success
+ * Note       : not callCommit..., as git is disabled on daemon side.
+ *              The script is run by the helper process (cf
+ *              startGitHelper), not forked from this thread.
+ =======================================================================*/
+static int
+callScript(Configuration* conf, char* script, char* user, char* comment)
+{
+  int rc = FALSE;
+  char *argv[] = {0, 0, 0, 0};
+
+  if (!(argv[0] = createString(conf->scriptsDir))) goto error;
+  if (!(argv[0] = catString(argv[0], script))) goto error;
+  argv[1] = user;
+  argv[2] = comment;
+  if (!askGitHelper(argv, user)) goto error;
+
+  rc = TRUE;
+ error:
+  argv[0] = destroyString(argv[0]);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : readPendingCommit
+ * Description: Get the comments queued by the clients
+ * Synopsis   : static char* readPendingCommit(char* path)
+ * Input      : char* path: the GIT_PENDING_COMMIT file
+ * Output     : the commit message to free, 0 on error
+ * Note       : "manual user edition" if there is no comment.
+ *              Only the first comments are kept if they are too long.
+ =======================================================================*/
+static char*
+readPendingCommit(char* path)
+{
+  char* rc = 0;
+  size_t len = 0;
+  int fd = -1;
+
+  if (!(rc = malloc(MAX_HELPER_STRING))) goto error;
+  *rc = 0;
+
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    if (errno == ENOENT) goto end;
+    logMain(LOG_ERR, "open fails on %s: %s", path, strerror(errno));
+    goto error;
+  }
+  len = fdRead(fd, rc, MAX_HELPER_STRING-1);
+  rc[len] = 0;
+
+  // remove the last \n
+  while (len > 0 && rc[len-1] == '\n') rc[--len] = 0;
+ end:
+  if (!*rc) strcpy(rc, "manual user edition");
+  if (fd != -1) close(fd);
+  return rc;
+ error:
+  if (fd != -1) close(fd);
+  free(rc);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : getReflogSize
+ * Description: Tell if the HEAD of a module moves
+ * Synopsis   : static off_t getReflogSize(char* gitDir)
+ * Input      : char* gitDir: the module's working directory
+ * Output     : size of the HEAD's reflog (0 if not found)
+ =======================================================================*/
+static off_t
+getReflogSize(char* gitDir)
+{
+  char path[MAX_SIZE_STRING];
+  struct stat statBuffer;
+
+  snprintf(path, MAX_SIZE_STRING, "%s/.git/logs/HEAD", gitDir);
+  if (stat(path, &statBuffer)) return 0;
+  return statBuffer.st_size;
+}
+
+/*=======================================================================
+ * Function   : doSync
+ * Description: Commit, pull and push a git module
+ * Synopsis   : static int doSync(char* user)
+ * Input      : char* user: the git module to synchronise
+ * Output     : TRUE on success
+ * Note       : the comments queued by the clients are committed at
+ *              once (cf openClose.c::deferCommit). The module is
+ *              locked so as no client writes it meanwhile.
+ *              When the pull brings changes we reload (SIGHUP).
+ =======================================================================*/
+static int
+doSync(char* user)
+{
+  int rc = FALSE;
+  Configuration* conf = 0;
+  char* gitDir = 0;
+  char* path = 0;
+  char* comment = 0;
+  off_t reflog = 0;
+  int hasPulled = FALSE;
+  int lock = -1;
+
+  logMain(LOG_INFO, "sync %s", user);
+  if (!(conf = acquireConfiguration())) goto error;
+  if (!(gitDir = createString(conf->gitDir))) goto error2;
+  if (!(gitDir = catString(gitDir, user))) goto error2;
+  if (!(path = createString(gitDir))) goto error2;
+  if (!(path = catString(path, "/" GIT_PENDING_COMMIT))) goto error2;
+  if (env.noRegression || env.dryRun) goto end;
+
+  if ((lock = lockGitModule(gitDir, LOCK_EX)) == -1) goto error2;
+  if (!(comment = readPendingCommit(path))) goto error2;
+  if (!callScript(conf, "/commit.sh", user, comment)) goto error2;
+  if (unlink(path) == -1 && errno != ENOENT) {
+    logMain(LOG_WARNING, "unlink fails on %s: %s", path, strerror(errno));
+  }
+  reflog = getReflogSize(gitDir);
+  if (!callScript(conf, "/pull.sh", user, 0)) goto error2;
+  hasPulled = (getReflogSize(gitDir) != reflog);
+  unlockGitModule(lock);
+  lock = -1;
+
+  if (!callScript(conf, "/push.sh", user, 0)) goto error2;
+ end:
+  rc = TRUE;
+ error2:
+  unlockGitModule(lock);
+  if ((conf = releaseConfiguration())) outdatedManager(conf);
+ error:
+  if (!rc) {
+    logMain(LOG_WARNING, "doSync fails on %s", user);
+  }
+  if (hasPulled && env.running) {
+    logMain(LOG_NOTICE, "%s module was updated by the pull", user);
+    kill(getpid(), SIGHUP);
+  }
+  gitDir = destroyString(gitDir);
+  path = destroyString(path);
+  free(comment);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : retryPush
+ * Description: Queue again a push that fails
+ * Synopsis   : static void retryPush(PushJob* job)
+ * Input      : PushJob* job: the push that fails (consumed)
+ * Output     : N/A
+ * Note       : pusher.mutex is held.
+ *              The delay doubles on each failure, up to GIT_MAX_RETRY.
+ *              When stopping, we give up after the last try: commits
+ *              stay in the local module until its next push.
+ =======================================================================*/
+static void
+retryPush(PushJob* job)
+{
+  time_t delay = GIT_RETRY_DELAY;
+  int i = 0;
+
+  if (!pusher.isRunning) {
+    logMain(LOG_ERR, "give up pushing %s", job->user);
+    goto end;
+  }
+
+  // a query came meanwhile: it will push soon
+  for (i = 0; i < pusher.nbJobs; ++i) {
+    if (!strcmp(pusher.jobs[i].user, job->user)) break;
+  }
+  if (i < pusher.nbJobs) {
+    pusher.jobs[i].nbFailures = job->nbFailures + 1;
+    goto end;
+  }
+  if (pusher.nbJobs == MAX_PUSH_JOB) {
+    logMain(LOG_ERR, "give up pushing %s: too many git modules",
+	    job->user);
+    goto end;
+  }
+
+  for (i = 0; i < job->nbFailures && delay < GIT_MAX_RETRY; ++i) {
+    delay *= 2;
+  }
+  if (delay > GIT_MAX_RETRY) delay = GIT_MAX_RETRY;
+  logMain(LOG_WARNING, "push %s again in %lis", job->user,
+	  (long int)delay);
+
+  job->first = currentTime();
+  job->due = job->first + delay;
+  ++job->nbFailures;
+  pusher.jobs[pusher.nbJobs++] = *job;
+  job->user = 0;
+  ++pusher.nbRetries;
+  pthread_cond_broadcast(&pusher.cond);
+ end:
+  job->user = destroyString(job->user);
+}
+
+/*=======================================================================
+ * Function   : pusherThread
+ * Description: Push the git modules once they are quiet
+ * Synopsis   : static void* pusherThread(void* arg)
+ * Input      : void* arg: not used
+ * Output     : N/A
+ * Note       : the remaining pushes are done at once on exit.
+ *              Failed pushes are queued again (cf retryPush).
+ =======================================================================*/
+static void*
+pusherThread(void* arg)
+{
+  PushJob job;
+  struct timespec until;
+  time_t now = 0;
+  int next = 0;
+  int isDone = FALSE;
+  int i = 0;
+
+  (void) arg;
+  pthread_mutex_lock(&pusher.mutex);
+  while (pusher.isRunning || pusher.nbJobs > 0) {
+
+    // look for the next module to push
+    now = currentTime();
+    next = -1;
+    for (i = 0; i < pusher.nbJobs; ++i) {
+      if (next == -1 || pusher.jobs[i].due < pusher.jobs[next].due)
+	next = i;
+    }
+
+    if (next == -1) {
+      pthread_cond_wait(&pusher.cond, &pusher.mutex);
+      continue;
+    }
+    if (pusher.isRunning && pusher.jobs[next].due > now) {
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_sec += pusher.jobs[next].due - now;
+      pthread_cond_timedwait(&pusher.cond, &pusher.mutex, &until);
+      continue;
+    }
+
+    // consume it (queries coming meanwhile make a new job)
+    job = pusher.jobs[next];
+    pusher.jobs[next] = pusher.jobs[--pusher.nbJobs];
+    pthread_mutex_unlock(&pusher.mutex);
+
+    isDone = doSync(job.user);
+
+    pthread_mutex_lock(&pusher.mutex);
+    if (isDone) {
+      ++pusher.nbPushes;
+      job.user = destroyString(job.user);
+    }
+    else {
+      retryPush(&job);
+    }
+  }
+  pthread_mutex_unlock(&pusher.mutex);
+  return 0;
+}
+
+/*=======================================================================
+ * Function   : queuePush
+ * Description: Ask to push a git module
+ * Synopsis   : int queuePush(char* user)
+ * Input      : char* user: git module
+ * Output     : TRUE on success
+ * Note       : queries on a module are merged and pushed when it stay
+ *              quiet for GIT_QUIET_DELAY (at most GIT_MAX_DELAY after
+ *              the first query)
+ =======================================================================*/
+int
+queuePush(char* user)
+{
+  int rc = FALSE;
+  PushJob* job = 0;
+  time_t now = 0;
+  int i = 0;
+
+  checkLabel(user);
+  logMain(LOG_DEBUG, "queuePush %s", user);
+  now = currentTime();
+  pthread_mutex_lock(&pusher.mutex);
+  if (!pusher.isRunning) goto error2;
+
+  for (i = 0; i < pusher.nbJobs; ++i) {
+    if (!strcmp(pusher.jobs[i].user, user)) break;
+  }
+  if (i < pusher.nbJobs) {
+    job = pusher.jobs + i;
+  }
+  else {
+    if (pusher.nbJobs == MAX_PUSH_JOB) {
+      logMain(LOG_WARNING, "too many git modules to push");
+      goto error2;
+    }
+    job = pusher.jobs + pusher.nbJobs;
+    if (!(job->user = createString(user))) goto error2;
+    job->first = now;
+    job->nbFailures = 0;
+    ++pusher.nbJobs;
+  }
+
+  job->due = now + GIT_QUIET_DELAY;
+  if (job->due > job->first + GIT_MAX_DELAY) {
+    job->due = job->first + GIT_MAX_DELAY;
+  }
+  pthread_cond_broadcast(&pusher.cond);
+
+  rc = TRUE;
+ error2:
+  pthread_mutex_unlock(&pusher.mutex);
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "queuePush fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : queueAllPush
+ * Description: Ask to push all the git modules
+ * Synopsis   : int queueAllPush(Configuration* conf)
+ * Input      : Configuration* conf: snapshot providing the modules
+ * Output     : TRUE on success
+ * Note       : clients do not tell which module they have committed
+ =======================================================================*/
+int
+queueAllPush(Configuration* conf)
+{
+  int rc = FALSE;
+  Collection* coll = 0;
+  RGIT* curr = 0;
+
+  logMain(LOG_DEBUG, "queueAllPush");
+  if (!queuePush(env.confLabel)) goto error;
+  while ((coll = rgNext_r(conf->collections, &curr))) {
+    if (!queuePush(coll->user)) goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "queueAllPush fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : pusherStatus
+ * Description: Log the pushes
+ * Synopsis   : void pusherStatus(int priority)
+ * Input      : int priority: log level
+ * Output     : N/A
+ =======================================================================*/
+void
+pusherStatus(int priority)
+{
+  int i = 0;
+
+  pthread_mutex_lock(&pusher.mutex);
+  logMain(priority, "===");
+  logMain(priority, "git pushes: %lu done, %lu retried, %i queued",
+	  pusher.nbPushes, pusher.nbRetries, pusher.nbJobs);
+  for (i = 0; i < pusher.nbJobs; ++i) {
+    logMain(priority, "%s (%i failures)",
+	    pusher.jobs[i].user, pusher.jobs[i].nbFailures);
+  }
+  logMain(priority, "===");
+  pthread_mutex_unlock(&pusher.mutex);
+}
+
+/*=======================================================================
+ * Function   : startPusher
+ * Description: Push the git modules from a dedicated thread
+ * Synopsis   : int startPusher()
+ * Input      : N/A
+ * Output     : TRUE on success
+ =======================================================================*/
+int
+startPusher()
+{
+  int rc = FALSE;
+  sigset_t mask;
+  sigset_t oldMask;
+  int err = 0;
+
+  logMain(LOG_DEBUG, "startPusher");
+  pthread_mutex_lock(&pusher.mutex);
+  if (pusher.isRunning) goto end;
+  pusher.isRunning = TRUE;
+
+  // the pusher must not catch the signals managed by sigwait
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+  err = pthread_create(&pusher.thread, 0, pusherThread, 0);
+  pthread_sigmask(SIG_SETMASK, &oldMask, 0);
+  if (err) {
+    logMain(LOG_ERR, "pthread_create fails: %s", strerror(err));
+    pusher.isRunning = FALSE;
+    goto error;
+  }
+ end:
+  rc = TRUE;
+ error:
+  pthread_mutex_unlock(&pusher.mutex);
+  if (!rc) {
+    logMain(LOG_ERR, "startPusher fails");
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : stopPusher
+ * Description: Stop the pusher thread
+ * Synopsis   : int stopPusher()
+ * Input      : N/A
+ * Output     : TRUE on success
+ * Note       : wait for the queued pushes to be done
+ =======================================================================*/
+int
+stopPusher()
+{
+  int rc = FALSE;
+  int isRunning = FALSE;
+  int err = 0;
+
+  logMain(LOG_DEBUG, "stopPusher");
+  pthread_mutex_lock(&pusher.mutex);
+  isRunning = pusher.isRunning;
+  pusher.isRunning = FALSE;
+  pthread_cond_broadcast(&pusher.cond);
+  pthread_mutex_unlock(&pusher.mutex);
+
+  if (isRunning && (err = pthread_join(pusher.thread, 0))) {
+    logMain(LOG_ERR, "pthread_join fails: %s", strerror(err));
+    goto error;
+  }
+
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "stopPusher fails");
+  }
+  return rc;
+}
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
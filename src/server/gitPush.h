@@ -0,0 +1,46 @@
+/*=======================================================================
+ * Project: MediaTeX
+ * Module : gitPush
+ *
+ * Batch the git pushes of the metadata modules
+
+ MediaTex is an Electronic Records Management System
+ Copyright (C) 2014 2015 2016 2017 Nicolas Roche
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef MDTX_SERVER_GITPUSH_H
+#define MDTX_SERVER_GITPUSH_H 1
+
+#include "mediatex-types.h"
+
+/* API */
+
+int startGitHelper();
+int stopGitHelper();
+int askGitHelper(char** argv, char* user);
+
+int startPusher();
+int stopPusher();
+int queuePush(char* user);
+int queueAllPush(Configuration* conf);
+void pusherStatus(int priority);
+
+#endif /* MDTX_SERVER_GITPUSH_H */
+
+/* Local Variables: */
+/* mode: c */
+/* mode: font-lock */
+/* End: */
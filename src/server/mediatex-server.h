@@ -32,6 +32,8 @@
 #include "server/cgiSrv.h"
 #include "server/have.h"
 #include "server/notify.h"
+#include "server/checkSupp.h"
+#include "server/gitPush.h"
 
 #endif /* MDTX_SERVER_H */
 
@@ -107,7 +107,7 @@ notifyArchive(NotifyData* data, Archive* archive)
 
   // continue searching deeper if needed
   while (!data->found && 
-	(asso = rgNext_r(archive->fromContainers, &curr))) {
+	(asso = rgNext_r(arFromContainers(archive), &curr))) {
     if (!notifyContainer(data, asso->container)) goto error;
   }
 
@@ -148,7 +148,7 @@ getWantedRemoteArchives(Collection* coll)
 
     // look for a remote-demands
     curr = 0;
-    while ((record = rgNext_r(archive->demands, &curr))) {
+    while ((record = rgNext_r(arDemands(archive), &curr))) {
       if (getRecordType(record) != REMOTE_DEMAND) continue;
       
       logMain(LOG_INFO, "working on remote demand:");
@@ -198,7 +198,7 @@ addFinalDemands(NotifyData* data)
     
     // add (a uniq) final demand
     curr = 0;
-    while ((record = rgNext_r(archive->demands, &curr))) {
+    while ((record = rgNext_r(arDemands(archive), &curr))) {
       if (getRecordType(record) == FINAL_DEMAND) {
 
 	logMain(LOG_INFO, "found a final demand to notify:");
@@ -224,7 +224,7 @@ addFinalDemands(NotifyData* data)
 
     // ...relay NAT client's final demand too (as our)
     curr = 0;
-    while ((record = rgNext_r(archive->demands, &curr))) {
+    while ((record = rgNext_r(arDemands(archive), &curr))) {
       if (getRecordType(record) == REMOTE_DEMAND &&
 	rgShareItems(localhost->gateways, record->server->networks)) {
 	
@@ -408,7 +408,7 @@ addMotdPolicyAll(NotifyData* data)
     // for all top parents
     curr = 0;
     while ((archive = rgNext_r(container->parents, &curr))) {
-      if (archive->fromContainers->nbItems) continue;
+      if (arFromContainers(archive)->nbItems) continue;
 
       logMain(LOG_INFO, "%s", "ask for local image");
       if (!askForLocalImage(data, archive)) goto error;
@@ -490,8 +490,10 @@ sendRemoteNotifyServer(Server* server, RecordTree* recordTree,
 {
   int rc = FALSE;
   Collection* coll = 0;
-  int socket = -1;
   char* serverFP = 0;
+  char reply[576];
+  struct timespec start;
+  int isSent = FALSE;
 
   checkServer(server);
   if (recordTree == 0) goto error;
@@ -500,15 +502,15 @@ sendRemoteNotifyServer(Server* server, RecordTree* recordTree,
   logMain(LOG_DEBUG, "sendRemoteNotifyServer for %s/%s:%i",
  	  coll->label, server->host, server->mdtxPort);
   
-  // get a socket to the server
-  if ((socket = connectServer(server)) == -1) {
+  // send the archive tree (on a kept alive connection if any)
+  perfBegin(start);
+  if (origin) serverFP = origin->fingerPrint; // masquerade
+  isSent = exchangeServer(server, recordTree, serverFP, reply, sizeof(reply));
+  perfEnd(PERF_NOTIFY, start, 0); // failed round-trips are timed too
+  if (!isSent) {
     logMain(LOG_NOTICE, "cannot connect %s", server->host);
     goto end;
   }
-    
-  // send the archive tree
-  if (origin) serverFP = origin->fingerPrint; // masquerade
-  if (!upgradeServer(socket, recordTree, serverFP)) goto error;
   
   logMain(LOG_NOTICE, "%s:%i notified", server->host, server->mdtxPort);
  end:
@@ -517,7 +519,6 @@ sendRemoteNotifyServer(Server* server, RecordTree* recordTree,
   if (!rc) {
     logMain(LOG_ERR, "sendRemoteNotifyServer fails");
   }
-  if (!env.dryRun && socket != -1) close(socket);
   return rc;
 }
 
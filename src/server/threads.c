@@ -32,6 +32,9 @@ static pthread_mutex_t jobsMutex;
 static pthread_attr_t taskAttr;
 int taskSocketNumber = 0;
 int taskSignalNumber = 0;
+int taskIdleNumber = 0; // kept alive connections (own budget)
+static time_t lastJobEnds = 0;
+static int isReleased = FALSE; // extraction metadata freed since
 
 /*=======================================================================
  * Function   : initMutex
@@ -91,6 +94,31 @@ initThreadParamaters(pthread_attr_t *attr)
 };
 
 
+/*=======================================================================
+ * Function   : releaseIdleMetadata
+ * Description: Free extraction metadata when no job ran for a while
+ * Synopsis   : static void releaseIdleMetadata()
+ * Input      : N/A
+ * Output     : N/A
+ * Note       : called by sigManager, so not concurrent with HUP. No
+ *              job can start meanwhile as we hold jobsMutex.
+ =======================================================================*/
+static void
+releaseIdleMetadata()
+{
+  pthread_mutex_lock(&jobsMutex);
+  if (!hold && !isReleased && 
+      taskSocketNumber == 0 && taskSignalNumber == 0 &&
+      taskIdleNumber == 0 &&
+      currentTime() - lastJobEnds >= IDLE_METADATA_TTL) {
+    if (!serverDiseaseIdle()) {
+      logMain(LOG_WARNING, "fails to free idle metadata");
+    }
+    isReleased = TRUE;
+  }
+  pthread_mutex_unlock(&jobsMutex);
+}
+
 /*=======================================================================
  * Function   : sigManager
  * Description: Signal handler calling the callback function
@@ -110,6 +138,7 @@ sigManager(void* arg)
   struct sockaddr_in address;
   int port = 0;
   sigset_t mask;
+  struct timespec timeout;
 
   (void) arg;
 
@@ -123,10 +152,19 @@ sigManager(void* arg)
   if (sigaddset(&mask, SIGSEGV)) goto error;
   if (sigaddset(&mask, SIGINT)) goto error;
 
+  // wake up from time to time so as to free idle metadata
+  timeout.tv_sec = IDLE_METADATA_TTL / 5;
+  timeout.tv_nsec = 0;
+
   while (env.running) {
     sigNumber = -1;
-    if ((sigNumber = sigwaitinfo(&mask, 0)) == -1) {
+    if ((sigNumber = sigtimedwait(&mask, 0, &timeout)) == -1) {
       if (errno == EINTR) continue; // so as to manage debugging with gdb
+      if (errno == EAGAIN) {
+	releaseIdleMetadata();
+	expireServerConnections(FALSE);
+	continue;
+      }
       logMain(LOG_ERR, "sigwait fails: %s", strerror(errno));
       goto error;
     }
@@ -136,36 +174,28 @@ sigManager(void* arg)
     case SIGSEGV:
       logMain(LOG_ERR, "segfault (SIGSEGV)");
       reEnableALL();
+      logFlush(env.logHandler);
       kill(getpid(), SIGSEGV);
       goto error;
       break;
     case SIGINT:
       logMain(LOG_ERR, "stopped by user (SIGINT)");
       reEnableALL();
+      logFlush(env.logHandler);
       kill(getpid(), SIGINT);
       goto error;
       break;
 
     case SIGHUP:
-      // wait until no more job are running
-      hold = TRUE;
+      // no need to wait for jobs: they keep their configuration
       logMain(LOG_NOTICE, "accepting signal HUP");
-    retry1:
-      while (taskSocketNumber > 0 || taskSignalNumber > 0)
-	usleep(100000);
-
-      pthread_mutex_lock(&jobsMutex);
-      if (taskSocketNumber > 0) {
-	pthread_mutex_unlock(&jobsMutex);
-	goto retry1;
+      if (!hupManager()) {
+	logFlush(env.logHandler);
+	exit(1); // force exit if reload fails;
       }
-
-      if (!hupManager()) exit(1); // force exit if reload fails;
-      pthread_mutex_unlock(&jobsMutex);
       if (!env.noRegression) {
 	memoryStatus(LOG_NOTICE, __FILE__, __LINE__);
       }
-      hold = FALSE;
       continue;
 
     case SIGTERM:
@@ -175,11 +205,12 @@ sigManager(void* arg)
       hold = TRUE;
       logMain(LOG_NOTICE, "accepting signal TERM");
     retry2:
-      while (taskSocketNumber > 0 || taskSignalNumber > 0)
+      while (taskSocketNumber > 0 || taskSignalNumber > 0 ||
+	     taskIdleNumber > 0)
 	usleep(100000);
 
       pthread_mutex_lock(&jobsMutex);
-      if (taskSocketNumber > 0) {
+      if (taskSocketNumber > 0 || taskIdleNumber > 0) {
 	pthread_mutex_unlock(&jobsMutex);
 	goto retry2;
       }
@@ -189,15 +220,21 @@ sigManager(void* arg)
       taskSignalNumber = MAX_TASK_SIGNAL_THREAD; // (not needed here)
       pthread_mutex_unlock(&jobsMutex);
 
-      if (!termManager()) exit(2); // force exit if it fails;;
+      if (!termManager()) {
+	logFlush(env.logHandler);
+	exit(2); // force exit if it fails;;
+      }
 
       // connect ouself in order to force exit from accept
       rc = TRUE;
       rc=rc&& (port = getConfiguration()->mdtxPort);
       rc=rc&& buildSocketAddressEasy(&address, 0x7f000001, 
 				      getConfiguration()->mdtxPort);
-      rc=rc&& connectTcpSocket(&address);
-      if (!rc) exit(3); // force exit if socket fails
+      rc=rc&& connectTcpSocket(&address, CONNECT_TIMEOUT, 0);
+      if (!rc) {
+	logFlush(env.logHandler);
+	exit(3); // force exit if socket fails
+      }
 
     case SIGUSR1:
       logMain(LOG_NOTICE, "accepting signal USR1");    
@@ -245,8 +282,15 @@ sigManager(void* arg)
  =======================================================================*/
 void signalJobEnds()
 {
+  Configuration* conf = 0;
+
+  // free the configuration if replaced by a HUP meanwhile
+  if ((conf = releaseConfiguration())) outdatedManager(conf);
+
   pthread_mutex_lock(&jobsMutex);
   taskSignalNumber--;
+  lastJobEnds = currentTime();
+  isReleased = FALSE;
   pthread_mutex_unlock(&jobsMutex);
 
   if (!env.noRegression) {
@@ -284,6 +328,7 @@ serverManager(int sock, struct sockaddr_in* address_accepted)
   memset(connexion, 0, sizeof (struct Connexion));
   connexion->sock = sock;
   connexion->ipv4 = ntohl(address_accepted->sin_addr.s_addr);
+  // the IP until the resolver thread get the name
   connexion->host = getHostNameByAddr(&address_accepted->sin_addr);
   port = ntohs(address_accepted->sin_port);
 
@@ -348,8 +393,20 @@ serverManager(int sock, struct sockaddr_in* address_accepted)
  =======================================================================*/
 void socketJobEnds(Connexion* connexion)
 {
+  Configuration* conf = 0;
+
+  // free the configuration if replaced by a HUP meanwhile
+  if ((conf = releaseConfiguration())) outdatedManager(conf);
+
   pthread_mutex_lock(&jobsMutex);
-  taskSocketNumber--;
+  if (connexion && connexion->isIdle) {
+    taskIdleNumber--;
+  }
+  else {
+    taskSocketNumber--;
+  }
+  lastJobEnds = currentTime();
+  isReleased = FALSE;
   pthread_mutex_unlock(&jobsMutex);
 
   // connexion variable is managed the calling thread
@@ -369,6 +426,69 @@ void socketJobEnds(Connexion* connexion)
 }
 
 
+/*=======================================================================
+ * Function   : socketJobIdles
+ * Description: Give back the socket thread slot while a kept alive
+ *              connection waits for its next frame
+ * Synopsis   : int socketJobIdles(Connexion* connexion)
+ * Input      : Connexion* connexion
+ * Output     : FALSE if too many connections are already idle
+ * Note       : idle connections have their own budget 
+ *              (MAX_TASK_IDLE_THREAD) so as they never delay the
+ *              new incoming connections
+ =======================================================================*/
+int socketJobIdles(Connexion* connexion)
+{
+  int rc = FALSE;
+
+  pthread_mutex_lock(&jobsMutex);
+  if (!hold && taskIdleNumber+1 <= MAX_TASK_IDLE_THREAD) {
+    taskSocketNumber--;
+    ++taskIdleNumber;
+    connexion->isIdle = TRUE;
+    lastJobEnds = currentTime();
+    isReleased = FALSE;
+    rc = TRUE;
+  }
+  pthread_mutex_unlock(&jobsMutex);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : socketJobWakes
+ * Description: Take back a socket thread slot as a frame is coming
+ * Synopsis   : int socketJobWakes(Connexion* connexion)
+ * Input      : Connexion* connexion
+ * Output     : FALSE if the daemon is stopping
+ * Note       : wait like serverManager do for a new connection, but
+ *              without sleeping for long as the peer is waiting
+ =======================================================================*/
+int socketJobWakes(Connexion* connexion)
+{
+  int rc = FALSE;
+
+ retry:
+  while (hold || taskSocketNumber+1 > MAX_TASK_SOCKET_THREAD) {
+    if (!env.running || hold) goto error;
+    usleep(100000);
+  };
+
+  // manage concurency with serverManager and SIGTERM
+  pthread_mutex_lock(&jobsMutex);
+  if (hold || taskSocketNumber+1 > MAX_TASK_SOCKET_THREAD) {
+    pthread_mutex_unlock(&jobsMutex);
+    goto retry;
+  }
+  ++taskSocketNumber;
+  taskIdleNumber--;
+  connexion->isIdle = FALSE;
+  pthread_mutex_unlock(&jobsMutex);
+
+  rc = TRUE;
+ error:
+  return rc;
+}
+
 /*=======================================================================
  * Function   : mainLoop
  * Description: Initialize the server connexions
@@ -380,20 +500,30 @@ int
 mainLoop()
 {
   int rc = FALSE;
+  Configuration* conf = 0;
   pthread_t thread;
   int err = 0;
+  int port = 0;
   char service[32] = "[place to write port number]";
   struct sockaddr_in address;
  
   // initializing 
+  lastJobEnds = currentTime();
   if (!initThreadParamaters(&taskAttr)) goto error;
   if (!mdtxShmInitialize()) goto error;
   if (!manageSignals(sigManager, &thread)) goto error;
+  if (!startResolver()) goto error;
+  if (!startChecker()) goto error;
+  if (!startPusher()) goto error;
+
+  // the signal thread may free the configuration meanwhile (HUP)
+  if (!(conf = acquireConfiguration())) goto error;
+  port = conf->mdtxPort;
+  if ((conf = releaseConfiguration())) outdatedManager(conf);
 
   // convert port into char*
-  if (sprintf(service, "%i", getConfiguration()->mdtxPort) < 0) {
-    logMain(LOG_ERR, "cannot convert %i port number into service", 
-	    getConfiguration()->mdtxPort);
+  if (sprintf(service, "%i", port) < 0) {
+    logMain(LOG_ERR, "cannot convert %i port number into service", port);
     goto error;
   }
   
@@ -415,6 +545,9 @@ mainLoop()
     rc = FALSE;
   }
   if (!mdtxShmFree()) rc = FALSE;
+  if (!stopPusher()) rc = FALSE;
+  if (!stopChecker()) rc = FALSE;
+  if (!stopResolver()) rc = FALSE;
   if (thread && (err = pthread_join(thread, 0))) {
     logMain(LOG_ERR, "pthread_join fails: %s", strerror(err));
     goto error;
@@ -33,11 +33,13 @@ typedef struct Connexion {
   Server* server;
   char status[576];
   RecordTree* message;
+  int isIdle; // waiting for the next frame (cf socketJobIdles)
 } Connexion;
 
 // callback functions requiered
 extern int hupManager();
 extern int termManager();
+extern int outdatedManager(Configuration* conf);
 extern void* signalJob(void* arg);
 extern void* socketJob(void* arg);
 
@@ -45,6 +47,10 @@ extern void* socketJob(void* arg);
 void signalJobEnds();
 void socketJobEnds(Connexion* connexion);
 
+// to be called by socketJob around the wait for the next frame
+int socketJobIdles(Connexion* connexion);
+int socketJobWakes(Connexion* connexion);
+
 // main thread
 int mainLoop();
 
@@ -23,21 +23,20 @@
 
 #include "mediatex-config.h"
 #include "server/mediatex-server.h"
+#include <openssl/md5.h>
+#include <sys/file.h>
 
 /*=======================================================================
- * Function   : cacheUpload
- * Description: call extract to upload a file on cache
- * Synopsis   : static int 
- *              cacheUpload(Collection* coll, off_t need, int* rcode)
- * Input      : Collection* collection: collections to use
- *              Record*: file to upload
+ * Function   : setUploadTarget
+ * Description: add the default target path if none is provided
+ * Synopsis   : static int setUploadTarget(Record* record)
+ * Input      : Record*: file to upload ("/source[:target]")
  * Output     : TRUE on success
  =======================================================================*/
 static int
-cacheUpload(Collection* coll, Record* record)
+setUploadTarget(Record* record)
 {
   int rc = FALSE;
-  ExtractData data;
   char* ptr = 0;
   char buf[MAX_SIZE_STRING];
   struct tm date;
@@ -47,14 +46,6 @@ cacheUpload(Collection* coll, Record* record)
     goto error;
   }
 
-  logMain(LOG_DEBUG, "upload file: %s", record->extra);
-  checkCollection(coll);
-  memset(&data, 0, sizeof(ExtractData));
-  if (!(data.toKeeps = createRing())) goto error;
-  data.scpContext = X_NO_REMOTE_COPY;
-  data.cpContext  = X_DO_LOCAL_COPY;
-  data.coll = coll;
-
   // (double) check we get a final supplies
   if (record->extra[0] != '/' || 
       // and not a directory name (ending by '/')
@@ -83,6 +74,39 @@ cacheUpload(Collection* coll, Record* record)
     if (!(record->extra = catString(record->extra, buf))) goto error;
   }
 
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "setUploadTarget fails");
+  } 
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cacheUpload
+ * Description: call extract to upload a file on cache
+ * Synopsis   : static int 
+ *              cacheUpload(Collection* coll, off_t need, int* rcode)
+ * Input      : Collection* collection: collections to use
+ *              Record*: file to upload
+ * Output     : TRUE on success
+ =======================================================================*/
+static int
+cacheUpload(Collection* coll, Record* record)
+{
+  int rc = FALSE;
+  ExtractData data;
+
+  logMain(LOG_DEBUG, "upload file: %s", record->extra);
+  checkCollection(coll);
+  memset(&data, 0, sizeof(ExtractData));
+  if (!(data.toKeeps = createRing())) goto error;
+  data.scpContext = X_NO_REMOTE_COPY;
+  data.cpContext  = X_DO_LOCAL_COPY;
+  data.coll = coll;
+
+  if (!setUploadTarget(record)) goto error;
+
   // do the upload
   if (!extractArchive(&data, record->archive, TRUE)) goto error;
   if (!extractDelToKeeps(coll, data.toKeeps)) goto error;
@@ -99,14 +123,256 @@ cacheUpload(Collection* coll, Record* record)
 }
 
 /*=======================================================================
- * Function   : uploadFinaleArchive
- * Description: Upload a new final supply into the cache
- * Synopsis   : int uploadFinaleArchive(ArchiveTree* finalSupplies)
+ * Function   : getPartPath
+ * Description: path of the partial content of a streamed upload
+ * Synopsis   : static char* getPartPath(Collection* coll, 
+ *                                       Archive* archive)
+ * Input      : Collection* coll
+ *              Archive* archive: archive being uploaded
+ * Output     : allocated absolute path, 0 on error
+ * Note       : the name only depends on the archive, so as an 
+ *              interrupted upload may be resumed later
+ =======================================================================*/
+static char*
+getPartPath(Collection* coll, Archive* archive)
+{
+  char* rc = 0;
+  char buf[MAX_SIZE_MD5 + MAX_SIZE_SIZE + 3];
+
+  sprintf(buf, "%s-%lli", archive->hash, (long long int)archive->size);
+  if (!(rc = createString(coll->cacheDir)) ||
+      !(rc = catString(rc, "/" UPLOAD_PART_PREFIX)) ||
+      !(rc = catString(rc, buf))) {
+    logMain(LOG_ERR, "getPartPath fails");
+    rc = destroyString(rc);
+  }
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : cacheStream
+ * Description: receive a file to upload from the socket
+ * Synopsis   : static int cacheStream(Connexion* connexion, 
+ *                                     Record* record)
+ * Input      : Connexion* connexion: having the socket
+ *              Record*: file to upload
+ * Output     : TRUE on success
+ * Note       : content is written into the cache while it is hashed,
+ *              and only renamed to its target if both size and hash
+ *              match the record. The partial content is kept if the
+ *              connection is lost (or no chunk comes for
+ *              UPLOAD_RECV_TIMEOUT seconds), so as the next try only
+ *              send the remaining content. Partials not resumed are
+ *              removed by the cache scan (cf scanPartFile).
+ *              The caller holds the cache read lock: it is released
+ *              while receiving (the place is already reserved) and
+ *              taken back to index the new record. A partial file is
+ *              only written by the stream holding its flock.
+ =======================================================================*/
+static int
+cacheStream(Connexion* connexion, Record* record)
+{
+  int rc = FALSE;
+  Collection* coll = 0;
+  Archive* archive = 0;
+  Record* targetRecord = 0;
+  char* target = 0;
+  char* partPath = 0;
+  char* absoluteCachePath = 0;
+  char buffer[4096];
+  char reply[64];
+  char hash[MAX_SIZE_MD5 + 1];
+  unsigned char md5sum[MD5_DIGEST_LENGTH];
+  MD5_CTX md5Ctx;
+  struct stat statBuffer;
+  struct stat partStat;
+  off_t offset = 0;
+  off_t len = 0;
+  size_t n = 0;
+  int fd = -1;
+  int isCorrupted = FALSE;
+  int isDeadline = FALSE;
+  int isUnlocked = FALSE;
+  int i = 0;
+
+  static char status[][64] = {
+    "316 upload interrupted for %s:%lli",
+    "317 no place into the cache for %s:%lli",
+    "314 size mismatch for %s:%lli",
+    "315 hash mismatch for %s:%lli",
+    "318 upload already in progress for %s:%lli"
+  };
+
+  coll = connexion->message->collection;
+  archive = record->archive;
+  checkCollection(coll);
+  checkArchive(archive);
+  logMain(LOG_DEBUG, "stream file: %s", record->extra);
+  sprintf(connexion->status, status[0], 
+	  archive->hash, (long long int)archive->size);
+
+  if (!setUploadTarget(record)) goto error;
+  if (!(target = getFinalSupplyOutPath(coll, record))) goto error;
+
+  // allocate place on cache
+  if (!cacheAlloc(&targetRecord, coll, archive)) {
+    sprintf(connexion->status, status[1], 
+	    archive->hash, (long long int)archive->size);
+    goto error;
+  }
+
+  // resume from the partial content if any (hash it again)
+  if (!(partPath = getPartPath(coll, archive))) goto error;
+  if ((fd = open(partPath, O_RDWR | O_CREAT, 0660)) == -1) {
+    logMain(LOG_ERR, "open %s fails: %s", partPath, strerror(errno));
+    goto error;
+  }
+
+  // only one stream per partial file (that must still be the one named)
+  if (flock(fd, LOCK_EX | LOCK_NB)) {
+    if (errno != EWOULDBLOCK) {
+      logMain(LOG_ERR, "flock fails: %s", strerror(errno));
+      goto error;
+    }
+    sprintf(connexion->status, status[4], 
+	    archive->hash, (long long int)archive->size);
+    goto error;
+  }
+  if (fstat(fd, &statBuffer)) {
+    logMain(LOG_ERR, "fstat fails: %s", strerror(errno));
+    goto error;
+  }
+  if (stat(partPath, &partStat) || 
+      partStat.st_ino != statBuffer.st_ino ||
+      partStat.st_dev != statBuffer.st_dev) {
+    // renamed or removed by the previous stream meanwhile
+    sprintf(connexion->status, status[4], 
+	    archive->hash, (long long int)archive->size);
+    goto error;
+  }
+  if (statBuffer.st_size > archive->size && ftruncate(fd, 0)) {
+    logMain(LOG_ERR, "ftruncate fails: %s", strerror(errno));
+    goto error;
+  }
+  MD5_Init(&md5Ctx);
+  while ((n = fdRead(fd, buffer, sizeof(buffer))) > 0) {
+    MD5_Update(&md5Ctx, buffer, n);
+    offset += n;
+  }
+  if (offset) {
+    logMain(LOG_NOTICE, "resume upload of %s:%lli from %lli", 
+	    archive->hash, (long long int)archive->size, 
+	    (long long int)offset);
+  }
+
+  // other threads may use the cache while we are receiving
+  if (!unLockCache(coll)) goto error;
+  isUnlocked = TRUE;
+
+  // ask the client for the remaining content
+  sprintf(reply, "%s %lli\n", STREAM_CONTINUE, (long long int)offset);
+  if (!tcpWrite(connexion->sock, reply, strlen(reply))) goto error;
+
+  // a stalled client must not hold the thread nor the allocation
+  if (!setRecvDeadline(connexion->sock, UPLOAD_RECV_TIMEOUT)) goto error;
+  isDeadline = TRUE;
+  while ((len = readChunk(connexion->sock)) > 0) {
+    if (offset + len > archive->size) {
+      sprintf(connexion->status, status[2], 
+	      archive->hash, (long long int)archive->size);
+      isCorrupted = TRUE;
+      goto error;
+    }
+    while (len > 0) {
+      n = (len < (off_t)sizeof(buffer))?len:sizeof(buffer);
+      if (fdRead(connexion->sock, buffer, n) != n) {
+	logMain(LOG_ERR, "chunk is truncated");
+	goto error;
+      }
+      if (!fdWrite(fd, buffer, n)) goto error;
+      MD5_Update(&md5Ctx, buffer, n);
+      offset += n;
+      len -= n;
+    }
+  }
+  if (len == -1) goto error;
+  if (!setRecvDeadline(connexion->sock, 0)) goto error;
+  isDeadline = FALSE;
+
+  // check integrity
+  MD5_Final(md5sum, &md5Ctx);
+  for (i = 0; i < MD5_DIGEST_LENGTH; ++i) {
+    sprintf(hash + (i<<1), "%02x", md5sum[i]);
+  }
+  if (offset != archive->size) {
+    sprintf(connexion->status, status[2], 
+	    archive->hash, (long long int)archive->size);
+    isCorrupted = TRUE;
+    goto error;
+  }
+  if (strncmp(hash, archive->hash, MAX_SIZE_MD5)) {
+    sprintf(connexion->status, status[3], 
+	    archive->hash, (long long int)archive->size);
+    isCorrupted = TRUE;
+    goto error;
+  }
+  // rename into the cache (created there, so honor default acl)
+  if (!lockCacheRead(coll)) goto error;
+  isUnlocked = FALSE;
+  if (!buildTargetFile(coll, &absoluteCachePath, coll->cacheDir, target))
+    goto error;
+  logMain(LOG_INFO, "move %s to %s", partPath, absoluteCachePath);
+  if (rename(partPath, absoluteCachePath)) {
+    logMain(LOG_ERR, "rename fails: %s", strerror(errno));
+    goto error;
+  }
+
+  // keep the flock until renamed, so as nobody writes it again
+  if (close(fd)) {
+    logMain(LOG_ERR, "close fails: %s", strerror(errno));
+    goto error;
+  }
+  fd = -1;
+
+  // toggle !malloc record to local-supply
+  targetRecord->extra = destroyString(targetRecord->extra);
+  if (!(targetRecord->extra = 
+	createString(absoluteCachePath + strlen(coll->cacheDir) + 1)))
+    goto error;
+  if (!journalCacheEntry(coll, targetRecord)) goto error;
+  targetRecord = 0;
+
+  logMain(LOG_NOTICE, "%s:%lli uploaded", 
+	  archive->hash, (long long int)archive->size);
+  rc = TRUE;
+ error:
+  if (!rc) {
+    logMain(LOG_ERR, "cacheStream fails");
+    if (isCorrupted && partPath && unlink(partPath)) {
+      logMain(LOG_ERR, "unlink fails: %s", strerror(errno));
+    }
+  } 
+  if (isDeadline) setRecvDeadline(connexion->sock, 0);
+  if (fd != -1) close(fd);
+  if (isUnlocked && !lockCacheRead(coll)) rc = FALSE;
+  if (targetRecord) delCacheEntry(coll, targetRecord);
+  destroyString(absoluteCachePath);
+  destroyString(partPath);
+  destroyString(target);
+  return rc;
+}
+
+/*=======================================================================
+ * Function   : uploadArchives
+ * Description: Upload new final supplies into the cache
+ * Synopsis   : static int uploadArchives(Connexion* connexion, 
+ *                                        int isStreamed)
  * Input      : Connexion* connexion
+ *              int isStreamed: contents come from the socket
  * Output     : TRUE on success
  =======================================================================*/
-int 
-uploadFinaleArchive(Connexion* connexion)
+static int 
+uploadArchives(Connexion* connexion, int isStreamed)
 {
   int rc = FALSE;
   Collection* coll = 0;
@@ -120,7 +386,7 @@ uploadFinaleArchive(Connexion* connexion)
     "313 already exists %s:%lli"
   };
 
-  logMain(LOG_DEBUG, "uploadFinaleArchive");
+  logMain(LOG_DEBUG, "uploadArchives");
   coll = connexion->message->collection;
   checkCollection(coll);
   
@@ -159,7 +425,12 @@ uploadFinaleArchive(Connexion* connexion)
     if (!addCacheEntry(coll, record)) goto error3;
   
     // extract the final supply into the cache
-    if (!(cacheUpload(coll, record))) goto error4;
+    if (isStreamed) {
+      if (!(cacheStream(connexion, record))) goto error4;
+    }
+    else {
+      if (!(cacheUpload(coll, record))) goto error4;
+    }
   }
   
   // record remains into the cache ; tree free by caller
@@ -181,11 +452,51 @@ uploadFinaleArchive(Connexion* connexion)
   if (!releaseCollection(coll, EXTR | CACH)) rc = FALSE;
  error:
   if (!rc) {
-    logMain(LOG_ERR, "uploadFinaleArchive fails");
+    logMain(LOG_ERR, "%s fails", 
+	    isStreamed?"uploadStreamArchive":"uploadFinaleArchive");
   }
   return rc;
 } 
 
+/*=======================================================================
+ * Function   : uploadFinaleArchive
+ * Description: Upload a new final supply into the cache
+ * Synopsis   : int uploadFinaleArchive(Connexion* connexion)
+ * Input      : Connexion* connexion
+ * Output     : TRUE on success
+ * Note       : the daemon copy the files from the client's paths
+ =======================================================================*/
+int 
+uploadFinaleArchive(Connexion* connexion)
+{
+  logMain(LOG_DEBUG, "uploadFinaleArchive");
+  return uploadArchives(connexion, FALSE);
+}
+
+/*=======================================================================
+ * Function   : uploadStreamArchive
+ * Description: Upload a new final supply streamed by the client
+ * Synopsis   : int uploadStreamArchive(Connexion* connexion)
+ * Input      : Connexion* connexion
+ * Output     : TRUE on success
+ * Note       : the client send the files' contents on the socket
+ *              (cf streamServer), so the daemon do not need to be 
+ *              allowed to read them. On failure, the connection is
+ *              not kept alive.
+ =======================================================================*/
+int 
+uploadStreamArchive(Connexion* connexion)
+{
+  int rc = FALSE;
+
+  logMain(LOG_DEBUG, "uploadStreamArchive");
+  if (!(rc = uploadArchives(connexion, TRUE))) {
+    // remaining chunks must not be read as the next frames
+    shutdown(connexion->sock, SHUT_RD);
+  }
+  return rc;
+}
+
 /* Local Variables: */
 /* mode: c */
 /* mode: font-lock */
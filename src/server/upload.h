@@ -30,6 +30,7 @@
 /* API */
 
 int uploadFinaleArchive(Connexion* connexion);
+int uploadStreamArchive(Connexion* connexion);
 
 #endif /* MDTX_SERVER_UPLOAD_H */
 